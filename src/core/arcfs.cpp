@@ -107,6 +107,9 @@ cArchiveFileSystem *cArchiveFileSystem::Open ( const char *filename )
 cArchiveFileSystem::cArchiveFileSystem ( cPseudoFileSystem *container ) :
     m_Container ( container ),
     m_Decoder ( NULL ),
+    m_Input ( NULL ),
+    m_InputSize ( 0 ),
+    m_DataStart ( 0 ),
     m_FileCount ( 0 ),
     m_FileIndex ( 0 ),
     m_TotalSectors ( 0 )
@@ -136,31 +139,37 @@ cArchiveFileSystem::~cArchiveFileSystem ()
         delete [] * ( UCHAR ** ) &fdr->reserved2;
         delete * ( sSector ** ) &fdr->DataChain;
     }
-    
+
+    delete m_Decoder;
+    delete [] m_Input;
+
     m_Container->Release ( this );
 }
 
 //------------------------------------------------------------------------------
-// Procedure:   cArchiveFileSystem::DirectoryCallback
-// Purpose:
+// Procedure:   cArchiveFileSystem::LoadDirectory
+// Purpose:     Add the entries in one directory sector of the archive
 // Parameters:
-// Returns:
+// Returns:     true if this is the last directory sector
 // Notes:
 //------------------------------------------------------------------------------
-bool cArchiveFileSystem::DirectoryCallback ( void *buffer, size_t size, void *token )
+bool cArchiveFileSystem::LoadDirectory ( const UCHAR *buffer )
 {
-    FUNCTION_ENTRY ( token, "cArchiveFileSystem::DirectoryCallback", false );
+    FUNCTION_ENTRY ( this, "cArchiveFileSystem::LoadDirectory", true );
 
-    cArchiveFileSystem *me = ( cArchiveFileSystem * ) token;
-
-    sArcFileDescriptorRecord *arc = ( sArcFileDescriptorRecord * ) buffer;
+    const sArcFileDescriptorRecord *arc = ( const sArcFileDescriptorRecord * ) buffer;
 
     // Populate the directory
     for ( int i = 0; i < 14; i++ ) {
 
         if ( IsValidName ( arc->FileName ) == false ) break;
 
-        sFileDescriptorRecord *fdr = &me->m_Directory [me->m_FileCount++];
+        if ( m_FileCount == ( int ) SIZE ( m_Directory )) {
+            WARNING ( "Too many files in archive" );
+            break;
+        }
+
+        sFileDescriptorRecord *fdr = &m_Directory [m_FileCount++];
 
         // Copy the fields from the .ark directory to the FDR
         memcpy ( fdr->FileName, arc->FileName, MAX_FILENAME );
@@ -171,9 +180,9 @@ bool cArchiveFileSystem::DirectoryCallback ( void *buffer, size_t size, void *to
         fdr->RecordLength      = arc->RecordLength;
         fdr->NoFixedRecords    = arc->NoFixedRecords;
 
-        // Allocate space for the file's data and store the pointer in a reserved portion of the FDR
-        int totalSectors = GetUSHORT ( &fdr->TotalSectors );
-        * ( UCHAR ** ) &fdr->reserved2 = new UCHAR [ DEFAULT_SECTOR_SIZE * totalSectors ];
+        // The file's data is decoded by LoadMember when it is opened, the
+        //   pointer to it is kept in a reserved portion of the FDR
+        * ( UCHAR ** ) &fdr->reserved2 = NULL;
 
         // Allocate a fake sector for use by this file
         sSector *sector = new sSector;
@@ -181,52 +190,22 @@ bool cArchiveFileSystem::DirectoryCallback ( void *buffer, size_t size, void *to
         sector->Size = DEFAULT_SECTOR_SIZE;
         * ( sSector ** ) &fdr->DataChain = sector;
 
-        me->m_TotalSectors += totalSectors + 1;
+        m_TotalSectors += GetUSHORT ( &fdr->TotalSectors ) + 1;
 
         arc++;
     }
 
-    // Look for the end of the directory and swith to the data callback
-    if ( memcmp (( char * ) buffer + 252, "END!", 4 ) == 0 ) {
-        // Set up the call back for the first file
-        return DataCallback ( buffer, size, token );
-    }
-
-    return true;
+    // Look for the end of the directory
+    return ( memcmp ( buffer + 252, "END!", 4 ) == 0 ) ? true : false;
 }
 
-//------------------------------------------------------------------------------
-// Procedure:   cArchiveFileSystem::DataCallback
-// Purpose:
-// Parameters:
-// Returns:
-// Notes:
-//------------------------------------------------------------------------------
-bool cArchiveFileSystem::DataCallback ( void *buffer, size_t size, void *token )
-{
-    FUNCTION_ENTRY ( token, "cArchiveFileSystem::DataCallback", false );
-
-    cArchiveFileSystem *me = ( cArchiveFileSystem * ) token;
-
-    // Get the FDR for the next file in line
-    sFileDescriptorRecord *fdr = &me->m_Directory [me->m_FileIndex++];
-
-    int totalSectors = GetUSHORT ( &fdr->TotalSectors );
-
-    buffer = * ( void ** ) fdr->reserved2;
-    size   = DEFAULT_SECTOR_SIZE * totalSectors;
-
-    me->m_Decoder->SetWriteCallback ( DataCallback, buffer, size, token );
-
-    return true;
-}
-    
 //------------------------------------------------------------------------------
 // Procedure:   cArchiveFileSystem::LoadFile
-// Purpose:
+// Purpose:     Read the archive and decode its directory
 // Parameters:
 // Returns:
-// Notes:
+// Notes:       The compressed data is kept so files can be decoded as they
+//              are opened
 //------------------------------------------------------------------------------
 void cArchiveFileSystem::LoadFile ()
 {
@@ -248,19 +227,86 @@ void cArchiveFileSystem::LoadFile ()
         file->ReadRecord ( inputBuffer + ( i * recLen ), recLen );
     }
 
-    // If it looks like it might be an archive, decode it
-    if ( inputBuffer [0] == 0x80 ) {
-        m_Decoder = new cDecodeLZW;
-        char buffer [256];
-        m_Decoder->SetWriteCallback ( DirectoryCallback, buffer, 256, this );
-        m_Decoder->ParseBuffer ( inputBuffer, size );
-        delete m_Decoder;
-        m_Decoder = NULL;
+    file->Release ( NULL );
+
+    // If it doesn't look like an archive, don't bother keeping it
+    if (( size == 0 ) || ( inputBuffer [0] != 0x80 )) {
+        delete [] inputBuffer;
+        return;
     }
-    
-    delete [] inputBuffer;
 
-    file->Release ( NULL );
+    m_Input     = inputBuffer;
+    m_InputSize = size;
+
+    m_Decoder = new cDecodeLZW;
+    m_Decoder->SetInput ( m_Input, m_InputSize );
+
+    // The directory sectors come first, the files follow in the same order
+    UCHAR buffer [ DEFAULT_SECTOR_SIZE ];
+    for ( EVER ) {
+        if ( m_Decoder->Read ( buffer, sizeof ( buffer )) != sizeof ( buffer )) break;
+        if ( LoadDirectory ( buffer ) == true ) break;
+    }
+
+    m_DataStart = m_Decoder->Position ();
+    m_FileIndex = 0;
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cArchiveFileSystem::LoadMember
+// Purpose:     Decode the data for one file in the archive
+// Parameters:
+// Returns:     true if the file's data is available
+// Notes:       The decoder only moves forward, so it is restarted when the
+//              file comes before its current position
+//------------------------------------------------------------------------------
+bool cArchiveFileSystem::LoadMember ( int index )
+{
+    FUNCTION_ENTRY ( this, "cArchiveFileSystem::LoadMember", true );
+
+    sFileDescriptorRecord *FDR = &m_Directory [index];
+
+    if ( * ( UCHAR ** ) &FDR->reserved2 != NULL ) return true;
+
+    if ( m_Decoder == NULL ) return false;
+
+    if ( index < m_FileIndex ) {
+        m_Decoder->SetInput ( m_Input, m_InputSize );
+        m_Decoder->Read ( NULL, m_DataStart );
+        m_FileIndex = 0;
+    }
+
+    // Skip over the files in between
+    size_t skip = 0;
+    for ( ; m_FileIndex < index; m_FileIndex++ ) {
+        skip += DEFAULT_SECTOR_SIZE * GetUSHORT ( &m_Directory [m_FileIndex].TotalSectors );
+    }
+
+    if ( m_Decoder->Read ( NULL, skip ) != skip ) {
+        ERROR ( "Archive is truncated" );
+        return false;
+    }
+
+    size_t size = DEFAULT_SECTOR_SIZE * GetUSHORT ( &FDR->TotalSectors );
+
+    UCHAR *fileBuffer = new UCHAR [ size ];
+    size_t count = m_Decoder->Read ( fileBuffer, size );
+
+    m_FileIndex++;
+
+    if ( count != size ) {
+        if ( m_Decoder->HasError () == true ) {
+            ERROR ( "Unable to decode file " << index << " in archive" );
+            delete [] fileBuffer;
+            return false;
+        }
+        WARNING ( "File " << index << " in archive is truncated" );
+        memset ( fileBuffer + count, 0, size - count );
+    }
+
+    * ( UCHAR ** ) &FDR->reserved2 = fileBuffer;
+
+    return true;
 }
 
 //------------------------------------------------------------------------------
@@ -334,7 +380,9 @@ sSector *cArchiveFileSystem::GetFileSector ( sFileDescriptorRecord *FDR, int ind
 
     sSector *sector = * ( sSector ** ) &FDR->DataChain;
 
+    // OpenFile has already decoded the file's data
     UCHAR *fileBuffer = * ( UCHAR ** ) &FDR->reserved2;
+    ASSERT ( fileBuffer != NULL );
 
     sector->Data = fileBuffer + ( index * DEFAULT_SECTOR_SIZE );
 
@@ -452,12 +500,17 @@ cFile *cArchiveFileSystem::OpenFile ( const char *filename )
 {
     FUNCTION_ENTRY ( this, "cArchiveFileSystem::OpenFile", true );
     
-    int len = strlen ( filename );
-    
+    char padded [ MAX_FILENAME ];
+    for ( int i = 0; i < MAX_FILENAME; i++ ) {
+        padded [i] = ( *filename != '\0' ) ? *filename++ : ' ';
+    }
+
     for ( int i = 0; i < m_FileCount; i++ ) {
         sFileDescriptorRecord *FDR = &m_Directory [i];
-        if ( strnicmp ( FDR->FileName, filename, len ) == 0 ) {
-             return cFileSystem::CreateFile ( FDR );
+        if ( strnicmp ( FDR->FileName, padded, MAX_FILENAME ) == 0 ) {
+            // Only this file is decoded, the rest of the archive is left alone
+            if ( LoadMember ( i ) == false ) return NULL;
+            return cFileSystem::CreateFile ( FDR );
         }
     }
 
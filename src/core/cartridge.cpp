@@ -69,13 +69,24 @@ enum eMemoryRegion {
 
 const int FILE_VERSION = 0x10;
 
+// A bank that needs space of its own once all the section headers are read
+struct sPendingBank {
+    sMemoryBank   *Bank;
+    const UCHAR   *Source;                  // NULL for RAM
+    int            Size;
+};
+
 const char *cCartridge::sm_Banner = "TI-99/4A Module - ";
 
 cCartridge::cCartridge ( const char *filename ) :
     m_FileName ( NULL ),
     m_RamFileName ( NULL ),
     m_Title ( NULL ),
-    m_BaseCRU ( 0 )
+    m_BaseCRU ( 0 ),
+    m_Image ( NULL ),
+    m_ImageSize ( 0 ),
+    m_Block ( NULL ),
+    m_BlockSize ( 0 )
 {
     FUNCTION_ENTRY ( this, "cCartridge ctor", true );
 
@@ -107,19 +118,25 @@ cCartridge::~cCartridge ()
 
     for ( unsigned i = 0; i < SIZE ( CpuMemory ); i++ ) {
         for ( int j = 0; j < CpuMemory[i].NumBanks; j++ ) {
-            delete [] CpuMemory[i].Bank[j].Data;
+            if ( IsShared ( CpuMemory[i].Bank[j].Data ) == false ) {
+                delete [] CpuMemory[i].Bank[j].Data;
+            }
         }
     }
 
     for ( unsigned i = 0; i < SIZE ( GromMemory ); i++ ) {
         for ( int j = 0; j < GromMemory[i].NumBanks; j++ ) {
-            delete [] GromMemory[i].Bank[j].Data;
+            if ( IsShared ( GromMemory[i].Bank[j].Data ) == false ) {
+                delete [] GromMemory[i].Bank[j].Data;
+            }
         }
     }
 
     memset ( CpuMemory, 0, sizeof ( CpuMemory ));
     memset ( GromMemory, 0, sizeof ( GromMemory ));
 
+    ReleaseImage ();
+
     delete [] m_Title;
     delete [] m_RamFileName;
     delete [] m_FileName;
@@ -182,10 +199,32 @@ bool cCartridge::IsValid () const
     return false;
 }
 
+bool cCartridge::HasBatteryRAM () const
+{
+    FUNCTION_ENTRY ( this, "cCartridge::HasBatteryRAM", true );
+
+    for ( unsigned i = 0; i < SIZE ( CpuMemory ); i++ ) {
+        for ( int j = 0; j < CpuMemory [i].NumBanks; j++ ) {
+            if ( CpuMemory[i].Bank[j].Type == MEMORY_BATTERY_BACKED ) return true;
+        }
+    }
+
+    for ( unsigned i = 0; i < SIZE ( GromMemory ); i++ ) {
+        for ( int j = 0; j < GromMemory [i].NumBanks; j++ ) {
+            if ( GromMemory[i].Bank[j].Type == MEMORY_BATTERY_BACKED ) return true;
+        }
+    }
+
+    return false;
+}
+
 void cCartridge::LoadRAM ()
 {
     FUNCTION_ENTRY ( this, "cCartridge::LoadRAM", true );
 
+    // Most cartridges don't have any - save looking for a .ram file
+    if ( HasBatteryRAM () == false ) return;
+
     FILE *file = m_RamFileName ? fopen ( m_RamFileName, "rb" ) : NULL;
     if ( file == NULL ) return;
 
@@ -203,7 +242,7 @@ void cCartridge::LoadRAM ()
     for ( unsigned i = 0; i < SIZE ( GromMemory ); i++ ) {
         for ( int j = 0; j < GromMemory [i].NumBanks; j++ ) {
             // If this bank is RAM & Battery backed - update the cartridge
-            if ( CpuMemory[i].Bank[j].Type == MEMORY_BATTERY_BACKED ) {
+            if ( GromMemory[i].Bank[j].Type == MEMORY_BATTERY_BACKED ) {
                 LoadBuffer ( GROM_BANK_SIZE, GromMemory [i].Bank [j].Data, file );
             }
         }
@@ -216,6 +255,8 @@ void cCartridge::SaveRAM ()
 {
     FUNCTION_ENTRY ( this, "cCartridge::SaveRAM", true );
 
+    if ( HasBatteryRAM () == false ) return;
+
     // Don't bother creating a .ram file if there is nothing stored in the RAM
 
     for ( unsigned i = 0; i < SIZE ( CpuMemory ); i++ ) {
@@ -272,6 +313,55 @@ save:
     fclose ( file );
 }
 
+// The whole image is read in - the banks used in place must not depend on the
+//   file, which may be rewritten (SaveImage) or replaced while it is loaded
+bool cCartridge::ReadImage ( FILE *file )
+{
+    FUNCTION_ENTRY ( this, "cCartridge::ReadImage", true );
+
+    fseek ( file, 0, SEEK_END );
+    ULONG size = ftell ( file );
+    fseek ( file, 0, SEEK_SET );
+
+    if ( size == 0 ) return false;
+
+    m_Image = new UCHAR [ size ];
+    if ( fread ( m_Image, size, 1, file ) != 1 ) {
+        ERROR ( "Error reading from file" );
+        delete [] m_Image;
+        m_Image = NULL;
+        return false;
+    }
+
+    m_ImageSize = size;
+
+    return true;
+}
+
+void cCartridge::ReleaseImage ()
+{
+    FUNCTION_ENTRY ( this, "cCartridge::ReleaseImage", true );
+
+    delete [] m_Image;
+    delete [] m_Block;
+
+    m_Image     = NULL;
+    m_ImageSize = 0;
+    m_Block     = NULL;
+    m_BlockSize = 0;
+}
+
+// Returns true if the bank data belongs to the image rather than the bank
+bool cCartridge::IsShared ( const UCHAR *ptr ) const
+{
+    FUNCTION_ENTRY ( this, "cCartridge::IsShared", true );
+
+    if (( ptr >= m_Image ) && ( ptr < m_Image + m_ImageSize )) return true;
+    if (( ptr >= m_Block ) && ( ptr < m_Block + m_BlockSize )) return true;
+
+    return false;
+}
+
 bool cCartridge::LoadOldImage ( FILE *file )
 {
     FUNCTION_ENTRY ( this, "cCartridge::LoadOldImage", true );
@@ -343,33 +433,69 @@ bool cCartridge::LoadImage ( const char *filename )
 
     SetFileName ( filename );
 
+    ReleaseImage ();
+
+    if ( ReadImage ( file ) == false ) {
+        fclose ( file );
+        return false;
+    }
+
+    const UCHAR *ptr = m_Image;
+    const UCHAR *end = m_Image + m_ImageSize;
+
     // Make sure this is really a TI-99/4A cartridge file
     char buffer [ 80 ];
-    fread ( buffer, sizeof ( buffer ), 1, file );
-    if ( strncmp ( buffer, sm_Banner, strlen ( sm_Banner ))) return false;
-    char *ptr = &buffer [ strlen ( sm_Banner )];
-    ptr [ strlen ( ptr ) - 2 ] = '\0';
-    SetTitle ( ptr );
+    if ( m_ImageSize < sizeof ( buffer ) + 1 ) {
+        ReleaseImage ();
+        fclose ( file );
+        return false;
+    }
+    memcpy ( buffer, ptr, sizeof ( buffer ));
+    buffer [ sizeof ( buffer ) - 1 ] = '\0';
+    if ( strncmp ( buffer, sm_Banner, strlen ( sm_Banner ))) {
+        ReleaseImage ();
+        fclose ( file );
+        return false;
+    }
+    char *title = &buffer [ strlen ( sm_Banner )];
+    if ( strlen ( title ) >= 2 ) title [ strlen ( title ) - 2 ] = '\0';
+    SetTitle ( title );
 
     EVENT ( "Loading module: " << Title ());
 
-    int version = ( UCHAR ) fgetc ( file );
+    ptr += sizeof ( buffer );
+
+    int version = *ptr++;
     if (( version & 0x80 ) != 0 ) {
-        ungetc ( version, file );
+        ReleaseImage ();
+        fseek ( file, sizeof ( buffer ), SEEK_SET );
         return LoadOldImage ( file );
     }
 
+    // The banks are all taken from the image from here on
+    fclose ( file );
+
     if ( version > FILE_VERSION ) {
         ERROR ( "Unrecognized file version" );
+        ReleaseImage ();
         return false;
     }
 
-    m_BaseCRU = ( USHORT ) ( fgetc ( file ) << 8 );
-    m_BaseCRU = ( USHORT ) ( m_BaseCRU | ( UCHAR ) fgetc ( file ));
+    sPendingBank pending [ ( SIZE ( CpuMemory ) + SIZE ( GromMemory )) * 4 ];
+    int pendingCount = 0;
+    ULONG blockSize = 0;
 
-    UCHAR index = ( UCHAR ) fgetc ( file );
+    if ( end - ptr < 2 ) goto error;
 
-    while ( ! feof ( file )) {
+    m_BaseCRU = ( USHORT ) (( ptr [0] << 8 ) | ptr [1] );
+    ptr += 2;
+
+    // Build the bank table from the section headers.  ROM banks stored as a
+    //   single literal block are used in place, everything else is given
+    //   space in the block once we know how much is needed.
+    while ( ptr < end ) {
+
+        UCHAR index = *ptr++;
 
         sMemoryRegion *memory = NULL;
         USHORT size = 0;
@@ -377,34 +503,95 @@ bool cCartridge::LoadImage ( const char *filename )
         if ( index < GROM_0 ) {
             memory = &CpuMemory [ index ];
             size   = ROM_BANK_SIZE;
-        } else {
+        } else if ( index <= GROM_7 ) {
             index -= GROM_0;
             memory = &GromMemory [ index ];
             size   = GROM_BANK_SIZE;
+        } else {
+            goto error;
         }
 
-        memory->NumBanks = ( int ) fgetc ( file );
+        if ( ptr >= end ) goto error;
+
+        memory->NumBanks = ( int ) *ptr++;
+        if ( memory->NumBanks > ( int ) SIZE ( memory->Bank )) goto error;
 
         EVENT ( "  " << (( size != GROM_BANK_SIZE ) ? " RAM" : "GROM" ) << " @ " << hex << ( USHORT ) ( index * size ));
 
         for ( int i = 0; i < memory->NumBanks; i++ ) {
-            memory->Bank[i].Type = ( MEMORY_TYPE_E ) fgetc ( file );
-            memory->Bank[i].Data = new UCHAR [ size ];
-            memset ( memory->Bank[i].Data, 0, size );
+            if ( ptr >= end ) goto error;
+            memory->Bank[i].Type = ( MEMORY_TYPE_E ) *ptr++;
+            memory->Bank[i].Data = NULL;
+            const UCHAR *source = NULL;
             if ( memory->Bank[i].Type == MEMORY_ROM ) {
-                LoadBuffer ( size, memory->Bank[i].Data, file );
+                const UCHAR *next = LoadBuffer ( size, NULL, ptr, end );
+                if ( next == NULL ) goto error;
+                if (( ptr [0] | ( ptr [1] << 8 )) == size ) {
+                    memory->Bank[i].Data = m_Image + ( ptr + 2 - m_Image );
+                    ptr = next;
+                    continue;
+                }
+                source = ptr;
+                ptr    = next;
             }
+            if ( pendingCount >= ( int ) SIZE ( pending )) goto error;
+            pending [pendingCount].Bank   = &memory->Bank[i];
+            pending [pendingCount].Source = source;
+            pending [pendingCount].Size   = size;
+            pendingCount++;
+            blockSize += size;
         }
         memory->CurBank = &memory->Bank[0];
+    }
 
-        index = ( UCHAR ) fgetc ( file );
+    if ( blockSize != 0 ) {
+        m_Block = new UCHAR [ blockSize ];
+        memset ( m_Block, 0, blockSize );
+        m_BlockSize = blockSize;
     }
 
-    fclose ( file );
+    for ( int i = 0, offset = 0; i < pendingCount; i++ ) {
+        sPendingBank *bank = &pending [i];
+        bank->Bank->Data = m_Block + offset;
+        if ( bank->Source != NULL ) {
+            LoadBuffer ( bank->Size, bank->Bank->Data, bank->Source, end );
+        }
+        offset += bank->Size;
+    }
 
     LoadRAM ();
 
     return true;
+
+error:
+
+    ERROR ( "Invalid cartridge image" );
+
+    for ( unsigned i = 0; i < SIZE ( CpuMemory ); i++ ) {
+        CpuMemory[i].NumBanks = 0;
+        CpuMemory[i].CurBank  = NULL;
+    }
+    for ( unsigned i = 0; i < SIZE ( GromMemory ); i++ ) {
+        GromMemory[i].NumBanks = 0;
+        GromMemory[i].CurBank  = NULL;
+    }
+
+    ReleaseImage ();
+
+    return false;
+}
+
+// Banks that don't compress well are stored as a single literal block so
+//   LoadImage can use them in place
+static void SaveBank ( int size, UCHAR *data, FILE *file )
+{
+    FUNCTION_ENTRY ( NULL, "SaveBank", true );
+
+    if ( CompressedSize ( size, data ) > size - size / 4 ) {
+        SaveRawBuffer ( size, data, file );
+    } else {
+        SaveBuffer ( size, data, file );
+    }
 }
 
 bool cCartridge::SaveImage ( const char *filename )
@@ -436,7 +623,7 @@ bool cCartridge::SaveImage ( const char *filename )
             for ( int j = 0; j < memory->NumBanks; j++ ) {
                 fputc ( memory->Bank[j].Type, file );
                 if ( memory->Bank[j].Type == MEMORY_ROM ) {
-                    SaveBuffer ( ROM_BANK_SIZE, memory->Bank[j].Data, file );
+                    SaveBank ( ROM_BANK_SIZE, memory->Bank[j].Data, file );
                 }
             }
         }
@@ -450,7 +637,7 @@ bool cCartridge::SaveImage ( const char *filename )
             for ( int j = 0; j < memory->NumBanks; j++ ) {
                 fputc ( memory->Bank[j].Type, file );
                 if ( memory->Bank[j].Type == MEMORY_ROM ) {
-                    SaveBuffer ( GROM_BANK_SIZE, memory->Bank[j].Data, file );
+                    SaveBank ( GROM_BANK_SIZE, memory->Bank[j].Data, file );
                 }
             }
         }
@@ -27,6 +27,7 @@
 //----------------------------------------------------------------------------
 
 #include <stdio.h>
+#include <string.h>
 #include "common.hpp"
 #include "logger.hpp"
 
@@ -46,41 +47,51 @@ int GetRunLength ( int bytesLeft, UCHAR *ptr, UCHAR lastChar )
     return runLength;
 }
 
+// Find the next block to be written - returns the number of bytes it covers
+static int NextBlock ( int length, UCHAR *ptr, USHORT *tag, USHORT *count )
+{
+    FUNCTION_ENTRY ( NULL, "NextBlock", true );
+
+    int runLength = GetRunLength ( length, ptr, *ptr );
+    if ( runLength >= MIN_RUN ) {
+        *tag = ( USHORT ) ( runLength | 0x8000 );
+        *count = 1;
+    } else {
+        int bytesLeft = length - runLength;
+        UCHAR lastChar = *ptr;
+        UCHAR *nextPtr = ptr + runLength;
+        while ( bytesLeft ) {
+            while ( bytesLeft && ( *nextPtr != lastChar )) {
+                bytesLeft--;
+                lastChar = *nextPtr++;
+                if ( ++runLength >= 0x7FFF ) break;
+            }
+            if ( runLength >= 0x7FFF ) break;
+            if ( bytesLeft ) {
+                int tempRun = GetRunLength ( bytesLeft, nextPtr, *nextPtr );
+                if ( tempRun >= MIN_RUN ) break;
+                runLength += tempRun;
+                if ( runLength >= 0x7FFF ) {
+                    runLength = 0x7FFF;
+                    break;
+                }
+                nextPtr += tempRun;
+                bytesLeft -= tempRun;
+            }
+        }
+        *tag = *count = ( USHORT ) runLength;
+    }
+
+    return runLength;
+}
+
 void SaveBuffer ( int length, UCHAR *ptr, FILE *file )
 {
     FUNCTION_ENTRY ( NULL, "SaveBuffer", true );
 
     while ( length ) {
         USHORT tag, count;
-        int runLength = GetRunLength ( length, ptr, *ptr );
-        if ( runLength >= MIN_RUN ) {
-            tag = ( USHORT ) ( runLength | 0x8000 );
-            count = 1;
-        } else {
-            int bytesLeft = length - runLength;
-            UCHAR lastChar = *ptr;
-            UCHAR *nextPtr = ptr + runLength;
-            while ( bytesLeft ) {
-                while ( bytesLeft && ( *nextPtr != lastChar )) {
-                    bytesLeft--;
-                    lastChar = *nextPtr++;
-                    if ( ++runLength >= 0x7FFF ) break;
-                }
-                if ( runLength >= 0x7FFF ) break;
-                if ( bytesLeft ) {
-                    int tempRun = GetRunLength ( bytesLeft, nextPtr, *nextPtr );
-                    if ( tempRun >= MIN_RUN ) break;
-                    runLength += tempRun;
-                    if ( runLength >= 0x7FFF ) {
-                        runLength = 0x7FFF;
-                        break;
-                    }
-                    nextPtr += tempRun;
-                    bytesLeft -= tempRun;
-                }
-            }
-            tag = count = ( USHORT ) runLength;
-        }
+        int runLength = NextBlock ( length, ptr, &tag, &count );
         fputc ( tag, file );
         fputc ( tag >> 8, file );
         fwrite ( ptr, 1, count, file );
@@ -89,6 +100,40 @@ void SaveBuffer ( int length, UCHAR *ptr, FILE *file )
     }
 }
 
+// Write the buffer as literal blocks - a buffer that fits in one block can be
+//   used in place by the in-memory LoadBuffer
+void SaveRawBuffer ( int length, UCHAR *ptr, FILE *file )
+{
+    FUNCTION_ENTRY ( NULL, "SaveRawBuffer", true );
+
+    while ( length ) {
+        USHORT count = ( USHORT ) (( length > 0x7FFF ) ? 0x7FFF : length );
+        fputc ( count, file );
+        fputc ( count >> 8, file );
+        fwrite ( ptr, 1, count, file );
+        ptr += count;
+        length -= count;
+    }
+}
+
+// The number of bytes SaveBuffer would write for this buffer
+int CompressedSize ( int length, UCHAR *ptr )
+{
+    FUNCTION_ENTRY ( NULL, "CompressedSize", true );
+
+    int size = 0;
+
+    while ( length ) {
+        USHORT tag, count;
+        int runLength = NextBlock ( length, ptr, &tag, &count );
+        size += 2 + count;
+        ptr += runLength;
+        length -= runLength;
+    }
+
+    return size;
+}
+
 void LoadBuffer ( int length, UCHAR *ptr, FILE *file )
 {
     FUNCTION_ENTRY ( NULL, "LoadBuffer", true );
@@ -114,3 +159,43 @@ void LoadBuffer ( int length, UCHAR *ptr, FILE *file )
         }
     }
 }
+
+// Expand a buffer held in memory - returns a pointer to the data following
+//   it, or NULL if the buffer is corrupt.  If ptr is NULL the buffer is
+//   only checked and skipped.
+const UCHAR *LoadBuffer ( int length, UCHAR *ptr, const UCHAR *data, const UCHAR *end )
+{
+    FUNCTION_ENTRY ( NULL, "LoadBuffer", true );
+
+    while ( length > 0 ) {
+        if ( end - data < 2 ) goto error;
+        USHORT tag = ( USHORT ) ( data [0] | ( data [1] << 8 ));
+        data += 2;
+        int count = tag & 0x7FFF;
+        if (( count == 0 ) || ( count > length )) goto error;
+        if ( tag & 0x8000 ) {
+            if ( end - data < 1 ) goto error;
+            if ( ptr != NULL ) {
+                memset ( ptr, *data, count );
+                ptr += count;
+            }
+            data += 1;
+        } else {
+            if ( end - data < count ) goto error;
+            if ( ptr != NULL ) {
+                memcpy ( ptr, data, count );
+                ptr += count;
+            }
+            data += count;
+        }
+        length -= count;
+    }
+
+    return data;
+
+error:
+
+    ERROR ( "Invalid compressed buffer" );
+
+    return NULL;
+}
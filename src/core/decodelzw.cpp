@@ -33,184 +33,218 @@
 
 DBG_REGISTER ( __FILE__ );
 
-static inline USHORT GetUSHORT ( const void *_ptr )
-{
-    FUNCTION_ENTRY ( NULL, "GetUSHORT", true );
-
-    const UCHAR *ptr = ( const UCHAR * ) _ptr;
-    return ( USHORT ) (( ptr [0] << 8 ) | ptr [1] );
-}
-
-cDecodeLZW::cDecodeLZW ()
+// Window space is added in chunks this size, most archives never need more
+const ULONG WINDOW_CHUNK = 0x10000;
+
+cDecodeLZW::cDecodeLZW () :
+    m_InStart ( NULL ),
+    m_InEnd ( NULL ),
+    m_InPtr ( NULL ),
+    m_Window ( NULL ),
+    m_WindowSize ( 0 )
 {
     FUNCTION_ENTRY ( this, "cDecodeLZW ctor", true );
-    
+
+    SetInput ( NULL, 0 );
 }
 
 cDecodeLZW::~cDecodeLZW ()
 {
     FUNCTION_ENTRY ( this, "cDecodeLZW dtor", true );
+
+    delete [] m_Window;
 }
 
 void cDecodeLZW::Reset ()
 {
     FUNCTION_ENTRY ( this, "cDecodeLZW::Reset", true );
-    
-    m_nBits    = 9;
-    m_nBitsB   = 7;
-    m_MaxCode  = 512;
-    m_FreeCode = CODE_FIRST_FREE;
-}
 
-void cDecodeLZW::Init ()
-{
-    FUNCTION_ENTRY ( this, "cDecodeLZW::Init", true );
-    
-    Reset ();
-    m_BitOff = 0;
+    m_nBits      = 9;
+    m_MaxCode    = 512;
+    m_FreeCode   = CODE_FIRST_FREE;
+    m_LastOffset = 0;
+    m_LastLength = 0;
 }
 
-bool cDecodeLZW::WriteChar ( UCHAR ch )
+void cDecodeLZW::SetInput ( const void *buffer, size_t size )
 {
-    FUNCTION_ENTRY ( this, "cDecodeLZW::WriteChar", false );
-    
-    *m_OutPtr++ = ch;
-
-    bool retVal = true;
-    
-    if ( m_OutPtr == m_WriteBuffer + m_MaxWriteSize ) {
-        retVal = m_WriteCallback ( m_WriteBuffer, m_MaxWriteSize, m_CallbackToken );
-        m_OutPtr = m_WriteBuffer;
-    }
+    FUNCTION_ENTRY ( this, "cDecodeLZW::SetInput", true );
 
-    return retVal;
-}
+    m_InStart   = ( const UCHAR * ) buffer;
+    m_InEnd     = m_InStart + size;
+    m_InPtr     = m_InStart;
+    m_BitBuffer = 0;
+    m_BitCount  = 0;
 
-void cDecodeLZW::Done ()
-{
-    FUNCTION_ENTRY ( this, "cDecodeLZW::Done", true );
+    m_WindowEnd = 0;
+    m_ReadPtr   = 0;
 
-    if ( m_OutPtr != m_WriteBuffer ) {
-        m_WriteCallback ( m_WriteBuffer, m_OutPtr - m_WriteBuffer, m_CallbackToken );
-        m_OutPtr = m_WriteBuffer;
-    }
+    m_Position  = 0;
+    m_Done      = false;
+    m_Error     = false;
+
+    Reset ();
 }
 
-USHORT cDecodeLZW::ReadCode ()
+inline int cDecodeLZW::ReadCode ()
 {
     FUNCTION_ENTRY ( this, "cDecodeLZW::ReadCode", false );
-    
-    USHORT code = 0;
-
-    if ( m_BitOff != 0 ) {
-        if ( m_BitOff <= m_nBitsB ) {
-            code      = (( USHORT ) ( m_CurWord << m_BitOff )) >> m_nBitsB;
-            m_BitOff += m_nBits;
-        } else {
-            code      = (( USHORT ) ( m_CurWord << m_BitOff )) >> m_nBitsB;
-            m_CurWord = GetUSHORT ( m_InPtr++ );
-            m_BitOff  = ( m_BitOff + m_nBits ) - 16;
-            code     |= m_CurWord >> ( 16 - m_BitOff );
+
+    if ( m_BitCount < m_nBits ) {
+        // Top up the bit buffer with as many whole bytes as will fit
+        while (( m_BitCount <= 56 ) && ( m_InPtr < m_InEnd )) {
+            m_BitBuffer |= ( ULLONG ) *m_InPtr++ << ( 56 - m_BitCount );
+            m_BitCount  += 8;
         }
-    } else {
-        m_CurWord = GetUSHORT ( m_InPtr++ );
-        m_BitOff += m_nBits;
-        code      = m_CurWord >> m_nBitsB;
+        if ( m_BitCount < m_nBits ) return -1;
     }
 
-    ASSERT ( code <= m_FreeCode );
+    int code = ( int ) ( m_BitBuffer >> ( 64 - m_nBits ));
+
+    m_BitBuffer <<= m_nBits;
+    m_BitCount   -= m_nBits;
 
     return code;
 }
 
-void cDecodeLZW::AddCode ( UCHAR ch, USHORT code )
+bool cDecodeLZW::Reserve ( ULONG size )
 {
-    FUNCTION_ENTRY ( this, "cDecodeLZW::AddCode", false );
-    
-    ASSERT ( m_FreeCode < 4096 );
+    FUNCTION_ENTRY ( this, "cDecodeLZW::Reserve", false );
 
-    USHORT index       = m_FreeCode++;
-    m_CHAR [index]     = ch;
-    m_NextCode [index] = code;
-}
+    if ( m_WindowEnd + size <= m_WindowSize ) return true;
 
-void cDecodeLZW::SetWriteCallback ( bool (*callback) ( void *, size_t, void * ), void *buffer, size_t size, void *token )
-{
-    FUNCTION_ENTRY ( this, "cDecodeLZW::SetWriteCallback", true );
-    
-    m_WriteCallback = callback;
-    m_CallbackToken = token;
-    m_MaxWriteSize  = size;
-    
-    m_WriteBuffer = ( UCHAR * ) buffer;
-    m_OutPtr      = m_WriteBuffer;
+    ULONG newSize = ( m_WindowEnd + size + WINDOW_CHUNK ) & ~ ( WINDOW_CHUNK - 1 );
+
+    UCHAR *window = new UCHAR [ newSize ];
+    if ( window == NULL ) return false;
+
+    if ( m_Window != NULL ) {
+        memcpy ( window, m_Window, m_WindowEnd );
+        delete [] m_Window;
+    }
+
+    m_Window     = window;
+    m_WindowSize = newSize;
+
+    return true;
 }
 
-int cDecodeLZW::ParseBuffer ( void *buffer, size_t size )
+//
+// Decode the next code and append its string to the window
+//
+bool cDecodeLZW::DecodeCode ()
 {
-    FUNCTION_ENTRY ( this, "cDecodeLZW::ParseBuffer", true );
-    
-    UCHAR   stackBuffer [CODE_MAX];
-    UCHAR  *stack = stackBuffer + CODE_MAX;
+    FUNCTION_ENTRY ( this, "cDecodeLZW::DecodeCode", false );
 
-    UCHAR   K = 0;
-    USHORT  oldCode = 0;
-    USHORT  curCode = 0;
+    if ( m_Done == true ) return false;
 
-    m_InPtr = ( USHORT * ) buffer;
+    int code = ReadCode ();
 
-    Init ();
+    switch ( code ) {
 
-    while (( char * ) m_InPtr < ( char * ) buffer + size ) {
+        case -1 :
+            WARNING ( "Unexpected end of LZW data" );
+            m_Done = true;
+            return false;
 
-        USHORT code = ReadCode ();
+        case CODE_EOF :
+            m_Done = true;
+            return false;
 
-        switch ( code ) {
+        case CODE_CLEAR :
+            // Strings from here on only refer to what follows - keep just the part that hasn't been read
+            if ( m_ReadPtr != 0 ) {
+                m_WindowEnd -= m_ReadPtr;
+                memmove ( m_Window, m_Window + m_ReadPtr, m_WindowEnd );
+                m_ReadPtr = 0;
+            }
+            Reset ();
+            return true;
 
-            case CODE_EOF :
+    }
 
-                Done ();
-                return 1;
+    ULONG offset = m_WindowEnd;
+    int length;
+
+    if ( code < 256 ) {
+        if ( Reserve ( 1 ) == false ) goto error;
+        m_Window [offset] = ( UCHAR ) code;
+        length = 1;
+    } else if ( m_LastLength == 0 ) {
+        // The first code after a clear has to be a literal
+        goto error;
+    } else if ( code < m_FreeCode ) {
+        length = m_Length [code];
+        if ( Reserve ( length ) == false ) goto error;
+        memcpy ( m_Window + offset, m_Window + m_Offset [code], length );
+    } else if ( code == m_FreeCode ) {
+        // The code being defined - the last string plus its own first character
+        length = m_LastLength + 1;
+        if ( Reserve ( length ) == false ) goto error;
+        memcpy ( m_Window + offset, m_Window + m_LastOffset, m_LastLength );
+        m_Window [offset + m_LastLength] = m_Window [m_LastOffset];
+    } else {
+        goto error;
+    }
 
-            case CODE_CLEAR :
+    m_WindowEnd += length;
+
+    // The new code is the last string plus the first character of this one,
+    //   and that is exactly what now sits at the last string's offset
+    if (( m_LastLength != 0 ) && ( m_FreeCode < CODE_MAX )) {
+        m_Offset [m_FreeCode] = m_LastOffset;
+        m_Length [m_FreeCode] = ( USHORT ) ( m_LastLength + 1 );
+        m_FreeCode++;
+        if (( m_FreeCode >= m_MaxCode ) && ( m_nBits != 12 )) {
+            m_nBits++;
+            m_MaxCode *= 2;
+        }
+    }
 
-                Reset ();
-                stack   = stackBuffer + CODE_MAX;
-                if ( WriteChar ( K = oldCode = ReadCode ()) == false ) return 0;
-                break;
+    m_LastOffset = offset;
+    m_LastLength = length;
 
-            default:
+    return true;
 
-                curCode = code;
+error:
 
-                if ( code >= m_FreeCode ) {
-                    curCode  = oldCode;
-                    *--stack = K;
-                }
+    WARNING ( "Invalid LZW code " << code );
 
-                while ( curCode > 0xFF ) {
-                    *--stack = m_CHAR [curCode];
-                    curCode  = m_NextCode [curCode];
-                }
+    m_Done  = true;
+    m_Error = true;
 
-                K = curCode;
+    return false;
+}
+
+//
+// Copy up to size decoded bytes to buffer, or skip over them if buffer is NULL
+//
+size_t cDecodeLZW::Read ( void *buffer, size_t size )
+{
+    FUNCTION_ENTRY ( this, "cDecodeLZW::Read", true );
 
-                if ( WriteChar ( curCode ) == false ) return 0;
-                while ( stack != stackBuffer + CODE_MAX ) {
-                    if ( WriteChar ( *stack++ ) == false ) return 0;
-                }
+    UCHAR *outPtr = ( UCHAR * ) buffer;
+    size_t count  = 0;
 
-                AddCode ( K, oldCode );
-                oldCode = code;
+    while ( count < size ) {
 
-                if (( m_FreeCode >= m_MaxCode ) && ( m_nBits != 12 )) {
-                    m_nBits++;
-                    m_nBitsB--;
-                    m_MaxCode *= 2;
-                }
-                break;
+        // Decode as much as is needed before copying it out in one piece
+        while (( m_WindowEnd - m_ReadPtr < size - count ) && ( DecodeCode () == true )) {
         }
+
+        size_t chunk = m_WindowEnd - m_ReadPtr;
+        if ( chunk == 0 ) break;
+        if ( chunk > size - count ) chunk = size - count;
+
+        if ( outPtr != NULL ) {
+            memcpy ( outPtr + count, m_Window + m_ReadPtr, chunk );
+        }
+
+        m_ReadPtr += chunk;
+        count     += chunk;
     }
 
-    return -1;
+    m_Position += count;
+
+    return count;
 }
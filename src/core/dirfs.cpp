@@ -0,0 +1,555 @@
+//----------------------------------------------------------------------------
+//
+// File:        dirfs.cpp
+// Date:        19-Oct-2026
+//
+// Description: A class to present a host directory of TIFILES & FIAD files
+//              as a TI disk filesystem
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <ctype.h>
+#include <memory.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.hpp"
+#include "logger.hpp"
+#include "diskio.hpp"
+#include "pseudofs.hpp"
+#include "dirfs.hpp"
+#include "fileio.hpp"
+#include "support.hpp"
+
+DBG_REGISTER ( __FILE__ );
+
+static inline USHORT GetUSHORT ( const void *_ptr )
+{
+    FUNCTION_ENTRY ( NULL, "GetUSHORT", true );
+
+    const UCHAR *ptr = ( const UCHAR * ) _ptr;
+    return ( USHORT ) (( ptr [0] << 8 ) | ptr [1] );
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDirectoryFileSystem::Open
+// Purpose:
+// Parameters:
+// Returns:
+// Notes:
+//------------------------------------------------------------------------------
+cDirectoryFileSystem *cDirectoryFileSystem::Open ( const char *pathname )
+{
+    FUNCTION_ENTRY ( NULL, "cDirectoryFileSystem::Open", true );
+
+    cDirectoryFileSystem *disk = new cDirectoryFileSystem ( pathname );
+
+    if ( disk->IsValid () == false ) {
+        disk->Release ( NULL );
+        return NULL;
+    }
+
+    return disk;
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDirectoryFileSystem::cDirectoryFileSystem
+// Purpose:
+// Parameters:
+// Returns:
+// Notes:
+//------------------------------------------------------------------------------
+cDirectoryFileSystem::cDirectoryFileSystem ( const char *pathname ) :
+    m_PathName ( NULL ),
+    m_IsValid ( false ),
+    m_FileCount ( 0 )
+{
+    FUNCTION_ENTRY ( this, "cDirectoryFileSystem ctor", true );
+
+    m_PathName = new char [ strlen ( pathname ) + 1 ];
+    strcpy ( m_PathName, pathname );
+
+    // Drop any trailing seperator so names can simply be appended
+    size_t length = strlen ( m_PathName );
+    if (( length > 1 ) && ( m_PathName [ length - 1 ] == FILE_SEPERATOR )) {
+        m_PathName [ length - 1 ] = '\0';
+    }
+
+    memset ( m_File, 0, sizeof ( m_File ));
+
+    LoadDirectory ();
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDirectoryFileSystem::~cDirectoryFileSystem
+// Purpose:
+// Parameters:
+// Returns:
+// Notes:
+//------------------------------------------------------------------------------
+cDirectoryFileSystem::~cDirectoryFileSystem ()
+{
+    FUNCTION_ENTRY ( this, "cDirectoryFileSystem dtor", true );
+
+    for ( int i = 0; i < m_FileCount; i++ ) {
+        m_File [i]->Release ( NULL );
+        m_File [i] = NULL;
+    }
+
+    delete [] m_PathName;
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDirectoryFileSystem::LoadDirectory
+// Purpose:     Open every TIFILES or FIAD file found in the directory
+// Parameters:
+// Returns:
+// Notes:       Anything else in the directory is ignored
+//------------------------------------------------------------------------------
+void cDirectoryFileSystem::LoadDirectory ()
+{
+    FUNCTION_ENTRY ( this, "cDirectoryFileSystem::LoadDirectory", true );
+
+    DIR *dir = opendir ( m_PathName );
+    if ( dir == NULL ) return;
+
+    m_IsValid = true;
+
+    struct dirent *entry;
+    while ((( entry = readdir ( dir )) != NULL ) && ( m_FileCount < MAX_FILES )) {
+
+        if ( entry->d_name [0] == '.' ) continue;
+
+        char filename [ MAXPATH ];
+        sprintf ( filename, "%s%c%s", m_PathName, FILE_SEPERATOR, entry->d_name );
+
+        struct stat info;
+        if (( stat ( filename, &info ) != 0 ) || ( ! S_ISREG ( info.st_mode ))) continue;
+
+        cPseudoFileSystem *file = cPseudoFileSystem::Open ( filename );
+        if ( file == NULL ) continue;
+
+        // Two host files may carry the same TI name, the first one wins
+        if ( FindFile ( file->m_FDR.FileName ) != -1 ) {
+            WARNING ( "Ignoring duplicate file " << filename );
+            file->Release ( NULL );
+            continue;
+        }
+
+        m_File [ m_FileCount++ ] = file;
+    }
+
+    closedir ( dir );
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDirectoryFileSystem::FindFile
+// Purpose:     Return the index of the file with the given TI filename
+// Parameters:
+// Returns:
+// Notes:       The name may be shorter than MAX_FILENAME or padded with blanks
+//------------------------------------------------------------------------------
+int cDirectoryFileSystem::FindFile ( const char *name ) const
+{
+    FUNCTION_ENTRY ( this, "cDirectoryFileSystem::FindFile", true );
+
+    char padded [ MAX_FILENAME ];
+    for ( int i = 0; i < MAX_FILENAME; i++ ) {
+        padded [i] = ( *name != '\0' ) ? *name++ : ' ';
+    }
+
+    for ( int i = 0; i < m_FileCount; i++ ) {
+        if ( strnicmp ( m_File [i]->m_FDR.FileName, padded, MAX_FILENAME ) == 0 ) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDirectoryFileSystem::FindFile
+// Purpose:     Return the index of the file that owns the given FDR
+// Parameters:
+// Returns:
+// Notes:
+//------------------------------------------------------------------------------
+int cDirectoryFileSystem::FindFile ( const sFileDescriptorRecord *fdr ) const
+{
+    FUNCTION_ENTRY ( this, "cDirectoryFileSystem::FindFile", true );
+
+    for ( int i = 0; i < m_FileCount; i++ ) {
+        if ( &m_File [i]->m_FDR == fdr ) return i;
+    }
+
+    return -1;
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDirectoryFileSystem::FileCount
+// Purpose:
+// Parameters:
+// Returns:
+// Notes:
+//------------------------------------------------------------------------------
+int cDirectoryFileSystem::FileCount () const
+{
+    FUNCTION_ENTRY ( this, "cDirectoryFileSystem::FileCount", true );
+
+    return m_FileCount;
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDirectoryFileSystem::GetFileDescriptor
+// Purpose:
+// Parameters:
+// Returns:
+// Notes:
+//------------------------------------------------------------------------------
+const sFileDescriptorRecord *cDirectoryFileSystem::GetFileDescriptor ( int index ) const
+{
+    FUNCTION_ENTRY ( this, "cDirectoryFileSystem::GetFileDescriptor", true );
+
+    ASSERT ( index < m_FileCount );
+
+    return &m_File [index]->m_FDR;
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDirectoryFileSystem::FreeSectors
+// Purpose:
+// Parameters:
+// Returns:
+// Notes:
+//------------------------------------------------------------------------------
+int cDirectoryFileSystem::FreeSectors () const
+{
+    FUNCTION_ENTRY ( this, "cDirectoryFileSystem::FreeSectors", true );
+
+    int used = 0;
+
+    for ( int i = 0; i < m_FileCount; i++ ) {
+        used += GetUSHORT ( &m_File [i]->m_FDR.TotalSectors ) + 1;
+    }
+
+    return ( used < DIRECTORY_SECTORS ) ? DIRECTORY_SECTORS - used : 0;
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDirectoryFileSystem::TotalSectors
+// Purpose:
+// Parameters:
+// Returns:
+// Notes:
+//------------------------------------------------------------------------------
+int cDirectoryFileSystem::TotalSectors () const
+{
+    FUNCTION_ENTRY ( this, "cDirectoryFileSystem::TotalSectors", true );
+
+    return DIRECTORY_SECTORS;
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDirectoryFileSystem::GetFileSector
+// Purpose:
+// Parameters:
+// Returns:
+// Notes:       Files opened through this class belong to their own
+//              cPseudoFileSystem, these just forward to it
+//------------------------------------------------------------------------------
+sSector *cDirectoryFileSystem::GetFileSector ( sFileDescriptorRecord *fdr, int index )
+{
+    FUNCTION_ENTRY ( this, "cDirectoryFileSystem::GetFileSector", true );
+
+    int i = FindFile ( fdr );
+
+    return ( i != -1 ) ? m_File [i]->GetFileSector ( fdr, index ) : NULL;
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDirectoryFileSystem::ExtendFile
+// Purpose:
+// Parameters:
+// Returns:
+// Notes:
+//------------------------------------------------------------------------------
+int cDirectoryFileSystem::ExtendFile ( sFileDescriptorRecord *fdr, int count )
+{
+    FUNCTION_ENTRY ( this, "cDirectoryFileSystem::ExtendFile", true );
+
+    int i = FindFile ( fdr );
+
+    return ( i != -1 ) ? m_File [i]->ExtendFile ( fdr, count ) : -1;
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDirectoryFileSystem::TruncateFile
+// Purpose:
+// Parameters:
+// Returns:
+// Notes:
+//------------------------------------------------------------------------------
+void cDirectoryFileSystem::TruncateFile ( sFileDescriptorRecord *fdr, int limit )
+{
+    FUNCTION_ENTRY ( this, "cDirectoryFileSystem::TruncateFile", true );
+
+    int i = FindFile ( fdr );
+
+    if ( i != -1 ) m_File [i]->TruncateFile ( fdr, limit );
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDirectoryFileSystem::DiskModified
+// Purpose:
+// Parameters:
+// Returns:
+// Notes:       Each file keeps track of its own changes
+//------------------------------------------------------------------------------
+void cDirectoryFileSystem::DiskModified ()
+{
+    FUNCTION_ENTRY ( this, "cDirectoryFileSystem::DiskModified", true );
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDirectoryFileSystem::Flush
+// Purpose:     Write back every file that has changed
+// Parameters:
+// Returns:
+// Notes:
+//------------------------------------------------------------------------------
+bool cDirectoryFileSystem::Flush ()
+{
+    FUNCTION_ENTRY ( this, "cDirectoryFileSystem::Flush", true );
+
+    bool retVal = true;
+
+    for ( int i = 0; i < m_FileCount; i++ ) {
+        if ( m_File [i]->Flush () == false ) retVal = false;
+    }
+
+    return retVal;
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDirectoryFileSystem::GetPath
+// Purpose:     Return the name of the directory
+// Parameters:
+// Returns:
+// Notes:
+//------------------------------------------------------------------------------
+bool cDirectoryFileSystem::GetPath ( char *buffer, size_t maxLen ) const
+{
+    FUNCTION_ENTRY ( this, "cDirectoryFileSystem::GetPath", true );
+
+    if ( maxLen < strlen ( m_PathName ) + 1 ) {
+	ERROR ( "Destination buffer is too short" );
+        return false;
+    }
+
+    strcpy ( buffer, m_PathName );
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDirectoryFileSystem::GetName
+// Purpose:     Return the volume name (the last component of the path)
+// Parameters:
+// Returns:
+// Notes:
+//------------------------------------------------------------------------------
+bool cDirectoryFileSystem::GetName ( char *buffer, size_t maxLen ) const
+{
+    FUNCTION_ENTRY ( this, "cDirectoryFileSystem::GetName", true );
+
+    const char *ptr = strrchr ( m_PathName, FILE_SEPERATOR );
+    ptr = ( ptr != NULL ) ? ptr + 1 : m_PathName;
+
+    size_t length = strlen ( ptr );
+    if ( length > MAX_FILENAME ) length = MAX_FILENAME;
+
+    if ( maxLen < length + 1 ) {
+	ERROR ( "Destination buffer is too short" );
+        return false;
+    }
+
+    for ( size_t i = 0; i < length; i++ ) {
+        buffer [i] = ( char ) toupper ( ptr [i] );
+    }
+    buffer [length] = '\0';
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDirectoryFileSystem::IsValid
+// Purpose:
+// Parameters:
+// Returns:
+// Notes:
+//------------------------------------------------------------------------------
+bool cDirectoryFileSystem::IsValid () const
+{
+    FUNCTION_ENTRY ( this, "cDirectoryFileSystem::IsValid", true );
+
+    return m_IsValid;
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDirectoryFileSystem::IsCollection
+// Purpose:
+// Parameters:
+// Returns:
+// Notes:
+//------------------------------------------------------------------------------
+bool cDirectoryFileSystem::IsCollection () const
+{
+    FUNCTION_ENTRY ( this, "cDirectoryFileSystem::IsCollection", true );
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDirectoryFileSystem::OpenFile
+// Purpose:
+// Parameters:
+// Returns:
+// Notes:
+//------------------------------------------------------------------------------
+cFile *cDirectoryFileSystem::OpenFile ( const char *filename )
+{
+    FUNCTION_ENTRY ( this, "cDirectoryFileSystem::OpenFile", true );
+
+    int index = FindFile ( filename );
+
+    return ( index != -1 ) ? m_File [index]->OpenFile ( NULL ) : NULL;
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDirectoryFileSystem::CreateFile
+// Purpose:     Create a new TIFILES file in the directory (deletes any
+//              pre-existing file)
+// Parameters:
+// Returns:
+// Notes:       The host filename is the TI filename with the characters the
+//              host can't handle replaced
+//------------------------------------------------------------------------------
+cFile *cDirectoryFileSystem::CreateFile ( const char *filename, UCHAR type, int recordLength )
+{
+    FUNCTION_ENTRY ( this, "cDirectoryFileSystem::CreateFile", true );
+
+    DeleteFile ( filename );
+
+    if ( m_FileCount >= MAX_FILES ) {
+        WARNING ( "No room left in the directory" );
+        return NULL;
+    }
+
+    char name [ MAX_FILENAME + 1 ];
+    int length = 0;
+    while (( length < MAX_FILENAME ) && ( filename [length] != '\0' ) && ( filename [length] != ' ' )) {
+        char ch = filename [length];
+        name [length++] = ( strchr ( "/\\:*?\"<>|", ch ) != NULL ) ? '_' : ch;
+    }
+    name [length] = '\0';
+
+    char pathname [ MAXPATH ];
+    sprintf ( pathname, "%s%c%s", m_PathName, FILE_SEPERATOR, name );
+
+    cPseudoFileSystem *file = cPseudoFileSystem::Create ( pathname, filename, type, recordLength );
+    if ( file == NULL ) return NULL;
+
+    m_File [ m_FileCount++ ] = file;
+
+    return file->OpenFile ( NULL );
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDirectoryFileSystem::AddFile
+// Purpose:     Copy a file from another filesystem into the directory
+// Parameters:
+// Returns:
+// Notes:
+//------------------------------------------------------------------------------
+bool cDirectoryFileSystem::AddFile ( cFile *file )
+{
+    FUNCTION_ENTRY ( this, "cDirectoryFileSystem::AddFile", true );
+
+    const sFileDescriptorRecord *FDR = file->GetFDR ();
+
+    char name [ MAX_FILENAME + 1 ];
+    memcpy ( name, FDR->FileName, MAX_FILENAME );
+    name [ MAX_FILENAME ] = '\0';
+
+    cFile *newFile = CreateFile ( name, FDR->FileStatus, FDR->RecordLength );
+    if ( newFile == NULL ) return false;
+
+    int totalSectors = GetUSHORT ( &FDR->TotalSectors );
+
+    UCHAR buffer [ DEFAULT_SECTOR_SIZE ];
+    for ( int i = 0; i < totalSectors; i++ ) {
+        file->ReadSector ( i, buffer );
+        newFile->WriteSector ( i, buffer );
+    }
+
+    sFileDescriptorRecord *newFDR = newFile->GetFDR ();
+    newFDR->RecordsPerSector = FDR->RecordsPerSector;
+    newFDR->EOF_Offset       = FDR->EOF_Offset;
+    newFDR->NoFixedRecords   = FDR->NoFixedRecords;
+
+    newFile->Release ( NULL );
+
+    int index = FindFile ( name );
+
+    return m_File [index]->SaveFileBuffer ();
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDirectoryFileSystem::DeleteFile
+// Purpose:     Remove the host file holding the given TI file
+// Parameters:
+// Returns:
+// Notes:
+//------------------------------------------------------------------------------
+bool cDirectoryFileSystem::DeleteFile ( const char *filename )
+{
+    FUNCTION_ENTRY ( this, "cDirectoryFileSystem::DeleteFile", true );
+
+    int index = FindFile ( filename );
+    if ( index == -1 ) return false;
+
+    cPseudoFileSystem *file = m_File [index];
+
+    for ( int i = index; i < m_FileCount - 1; i++ ) {
+        m_File [i] = m_File [i + 1];
+    }
+    m_File [ --m_FileCount ] = NULL;
+
+    // Nothing is left to write back
+    file->m_Modified = false;
+
+    bool retVal = ( remove ( file->m_PathName ) == 0 ) ? true : false;
+
+    file->Release ( NULL );
+
+    return retVal;
+}
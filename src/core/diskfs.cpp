@@ -40,8 +40,6 @@
 
 DBG_REGISTER ( __FILE__ );
 
-cDiskFileSystem *cDiskFileSystem::sm_SortDisk;
-
 static inline USHORT GetUSHORT ( const void *_ptr )
 {
     FUNCTION_ENTRY ( NULL, "GetUSHORT", true );
@@ -57,6 +55,54 @@ static inline USHORT GetUSHORT_LE ( const void *_ptr )
     const UCHAR *ptr = ( const UCHAR * ) _ptr;
     return ( USHORT ) (( ptr [1] << 8 ) | ptr [0] );
 }
+
+// The allocation map is scanned 64 sectors at a time.  Bit n of the map is
+//   sector n, so the bytes of a word are in little-endian order.
+
+typedef ULLONG MAPWORD;
+
+// First sector available for file data (from TI-DSR), the ones below hold FDRs
+const int FIRST_DATA_SECTOR     = 34;
+
+const int MAP_SECTORS           = sizeof ((( VIB * ) 0 )->AllocationMap ) * 8;
+const int MAP_WORDS             = MAP_SECTORS / 64;
+
+static inline MAPWORD GetMapWord ( const UCHAR *map, int index )
+{
+    const UCHAR *ptr = map + index * 8;
+
+    MAPWORD word = 0;
+    for ( int i = 7; i >= 0; i-- ) {
+        word = ( word << 8 ) | ptr [i];
+    }
+
+    return word;
+}
+
+static inline int CountTrailingZeros ( MAPWORD word )
+{
+#if defined ( __GNUC__ )
+    return __builtin_ctzll ( word );
+#else
+    int count = 0;
+    while (( word & 1 ) == 0 ) {
+        word >>= 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+static inline int CountBits ( MAPWORD word )
+{
+#if defined ( __GNUC__ )
+    return __builtin_popcountll ( word );
+#else
+    int count = 0;
+    for ( ; word != 0; word &= word - 1 ) count++;
+    return count;
+#endif
+}
 
 //------------------------------------------------------------------------------
 // Procedure:   cDiskFileSystem::Open
@@ -94,15 +140,22 @@ cDiskFileSystem *cDiskFileSystem::Open ( const char *filename )
 //------------------------------------------------------------------------------
 cDiskFileSystem::cDiskFileSystem ( cDiskMedia *media ) :
     m_Media ( media ),
-    m_VIB ( NULL )
+    m_VIB ( NULL ),
+    m_FileCount ( 0 ),
+    m_FirstEntry ( 0 ),
+    m_Sorted ( true )
 {
     FUNCTION_ENTRY ( this, "cDiskFileSystem ctor", true );
 
+    memset ( m_Directory, 0, sizeof ( m_Directory ));
+    memset ( m_Hash, 0, sizeof ( m_Hash ));
+
     if ( m_Media != NULL ) {
         m_Media->AddRef ( this );
         sSector *sec = m_Media->GetSector ( 0, 0, 0 );
         if ( sec != NULL ) {
             m_VIB = ( VIB * ) sec->Data;
+            LoadDirectory ();
         }
     }
 }
@@ -135,22 +188,95 @@ int cDiskFileSystem::FindFreeSector ( int start ) const
 {
     FUNCTION_ENTRY ( this, "cDiskFileSystem::FindFreeSector", true );
 
-    int index = ( start / 8 ) * 8;
+    if ( start >= MAP_SECTORS ) return -1;
 
-    for ( unsigned i = ( start / 8 ); i < SIZE ( m_VIB->AllocationMap ); i++ ) {
-        UCHAR bits = m_VIB->AllocationMap [i];
-        for ( int j = 0; j < 8; j++ ) {
-            if ((( bits & 1 ) == 0 ) && ( index >= start )) {
-                return index;
-            }
-            index++;
-            bits >>= 1;
+    // Ignore the sectors before 'start' in the first word
+    MAPWORD mask = ~ ( MAPWORD ) 0 << ( start % 64 );
+
+    for ( int i = start / 64; i < MAP_WORDS; i++ ) {
+        MAPWORD free = ~ GetMapWord ( m_VIB->AllocationMap, i ) & mask;
+        if ( free != 0 ) {
+            return i * 64 + CountTrailingZeros ( free );
         }
+        mask = ~ ( MAPWORD ) 0;
     }
 
     return -1;
 }
 
+//------------------------------------------------------------------------------
+// Procedure:   cDiskFileSystem::FindUsedSector
+// Purpose:     Find an allocated sector on the disk beginning at sector 'start'
+// Parameters:
+// Returns:     The sector index or MAP_SECTORS if there are none
+// Notes:       Used to find the end of a run of free sectors
+//------------------------------------------------------------------------------
+int cDiskFileSystem::FindUsedSector ( int start ) const
+{
+    FUNCTION_ENTRY ( this, "cDiskFileSystem::FindUsedSector", true );
+
+    if ( start >= MAP_SECTORS ) return MAP_SECTORS;
+
+    MAPWORD mask = ~ ( MAPWORD ) 0 << ( start % 64 );
+
+    for ( int i = start / 64; i < MAP_WORDS; i++ ) {
+        MAPWORD used = GetMapWord ( m_VIB->AllocationMap, i ) & mask;
+        if ( used != 0 ) {
+            return i * 64 + CountTrailingZeros ( used );
+        }
+        mask = ~ ( MAPWORD ) 0;
+    }
+
+    return MAP_SECTORS;
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDiskFileSystem::FindFreeRun
+// Purpose:     Pick a run of free sectors between 'start' and 'limit'
+// Parameters:  count   - the number of sectors wanted
+//              bestFit - take the smallest run that holds 'count' sectors
+//                        rather than the largest one
+//              length  - returns the length of the run
+// Returns:     The first sector of the run or -1 if there is no free sector
+// Notes:       If no run is big enough the largest one is returned either way
+//------------------------------------------------------------------------------
+int cDiskFileSystem::FindFreeRun ( int start, int limit, int count, bool bestFit, int *length ) const
+{
+    FUNCTION_ENTRY ( this, "cDiskFileSystem::FindFreeRun", true );
+
+    int bestIndex  = -1;
+    int bestLength = 0;
+
+    int index = FindFreeSector ( start );
+
+    while (( index != -1 ) && ( index < limit )) {
+
+        int end = FindUsedSector ( index );
+        if ( end > limit ) end = limit;
+
+        int size = end - index;
+
+        bool better = false;
+        if (( bestFit == true ) && ( bestLength >= count )) {
+            better = (( size >= count ) && ( size < bestLength )) ? true : false;
+        } else {
+            better = ( size > bestLength ) ? true : false;
+        }
+
+        if ( better == true ) {
+            bestIndex  = index;
+            bestLength = size;
+            if (( bestFit == true ) && ( size == count )) break;
+        }
+
+        index = FindFreeSector ( end );
+    }
+
+    *length = bestLength;
+
+    return bestIndex;
+}
+
 //------------------------------------------------------------------------------
 // Procedure:   cDiskFileSystem::SetSectorAllocation
 // Purpose:     Update the allocation bitmap in the VIB for the indicated sector
@@ -172,11 +298,39 @@ void cDiskFileSystem::SetSectorAllocation ( int index, bool bUsed )
     }
 }
 
+//------------------------------------------------------------------------------
+// Procedure:   cDiskFileSystem::SetSectorRange
+// Purpose:     Update the allocation bitmap for 'count' sectors from 'index'
+// Parameters:
+// Returns:
+// Notes:       Whole bytes are set at once, only the ends are done bit by bit
+//------------------------------------------------------------------------------
+void cDiskFileSystem::SetSectorRange ( int index, int count, bool bUsed )
+{
+    FUNCTION_ENTRY ( this, "cDiskFileSystem::SetSectorRange", true );
+
+    int end = index + count;
+
+    while (( index < end ) && ( index % 8 != 0 )) {
+        SetSectorAllocation ( index++, bUsed );
+    }
+
+    if ( end - index >= 8 ) {
+        int bytes = ( end - index ) / 8;
+        memset ( m_VIB->AllocationMap + index / 8, ( bUsed == true ) ? 0xFF : 0x00, bytes );
+        index += bytes * 8;
+    }
+
+    while ( index < end ) {
+        SetSectorAllocation ( index++, bUsed );
+    }
+}
+
 //------------------------------------------------------------------------------
 // Procedure:   cDiskFileSystem::FindLastSector
 // Purpose:     Return the index of the last sector of the file
 // Parameters:
-// Returns:
+// Returns:     The sector index or -1 if the file is empty
 // Notes:
 //------------------------------------------------------------------------------
 int cDiskFileSystem::FindLastSector ( sFileDescriptorRecord *FDR ) const
@@ -189,20 +343,23 @@ int cDiskFileSystem::FindLastSector ( sFileDescriptorRecord *FDR ) const
 
     // Keep track of how many sectors we've already seen
     int count = 0;
+    int last  = -1;
 
     while ( count < totalSectors ) {
 
         ASSERT ( chain < FDR->DataChain + MAX_CHAINS );
 
+        int start  = chain->start + (( int ) ( chain->start_offset & 0x0F ) << 8 );
         int offset = (( int ) chain->offset << 4 ) + ( chain->start_offset >> 4 ) + 1;
 
         ASSERT ( offset > count );
 
+        last  = start + ( offset - count ) - 1;
         count = offset;
         chain++;
     }
 
-    return count - 1;
+    return last;
 }
 
 //------------------------------------------------------------------------------
@@ -322,28 +479,133 @@ const sSector *cDiskFileSystem::FindSector ( int index ) const
     return m_Media->GetSector ( t, h, s );
 }
 
+//------------------------------------------------------------------------------
+// Procedure:   cDiskFileSystem::HashName
+// Purpose:     Return the hash slot for a filename
+// Parameters:
+// Returns:
+// Notes:       Case is ignored and the name ends at a NUL or after MAX_FILENAME
+//              characters, trailing blanks don't count
+//------------------------------------------------------------------------------
+int cDiskFileSystem::HashName ( const char *name )
+{
+    FUNCTION_ENTRY ( NULL, "cDiskFileSystem::HashName", false );
+
+    int length = 0;
+    while (( length < MAX_FILENAME ) && ( name [length] != '\0' )) length++;
+    while (( length > 0 ) && ( name [ length - 1 ] == ' ' )) length--;
+
+    unsigned hash = 0;
+    for ( int i = 0; i < length; i++ ) {
+        hash = hash * 31 + toupper ( name [i] );
+    }
+
+    return hash & ( DIRECTORY_HASH_SIZE - 1 );
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDiskFileSystem::LoadDirectory
+// Purpose:     Read the file descriptor index into m_Directory
+// Parameters:
+// Returns:
+// Notes:       Called once when the disk is opened, the copy is maintained
+//              by AddFileDescriptor and DeleteFile from then on
+//------------------------------------------------------------------------------
+void cDiskFileSystem::LoadDirectory ()
+{
+    FUNCTION_ENTRY ( this, "cDiskFileSystem::LoadDirectory", true );
+
+    m_FileCount = 0;
+    m_Sorted    = true;
+
+    const sSector *sector = FindSector ( 1 );
+    if ( sector == NULL ) return;
+
+    const USHORT *FDI = ( const USHORT * ) sector->Data;
+
+    m_FirstEntry = ( FDI [0] == 0 ) ? 1 : 0;
+
+    for ( int i = m_FirstEntry; ( i < 128 ) && ( m_FileCount < MAX_FILES ); i++ ) {
+        if ( FDI [i] == 0 ) break;
+        int index = GetUSHORT ( &FDI [i] );
+        sSector *fdrSector = FindSector ( index );
+        if ( fdrSector == NULL ) continue;
+        sDirectoryEntry *entry = &m_Directory [ m_FileCount++ ];
+        entry->Sector = index;
+        entry->FDR    = ( sFileDescriptorRecord * ) fdrSector->Data;
+        if (( m_FileCount > 1 ) && ( memcmp ( entry[-1].FDR->FileName, entry->FDR->FileName, MAX_FILENAME ) > 0 )) {
+            m_Sorted = false;
+        }
+    }
+
+    HashDirectory ();
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDiskFileSystem::HashDirectory
+// Purpose:     Rebuild the filename hash from m_Directory
+// Parameters:
+// Returns:
+// Notes:       Uses linear probing - the table is never more than half full
+//------------------------------------------------------------------------------
+void cDiskFileSystem::HashDirectory ()
+{
+    FUNCTION_ENTRY ( this, "cDiskFileSystem::HashDirectory", true );
+
+    memset ( m_Hash, 0, sizeof ( m_Hash ));
+
+    // The first entry of duplicate names wins, as it did with a linear search
+    for ( int i = 0; i < m_FileCount; i++ ) {
+        const sDirectoryEntry *entry = &m_Directory [i];
+        if ( FindFileDescriptorIndex ( entry->FDR->FileName ) != -1 ) continue;
+        int slot = HashName ( entry->FDR->FileName );
+        while ( m_Hash [slot].Sector != 0 ) {
+            slot = ( slot + 1 ) & ( DIRECTORY_HASH_SIZE - 1 );
+        }
+        m_Hash [slot] = *entry;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDiskFileSystem::WriteDirectory
+// Purpose:     Copy m_Directory back to the file descriptor index
+// Parameters:
+// Returns:
+// Notes:
+//------------------------------------------------------------------------------
+void cDiskFileSystem::WriteDirectory ()
+{
+    FUNCTION_ENTRY ( this, "cDiskFileSystem::WriteDirectory", true );
+
+    USHORT *FDI = ( USHORT * ) FindSector ( 1 )->Data;
+
+    memset ( FDI, 0, DEFAULT_SECTOR_SIZE );
+
+    for ( int i = 0; i < m_FileCount; i++ ) {
+        USHORT index = ( USHORT ) m_Directory [i].Sector;
+        FDI [ m_FirstEntry + i ] = GetUSHORT ( &index );
+    }
+}
+
 //------------------------------------------------------------------------------
 // Procedure:   cDiskFileSystem::FindFileDescriptorIndex
 // Purpose:     Return the sector index of the file descriptor with the given filename
 // Parameters:
 // Returns:
-// Notes:
+// Notes:       Case is ignored, the name may be padded with blanks or not
 //------------------------------------------------------------------------------
-int cDiskFileSystem::FindFileDescriptorIndex ( const char *name )
+int cDiskFileSystem::FindFileDescriptorIndex ( const char *name ) const
 {
     FUNCTION_ENTRY ( this, "cDiskFileSystem::FindFileDescriptorIndex", true );
 
-    USHORT *dirIndex = ( USHORT * ) FindSector ( 1 )->Data;
-
-    int start = ( dirIndex [0] == 0 ) ? 1 : 0;
-    int len   = ( strlen ( name ) < 10 ) ? strlen ( name ) : 10;
+    char padded [ MAX_FILENAME ];
+    for ( int i = 0; i < MAX_FILENAME; i++ ) {
+        padded [i] = ( *name != '\0' ) ? *name++ : ' ';
+    }
 
-    for ( int i = start; i < 128; i++ ) {
-        if ( dirIndex [i] == 0 ) break;
-        int index = GetUSHORT ( &dirIndex [i] );
-        sFileDescriptorRecord *FDR = ( sFileDescriptorRecord * ) FindSector ( index )->Data;
-        if ( strnicmp ( FDR->FileName, name, len ) == 0 ) {
-            return index;
+    for ( int slot = HashName ( padded ); m_Hash [slot].Sector != 0; slot = ( slot + 1 ) & ( DIRECTORY_HASH_SIZE - 1 )) {
+        if ( strnicmp ( m_Hash [slot].FDR->FileName, padded, MAX_FILENAME ) == 0 ) {
+            return m_Hash [slot].Sector;
         }
     }
 
@@ -361,10 +623,10 @@ typedef int (*QSORT_FUNC) ( const void *, const void * );
 //------------------------------------------------------------------------------
 int cDiskFileSystem::sortDirectoryIndex ( const void *ptr1, const void *ptr2 )
 {
-    sFileDescriptorRecord *fdr1 = ( sFileDescriptorRecord * ) sm_SortDisk->FindSector ( GetUSHORT ( ptr1 ))->Data;
-    sFileDescriptorRecord *fdr2 = ( sFileDescriptorRecord * ) sm_SortDisk->FindSector ( GetUSHORT ( ptr2 ))->Data;
+    const sDirectoryEntry *entry1 = ( const sDirectoryEntry * ) ptr1;
+    const sDirectoryEntry *entry2 = ( const sDirectoryEntry * ) ptr2;
 
-    return strcmp ( fdr1->FileName, fdr2->FileName );
+    return memcmp ( entry1->FDR->FileName, entry2->FDR->FileName, MAX_FILENAME );
 }
 
 //------------------------------------------------------------------------------
@@ -372,12 +634,21 @@ int cDiskFileSystem::sortDirectoryIndex ( const void *ptr1, const void *ptr2 )
 // Purpose:
 // Parameters:
 // Returns:
-// Notes:
+// Notes:       The new entry is inserted in order, an index that wasn't sorted
+//              on the disk is sorted the first time
 //------------------------------------------------------------------------------
 int cDiskFileSystem::AddFileDescriptor ( const sFileDescriptorRecord *FDR )
 {
     FUNCTION_ENTRY ( this, "cDiskFileSystem::AddFileDescriptor", true );
 
+    // Preserve the 'visibilty' of files
+    if ( m_FileCount == 0 ) m_FirstEntry = 0;
+
+    if ( m_FirstEntry + m_FileCount >= MAX_FILES ) {
+        WARNING ( "File descriptor index is full" );
+        return -1;
+    }
+
     // Find a place to put the FDR
     int fdrIndex = FindFreeSector ( 0 );
     if ( fdrIndex == -1 ) {
@@ -385,44 +656,55 @@ int cDiskFileSystem::AddFileDescriptor ( const sFileDescriptorRecord *FDR )
         return -1;
     }
 
-    USHORT *FDI = ( USHORT * ) FindSector ( 1 )->Data;
-
-    sm_SortDisk = this;
-
-    // Preserve the 'visibilty' of files
-    int start = (( FDI [0] == 0 ) && ( FDI [1] != 0 )) ? 1 : 0;
+    // Mark the new FDR's sector as used
+    SetSectorAllocation ( fdrIndex, true );
 
-    // Look for a free slot in the file descriptor index
-    for ( int i = start; i < 127; i++ ) {
+    // Copy the FDR to the sector on m_Media
+    sFileDescriptorRecord *newFDR = ( sFileDescriptorRecord * ) FindSector ( fdrIndex )->Data;
+    memcpy ( newFDR, FDR, DEFAULT_SECTOR_SIZE );
 
-        if ( FDI [i] == 0 ) {
+    // Make sure the new name is padded with spaces
+    for ( unsigned j = strlen ( newFDR->FileName ); j < sizeof ( newFDR->FileName ); j++ ) {
+        newFDR->FileName [j] = ' ';
+    }
 
-            // Mark the new FDR's sector as used
-            SetSectorAllocation ( fdrIndex, true );
+    // Zero out the CHAIN list
+    newFDR->TotalSectors = 0;
+    memset ( newFDR->DataChain, 0, sizeof ( CHAIN ) * MAX_CHAINS );
 
-            // Copy the FDR to the sector on m_Media
-            sFileDescriptorRecord *newFDR = ( sFileDescriptorRecord * ) FindSector ( fdrIndex )->Data;
-            memcpy ( newFDR, FDR, DEFAULT_SECTOR_SIZE );
+    if ( m_Sorted == false ) {
+        qsort ( m_Directory, m_FileCount, sizeof ( sDirectoryEntry ), ( QSORT_FUNC ) sortDirectoryIndex );
+        m_Sorted = true;
+    }
 
-            // Make sure the new name is padded with spaces
-            for ( unsigned j = strlen ( newFDR->FileName ); j < sizeof ( newFDR->FileName ); j++ ) {
-                newFDR->FileName [j] = ' ';
-            }
+    // Add the name in order
+    int low  = 0;
+    int high = m_FileCount;
+    while ( low < high ) {
+        int mid = ( low + high ) / 2;
+        if ( memcmp ( m_Directory [mid].FDR->FileName, newFDR->FileName, MAX_FILENAME ) < 0 ) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
 
-            // Zero out the CHAIN list
-            newFDR->TotalSectors = 0;
-            memset ( newFDR->DataChain, 0, sizeof ( CHAIN ) * MAX_CHAINS );
+    memmove ( m_Directory + low + 1, m_Directory + low, ( m_FileCount - low ) * sizeof ( sDirectoryEntry ));
+    m_Directory [low].Sector = fdrIndex;
+    m_Directory [low].FDR    = newFDR;
+    m_FileCount++;
 
-            // Add the name and resort the directory
-            FDI [i] = GetUSHORT ( &fdrIndex );
-            qsort ( FDI + start, i - start + 1, sizeof ( USHORT ), ( QSORT_FUNC ) sortDirectoryIndex );
-            break;
-        }
+    int slot = HashName ( newFDR->FileName );
+    while ( m_Hash [slot].Sector != 0 ) {
+        slot = ( slot + 1 ) & ( DIRECTORY_HASH_SIZE - 1 );
     }
+    m_Hash [slot] = m_Directory [low];
+
+    WriteDirectory ();
 
     return fdrIndex;
 }
-
+
 //------------------------------------------------------------------------------
 // Procedure:   cDiskFileSystem::FileCount
 // Purpose:
@@ -434,15 +716,7 @@ int cDiskFileSystem::FileCount () const
 {
     FUNCTION_ENTRY ( this, "cDiskFileSystem::FileCount", true );
 
-    const USHORT *dirIndex = ( const USHORT * ) FindSector ( 1 )->Data;
-
-    int start = ( dirIndex [0] == 0 ) ? 1 : 0;
-
-    for ( int i = start; i < 128; i++ ) {
-        if ( dirIndex [i] == 0 ) return i - start;
-    }
-
-    return 127;
+    return m_FileCount;
 }
 
 //------------------------------------------------------------------------------
@@ -456,13 +730,7 @@ const sFileDescriptorRecord *cDiskFileSystem::GetFileDescriptor ( int index ) co
 {
     FUNCTION_ENTRY  ( this, "cDiskFileSystem::GetFileDescriptor", false );
 
-    const USHORT *dirIndex = ( const USHORT * ) FindSector ( 1 )->Data;
-
-    int start = ( dirIndex [0] == 0 ) ? 1 : 0;
-
-    const sSector *sector = FindSector ( GetUSHORT ( &dirIndex [start + index] ));
-
-    return ( const sFileDescriptorRecord * ) sector->Data;
+    return (( index >= 0 ) && ( index < m_FileCount )) ? m_Directory [index].FDR : NULL;
 }
 
 //------------------------------------------------------------------------------
@@ -477,14 +745,10 @@ int cDiskFileSystem::FreeSectors () const
 {
     FUNCTION_ENTRY ( this, "cDiskFileSystem::FreeSectors", true );
 
-    int free = 0;
+    int free = MAP_SECTORS;
 
-    for ( unsigned i = 0; i < SIZE ( m_VIB->AllocationMap ); i++ ) {
-        UCHAR bits = m_VIB->AllocationMap [i];
-        for ( int j = 0; j < 8; j++ ) {
-            if (( bits & 1 ) == 0 ) free++;
-            bits >>= 1;
-        }
+    for ( int i = 0; i < MAP_WORDS; i++ ) {
+        free -= CountBits ( GetMapWord ( m_VIB->AllocationMap, i ));
     }
 
     return free;
@@ -609,52 +873,74 @@ sSector *cDiskFileSystem::GetFileSector ( sFileDescriptorRecord *FDR, int index
 // Procedure:   cDiskFileSystem::ExtendFile
 // Purpose:     Increase the sector allocation for this file by 'count'.
 // Parameters:
-// Returns:
-// Notes:
+// Returns:     The number of sectors added
+// Notes:       Sectors are taken a run at a time to keep the CHAIN list short.
+//              A file keeps growing in place if it can, otherwise a new file
+//              gets the smallest run that holds it and a growing file the
+//              largest one, to leave it room to grow into.
 //------------------------------------------------------------------------------
 int cDiskFileSystem::ExtendFile ( sFileDescriptorRecord *FDR, int count )
 {
     FUNCTION_ENTRY ( this, "cDiskFileSystem::ExtendFile", true );
 
-    // Try to extend the file without fragmenting
-    int start = FindLastSector ( FDR ) + 1;
-    if ( start == 0 ) {
-        start = 34;
-    }
+    // Don't hand out sectors the disk doesn't have
+    int limit = GetUSHORT ( &m_VIB->FormattedSectors );
+    if (( limit == 0 ) || ( limit > MAP_SECTORS )) limit = MAP_SECTORS;
+
+    int last = FindLastSector ( FDR );
+
+    bool bestFit = ( last == -1 ) ? true : false;
 
-    for ( int i = 0; i < count; i++ ) {
+    int added = 0;
 
-        int index = FindFreeSector ( start );
-        if ( index == -1 ) {
-            // Can't stay contiguous, try any available sector - start at sector 34 (from TI-DSR)
-            index = FindFreeSector ( 34 );
+    while ( added < count ) {
+
+        int needed = count - added;
+        int length = 0;
+        int index  = -1;
+
+        if (( last != -1 ) && ( last + 1 < limit ) && ( FindFreeSector ( last + 1 ) == last + 1 )) {
+            index  = last + 1;
+            length = FindUsedSector ( index ) - index;
+        } else {
+            index = FindFreeRun ( FIRST_DATA_SECTOR, limit, needed, bestFit, &length );
             if ( index == -1 ) {
                 // No 'normal' sectors left - try FDI sector range
-                index = FindFreeSector ( 0 );
+                index = FindFreeRun ( 0, limit, needed, bestFit, &length );
                 if ( index == -1 ) {
                     WARNING ( "Disk is full" );
-                    return i;
+                    break;
                 }
             }
         }
 
-        // Add this sector to the file chain and mark it in use
-        if ( AddFileSector ( FDR, index ) == false ) {
-            WARNING ( "File is too fragmented" );
-            return i;
+        if ( length > needed ) length = needed;
+        if ( length > limit - index ) length = limit - index;
+
+        // Add the run to the file chain and mark it in use
+        int i = 0;
+        for ( ; i < length; i++ ) {
+            if ( AddFileSector ( FDR, index + i ) == false ) break;
+            sSector *sector = FindSector ( index + i );
+            memset ( sector->Data, 0, DEFAULT_SECTOR_SIZE );
         }
 
-        sSector *sector = FindSector ( index );
-        memset ( sector->Data, 0, DEFAULT_SECTOR_SIZE );
+        SetSectorRange ( index, i, true );
 
-        SetSectorAllocation ( index, true );
+        added += i;
+        last   = index + i - 1;
 
-        start = index + 1;
+        if ( i < length ) {
+            WARNING ( "File is too fragmented" );
+            break;
+        }
+    }
 
+    if ( added > 0 ) {
         DiskModified ();
     }
 
-    return count;
+    return added;
 }
 
 //------------------------------------------------------------------------------
@@ -692,9 +978,7 @@ void cDiskFileSystem::TruncateFile ( sFileDescriptorRecord *FDR, int limit )
         if ( limit < offset ) {
 
             // Mark the excess sectors as free
-            for ( int i = limit - count; i < offset - count; i++ ) {
-                SetSectorAllocation ( start + i, false );
-            }
+            SetSectorRange ( start + limit - count, offset - limit, false );
 
             // Update the chain
             chain->start        = start & 0xFF;
@@ -713,9 +997,7 @@ void cDiskFileSystem::TruncateFile ( sFileDescriptorRecord *FDR, int limit )
         int offset = (( int ) chain->offset << 4 ) + ( chain->start_offset >> 4 ) + 1;
 
         // Mark the sectors as free
-        for ( int i = 0; i < offset - count; i++ ) {
-            SetSectorAllocation ( start + i, false );
-        }
+        SetSectorRange ( start, offset - count, false );
 
         chain->start        = 0;
         chain->start_offset = 0;
@@ -745,6 +1027,20 @@ void cDiskFileSystem::DiskModified ()
     m_Media->DiskModified ();
 }
 
+//------------------------------------------------------------------------------
+// Procedure:   cDiskFileSystem::Flush
+// Purpose:     Write any changes back to the disk image
+// Parameters:
+// Returns:
+// Notes:
+//------------------------------------------------------------------------------
+bool cDiskFileSystem::Flush ()
+{
+    FUNCTION_ENTRY ( this, "cDiskFileSystem::Flush", true );
+
+    return ( m_Media != NULL ) ? m_Media->WriteBack () : false;
+}
+
 //------------------------------------------------------------------------------
 // Procedure:   cDiskFileSystem::GetPath
 // Purpose:     Return the filename of the disk
@@ -876,13 +1172,21 @@ cFile *cDiskFileSystem::CreateFile ( const char *filename, UCHAR type, int recor
         fdr.FileName [i] = ( *filename != '\0' ) ? *filename++ : ' ';
     }
 
-    fdr.FileStatus       = type;
-    fdr.RecordsPerSector = ( type & VARIABLE_TYPE ) ? ( 255 / ( recordLength + 1 )) : 256 / recordLength;
-    fdr.RecordLength     = recordLength;
+    fdr.FileStatus = type;
 
-    FATAL ( "Function not implemented yet" );
+    if (( type & PROGRAM_TYPE ) == 0 ) {
+        fdr.RecordsPerSector = ( type & VARIABLE_TYPE ) ? ( 255 / ( recordLength + 1 )) : 256 / recordLength;
+        fdr.RecordLength     = recordLength;
+    }
 
-    return NULL;
+    int fdrIndex = AddFileDescriptor ( &fdr );
+    if ( fdrIndex == -1 ) {
+        return NULL;
+    }
+
+    DiskModified ();
+
+    return cFileSystem::CreateFile (( sFileDescriptorRecord * ) FindSector ( fdrIndex )->Data );
 }
 
 
@@ -932,7 +1236,7 @@ bool cDiskFileSystem::AddFile ( cFile *file )
     sFileDescriptorRecord *newFDR = ( sFileDescriptorRecord * ) FindSector ( fdrIndex )->Data;
 
     // This shouldn't fail since we've already checked for free space
-    if ( ExtendFile ( newFDR, totalSectors ) == false ) {
+    if ( ExtendFile ( newFDR, totalSectors ) != totalSectors ) {
         FATAL ( "Internal error: Unable to extend file" );
         DeleteFile ( FDR->FileName );
         return false;
@@ -964,20 +1268,18 @@ bool cDiskFileSystem::DeleteFile ( const char *fileName )
         return false;
     }
 
-    USHORT *FDI = ( USHORT * ) FindSector ( 1 )->Data;
-
-    int start = ( FDI [0] == 0 ) ? 1 : 0;
-
     // Remove the pointer to the FDR from the FDI
-    int fdrIndex = GetUSHORT ( &index );
-    for ( int i = start; i < 127; i++ ) {
-        if ( FDI [i] == fdrIndex ) {
-            memcpy ( FDI + i, FDI + i + 1, ( 127 - i ) * sizeof ( USHORT ));
-            FDI [127] = 0;
+    for ( int i = 0; i < m_FileCount; i++ ) {
+        if ( m_Directory [i].Sector == index ) {
+            memmove ( m_Directory + i, m_Directory + i + 1, ( m_FileCount - i - 1 ) * sizeof ( sDirectoryEntry ));
+            m_FileCount--;
             break;
         }
     }
 
+    HashDirectory ();
+    WriteDirectory ();
+
     sFileDescriptorRecord *FDR = ( sFileDescriptorRecord * ) FindSector ( index )->Data;
 
     // Release all of the sectors owned by the file itself
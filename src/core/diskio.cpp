@@ -33,6 +33,9 @@
 #if ! defined ( __WIN32__ )
   #include <unistd.h>
 #endif
+#if ! defined ( __WIN32__ ) && ! defined ( PSP )
+  #define HAVE_FSYNC
+#endif
 #include "common.hpp"
 #include "logger.hpp"
 #include "support.hpp"
@@ -42,6 +45,14 @@
 
 DBG_REGISTER ( __FILE__ );
 
+#define JOURNAL_RECORD          "JREC"
+#define JOURNAL_COMMIT          "JEND"
+#define JOURNAL_HEADER_SIZE     12
+
+static cDiskWriter DefaultWriter;
+
+cDiskWriter *cDiskMedia::sm_Writer = NULL;
+
 cDiskMedia::cDiskMedia ( const char *fileName ) :
     cBaseObject ( "cDiskMedia" ),
     m_HasChanged ( false ),
@@ -52,11 +63,21 @@ cDiskMedia::cDiskMedia ( const char *fileName ) :
     m_MaxTracks ( 0 ),
     m_NumHeads ( 0 ),
     m_NumTracks ( 0 ),
-    m_RawData ( NULL )
+    m_RawData ( NULL ),
+    m_ImageData ( NULL ),
+    m_ImageSize ( 0 ),
+    m_ImageSectors ( 0 ),
+    m_ImageDensity ( DENSITY_UNKNOWN ),
+    m_Rewrite ( false ),
+    m_FileSectors ( 0 ),
+    m_FileTracks ( 0 ),
+    m_FileSides ( 0 )
 {
     FUNCTION_ENTRY ( this, "cDiskMedia ctor", true );
 
     memset ( m_Track, 0, sizeof ( m_Track ));
+    memset ( m_Image, 0, sizeof ( m_Image ));
+    memset ( m_Dirty, 0, sizeof ( m_Dirty ));
 
     SetName ( fileName );
     LoadFile ();
@@ -72,11 +93,21 @@ cDiskMedia::cDiskMedia ( int maxTracks, int maxHeads ) :
     m_MaxTracks ( 0 ),
     m_NumHeads ( 0 ),
     m_NumTracks ( 0 ),
-    m_RawData ( NULL )
+    m_RawData ( NULL ),
+    m_ImageData ( NULL ),
+    m_ImageSize ( 0 ),
+    m_ImageSectors ( 0 ),
+    m_ImageDensity ( DENSITY_UNKNOWN ),
+    m_Rewrite ( false ),
+    m_FileSectors ( 0 ),
+    m_FileTracks ( 0 ),
+    m_FileSides ( 0 )
 {
     FUNCTION_ENTRY ( this, "cDiskMedia ctor", true );
 
     memset ( m_Track, 0, sizeof ( m_Track ));
+    memset ( m_Image, 0, sizeof ( m_Image ));
+    memset ( m_Dirty, 0, sizeof ( m_Dirty ));
 
     AllocateTracks ( maxTracks, maxHeads );
 
@@ -88,13 +119,15 @@ cDiskMedia::~cDiskMedia ()
     FUNCTION_ENTRY ( this, "cDiskMedia dtor", true );
 
     if ( m_HasChanged == true ) {
-        SaveFile ();
+        WriteBack ();
     }
 
     delete [] m_FileName;
     m_FileName = NULL;
 
-    delete [] m_RawData;
+    ReleaseImage ();
+
+    free ( m_RawData );
     m_RawData = NULL;
 }
 
@@ -225,13 +258,15 @@ void cDiskMedia::AllocateTracks ( int maxTracks, int maxHeads )
     m_MaxHeads  = ( maxHeads != 0 ) ? maxHeads : 2;
     m_MaxTracks = ( maxTracks != 0 ) ? maxTracks : MAX_TRACKS;
 
-    UCHAR *ptr = new UCHAR [ m_MaxHeads * m_MaxTracks * MAX_TRACK_SIZE ];
+    // calloc leaves the pages alone until a track is actually used
+    UCHAR *ptr = ( UCHAR * ) calloc ( m_MaxHeads * m_MaxTracks, MAX_TRACK_SIZE );
 
-    delete [] m_RawData;
+    free ( m_RawData );
     m_RawData = ptr;
-    memset ( m_RawData, 0, m_MaxHeads * m_MaxTracks * MAX_TRACK_SIZE );
 
     memset ( m_Track, 0, sizeof ( m_Track ));
+    memset ( m_Image, 0, sizeof ( m_Image ));
+    memset ( m_Dirty, 0, sizeof ( m_Dirty ));
 
     for ( int h = 0; h < m_MaxHeads; h++ ) {
         for ( int t = 0; t < m_MaxTracks; t++ ) {
@@ -258,6 +293,9 @@ void cDiskMedia::FormatTrack ( int tIndex, int hIndex, eDiskDensity density, int
     if ( tIndex + 1 > m_NumTracks ) m_NumTracks = tIndex + 1;
     if ( hIndex + 1 > m_NumHeads ) m_NumHeads = hIndex + 1;
 
+    m_Image [hIndex][tIndex].Pending = false;
+    m_Dirty [hIndex][tIndex] = ( ULONG ) -1;
+
     sTrack *track  = &m_Track [hIndex][tIndex];
     track->Density = density;
 
@@ -328,7 +366,8 @@ void cDiskMedia::FormatTrack ( int tIndex, int hIndex, eDiskDensity density, int
     track->Size = ptr - track->Data;
 }
 
-static sSector sectorInfo [] = {
+// Template only - callers fill in a copy so disks can be loaded on several threads
+static const sSector sectorInfo [] = {
     { 0, 0,  0, 1, NULL },
     { 0, 0,  1, 1, NULL },
     { 0, 0,  2, 1, NULL },
@@ -363,17 +402,66 @@ void cDiskMedia::FormatDisk ( int noTracks, int noSides, eDiskDensity density )
 
     int noSectors = ( density == DENSITY_SINGLE ) ? 9 : 18;
 
+    sSector info [ SIZE ( sectorInfo ) ];
+    memcpy ( info, sectorInfo, sizeof ( info ));
+
     for ( int h = 0; h < noSides; h++ ) {
         for ( int t = 0; t < noTracks; t++ ) {
             for ( int s = 0; s < noSectors; s++ ) {
-                sectorInfo [s].LogicalCylinder = t;
-                sectorInfo [s].LogicalSide     = h;
+                info [s].LogicalCylinder = t;
+                info [s].LogicalSide     = h;
             }
-            FormatTrack ( t, h, density, noSectors, sectorInfo );
+            FormatTrack ( t, h, density, noSectors, info );
         }
     }
 }
 
+void cDiskMedia::DecodeTrack ( int tIndex, int hIndex )
+{
+    FUNCTION_ENTRY ( this, "cDiskMedia::DecodeTrack", false );
+
+    sTrackImage *image = &m_Image [hIndex][tIndex];
+
+    if ( image->Pending == false ) return;
+
+    image->Pending = false;
+
+    // Decoding doesn't change the disk
+    bool hasChanged = m_HasChanged;
+
+    UCHAR *data = m_ImageData + image->Offset;
+
+    if ( m_Format == FORMAT_RAW_TRACK ) {
+        WriteTrack ( tIndex, hIndex, image->Size, data );
+    } else {
+        int noSectors = ( m_ImageDensity == DENSITY_SINGLE ) ? 9 : 18;
+        sSector info [ SIZE ( sectorInfo ) ];
+        memcpy ( info, sectorInfo, sizeof ( info ));
+        for ( int s = 0; s < noSectors; s++ ) {
+            info [s].LogicalCylinder = tIndex;
+            info [s].LogicalSide     = hIndex;
+        }
+        FormatTrack ( tIndex, hIndex, m_ImageDensity, noSectors, info );
+        for ( int s = 0; ( s < m_ImageSectors ) && (( s + 1 ) * DEFAULT_SECTOR_SIZE <= image->Size ); s++ ) {
+            WriteSector ( tIndex, hIndex, s, tIndex, data + s * DEFAULT_SECTOR_SIZE );
+        }
+    }
+
+    m_HasChanged = hasChanged;
+    m_Dirty [hIndex][tIndex] = 0;
+}
+
+void cDiskMedia::DecodeAll ()
+{
+    FUNCTION_ENTRY ( this, "cDiskMedia::DecodeAll", true );
+
+    for ( int h = 0; h < m_MaxHeads; h++ ) {
+        for ( int t = 0; t < m_MaxTracks; t++ ) {
+            DecodeTrack ( t, h );
+        }
+    }
+}
+
 void cDiskMedia::WriteSector ( int tIndex, int hIndex, int logSec, int logCyl, void *data )
 {
     FUNCTION_ENTRY ( this, "cDiskMedia::WriteSector", true );
@@ -384,6 +472,7 @@ void cDiskMedia::WriteSector ( int tIndex, int hIndex, int logSec, int logCyl, v
 
     if ( memcmp ( sector->Data, data, 128 << sector->Size ) != 0 ) {
         memcpy ( sector->Data, data, 128 << sector->Size );
+        m_Dirty [hIndex][tIndex] |= 1UL << ( sector - m_Track [hIndex][tIndex].Sector );
         m_HasChanged = true;
     }
 }
@@ -398,6 +487,8 @@ void cDiskMedia::WriteTrack ( int tIndex, int hIndex, int size, UCHAR *data )
     if ( tIndex + 1 > m_NumTracks ) m_NumTracks = tIndex + 1;
     if ( hIndex + 1 > m_NumHeads ) m_NumHeads = hIndex + 1;
 
+    m_Image [hIndex][tIndex].Pending = false;
+
     sTrack *track = &m_Track [hIndex][tIndex];
 
     if (( track->Size == size ) && ( memcmp ( track->Data, data, size ) == 0 )) {
@@ -437,9 +528,59 @@ void cDiskMedia::WriteTrack ( int tIndex, int hIndex, int size, UCHAR *data )
         sector++;
     }
 
+    m_Dirty [hIndex][tIndex] = ( ULONG ) -1;
     m_HasChanged = true;
 }
 
+//----------------------------------------------------------------------------
+//
+// The image file is read in one piece, the Read routines below only locate
+// the tracks in it.  DecodeTrack builds a track the first time it is used.
+// It is not mapped: the file may be rewritten or truncated by some other
+// program while the disk is mounted, and the tracks still to be decoded
+// must not depend on it.
+//
+//----------------------------------------------------------------------------
+
+bool cDiskMedia::ReadImage ( FILE *file )
+{
+    FUNCTION_ENTRY ( this, "cDiskMedia::ReadImage", true );
+
+    ReleaseImage ();
+
+    fseek ( file, 0, SEEK_END );
+    ULONG size = ftell ( file );
+    fseek ( file, 0, SEEK_SET );
+
+    if ( size == 0 ) return false;
+
+    m_ImageData = new UCHAR [ size ];
+    if ( fread ( m_ImageData, size, 1, file ) != 1 ) {
+        ERROR ( "Error reading from file" );
+        delete [] m_ImageData;
+        m_ImageData = NULL;
+        return false;
+    }
+
+    m_ImageSize = size;
+
+    return true;
+}
+
+void cDiskMedia::ReleaseImage ()
+{
+    FUNCTION_ENTRY ( this, "cDiskMedia::ReleaseImage", true );
+
+    if ( m_ImageData == NULL ) return;
+
+    delete [] m_ImageData;
+
+    m_ImageData = NULL;
+    m_ImageSize = 0;
+
+    memset ( m_Image, 0, sizeof ( m_Image ));
+}
+
 //----------------------------------------------------------------------------
 //
 // Read disk files that contain raw track data.  This is the format used by
@@ -448,67 +589,51 @@ void cDiskMedia::WriteTrack ( int tIndex, int hIndex, int size, UCHAR *data )
 //
 //----------------------------------------------------------------------------
 
-bool cDiskMedia::ReadDiskRawTrack ( FILE *file )
+bool cDiskMedia::ReadDiskRawTrack ()
 {
     FUNCTION_ENTRY ( this, "cDiskMedia::ReadDiskRawTrack", true );
 
-    UCHAR trackBuffer [ 2 * MAX_TRACK_SIZE ];
+    UCHAR *start = m_ImageData;
+    UCHAR *end   = m_ImageData + m_ImageSize;
 
-    // Find out the index GAP character (should be 0xFF or 0x4E but PC99 uses 0x00 for FM disks)
-    if ( fread ( trackBuffer, 64, 1, file ) != 1 ) {
+    if ( m_ImageSize < 64 ) {
         ERROR ( "Error reading from file" );
         return false;
     }
 
-    UCHAR indexGapChar   = trackBuffer [0];
+    // Find out the index GAP character (should be 0xFF or 0x4E but PC99 uses 0x00 for FM disks)
+    UCHAR indexGapChar   = start [0];
     eDiskDensity density = ( indexGapChar != 0x4E ) ? DENSITY_SINGLE : DENSITY_DOUBLE;
     int maxTrackSize     = 120 * (( density == DENSITY_SINGLE ) ? TRACK_SIZE_FM : TRACK_SIZE_MFM ) / 100;
 
-    UCHAR *markID = FindAddressMark ( 0xFF, 0xFE, density, trackBuffer, trackBuffer + 64 );
+    UCHAR *markID = FindAddressMark ( 0xFF, 0xFE, density, start, start + 64 );
     if ( markID == NULL ) return false;
     if ( density == DENSITY_DOUBLE ) markID -= 3;
     markID -= 1 + (( density == DENSITY_SINGLE ) ? SYNC_BYTES_FM : SYNC_BYTES_MFM );
-    int indexGapSize = markID - trackBuffer;
+    int indexGapSize = markID - start;
 
-    sTrack trackData [ 2 * MAX_TRACKS ];
+    sTrackImage trackData [ 2 * MAX_TRACKS ];
     memset ( trackData, 0, sizeof ( trackData ));
 
-    int count = 0;
     int index = 0;
 
-    fseek ( file, 0, SEEK_SET );
+    // Split the image into tracks, looking at no more than 2 tracks at a time
+    for ( UCHAR *ptr = start; ( ptr < end ) && ( index < 2 * MAX_TRACKS ); ) {
 
-    for ( EVER ) {
-
-        int read = fread ( trackBuffer + count, 1, sizeof ( trackBuffer ) - count, file );
-        if ( read <= 0 ) break;
-
-        count += read;
-
-        // trackBuffer should now contain enough data for at least 1 track
-        while ( count >= maxTrackSize ) {
-
-            UCHAR *ptr = FindEndOfTrack ( density, indexGapChar, indexGapSize, trackBuffer, trackBuffer + count );
-            if ( ptr == NULL ) return false;
+        UCHAR *next = end;
 
-            int size = ptr - trackBuffer;
-
-            trackData [index].Size = size;
-            trackData [index].Data = new UCHAR [ size ];
-            memcpy ( trackData [index].Data, trackBuffer, size );
-            index++;
-
-            count -= size;
-            memcpy ( trackBuffer, ptr, count );
+        if ( end - ptr >= maxTrackSize ) {
+            UCHAR *max = ( end - ptr > 2 * MAX_TRACK_SIZE ) ? ptr + 2 * MAX_TRACK_SIZE : end;
+            next = FindEndOfTrack ( density, indexGapChar, indexGapSize, ptr, max );
+            if (( next == NULL ) || ( next <= ptr )) return false;
         }
 
-    }
-
-    if ( count > 0 ) {
-        trackData [index].Size = count;
-        trackData [index].Data = new UCHAR [ count ];
-        memcpy ( trackData [index].Data, trackBuffer, count );
+        trackData [index].Pending = true;
+        trackData [index].Offset  = ptr - start;
+        trackData [index].Size    = next - ptr;
         index++;
+
+        ptr = next;
     }
 
     int maxTrack = MAX_TRACKS_HI;
@@ -518,26 +643,29 @@ bool cDiskMedia::ReadDiskRawTrack ( FILE *file )
 
     // Try to distinguish between single-sided 80 tracks and double-sided 40 track disks
     if ( index == MAX_TRACKS_HI ) {
-        WriteTrack ( 0, 0, trackData [MAX_TRACKS_LO].Size, trackData [MAX_TRACKS_LO].Data );
+        WriteTrack ( 0, 0, trackData [MAX_TRACKS_LO].Size, start + trackData [MAX_TRACKS_LO].Offset );
         sSector *sector = &m_Track [0][0].Sector [0];
         if ( sector->LogicalSide == 1 ) maxTrack = MAX_TRACKS_LO;
         m_Track [0][0].Size = 0;
+        memset ( m_Track [0][0].Sector, 0, sizeof ( m_Track [0][0].Sector ));
     }
 
+    int count = index;
+
     index = 0;
     for ( int h = 0; h < 2; h++ ) {
         for ( int t = 0; t < MAX_TRACKS; t++ ) {
-            if (( t < maxTrack ) && ( trackData [index].Data != NULL )) {
-                WriteTrack ( t, h, trackData [index].Size, trackData [index].Data );
-                delete [] trackData [index].Data;
-                index++;
+            if (( t < maxTrack ) && ( index < count )) {
+                if ( t + 1 > m_NumTracks ) m_NumTracks = t + 1;
+                if ( h + 1 > m_NumHeads ) m_NumHeads = h + 1;
+                m_Image [h][t] = trackData [index++];
             }
         }
     }
 
     return true;
 }
-
+
 //----------------------------------------------------------------------------
 //
 // Read disk files that contain raw sector data.  This is the format used by
@@ -547,25 +675,19 @@ bool cDiskMedia::ReadDiskRawTrack ( FILE *file )
 //
 //----------------------------------------------------------------------------
 
-bool cDiskMedia::ReadDiskRawSector ( FILE *file  )
+bool cDiskMedia::ReadDiskRawSector ()
 {
     FUNCTION_ENTRY ( this, "cDiskMedia::ReadDiskRawSector", true );
 
-    fseek ( file, 0, SEEK_END );
-    ULONG size = ftell ( file );
-    fseek ( file, 0, SEEK_SET );
-
-    int totalSectors = size / DEFAULT_SECTOR_SIZE;
-
-    char buffer [ DEFAULT_SECTOR_SIZE ];
+    int totalSectors = m_ImageSize / DEFAULT_SECTOR_SIZE;
 
-    // Read the 1st sector from the disk to get the VIB
-    if ( fread ( buffer, sizeof ( buffer ), 1, file ) != 1 ) {
+    // The 1st sector from the disk holds the VIB
+    if ( totalSectors == 0 ) {
         ERROR ( "Error reading from file" );
         return false;
     }
 
-    VIB *vib      = ( VIB * ) buffer;
+    VIB *vib      = ( VIB * ) m_ImageData;
     int noSectors = ( vib->SectorsPerTrack != 0 ) ? vib->SectorsPerTrack : 9;
     int noTracks  = totalSectors / noSectors;
 
@@ -577,29 +699,38 @@ bool cDiskMedia::ReadDiskRawSector ( FILE *file  )
     noTracks /= noSides;
 
     // Clear any old data & prepare for a new image
-    FormatDisk ( noTracks, noSides, density );
+    AllocateTracks ( noTracks, noSides );
 
-    fseek ( file, 0, SEEK_SET );
+    m_ImageSectors = noSectors;
+    m_ImageDensity = density;
+
+    ULONG trackSize = noSectors * DEFAULT_SECTOR_SIZE;
+    ULONG offset    = 0;
 
     for ( int h = 0; h < noSides; h++ ) {
         for ( int t = 0; t < noTracks; t++ ) {
             int track = ( h == 0 ) ? t : noTracks - 1 - t;
-            for ( int s = 0; s < noSectors; s++ ) {
-                if ( fread ( buffer, sizeof ( buffer ), 1, file ) != 1 ) {
-                    if ( feof ( file )) {
-                        return true;
-                    }
-                    ERROR ( "Error reading from file" );
-                    return false;
-                }
-                WriteSector ( track, h, s, track, buffer );
-            }
+            sTrackImage *image = &m_Image [h][track];
+            image->Pending = true;
+            image->Offset  = offset;
+            image->Size    = ( offset >= m_ImageSize ) ? 0 : ( m_ImageSize - offset < trackSize ) ? m_ImageSize - offset : trackSize;
+            offset += trackSize;
         }
     }
 
+    m_NumTracks = noTracks;
+    m_NumHeads  = noSides;
+
+    // Only an image that holds exactly the tracks we see can be written in place
+    if ( m_ImageSize == ( ULONG ) noSides * noTracks * trackSize ) {
+        m_FileSectors = noSectors;
+        m_FileTracks  = noTracks;
+        m_FileSides   = noSides;
+    }
+
     return true;
 }
-
+
 struct sTrackInfo {
     int       noSectors;
     int       totalSize;
@@ -693,6 +824,14 @@ bool cDiskMedia::LoadFile ()
     bool retVal = false;
     const char *errMsg = NULL;
 
+    ReleaseImage ();
+
+    // Let pending writes land and replay any that were interrupted
+    GetWriter ()->Sync ();
+    cDiskWriter::Recover ( m_FileName );
+
+    m_FileSectors = 0;
+
     FILE *file = fopen ( m_FileName, "rb" );
 
     if ( file == NULL ) {
@@ -701,10 +840,10 @@ bool cDiskMedia::LoadFile ()
         errMsg = "Error reading";
         switch ( m_Format = DetermineFormat ( file )) {
             case FORMAT_RAW_TRACK :
-                retVal = ReadDiskRawTrack ( file );
+                retVal = ReadImage ( file ) && ReadDiskRawTrack ();
                 break;
             case FORMAT_RAW_SECTOR :
-                retVal = ReadDiskRawSector ( file );
+                retVal = ReadImage ( file ) && ReadDiskRawSector ();
                 break;
             case FORMAT_ANADISK :
                 retVal = ReadDiskAnadisk ( file );
@@ -721,13 +860,17 @@ bool cDiskMedia::LoadFile ()
 
     if ( retVal != true ) {
         WARNING ( errMsg << " disk image '" << m_FileName << '\'' );
+        ReleaseImage ();
         AllocateTracks ( m_MaxTracks, m_MaxHeads );
         m_Format = FORMAT_UNKNOWN;
     } else {
         m_IsWriteProtected = IsWriteable ( m_FileName ) ? false : true;
     }
 
+    memset ( m_Dirty, 0, sizeof ( m_Dirty ));
+
     m_HasChanged = false;
+    m_Rewrite    = false;
 
     return retVal;
 }
@@ -839,6 +982,7 @@ void cDiskMedia::ClearDisk ()
 {
     FUNCTION_ENTRY ( this, "cDiskMedia::ClearDisk", true );
 
+    ReleaseImage ();
     AllocateTracks ( m_MaxTracks, m_MaxHeads );
 
     m_HasChanged = false;
@@ -868,13 +1012,27 @@ bool cDiskMedia::SaveFile ( eDiskFormat format, bool force )
         }
     }
 
+    // Writes still queued for the old file must not land on the new one
+    GetWriter ()->Sync ();
+
+    // The file is about to be overwritten, take what is left in it first
+    DecodeAll ();
+
     if (( format == FORMAT_RAW_SECTOR ) && ( IsValidRawSector () == false )) {
         ERROR ( "Disk contains features that this format does not support" );
         return false;
     }
 
-    FILE *file = fopen ( m_FileName, "wb" );
+    ReleaseImage ();
+
+    // Write a new file next to the image and swap it in once complete, an
+    //   interrupted save leaves the old image intact
+    char *tmpName = new char [ strlen ( m_FileName ) + 5 ];
+    sprintf ( tmpName, "%s.tmp", m_FileName );
+
+    FILE *file = fopen ( tmpName, "wb" );
     if ( file == NULL ) {
+        delete [] tmpName;
         return false;
     }
 
@@ -896,20 +1054,173 @@ bool cDiskMedia::SaveFile ( eDiskFormat format, bool force )
             break;
     }
 
+    if ( fflush ( file ) != 0 ) retVal = false;
+#if defined ( HAVE_FSYNC )
+    if (( retVal == true ) && ( fsync ( fileno ( file )) != 0 )) retVal = false;
+#endif
+
     fclose ( file );
 
+    if ( retVal == true ) {
+#if defined ( __WIN32__ )
+        remove ( m_FileName );
+#endif
+        if ( rename ( tmpName, m_FileName ) != 0 ) {
+            errMsg = "Unable to replace";
+            retVal = false;
+        }
+    }
+
+    if ( retVal != true ) {
+        remove ( tmpName );
+    }
+
+    delete [] tmpName;
+
     if ( errMsg != NULL ) {
         WARNING ( errMsg << " disk file '" << m_FileName << '\'' );
     }
 
     if ( retVal == true ) {
+        cDiskWriter::Discard ( m_FileName );
+        memset ( m_Dirty, 0, sizeof ( m_Dirty ));
         m_HasChanged = false;
+        m_Rewrite    = false;
         m_Format     = format;
+        SetFileLayout ();
     }
 
     return retVal;
 }
-
+
+//----------------------------------------------------------------------------
+//
+// Raw sector images that keep the layout they were loaded with only need
+// the sectors that changed, these are handed to the disk writer in a single
+// batch.  Anything else gets a full SaveFile.
+//
+//----------------------------------------------------------------------------
+
+bool cDiskMedia::IsRegularTrack ( int tIndex, int hIndex, int noSectors )
+{
+    FUNCTION_ENTRY ( this, "cDiskMedia::IsRegularTrack", false );
+
+    const sTrack *track = GetTrack ( tIndex, hIndex );
+    if ( track == NULL ) return false;
+
+    int count = 0;
+    while (( count < MAX_SECTORS ) && ( track->Sector [count].Data != NULL )) count++;
+    if ( count != noSectors ) return false;
+
+    for ( int s = 0; s < noSectors; s++ ) {
+        const sSector *sector = GetSector ( tIndex, hIndex, s );
+        if (( sector == NULL ) || ( sector->Size != 1 ) || ( sector->Data [-1] != 0xFB )) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void cDiskMedia::SetFileLayout ()
+{
+    FUNCTION_ENTRY ( this, "cDiskMedia::SetFileLayout", true );
+
+    m_FileSectors = 0;
+
+    if (( m_Format != FORMAT_RAW_SECTOR ) || ( m_NumHeads == 0 ) || ( m_NumTracks == 0 )) return;
+
+    int noSectors = 0;
+    while (( noSectors < MAX_SECTORS ) && ( m_Track [0][0].Sector [noSectors].Data != NULL )) noSectors++;
+
+    for ( int h = 0; h < m_NumHeads; h++ ) {
+        for ( int t = 0; t < m_NumTracks; t++ ) {
+            if ( IsRegularTrack ( t, h, noSectors ) == false ) return;
+        }
+    }
+
+    m_FileSectors = noSectors;
+    m_FileTracks  = m_NumTracks;
+    m_FileSides   = m_NumHeads;
+}
+
+bool cDiskMedia::CanWriteInPlace ()
+{
+    FUNCTION_ENTRY ( this, "cDiskMedia::CanWriteInPlace", true );
+
+    if (( m_Format != FORMAT_RAW_SECTOR ) || ( m_Rewrite == true ) || ( m_FileSectors == 0 )) return false;
+    if (( m_NumTracks != m_FileTracks ) || ( m_NumHeads != m_FileSides )) return false;
+
+    for ( int h = 0; h < m_MaxHeads; h++ ) {
+        for ( int t = 0; t < m_MaxTracks; t++ ) {
+            if ( m_Dirty [h][t] == 0 ) continue;
+            if (( h >= m_FileSides ) || ( t >= m_FileTracks )) return false;
+            if ( IsRegularTrack ( t, h, m_FileSectors ) == false ) return false;
+        }
+    }
+
+    return true;
+}
+
+bool cDiskMedia::WriteInPlace ()
+{
+    FUNCTION_ENTRY ( this, "cDiskMedia::WriteInPlace", true );
+
+    int count = 0;
+
+    for ( int pass = 0; pass < 2; pass++ ) {
+
+        if (( pass == 1 ) && ( count == 0 )) break;
+
+        sDiskBatch *batch = ( pass == 0 ) ? NULL : cDiskWriter::CreateBatch ( m_FileName, count );
+        sDiskWrite *write = ( pass == 0 ) ? NULL : batch->Write;
+
+        for ( int h = 0; h < m_FileSides; h++ ) {
+            for ( int t = 0; t < m_FileTracks; t++ ) {
+                if ( m_Dirty [h][t] == 0 ) continue;
+                // Side 1 is stored from the last track back to the first
+                ULONG index = ( h == 0 ) ? t : 2 * m_FileTracks - 1 - t;
+                for ( int s = 0; s < m_FileSectors; s++ ) {
+                    const sSector *sector = GetSector ( t, h, s );
+                    if (( m_Dirty [h][t] & ( 1UL << ( sector - m_Track [h][t].Sector ))) == 0 ) continue;
+                    if ( pass == 0 ) {
+                        count++;
+                        continue;
+                    }
+                    write->Offset = ( index * m_FileSectors + s ) * DEFAULT_SECTOR_SIZE;
+                    write->Size   = DEFAULT_SECTOR_SIZE;
+                    write->Data   = new UCHAR [ DEFAULT_SECTOR_SIZE ];
+                    memcpy ( write->Data, sector->Data, DEFAULT_SECTOR_SIZE );
+                    write++;
+                }
+                if ( pass == 1 ) m_Dirty [h][t] = 0;
+            }
+        }
+
+        if ( pass == 1 ) GetWriter ()->Submit ( batch );
+    }
+
+    m_HasChanged = false;
+
+    return true;
+}
+
+// Without fullSave, changes that need a full save are left for SaveFile
+bool cDiskMedia::WriteBack ( bool fullSave )
+{
+    FUNCTION_ENTRY ( this, "cDiskMedia::WriteBack", true );
+
+    if (( m_HasChanged == false ) || ( m_FileName == NULL )) {
+        return true;
+    }
+
+    if ( CanWriteInPlace () == false ) {
+        return ( fullSave == true ) ? SaveFile () : false;
+    }
+
+    return WriteInPlace ();
+}
+
 void cDiskMedia::SetName ( const char *fileName )
 {
     FUNCTION_ENTRY ( this, "cDiskMedia::SetName", true );
@@ -923,7 +1234,9 @@ void cDiskMedia::SetName ( const char *fileName )
         strcpy ( m_FileName, fileName );
     }
 
-    m_HasChanged = true;
+    m_HasChanged  = true;
+    m_Rewrite     = true;
+    m_FileSectors = 0;
 }
 
 sTrack *cDiskMedia::GetTrack ( int tIndex, int hIndex )
@@ -933,6 +1246,8 @@ sTrack *cDiskMedia::GetTrack ( int tIndex, int hIndex )
     if (( tIndex < 0 ) || ( tIndex >= m_MaxTracks )) return NULL;
     if (( hIndex < 0 ) || ( hIndex >= m_MaxHeads )) return NULL;
 
+    DecodeTrack ( tIndex, hIndex );
+
     return &m_Track [hIndex][tIndex];
 }
 
@@ -943,6 +1258,8 @@ sSector *cDiskMedia::GetSector ( int tIndex, int hIndex, int sIndex, int track )
     if (( tIndex < 0 ) || ( tIndex >= m_MaxTracks )) return NULL;
     if (( hIndex < 0 ) || ( hIndex >= m_MaxHeads )) return NULL;
 
+    DecodeTrack ( tIndex, hIndex );
+
     sSector *sector = m_Track [hIndex][tIndex].Sector;
 
     if ( track == -1 ) track = tIndex;
@@ -954,3 +1271,346 @@ sSector *cDiskMedia::GetSector ( int tIndex, int hIndex, int sIndex, int track )
 
     return NULL;
 }
+
+void cDiskMedia::SetWriter ( cDiskWriter *writer )
+{
+    FUNCTION_ENTRY ( NULL, "cDiskMedia::SetWriter", true );
+
+    sm_Writer = writer;
+}
+
+cDiskWriter *cDiskMedia::GetWriter ()
+{
+    FUNCTION_ENTRY ( NULL, "cDiskMedia::GetWriter", false );
+
+    return ( sm_Writer != NULL ) ? sm_Writer : &DefaultWriter;
+}
+
+//----------------------------------------------------------------------------
+//
+// The journal is a sequence of records, each a 12 byte header (tag, offset
+// and size, little endian) followed by the data.  A commit record holding
+// the number of records and their checksum closes each batch.  Only the
+// batches that were committed are replayed.
+//
+//----------------------------------------------------------------------------
+
+static void PutLong ( UCHAR *ptr, ULONG value )
+{
+    ptr [0] = ( UCHAR ) ( value >>  0 );
+    ptr [1] = ( UCHAR ) ( value >>  8 );
+    ptr [2] = ( UCHAR ) ( value >> 16 );
+    ptr [3] = ( UCHAR ) ( value >> 24 );
+}
+
+static ULONG GetLong ( const UCHAR *ptr )
+{
+    return ( ULONG ) ptr [0] | (( ULONG ) ptr [1] << 8 ) | (( ULONG ) ptr [2] << 16 ) | (( ULONG ) ptr [3] << 24 );
+}
+
+// 32-bit FNV-1a
+static ULONG Checksum ( ULONG sum, const UCHAR *ptr, ULONG size )
+{
+    for ( ULONG i = 0; i < size; i++ ) {
+        sum = (( sum ^ ptr [i] ) * 16777619UL ) & 0xFFFFFFFFUL;
+    }
+
+    return sum;
+}
+
+#define CHECKSUM_START          2166136261UL
+
+cDiskWriter::cDiskWriter ()
+{
+    FUNCTION_ENTRY ( this, "cDiskWriter ctor", true );
+}
+
+cDiskWriter::~cDiskWriter ()
+{
+    FUNCTION_ENTRY ( this, "cDiskWriter dtor", true );
+}
+
+sDiskBatch *cDiskWriter::CreateBatch ( const char *fileName, int count )
+{
+    FUNCTION_ENTRY ( NULL, "cDiskWriter::CreateBatch", true );
+
+    sDiskBatch *batch = new sDiskBatch;
+    batch->FileName = new char [ strlen ( fileName ) + 1 ];
+    strcpy ( batch->FileName, fileName );
+    batch->Count = count;
+    batch->Write = new sDiskWrite [ ( count != 0 ) ? count : 1 ];
+    batch->Next  = NULL;
+
+    memset ( batch->Write, 0, sizeof ( sDiskWrite ) * (( count != 0 ) ? count : 1 ));
+
+    return batch;
+}
+
+// Frees the whole chain starting at batch
+void cDiskWriter::FreeBatch ( sDiskBatch *batch )
+{
+    FUNCTION_ENTRY ( NULL, "cDiskWriter::FreeBatch", true );
+
+    while ( batch != NULL ) {
+        sDiskBatch *next = batch->Next;
+        for ( int i = 0; i < batch->Count; i++ ) {
+            delete [] batch->Write [i].Data;
+        }
+        delete [] batch->Write;
+        delete [] batch->FileName;
+        delete batch;
+        batch = next;
+    }
+}
+
+char *cDiskWriter::JournalName ( const char *fileName )
+{
+    FUNCTION_ENTRY ( NULL, "cDiskWriter::JournalName", true );
+
+    char *name = new char [ strlen ( fileName ) + 5 ];
+    sprintf ( name, "%s.jnl", fileName );
+
+    return name;
+}
+
+// Appends the batches of the chain to the journal as one commit
+bool cDiskWriter::WriteJournal ( const char *name, const sDiskBatch *batch )
+{
+    FUNCTION_ENTRY ( NULL, "cDiskWriter::WriteJournal", true );
+
+    FILE *file = fopen ( name, "ab" );
+    if ( file == NULL ) return false;
+
+    bool  retVal = true;
+    ULONG sum    = CHECKSUM_START;
+    ULONG count  = 0;
+
+    for ( ; ( retVal == true ) && ( batch != NULL ); batch = batch->Next ) {
+        for ( int i = 0; i < batch->Count; i++ ) {
+            const sDiskWrite *write = &batch->Write [i];
+            UCHAR header [ JOURNAL_HEADER_SIZE ];
+            memcpy ( header, JOURNAL_RECORD, 4 );
+            PutLong ( header + 4, write->Offset );
+            PutLong ( header + 8, write->Size );
+            sum = Checksum ( sum, header, sizeof ( header ));
+            sum = Checksum ( sum, write->Data, write->Size );
+            if (( fwrite ( header, sizeof ( header ), 1, file ) != 1 ) ||
+                ( fwrite ( write->Data, write->Size, 1, file ) != 1 )) {
+                retVal = false;
+                break;
+            }
+            count++;
+        }
+    }
+
+    if ( retVal == true ) {
+        UCHAR commit [ JOURNAL_HEADER_SIZE ];
+        memcpy ( commit, JOURNAL_COMMIT, 4 );
+        PutLong ( commit + 4, count );
+        PutLong ( commit + 8, sum );
+        if ( fwrite ( commit, sizeof ( commit ), 1, file ) != 1 ) retVal = false;
+    }
+
+    if ( fflush ( file ) != 0 ) retVal = false;
+#if defined ( HAVE_FSYNC )
+    if (( retVal == true ) && ( fsync ( fileno ( file )) != 0 )) retVal = false;
+#endif
+
+    fclose ( file );
+
+    return retVal;
+}
+
+bool cDiskWriter::ApplyWrites ( const char *fileName, const sDiskBatch *batch )
+{
+    FUNCTION_ENTRY ( NULL, "cDiskWriter::ApplyWrites", true );
+
+    FILE *file = fopen ( fileName, "r+b" );
+    if ( file == NULL ) return false;
+
+    bool retVal = true;
+
+    for ( ; ( retVal == true ) && ( batch != NULL ); batch = batch->Next ) {
+        for ( int i = 0; i < batch->Count; i++ ) {
+            const sDiskWrite *write = &batch->Write [i];
+            if (( fseek ( file, write->Offset, SEEK_SET ) != 0 ) ||
+                ( fwrite ( write->Data, write->Size, 1, file ) != 1 )) {
+                retVal = false;
+                break;
+            }
+        }
+    }
+
+    if ( fflush ( file ) != 0 ) retVal = false;
+#if defined ( HAVE_FSYNC )
+    if (( retVal == true ) && ( fsync ( fileno ( file )) != 0 )) retVal = false;
+#endif
+
+    fclose ( file );
+
+    return retVal;
+}
+
+// Writes and frees the chain, batches for the same file share one commit
+bool cDiskWriter::WriteBatches ( sDiskBatch *list )
+{
+    FUNCTION_ENTRY ( NULL, "cDiskWriter::WriteBatches", true );
+
+    bool retVal = true;
+
+    while ( list != NULL ) {
+
+        // Pull every batch for the head's file out of the list, in order
+        sDiskBatch *group = list;
+        sDiskBatch *tail  = list;
+        list = list->Next;
+        tail->Next = NULL;
+
+        for ( sDiskBatch **prev = &list; *prev != NULL; ) {
+            sDiskBatch *batch = *prev;
+            if ( strcmp ( batch->FileName, group->FileName ) == 0 ) {
+                *prev       = batch->Next;
+                batch->Next = NULL;
+                tail->Next  = batch;
+                tail        = batch;
+            } else {
+                prev = &batch->Next;
+            }
+        }
+
+        char *name = JournalName ( group->FileName );
+
+        if ( WriteJournal ( name, group ) == false ) {
+            // Better an unprotected write than none at all
+            WARNING ( "Unable to write journal '" << name << '\'' );
+            remove ( name );
+            if ( ApplyWrites ( group->FileName, group ) == false ) {
+                ERROR ( "Error writing to disk file '" << group->FileName << '\'' );
+                retVal = false;
+            }
+        } else if ( ApplyWrites ( group->FileName, group ) == true ) {
+            remove ( name );
+        } else {
+            // The journal stays behind and is replayed by the next Recover
+            ERROR ( "Error writing to disk file '" << group->FileName << '\'' );
+            retVal = false;
+        }
+
+        delete [] name;
+
+        FreeBatch ( group );
+    }
+
+    return retVal;
+}
+
+// Replays the committed batches left in the journal of an image, an
+//   incomplete batch at the end was never applied and is dropped
+bool cDiskWriter::Recover ( const char *fileName )
+{
+    FUNCTION_ENTRY ( NULL, "cDiskWriter::Recover", true );
+
+    if ( fileName == NULL ) return true;
+
+    char *name = JournalName ( fileName );
+
+    FILE *file = fopen ( name, "rb" );
+    if ( file == NULL ) {
+        delete [] name;
+        return true;
+    }
+
+    fseek ( file, 0, SEEK_END );
+    ULONG size = ftell ( file );
+    fseek ( file, 0, SEEK_SET );
+
+    UCHAR *data = new UCHAR [ size + 1 ];
+    if (( size > 0 ) && ( fread ( data, size, 1, file ) != 1 )) size = 0;
+    fclose ( file );
+
+    bool  retVal = true;
+    ULONG pos    = 0;
+    int   count  = 0;
+
+    while (( retVal == true ) && ( pos + JOURNAL_HEADER_SIZE <= size )) {
+
+        // Look for the commit record that closes this batch
+        ULONG end     = pos;
+        ULONG sum     = CHECKSUM_START;
+        ULONG records = 0;
+        bool  valid   = false;
+
+        while ( end + JOURNAL_HEADER_SIZE <= size ) {
+            const UCHAR *header = data + end;
+            if ( memcmp ( header, JOURNAL_COMMIT, 4 ) == 0 ) {
+                valid = (( GetLong ( header + 4 ) == records ) && ( GetLong ( header + 8 ) == sum )) ? true : false;
+                break;
+            }
+            if ( memcmp ( header, JOURNAL_RECORD, 4 ) != 0 ) break;
+            ULONG length = GetLong ( header + 8 );
+            if ( length > size - end - JOURNAL_HEADER_SIZE ) break;
+            sum  = Checksum ( sum, header, JOURNAL_HEADER_SIZE + length );
+            end += JOURNAL_HEADER_SIZE + length;
+            records++;
+        }
+
+        if ( valid == false ) {
+            WARNING ( "Discarding incomplete journal entry for disk file '" << fileName << '\'' );
+            break;
+        }
+
+        sDiskBatch *batch = CreateBatch ( fileName, records );
+        for ( ULONG i = 0; i < records; i++ ) {
+            sDiskWrite *write = &batch->Write [i];
+            write->Offset = GetLong ( data + pos + 4 );
+            write->Size   = GetLong ( data + pos + 8 );
+            write->Data   = new UCHAR [ write->Size ];
+            memcpy ( write->Data, data + pos + JOURNAL_HEADER_SIZE, write->Size );
+            pos += JOURNAL_HEADER_SIZE + write->Size;
+        }
+
+        retVal = ApplyWrites ( fileName, batch );
+        FreeBatch ( batch );
+
+        pos = end + JOURNAL_HEADER_SIZE;
+        count++;
+    }
+
+    delete [] data;
+
+    if ( retVal == true ) {
+        if ( count > 0 ) WARNING ( "Recovered " << count << " interrupted write(s) to disk file '" << fileName << '\'' );
+        remove ( name );
+    } else {
+        ERROR ( "Unable to recover disk file '" << fileName << '\'' );
+    }
+
+    delete [] name;
+
+    return retVal;
+}
+
+// Drops the journal of an image that has just been rewritten in full, its
+//   writes are already in the new file and must not be replayed over it
+void cDiskWriter::Discard ( const char *fileName )
+{
+    FUNCTION_ENTRY ( NULL, "cDiskWriter::Discard", true );
+
+    if ( fileName == NULL ) return;
+
+    char *name = JournalName ( fileName );
+    remove ( name );
+    delete [] name;
+}
+
+void cDiskWriter::Submit ( sDiskBatch *batch )
+{
+    FUNCTION_ENTRY ( this, "cDiskWriter::Submit", true );
+
+    WriteBatches ( batch );
+}
+
+void cDiskWriter::Sync ()
+{
+    FUNCTION_ENTRY ( this, "cDiskWriter::Sync", true );
+}
@@ -0,0 +1,628 @@
+//----------------------------------------------------------------------------
+//
+// File:        disklib.cpp
+// Date:        19-Oct-2026
+//
+// Description: An index of the disk images found under a directory tree
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#if ! defined ( __WIN32__ ) && ! defined ( PSP )
+  #include <sys/mman.h>
+  #define HAVE_MMAP
+#endif
+#include "common.hpp"
+#include "logger.hpp"
+#include "support.hpp"
+#include "fs.hpp"
+#include "diskfs.hpp"
+#include "disklib.hpp"
+
+DBG_REGISTER ( __FILE__ );
+
+// Guards against directory loops through symbolic links
+#define MAX_DEPTH               16
+
+#define BYTE_ORDER_MARK         0x1234
+
+struct sPathList {
+    char         **Name;
+    int            Count;
+    int            Max;
+};
+
+static inline USHORT GetUSHORT ( const void *_ptr )
+{
+    const UCHAR *ptr = ( const UCHAR * ) _ptr;
+    return ( USHORT ) (( ptr [0] << 8 ) | ptr [1] );
+}
+
+static void AddPath ( sPathList *list, const char *name )
+{
+    FUNCTION_ENTRY ( NULL, "AddPath", true );
+
+    if ( list->Count == list->Max ) {
+        list->Max  = ( list->Max == 0 ) ? 256 : list->Max * 2;
+        list->Name = ( char ** ) realloc ( list->Name, list->Max * sizeof ( char * ));
+    }
+
+    list->Name [ list->Count++ ] = strdup ( name );
+}
+
+static void FreePaths ( sPathList *list )
+{
+    FUNCTION_ENTRY ( NULL, "FreePaths", true );
+
+    for ( int i = 0; i < list->Count; i++ ) {
+        free ( list->Name [i] );
+    }
+
+    free ( list->Name );
+}
+
+static int ComparePaths ( const void *ptr1, const void *ptr2 )
+{
+    return strcmp ( * ( const char ** ) ptr1, * ( const char ** ) ptr2 );
+}
+
+static bool IsDiskImage ( const char *name )
+{
+    FUNCTION_ENTRY ( NULL, "IsDiskImage", false );
+
+    const char *ext = strrchr ( name, '.' );
+    if ( ext == NULL ) return false;
+
+    return (( tolower ( ext [1] ) == 'd' ) && ( tolower ( ext [2] ) == 's' ) &&
+            ( tolower ( ext [3] ) == 'k' ) && ( ext [4] == '\0' )) ? true : false;
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   FindImages
+// Purpose:     Add the path (relative to root) of every disk image below the
+//              given directory to the list
+// Parameters:
+// Returns:
+// Notes:
+//------------------------------------------------------------------------------
+static void FindImages ( const char *root, const char *relative, int depth, sPathList *list )
+{
+    FUNCTION_ENTRY ( NULL, "FindImages", true );
+
+    char dirName [ MAXPATH ];
+    if ( *relative == '\0' ) {
+        strcpy ( dirName, root );
+    } else {
+        sprintf ( dirName, "%s%c%s", root, FILE_SEPERATOR, relative );
+    }
+
+    DIR *dir = opendir ( dirName );
+    if ( dir == NULL ) return;
+
+    struct dirent *entry;
+    while (( entry = readdir ( dir )) != NULL ) {
+
+        if ( entry->d_name [0] == '.' ) continue;
+
+        char name [ MAXPATH ];
+        if ( *relative == '\0' ) {
+            strcpy ( name, entry->d_name );
+        } else {
+            sprintf ( name, "%s%c%s", relative, FILE_SEPERATOR, entry->d_name );
+        }
+
+        char fullName [ MAXPATH ];
+        sprintf ( fullName, "%s%c%s", root, FILE_SEPERATOR, name );
+
+        struct stat info;
+        if ( stat ( fullName, &info ) != 0 ) continue;
+
+        if ( S_ISDIR ( info.st_mode )) {
+            if ( depth < MAX_DEPTH ) FindImages ( root, name, depth + 1, list );
+        } else if ( S_ISREG ( info.st_mode ) && IsDiskImage ( name )) {
+            AddPath ( list, name );
+        }
+    }
+
+    closedir ( dir );
+}
+
+cDiskScanner::cDiskScanner ()
+{
+    FUNCTION_ENTRY ( this, "cDiskScanner ctor", true );
+}
+
+cDiskScanner::~cDiskScanner ()
+{
+    FUNCTION_ENTRY ( this, "cDiskScanner dtor", true );
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDiskScanner::Scan
+// Purpose:     Scan the jobs on the calling thread
+// Parameters:
+// Returns:
+// Notes:
+//------------------------------------------------------------------------------
+void cDiskScanner::Scan ( sLibraryJob *job, int count )
+{
+    FUNCTION_ENTRY ( this, "cDiskScanner::Scan", true );
+
+    for ( int i = 0; i < count; i++ ) {
+        ScanDisk ( &job [i] );
+    }
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDiskScanner::ScanDisk
+// Purpose:     Read the VIB and the catalog of a disk image
+// Parameters:
+// Returns:
+// Notes:       Touches nothing but the job, so several can run at once
+//------------------------------------------------------------------------------
+void cDiskScanner::ScanDisk ( sLibraryJob *job )
+{
+    FUNCTION_ENTRY ( NULL, "cDiskScanner::ScanDisk", true );
+
+    sLibraryDisk *disk = &job->Disk;
+
+    disk->IsValid      = false;
+    disk->FileCount    = 0;
+    disk->TotalSectors = 0;
+    disk->FreeSectors  = 0;
+    memset ( disk->VolumeName, ' ', MAX_FILENAME );
+
+    cDiskFileSystem *image = cDiskFileSystem::Open ( job->PathName );
+    if ( image == NULL ) return;
+
+    // The catalog functions are only available through the base class
+    const cFileSystem *fs = image;
+
+    char name [ MAX_FILENAME + 1 ];
+    if ( image->GetName ( name, sizeof ( name )) == true ) {
+        memcpy ( disk->VolumeName, name, strlen ( name ));
+    }
+
+    disk->IsValid      = true;
+    disk->TotalSectors = ( USHORT ) fs->TotalSectors ();
+    disk->FreeSectors  = ( USHORT ) fs->FreeSectors ();
+
+    int count = fs->FileCount ();
+
+    for ( int i = 0; i < count; i++ ) {
+        const sFileDescriptorRecord *fdr = fs->GetFileDescriptor ( i );
+        if ( fdr == NULL ) continue;
+        sLibraryFile *file = &job->File [ disk->FileCount++ ];
+        memcpy ( file->FileName, fdr->FileName, MAX_FILENAME );
+        file->FileStatus   = fdr->FileStatus;
+        file->RecordLength = fdr->RecordLength;
+        file->TotalSectors = GetUSHORT ( &fdr->TotalSectors );
+        file->Disk         = 0;
+    }
+
+    image->Release ( NULL );
+}
+
+cDiskLibrary::cDiskLibrary ( const char *rootPath ) :
+    m_RootPath ( NULL ),
+    m_IndexName ( NULL ),
+    m_Data ( NULL ),
+    m_Size ( 0 ),
+    m_Mapped ( false ),
+    m_Header ( NULL ),
+    m_Disk ( NULL ),
+    m_File ( NULL ),
+    m_String ( NULL )
+{
+    FUNCTION_ENTRY ( this, "cDiskLibrary ctor", true );
+
+    m_RootPath = strdup ( rootPath );
+
+    // Leave the root as given, but without a trailing seperator
+    size_t length = strlen ( m_RootPath );
+    while (( length > 1 ) && ( m_RootPath [ length - 1 ] == FILE_SEPERATOR )) {
+        m_RootPath [ --length ] = '\0';
+    }
+
+    m_IndexName = ( char * ) malloc ( length + strlen ( LIBRARY_FILENAME ) + 2 );
+    sprintf ( m_IndexName, "%s%c%s", m_RootPath, FILE_SEPERATOR, LIBRARY_FILENAME );
+}
+
+cDiskLibrary::~cDiskLibrary ()
+{
+    FUNCTION_ENTRY ( this, "cDiskLibrary dtor", true );
+
+    ReleaseIndex ();
+
+    free ( m_IndexName );
+    free ( m_RootPath );
+}
+
+bool cDiskLibrary::MapIndex ( FILE *file )
+{
+    FUNCTION_ENTRY ( this, "cDiskLibrary::MapIndex", true );
+
+    fseek ( file, 0, SEEK_END );
+    ULONG size = ftell ( file );
+    fseek ( file, 0, SEEK_SET );
+
+    if ( size < sizeof ( sLibraryHeader )) return false;
+
+#if defined ( HAVE_MMAP )
+    void *ptr = mmap ( NULL, size, PROT_READ, MAP_PRIVATE, fileno ( file ), 0 );
+    if ( ptr != MAP_FAILED ) {
+        m_Data   = ( UCHAR * ) ptr;
+        m_Size   = size;
+        m_Mapped = true;
+        return true;
+    }
+#endif
+
+    m_Data = new UCHAR [ size ];
+    if ( fread ( m_Data, size, 1, file ) != 1 ) {
+        ERROR ( "Error reading from file" );
+        delete [] m_Data;
+        m_Data = NULL;
+        return false;
+    }
+
+    m_Size   = size;
+    m_Mapped = false;
+
+    return true;
+}
+
+void cDiskLibrary::ReleaseIndex ()
+{
+    FUNCTION_ENTRY ( this, "cDiskLibrary::ReleaseIndex", true );
+
+#if defined ( HAVE_MMAP )
+    if ( m_Mapped == true ) {
+        munmap ( m_Data, m_Size );
+    } else
+#endif
+    delete [] m_Data;
+
+    m_Data   = NULL;
+    m_Size   = 0;
+    m_Mapped = false;
+
+    m_Header = NULL;
+    m_Disk   = NULL;
+    m_File   = NULL;
+    m_String = NULL;
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDiskLibrary::Load
+// Purpose:     Map the index file, if there is one
+// Parameters:
+// Returns:     true if the index is present and usable
+// Notes:       Anything that doesn't look exactly right is ignored - Update
+//              will simply rebuild the index from scratch
+//------------------------------------------------------------------------------
+bool cDiskLibrary::Load ()
+{
+    FUNCTION_ENTRY ( this, "cDiskLibrary::Load", true );
+
+    ReleaseIndex ();
+
+    FILE *file = fopen ( m_IndexName, "rb" );
+    if ( file == NULL ) return false;
+
+    bool mapped = MapIndex ( file );
+
+    fclose ( file );
+
+    if ( mapped == false ) return false;
+
+    const sLibraryHeader *header = ( const sLibraryHeader * ) m_Data;
+
+    bool ok = (( memcmp ( header->Magic, LIBRARY_MAGIC, 4 ) == 0 ) &&
+               ( header->Version == LIBRARY_VERSION ) &&
+               ( header->ByteOrder == BYTE_ORDER_MARK ) &&
+               ( header->DiskSize == sizeof ( sLibraryDisk )) &&
+               ( header->FileSize == sizeof ( sLibraryFile ))) ? true : false;
+
+    ULONG size = sizeof ( sLibraryHeader );
+
+    if ( ok == true ) {
+        size += header->DiskCount * sizeof ( sLibraryDisk ) + header->FileCount * sizeof ( sLibraryFile ) + header->StringSize;
+        if (( size != m_Size ) || ( header->StringSize == 0 ) || ( m_Data [ size - 1 ] != '\0' )) ok = false;
+    }
+
+    if ( ok == true ) {
+        m_Header = header;
+        m_Disk   = ( const sLibraryDisk * ) ( header + 1 );
+        m_File   = ( const sLibraryFile * ) ( m_Disk + header->DiskCount );
+        m_String = ( const char * ) ( m_File + header->FileCount );
+        for ( ULONG i = 0; i < header->DiskCount; i++ ) {
+            const sLibraryDisk *disk = &m_Disk [i];
+            if (( disk->PathOffset >= header->StringSize ) || ( disk->FirstFile + disk->FileCount > header->FileCount )) {
+                ok = false;
+                break;
+            }
+        }
+    }
+
+    if ( ok == false ) {
+        WARNING ( "Ignoring invalid disk library index " << m_IndexName );
+        ReleaseIndex ();
+    }
+
+    return ok;
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDiskLibrary::WriteIndex
+// Purpose:     Replace the index file
+// Parameters:
+// Returns:
+// Notes:       The new index is written to a temporary file and renamed so a
+//              reader never sees a partial file
+//------------------------------------------------------------------------------
+bool cDiskLibrary::WriteIndex ( int diskCount, const sLibraryDisk *disk, int fileCount, const sLibraryFile *file, int stringSize, const char *string ) const
+{
+    FUNCTION_ENTRY ( this, "cDiskLibrary::WriteIndex", true );
+
+    sLibraryHeader header;
+    memset ( &header, 0, sizeof ( header ));
+    memcpy ( header.Magic, LIBRARY_MAGIC, 4 );
+    header.Version    = LIBRARY_VERSION;
+    header.ByteOrder  = BYTE_ORDER_MARK;
+    header.DiskSize   = sizeof ( sLibraryDisk );
+    header.FileSize   = sizeof ( sLibraryFile );
+    header.DiskCount  = diskCount;
+    header.FileCount  = fileCount;
+    header.StringSize = stringSize;
+
+    char tempName [ MAXPATH ];
+    sprintf ( tempName, "%s.tmp", m_IndexName );
+
+    FILE *out = fopen ( tempName, "wb" );
+    if ( out == NULL ) {
+        ERROR ( "Unable to create file " << tempName );
+        return false;
+    }
+
+    bool ok = ( fwrite ( &header, sizeof ( header ), 1, out ) == 1 ) ? true : false;
+    if (( ok == true ) && ( diskCount > 0 )) ok = ( fwrite ( disk, sizeof ( sLibraryDisk ), diskCount, out ) == ( size_t ) diskCount ) ? true : false;
+    if (( ok == true ) && ( fileCount > 0 )) ok = ( fwrite ( file, sizeof ( sLibraryFile ), fileCount, out ) == ( size_t ) fileCount ) ? true : false;
+    if ( ok == true ) ok = ( fwrite ( string, stringSize, 1, out ) == 1 ) ? true : false;
+
+    if ( fclose ( out ) != 0 ) ok = false;
+
+#if defined ( __WIN32__ )
+    if ( ok == true ) remove ( m_IndexName );
+#endif
+
+    if (( ok == false ) || ( rename ( tempName, m_IndexName ) != 0 )) {
+        ERROR ( "Unable to write file " << m_IndexName );
+        remove ( tempName );
+        return false;
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDiskLibrary::Update
+// Purpose:     Bring the index up to date with the images under the root
+// Parameters:  scanner - used to read the images that are new or changed
+// Returns:     The number of images that had to be read or -1 on error
+// Notes:       An image is only read again if its time stamp or size has
+//              changed, entries for images that are gone are dropped
+//------------------------------------------------------------------------------
+int cDiskLibrary::Update ( cDiskScanner *scanner )
+{
+    FUNCTION_ENTRY ( this, "cDiskLibrary::Update", true );
+
+    if ( m_Header == NULL ) Load ();
+
+    sPathList list = { NULL, 0, 0 };
+    FindImages ( m_RootPath, "", 0, &list );
+
+    // FindDisk relies on the disks being sorted by path
+    if ( list.Count > 0 ) {
+        qsort ( list.Name, list.Count, sizeof ( char * ), ComparePaths );
+    }
+
+    sLibraryDisk *disk = new sLibraryDisk [ list.Count + 1 ];
+    int *source = new int [ list.Count + 1 ];
+
+    int jobCount = 0;
+
+    for ( int i = 0; i < list.Count; i++ ) {
+        char fullName [ MAXPATH ];
+        sprintf ( fullName, "%s%c%s", m_RootPath, FILE_SEPERATOR, list.Name [i] );
+        struct stat info;
+        if ( stat ( fullName, &info ) != 0 ) memset ( &info, 0, sizeof ( info ));
+        int old = FindDisk ( list.Name [i] );
+        if (( old != -1 ) && ( m_Disk [old].ModTime == ( ULONG ) info.st_mtime ) && ( m_Disk [old].ImageSize == ( ULONG ) info.st_size )) {
+            disk [i] = m_Disk [old];
+            source [i] = old;
+        } else {
+            memset ( &disk [i], 0, sizeof ( sLibraryDisk ));
+            disk [i].ModTime   = ( ULONG ) info.st_mtime;
+            disk [i].ImageSize = ( ULONG ) info.st_size;
+            source [i] = -1 - jobCount++;
+        }
+    }
+
+    sLibraryJob *job = new sLibraryJob [ jobCount + 1 ];
+
+    for ( int i = 0; i < list.Count; i++ ) {
+        if ( source [i] >= 0 ) continue;
+        sLibraryJob *next = &job [ -1 - source [i]];
+        next->PathName = ( char * ) malloc ( strlen ( m_RootPath ) + strlen ( list.Name [i] ) + 2 );
+        sprintf ( next->PathName, "%s%c%s", m_RootPath, FILE_SEPERATOR, list.Name [i] );
+        next->Disk = disk [i];
+    }
+
+    if ( jobCount > 0 ) {
+        if ( scanner != NULL ) {
+            scanner->Scan ( job, jobCount );
+        } else {
+            cDiskScanner defaultScanner;
+            defaultScanner.Scan ( job, jobCount );
+        }
+    }
+
+    // Put the new index together
+    int fileCount  = 0;
+    int stringSize = 1;
+    for ( int i = 0; i < list.Count; i++ ) {
+        if ( source [i] < 0 ) disk [i] = job [ -1 - source [i]].Disk;
+        fileCount  += disk [i].FileCount;
+        stringSize += strlen ( list.Name [i] ) + 1;
+    }
+
+    sLibraryFile *file = new sLibraryFile [ fileCount + 1 ];
+    char *string = new char [ stringSize ];
+
+    int fileIndex   = 0;
+    int stringIndex = 0;
+
+    // Offset 0 is the empty string
+    string [ stringIndex++ ] = '\0';
+
+    for ( int i = 0; i < list.Count; i++ ) {
+        const sLibraryFile *first = ( source [i] >= 0 ) ? &m_File [ disk [i].FirstFile ] : job [ -1 - source [i]].File;
+        disk [i].PathOffset = stringIndex;
+        disk [i].FirstFile  = fileIndex;
+        for ( int j = 0; j < disk [i].FileCount; j++ ) {
+            file [ fileIndex ] = first [j];
+            file [ fileIndex++ ].Disk = i;
+        }
+        strcpy ( string + stringIndex, list.Name [i] );
+        stringIndex += strlen ( list.Name [i] ) + 1;
+    }
+
+    bool ok = WriteIndex ( list.Count, disk, fileCount, file, stringSize, string );
+
+    for ( int i = 0; i < jobCount; i++ ) {
+        free ( job [i].PathName );
+    }
+
+    delete [] string;
+    delete [] file;
+    delete [] job;
+    delete [] source;
+    delete [] disk;
+
+    FreePaths ( &list );
+
+    if ( ok == false ) return -1;
+
+    Load ();
+
+    return jobCount;
+}
+
+int cDiskLibrary::DiskCount () const
+{
+    FUNCTION_ENTRY ( this, "cDiskLibrary::DiskCount", false );
+
+    return ( m_Header != NULL ) ? m_Header->DiskCount : 0;
+}
+
+int cDiskLibrary::FileCount () const
+{
+    FUNCTION_ENTRY ( this, "cDiskLibrary::FileCount", false );
+
+    return ( m_Header != NULL ) ? m_Header->FileCount : 0;
+}
+
+const sLibraryDisk *cDiskLibrary::GetDisk ( int index ) const
+{
+    FUNCTION_ENTRY ( this, "cDiskLibrary::GetDisk", false );
+
+    return (( index >= 0 ) && ( index < DiskCount ())) ? &m_Disk [index] : NULL;
+}
+
+const sLibraryFile *cDiskLibrary::GetFile ( int index ) const
+{
+    FUNCTION_ENTRY ( this, "cDiskLibrary::GetFile", false );
+
+    return (( index >= 0 ) && ( index < FileCount ())) ? &m_File [index] : NULL;
+}
+
+const char *cDiskLibrary::GetPath ( const sLibraryDisk *disk ) const
+{
+    FUNCTION_ENTRY ( this, "cDiskLibrary::GetPath", false );
+
+    return m_String + disk->PathOffset;
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDiskLibrary::FindDisk
+// Purpose:     Look up an image by its path relative to the root
+// Parameters:
+// Returns:     The index of the disk or -1 if it isn't in the index
+// Notes:
+//------------------------------------------------------------------------------
+int cDiskLibrary::FindDisk ( const char *path ) const
+{
+    FUNCTION_ENTRY ( this, "cDiskLibrary::FindDisk", true );
+
+    int low  = 0;
+    int high = DiskCount () - 1;
+
+    while ( low <= high ) {
+        int mid = ( low + high ) / 2;
+        int cmp = strcmp ( path, GetPath ( &m_Disk [mid] ));
+        if ( cmp == 0 ) return mid;
+        if ( cmp < 0 ) high = mid - 1;
+        else low = mid + 1;
+    }
+
+    return -1;
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDiskLibrary::FindFile
+// Purpose:     Search the catalogs for a TI filename
+// Parameters:  name  - the text to look for, case is ignored
+//              start - the first file index to look at
+// Returns:     The index of the next file whose name contains the text or -1
+// Notes:
+//------------------------------------------------------------------------------
+int cDiskLibrary::FindFile ( const char *name, int start ) const
+{
+    FUNCTION_ENTRY ( this, "cDiskLibrary::FindFile", true );
+
+    int length = strlen ( name );
+    if (( length == 0 ) || ( length > MAX_FILENAME )) return -1;
+
+    for ( int i = ( start < 0 ) ? 0 : start; i < FileCount (); i++ ) {
+        const char *fileName = m_File [i].FileName;
+        for ( int j = 0; j <= MAX_FILENAME - length; j++ ) {
+            int k = 0;
+            while (( k < length ) && ( toupper ( fileName [ j + k ] ) == toupper ( name [k] ))) k++;
+            if ( k == length ) return i;
+        }
+    }
+
+    return -1;
+}
@@ -211,6 +211,7 @@ void cFileSystem::ShowDirectory ( bool verbose ) const
     for ( int i = 0; i < fileCount; i++ ) {
 
         const sFileDescriptorRecord *FDR = GetFileDescriptor ( i );
+        if ( FDR == NULL ) continue;
 
         printf ( "  %10.10s", FDR->FileName );
         int size = GetUSHORT ( &FDR->TotalSectors ) + 1;
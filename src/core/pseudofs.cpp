@@ -79,6 +79,54 @@ cPseudoFileSystem *cPseudoFileSystem::Open ( const char *filename )
     return disk;
 }
 
+//------------------------------------------------------------------------------
+// Procedure:   cPseudoFileSystem::Create
+// Purpose:     Create an empty TIFILES file and open it
+// Parameters:  filename - host file to create
+//              name - TI filename
+//              type - TI file status flags
+//              recordLength - logical record length (ignored for programs)
+// Returns:     The new filesystem or NULL if the file could not be created
+// Notes:
+//------------------------------------------------------------------------------
+cPseudoFileSystem *cPseudoFileSystem::Create ( const char *filename, const char *name, UCHAR type, int recordLength )
+{
+    FUNCTION_ENTRY ( NULL, "cPseudoFileSystem::Create", true );
+
+    UCHAR header [128];
+    memset ( header, 0, sizeof ( header ));
+
+    sTIFILES_Header *hdr = ( sTIFILES_Header * ) header;
+    hdr->length = 7;
+    memcpy ( hdr->Name, "TIFILES", 7 );
+    hdr->Status = type;
+    if (( type & PROGRAM_TYPE ) == 0 ) {
+        hdr->RecordsPerSector = ( type & VARIABLE_TYPE ) ? ( 255 / ( recordLength + 1 )) : 256 / recordLength;
+        hdr->RecordSize       = recordLength;
+    }
+
+    for ( int i = 0; i < MAX_FILENAME; i++ ) {
+        header [ 16 + i ] = ( *name != '\0' ) ? *name++ : ' ';
+    }
+
+    FILE *file = fopen ( filename, "wb" );
+    if ( file == NULL ) {
+        ERROR ( "Unable to create file " << filename );
+        return NULL;
+    }
+
+    bool isValid = ( fwrite ( header, sizeof ( header ), 1, file ) == 1 ) ? true : false;
+    if ( fclose ( file ) != 0 ) isValid = false;
+
+    if ( isValid == false ) {
+        ERROR ( "Error writing file " << filename );
+        remove ( filename );
+        return NULL;
+    }
+
+    return Open ( filename );
+}
+
 //------------------------------------------------------------------------------
 // Procedure:   cPseudoFileSystem::cPseudoFileSystem
 // Purpose:
@@ -91,7 +139,9 @@ cPseudoFileSystem::cPseudoFileSystem ( const char *filename ) :
     m_FileName ( NULL ),
     m_FileBuffer ( NULL ),
     m_File ( NULL ),
-    m_CurrentSector ( NULL )
+    m_CurrentSector ( NULL ),
+    m_IsFIAD ( false ),
+    m_Modified ( false )
 {    
     FUNCTION_ENTRY ( this, "cPseudoFileSystem ctor", true );
 
@@ -114,11 +164,13 @@ cPseudoFileSystem::cPseudoFileSystem ( const char *filename ) :
    
     m_File = fopen ( filename, "rb" );
 
-    if ( FindHeader () == false ) {
-        fclose ( m_File );
-        m_File = NULL;
-    } else {
-        LoadFileBuffer ();
+    if ( m_File != NULL ) {
+        if ( FindHeader () == false ) {
+            fclose ( m_File );
+            m_File = NULL;
+        } else {
+            LoadFileBuffer ();
+        }
     }
 }
 
@@ -133,6 +185,8 @@ cPseudoFileSystem::~cPseudoFileSystem ()
 {
     FUNCTION_ENTRY ( this, "cPseudoFileSystem dtor", true );
 
+    Flush ();
+
     if ( m_File != NULL ) {
 	fclose ( m_File );
 	m_File = NULL;
@@ -157,13 +211,15 @@ bool cPseudoFileSystem::FindHeader ()
 
     // See if there is either a TIFILES header or a file descriptor record (FIAD)
     char buffer [128];
+    memset ( buffer, 0, sizeof ( buffer ));
     fseek ( m_File, 0, SEEK_SET );
     fread ( buffer, 1, sizeof ( buffer ), m_File );
 
     // Look for TIFILES (and all it's variants)
     if ( ConstructFDR_TIFILES ( buffer ) == false ) {
         // See if we can detect the FIAD header
-        return ConstructFDR_FIAD ( buffer );
+        m_IsFIAD = ConstructFDR_FIAD ( buffer );
+        return m_IsFIAD;
     }
 
     return true;
@@ -198,6 +254,9 @@ bool cPseudoFileSystem::ConstructFDR_TIFILES ( char *buffer )
     int recCount = GetUSHORT_LE ( &m_FDR.NoFixedRecords );
     int rps = m_FDR.RecordsPerSector;
 
+    // Variable length files count sectors rather than records
+    if ( m_FDR.FileStatus & VARIABLE_TYPE ) rps = 1;
+
     // Make sure things match up - if not, swap bytes
     if (( recCount < ( totalSectors - 1 ) * rps ) || ( recCount > totalSectors * rps )) {
         swab (( char * ) &hdr->RecordCount, ( char * ) &m_FDR.NoFixedRecords, 2 );
@@ -283,6 +342,60 @@ void cPseudoFileSystem::LoadFileBuffer ()
     }
 }
 
+//------------------------------------------------------------------------------
+// Procedure:   cPseudoFileSystem::SaveFileBuffer
+// Purpose:     Rewrite the file with the current header and contents
+// Parameters:
+// Returns:     true if the file was written successfully
+// Notes:       TIFILES files get the short header with the TI filename at
+//              offset 16, FIAD files keep their FDR
+//------------------------------------------------------------------------------
+bool cPseudoFileSystem::SaveFileBuffer ()
+{
+    FUNCTION_ENTRY ( this, "cPseudoFileSystem::SaveFileBuffer", true );
+
+    UCHAR header [128];
+    memset ( header, 0, sizeof ( header ));
+
+    if ( m_IsFIAD == true ) {
+        memcpy ( header, &m_FDR, sizeof ( header ));
+    } else {
+        sTIFILES_Header *hdr = ( sTIFILES_Header * ) header;
+        hdr->length           = 7;
+        memcpy ( hdr->Name, "TIFILES", 7 );
+        hdr->SectorCount      = m_FDR.TotalSectors;
+        hdr->Status           = m_FDR.FileStatus;
+        hdr->RecordsPerSector = m_FDR.RecordsPerSector;
+        hdr->EOF_Offset       = m_FDR.EOF_Offset;
+        hdr->RecordSize       = m_FDR.RecordLength;
+        hdr->RecordCount      = m_FDR.NoFixedRecords;
+        memcpy ( header + 16, m_FDR.FileName, MAX_FILENAME );
+    }
+
+    FILE *file = fopen ( m_PathName, "wb" );
+    if ( file == NULL ) {
+        ERROR ( "Unable to write file " << m_PathName );
+        return false;
+    }
+
+    size_t size = GetUSHORT ( &m_FDR.TotalSectors ) * DEFAULT_SECTOR_SIZE;
+
+    bool retVal = true;
+
+    if ( fwrite ( header, sizeof ( header ), 1, file ) != 1 ) retVal = false;
+    if (( size > 0 ) && ( fwrite ( m_FileBuffer, size, 1, file ) != 1 )) retVal = false;
+    if ( fclose ( file ) != 0 ) retVal = false;
+
+    if ( retVal == false ) {
+        ERROR ( "Error writing file " << m_PathName );
+        return false;
+    }
+
+    m_Modified = false;
+
+    return true;
+}
+
 //------------------------------------------------------------------------------
 // Procedure:   cPseudoFileSystem::FileCount
 // Purpose:
@@ -366,15 +479,27 @@ sSector *cPseudoFileSystem::GetFileSector ( sFileDescriptorRecord *fdr, int inde
 // Returns:
 // Notes:
 //------------------------------------------------------------------------------
-int cPseudoFileSystem::ExtendFile ( sFileDescriptorRecord *fdr, int )
+int cPseudoFileSystem::ExtendFile ( sFileDescriptorRecord *fdr, int count )
 {
     FUNCTION_ENTRY ( this, "cPseudoFileSystem::ExtendFile", true );
 
     if ( fdr != &m_FDR ) return -1;
 
-    FATAL ( "Function not implemented" );
+    USHORT totalSectors = GetUSHORT ( &m_FDR.TotalSectors );
+
+    UCHAR *buffer = new UCHAR [ ( totalSectors + count ) * DEFAULT_SECTOR_SIZE ];
+    memcpy ( buffer, m_FileBuffer, totalSectors * DEFAULT_SECTOR_SIZE );
+    memset ( buffer + totalSectors * DEFAULT_SECTOR_SIZE, 0, count * DEFAULT_SECTOR_SIZE );
+
+    delete [] m_FileBuffer;
+    m_FileBuffer = buffer;
+
+    totalSectors      += count;
+    m_FDR.TotalSectors = GetUSHORT ( &totalSectors );
 
-    return -1;
+    m_Modified = true;
+
+    return count;
 }
 
 //------------------------------------------------------------------------------
@@ -384,13 +509,24 @@ int cPseudoFileSystem::ExtendFile ( sFileDescriptorRecord *fdr, int )
 // Returns:
 // Notes:
 //------------------------------------------------------------------------------
-void cPseudoFileSystem::TruncateFile ( sFileDescriptorRecord *fdr, int )
+void cPseudoFileSystem::TruncateFile ( sFileDescriptorRecord *fdr, int limit )
 {
     FUNCTION_ENTRY ( this, "cPseudoFileSystem::TruncateFile", true );
 
     if ( fdr != &m_FDR ) return;
 
-    FATAL ( "Function not implemented" );
+    USHORT totalSectors = GetUSHORT ( &m_FDR.TotalSectors );
+
+    if ( limit >= totalSectors ) {
+        WARNING ( "limit (" << limit << ") exceeds totalSectors (" << totalSectors << ")" );
+        return;
+    }
+
+    // The buffer keeps its size, only the part that gets written shrinks
+    totalSectors       = ( USHORT ) limit;
+    m_FDR.TotalSectors = GetUSHORT ( &totalSectors );
+
+    m_Modified = true;
 }
 
 //------------------------------------------------------------------------------
@@ -404,9 +540,23 @@ void cPseudoFileSystem::DiskModified ()
 {
     FUNCTION_ENTRY ( this, "cPseudoFileSystem::DiskModified", true );
 
-    // Write m_CurrentSector to the file
+    m_Modified = true;
+}
 
-    FATAL ( "Function not implemented" );
+//------------------------------------------------------------------------------
+// Procedure:   cPseudoFileSystem::Flush
+// Purpose:     Write any changes back to the file
+// Parameters:
+// Returns:
+// Notes:
+//------------------------------------------------------------------------------
+bool cPseudoFileSystem::Flush ()
+{
+    FUNCTION_ENTRY ( this, "cPseudoFileSystem::Flush", true );
+
+    if (( m_Modified == false ) || ( m_File == NULL )) return true;
+
+    return SaveFileBuffer ();
 }
 
 //------------------------------------------------------------------------------
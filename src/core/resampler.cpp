@@ -0,0 +1,163 @@
+//----------------------------------------------------------------------------
+//
+// File:        resampler.cpp
+// Date:        19-Oct-2026
+//
+// Description: Polyphase FIR sample rate converter
+//
+//   Converts by the rational ratio m_Up / m_Down : each output picks the
+//   row of a windowed sinc table that matches its fractional position
+//   between two inputs.  The table is computed once per converter, a few
+//   KB for the usual 8 KHz to 22050/44100/48000 Hz conversions.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include <math.h>
+#include <string.h>
+#include "common.hpp"
+#include "logger.hpp"
+#include "resampler.hpp"
+
+DBG_REGISTER ( __FILE__ );
+
+#define RESAMPLER_COEFF_BITS    15
+#define RESAMPLER_CUTOFF        0.90
+
+static int GCD ( int a, int b )
+{
+    while ( b != 0 ) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+cResampler::cResampler ( int inputRate, int outputRate ) :
+    m_InputRate ( inputRate ),
+    m_OutputRate ( outputRate ),
+    m_Up ( 1 ),
+    m_Down ( 1 ),
+    m_Phases ( 1 ),
+    m_Table ( NULL ),
+    m_Index ( 0 ),
+    m_Phase ( 0 )
+{
+    FUNCTION_ENTRY ( this, "cResampler ctor", true );
+
+    if (( inputRate > 0 ) && ( outputRate > 0 )) {
+        int gcd = GCD ( inputRate, outputRate );
+        m_Up    = outputRate / gcd;
+        m_Down  = inputRate / gcd;
+    }
+
+    m_Phases = ( m_Up < RESAMPLER_MAX_PHASES ) ? m_Up : RESAMPLER_MAX_PHASES;
+    m_Table  = new short [ m_Phases * RESAMPLER_TAPS ];
+
+    BuildTable ();
+    Reset ();
+}
+
+cResampler::~cResampler ()
+{
+    FUNCTION_ENTRY ( this, "cResampler dtor", true );
+
+    delete [] m_Table;
+}
+
+// Row p holds a Blackman windowed sinc centred p/m_Phases after tap
+//   RESAMPLER_TAPS/2-1, band limited to the lower of the two rates and
+//   normalized so that each row sums exactly to one
+void cResampler::BuildTable ()
+{
+    FUNCTION_ENTRY ( this, "cResampler::BuildTable", true );
+
+    double cutoff = RESAMPLER_CUTOFF;
+    if ( m_Up < m_Down ) cutoff *= ( double ) m_Up / m_Down;
+
+    for ( int p = 0; p < m_Phases; p++ ) {
+        short *row = m_Table + p * RESAMPLER_TAPS;
+        double kernel [ RESAMPLER_TAPS ];
+        double sum = 0.0;
+        for ( int k = 0; k < RESAMPLER_TAPS; k++ ) {
+            double x = ( RESAMPLER_TAPS / 2 - 1 - k ) + ( double ) p / m_Phases;
+            double s = ( x == 0.0 ) ? 1.0 : sin ( M_PI * cutoff * x ) / ( M_PI * cutoff * x );
+            double w = 0.42 + 0.5 * cos ( 2.0 * M_PI * x / RESAMPLER_TAPS ) + 0.08 * cos ( 4.0 * M_PI * x / RESAMPLER_TAPS );
+            kernel [k] = s * w;
+            sum += kernel [k];
+        }
+        int total = 0, peak = 0;
+        for ( int k = 0; k < RESAMPLER_TAPS; k++ ) {
+            row [k] = ( short ) floor ( kernel [k] / sum * ( 1 << RESAMPLER_COEFF_BITS ) + 0.5 );
+            total += row [k];
+            if ( row [k] > row [peak] ) peak = k;
+        }
+        row [peak] += ( 1 << RESAMPLER_COEFF_BITS ) - total;
+    }
+}
+
+// Largest number of samples Process can return for a given input count
+int cResampler::MaxOutput ( int count ) const
+{
+    FUNCTION_ENTRY ( this, "cResampler::MaxOutput", false );
+
+    return ( int ) ((( long long ) count * m_Up + m_Down - 1 ) / m_Down ) + 1;
+}
+
+void cResampler::Reset ()
+{
+    FUNCTION_ENTRY ( this, "cResampler::Reset", false );
+
+    memset ( m_History, 0, sizeof ( m_History ));
+
+    m_Index = 0;
+    m_Phase = 0;
+}
+
+// Consumes all the input and returns the number of samples written
+int cResampler::Process ( const int *input, int count, int *output )
+{
+    FUNCTION_ENTRY ( this, "cResampler::Process", false );
+
+    int written = 0;
+
+    for ( int i = 0; i < count; i++ ) {
+
+        m_History [ m_Index ] = m_History [ m_Index + RESAMPLER_TAPS ] = input [i];
+        m_Index = ( m_Index + 1 ) % RESAMPLER_TAPS;
+
+        const int *window = m_History + m_Index;
+
+        while ( m_Phase < m_Up ) {
+            int row = ( m_Phases == m_Up ) ? m_Phase : ( int ) (( long long ) m_Phase * m_Phases / m_Up );
+            const short *coeff = m_Table + row * RESAMPLER_TAPS;
+            long long acc = 0;
+            for ( int k = 0; k < RESAMPLER_TAPS; k++ ) {
+                acc += ( long long ) window [k] * coeff [k];
+            }
+            output [ written++ ] = ( int ) (( acc + ( 1 << ( RESAMPLER_COEFF_BITS - 1 ))) >> RESAMPLER_COEFF_BITS );
+            m_Phase += m_Down;
+        }
+
+        m_Phase -= m_Up;
+    }
+
+    return written;
+}
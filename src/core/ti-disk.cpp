@@ -40,6 +40,19 @@
 
 DBG_REGISTER ( __FILE__ );
 
+extern "C" UCHAR CpuMemory [ 0x10000 ];
+
+// General addressing modes of a TMS9900 operand
+#define MODE_REGISTER		0
+#define MODE_INDIRECT		1
+#define MODE_SYMBOLIC		2
+#define MODE_AUTOINC		3
+
+static inline USHORT GetWord ( ADDRESS address )
+{
+    return ( USHORT ) (( CpuMemory [ address ] << 8 ) | CpuMemory [ ( ADDRESS ) ( address + 1 ) ] );
+}
+
 cDiskDevice::cDiskDevice ( const char *filename ) :
     m_StepDirection ( 0 ),
     m_ClocksPerRev ( 600000 ),
@@ -60,7 +73,11 @@ cDiskDevice::cDiskDevice ( const char *filename ) :
     m_BytesLeft ( 0 ),
     m_DataPtr ( NULL ),
     m_CmdInProgress ( CMD_NONE ),
-    m_TrapIndex (( UCHAR ) -1 )
+    m_TrapIndex (( UCHAR ) -1 ),
+    m_StrictTiming ( false ),
+    m_LoopPC ( 0 ),
+    m_LoopClocks ( 0 ),
+    m_LoopBytes ( 0 )
 {
     FUNCTION_ENTRY ( this, "cDiskDevice::cDiskDevice", true );
 
@@ -275,10 +292,12 @@ void cDiskDevice::CompleteCommand ()
         case CMD_WRITE_TRACK :
             m_StatusRegister |= STATUS_LOST_DATA;
             m_CurDisk->WriteTrack ( m_TrackSelect, m_HeadSelect, m_BytesExpected - m_BytesLeft, m_DataBuffer );
+            m_CurDisk->WriteBack ( false );
             break;
         case CMD_WRITE_SECTOR :
             m_StatusRegister |= STATUS_LOST_DATA;
             m_CurDisk->WriteSector ( m_TrackSelect, m_HeadSelect, m_CurSector->LogicalSector, m_CurSector->LogicalCylinder, m_DataBuffer );
+            m_CurDisk->WriteBack ( false );
             break;
     }
 
@@ -338,12 +357,182 @@ void cDiskDevice::WriteByte ( UCHAR val )
             } else {
                 m_CurDisk->WriteSector ( m_TrackSelect, m_HeadSelect, m_CurSector->LogicalSector, m_CurSector->LogicalCylinder, m_DataBuffer );
             }
+            // Sector images get the change written back right away, others
+            //   are saved when the disk is released
+            m_CurDisk->WriteBack ( false );
         }
     } else {
         ; // Just ignore these
     }
 }
 
+//
+// Look for the MOVB/DEC/JNE loop that is accessing the data register right
+//   now.  For reads the MOVB has only fetched its source operand, for writes
+//   the whole instruction has been fetched.
+//
+bool cDiskDevice::FindTransferLoop ( bool read, sTransferLoop *loop ) const
+{
+    FUNCTION_ENTRY ( this, "cDiskDevice::FindTransferLoop", false );
+
+    ADDRESS pc   = m_pCPU->GetPC ();
+    ADDRESS port = ( ADDRESS ) ( read ? REG_RD_DATA : REG_WR_DATA );
+
+    for ( int words = 1; words <= 3; words++ ) {
+
+        ADDRESS start  = ( ADDRESS ) ( pc - 2 * words );
+        USHORT  opcode = GetWord ( start );
+        if (( opcode & 0xF000 ) != 0xD000 ) continue;
+
+        int src = opcode & 0x3F;
+        int dst = ( opcode >> 6 ) & 0x3F;
+
+        int portField = read ? src : dst;
+        int memField  = read ? dst : src;
+
+        // Symbolic operands are followed by their address, source first
+        ADDRESS next = ( ADDRESS ) ( start + 2 );
+        ADDRESS srcAddress = GetWord ( next );
+        if (( src >> 4 ) == MODE_SYMBOLIC ) next += 2;
+        ADDRESS dstAddress = GetWord ( next );
+        if (( dst >> 4 ) == MODE_SYMBOLIC ) next += 2;
+
+        ADDRESS fetched = read ? ( ADDRESS ) ( start + 2 + ((( src >> 4 ) == MODE_SYMBOLIC ) ? 2 : 0 )) : next;
+        if ( fetched != pc ) continue;
+
+        // The data register side: *Rn or @>5FFx
+        int portMode = portField >> 4;
+        int portReg  = portField & 0x0F;
+        if ( portMode == MODE_INDIRECT ) {
+            if ( m_pCPU->GetRegister ( portReg ) != port ) continue;
+        } else if (( portMode == MODE_SYMBOLIC ) && ( portReg == 0 )) {
+            if (( read ? srcAddress : dstAddress ) != port ) continue;
+        } else {
+            continue;
+        }
+
+        // The memory side: *Rn, *Rn+ or @addr
+        loop->PC       = start;
+        loop->Mode     = memField >> 4;
+        loop->Register = memField & 0x0F;
+        loop->Address  = read ? dstAddress : srcAddress;
+        if ( loop->Mode == MODE_REGISTER ) return false;
+        if (( loop->Mode == MODE_SYMBOLIC ) && ( loop->Register != 0 )) return false;
+
+        // DEC Rn followed by a JNE back to the MOVB
+        USHORT dec = GetWord ( next );
+        USHORT jne = GetWord (( ADDRESS ) ( next + 2 ));
+        if (( dec & 0xFFF0 ) != 0x0600 ) return false;
+        if (( jne & 0xFF00 ) != 0x1600 ) return false;
+        if (( ADDRESS ) ( next + 4 + 2 * ( signed char ) ( jne & 0xFF )) != start ) return false;
+
+        loop->Counter = dec & 0x0F;
+        if (( loop->Mode != MODE_SYMBOLIC ) && ( loop->Register == loop->Counter )) return false;
+        if (( portMode == MODE_INDIRECT ) && ( portReg == loop->Counter )) return false;
+
+        return true;
+    }
+
+    return false;
+}
+
+//
+// Returns the number of bytes beyond the current one that can be moved in
+//   one go.  The cost of one pass through the loop is measured between the
+//   first two accesses, so the loop has to run once before it is taken over.
+//
+int cDiskDevice::CountTransfer ( bool read, const sTransferLoop &loop, ULONG *clocks )
+{
+    FUNCTION_ENTRY ( this, "cDiskDevice::CountTransfer", false );
+
+    ULONG now = m_pCPU->GetClocks ();
+    bool repeat = (( loop.PC == m_LoopPC ) && ( m_BytesLeft == m_LoopBytes - 1 )) ? true : false;
+
+    *clocks = now - m_LoopClocks;
+
+    m_LoopPC     = loop.PC;
+    m_LoopClocks = now;
+    m_LoopBytes  = m_BytesLeft;
+
+    if ( repeat == false ) return 0;
+
+    // The counter hasn't been decremented for the current byte yet
+    int counter = m_pCPU->GetRegister ( loop.Counter );
+    if ( counter == 0 ) counter = 0x10000;
+
+    int count = read ? ((( counter < m_BytesLeft ) ? counter : m_BytesLeft ) - 1 ) :
+                        (( counter - 1 < m_BytesLeft ) ? counter - 1 : m_BytesLeft );
+
+    if ( count <= 0 ) return 0;
+
+    m_LoopPC = 0;
+
+    return count;
+}
+
+//
+// Read the data register.  Bytes for the passes of the loop that are skipped
+//   are stored before the current one, so the MOVB in progress writes the
+//   last byte to the right place.
+//
+UCHAR cDiskDevice::ReadBlock ()
+{
+    FUNCTION_ENTRY ( this, "cDiskDevice::ReadBlock", false );
+
+    sTransferLoop loop;
+    ULONG clocks;
+
+    if (( m_BytesLeft <= 1 ) || ( FindTransferLoop ( true, &loop ) == false )) return ReadByte ();
+
+    int count = CountTransfer ( true, loop, &clocks );
+    if ( count == 0 ) return ReadByte ();
+
+    ADDRESS address = ( loop.Mode == MODE_SYMBOLIC ) ? loop.Address : m_pCPU->GetRegister ( loop.Register );
+
+    for ( int i = 0; i < count; i++ ) {
+        m_pCPU->WriteMemory ( address, ( UCHAR ) ( ReadByte () ^ 0xFF ));
+        if ( loop.Mode == MODE_AUTOINC ) address++;
+    }
+
+    if ( loop.Mode == MODE_AUTOINC ) m_pCPU->SetRegister ( loop.Register, address );
+    m_pCPU->SetRegister ( loop.Counter, ( USHORT ) ( m_pCPU->GetRegister ( loop.Counter ) - count ));
+    m_pCPU->AddClocks ( count * clocks );
+
+    TRACE ( "PC: " << hex << loop.PC << " Read " << dec << count + 1 << " bytes in one pass" );
+
+    return ReadByte ();
+}
+
+//
+// Called after the byte being written has been handled - the rest of the
+//   bytes are fetched and written before the loop gets to its next pass
+//
+void cDiskDevice::WriteBlock ()
+{
+    FUNCTION_ENTRY ( this, "cDiskDevice::WriteBlock", false );
+
+    sTransferLoop loop;
+    ULONG clocks;
+
+    if (( m_BytesLeft <= 0 ) || ( FindTransferLoop ( false, &loop ) == false )) return;
+
+    int count = CountTransfer ( false, loop, &clocks );
+    if ( count == 0 ) return;
+
+    ADDRESS address = ( loop.Mode == MODE_SYMBOLIC ) ? loop.Address : m_pCPU->GetRegister ( loop.Register );
+
+    for ( int i = 0; i < count; i++ ) {
+        WriteByte (( UCHAR ) ( m_pCPU->ReadMemory ( address ) ^ 0xFF ));
+        if ( loop.Mode == MODE_AUTOINC ) address++;
+    }
+
+    if ( loop.Mode == MODE_AUTOINC ) m_pCPU->SetRegister ( loop.Register, address );
+    m_pCPU->SetRegister ( loop.Counter, ( USHORT ) ( m_pCPU->GetRegister ( loop.Counter ) - count ));
+    m_pCPU->AddClocks ( count * clocks );
+
+    TRACE ( "PC: " << hex << loop.PC << " Wrote " << dec << count + 1 << " bytes in one pass" );
+}
+
 void cDiskDevice::Restore ( UCHAR cmd )
 {
     FUNCTION_ENTRY ( this, "cDiskDevice::Restore", true );
@@ -602,6 +791,8 @@ void cDiskDevice::HandleCommand ( UCHAR cmd )
     // Make sure the previous command has completed
     CompleteCommand ();
 
+    m_LoopPC = 0;
+
     switch ( cmd & 0xF0 ) {
         case 0x00 :			// CMD_RESTORE
             EVENT ( "PC: " << hex << m_pCPU->GetPC () << " => " << "CMD_RESTORE" );
@@ -677,6 +868,7 @@ UCHAR cDiskDevice::WriteMemory ( const ADDRESS address, UCHAR val )
             break;
         case REG_WR_DATA :
             WriteByte ( val );
+            if ( m_StrictTiming == false ) WriteBlock ();
             break;
         default :
             ERROR ( "PC: " << hex << m_pCPU->GetPC () << " *** Unexpected MEM Wr: " << hex << address << " => " << val );
@@ -711,7 +903,7 @@ UCHAR cDiskDevice::ReadMemory ( const ADDRESS address, UCHAR )
             EVENT ( "PC: " << hex << m_pCPU->GetPC () << " Get Track = " << hex << ( UCHAR ) retVal );
             break;
         case REG_RD_DATA :
-            retVal = ReadByte ();
+            retVal = ( m_StrictTiming == false ) ? ReadBlock () : ReadByte ();
             break;
         default :
             ERROR ( "PC: " << hex << m_pCPU->GetPC () << " *** Unexpected MEM Rd: " << hex << address );
@@ -0,0 +1,973 @@
+//----------------------------------------------------------------------------
+//
+// File:        ti-dsr.cpp
+// Date:        19-Oct-2026
+//
+// Description: A disk controller that handles the file level (PAB) requests
+//              itself instead of emulating the FD1771
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+//
+// The DSR ROM is built here and contains nothing but a header and one entry
+// point per drive:
+//
+//	DSKn	MOV  @>4FF0+2n,R0	; trapped, the request is handled here
+//		JEQ  $+4		; not ours, let DSRLNK keep looking
+//		INCT R11
+//		B    *R11
+//
+// The PAB is found from the pointers DSRLNK leaves in the scratch pad and
+// the request is served from a cFileSystem, either a disk image or a host
+// directory of TIFILES/FIAD files.  Open files are read into memory and
+// written back when they are closed.
+//
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <memory.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.hpp"
+#include "logger.hpp"
+#include "cartridge.hpp"
+#include "tms9900.hpp"
+#include "tms9918a.hpp"
+#include "device.hpp"
+#include "diskio.hpp"
+#include "diskfs.hpp"
+#include "dirfs.hpp"
+#include "fileio.hpp"
+#include "ti-dsr.hpp"
+
+DBG_REGISTER ( __FILE__ );
+
+extern "C" UCHAR CpuMemory [ 0x10000 ];
+
+// Scratch pad locations set up by DSRLNK
+#define DSR_NAME_LENGTH		0x8354
+#define DSR_NAME_POINTER	0x8356
+
+#define DSR_LIST		0x4010
+#define DSR_CODE		0x4040
+
+#define CATALOG_RECORD_LENGTH	38
+#define DEFAULT_RECORD_LENGTH	80
+
+static inline USHORT GetUSHORT ( const void *_ptr )
+{
+    FUNCTION_ENTRY ( NULL, "GetUSHORT", true );
+
+    const UCHAR *ptr = ( const UCHAR * ) _ptr;
+    return ( USHORT ) (( ptr [0] << 8 ) | ptr [1] );
+}
+
+static inline USHORT GetUSHORT_LE ( const void *_ptr )
+{
+    FUNCTION_ENTRY ( NULL, "GetUSHORT_LE", true );
+
+    const UCHAR *ptr = ( const UCHAR * ) _ptr;
+    return ( USHORT ) (( ptr [1] << 8 ) | ptr [0] );
+}
+
+static inline void PutUSHORT ( void *_ptr, int value )
+{
+    FUNCTION_ENTRY ( NULL, "PutUSHORT", true );
+
+    UCHAR *ptr = ( UCHAR * ) _ptr;
+    ptr [0] = ( UCHAR ) ( value >> 8 );
+    ptr [1] = ( UCHAR ) value;
+}
+
+static inline void PutUSHORT_LE ( void *_ptr, int value )
+{
+    FUNCTION_ENTRY ( NULL, "PutUSHORT_LE", true );
+
+    UCHAR *ptr = ( UCHAR * ) _ptr;
+    ptr [0] = ( UCHAR ) value;
+    ptr [1] = ( UCHAR ) ( value >> 8 );
+}
+
+// Store an integer as an internal format (radix 100) floating point number
+static UCHAR *PutNumber ( UCHAR *ptr, int value )
+{
+    FUNCTION_ENTRY ( NULL, "PutNumber", true );
+
+    *ptr++ = 8;
+    memset ( ptr, 0, 8 );
+
+    if ( value != 0 ) {
+        int magnitude = ( value < 0 ) ? -value : value;
+        UCHAR digits [8];
+        int count = 0;
+        while ( magnitude > 0 ) {
+            digits [count++] = ( UCHAR ) ( magnitude % 100 );
+            magnitude /= 100;
+        }
+        ptr [0] = ( UCHAR ) ( 0x40 + count - 1 );
+        for ( int i = 0; i < count; i++ ) {
+            ptr [ 1 + i ] = digits [ count - 1 - i ];
+        }
+        // Negative numbers have their first word negated
+        if ( value < 0 ) PutUSHORT ( ptr, -GetUSHORT ( ptr ));
+    }
+
+    return ptr + 8;
+}
+
+cDsrDiskDevice::cDsrDiskDevice ( cTMS9918A *vdp ) :
+    m_pVDP ( vdp ),
+    m_TrapIndex (( UCHAR ) -1 )
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::cDsrDiskDevice", true );
+
+    memset ( m_Drive, 0, sizeof ( m_Drive ));
+    memset ( m_File, 0, sizeof ( m_File ));
+
+    m_CRU  = 0x1100;
+    m_pROM = new cCartridge ();
+
+    BuildROM ();
+}
+
+cDsrDiskDevice::~cDsrDiskDevice ()
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::~cDsrDiskDevice", true );
+
+    CloseAll ();
+
+    for ( unsigned i = 0; i < SIZE ( m_Drive ); i++ ) {
+        UnLoadDisk ( i );
+    }
+}
+
+void cDsrDiskDevice::BuildROM ()
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::BuildROM", true );
+
+    m_pROM->SetTitle ( "File level disk DSR" );
+    m_pROM->SetCRU ( m_CRU );
+
+    sMemoryRegion *region = &m_pROM->CpuMemory [4];
+
+    UCHAR *rom = new UCHAR [ ROM_BANK_SIZE ];
+    memset ( rom, 0, ROM_BANK_SIZE );
+
+    region->NumBanks     = 1;
+    region->Bank[0].Type = MEMORY_ROM;
+    region->Bank[0].Data = rom;
+
+    rom [0] = 0xAA;
+    rom [1] = 0x01;
+    PutUSHORT ( rom + 0x08, DSR_LIST );
+
+    for ( int i = 0; i < DSR_MAX_DRIVES; i++ ) {
+        UCHAR *entry = rom + ( DSR_LIST - 0x4000 ) + i * 10;
+        UCHAR *code  = rom + ( DSR_CODE - 0x4000 ) + i * 16;
+        PutUSHORT ( entry + 0, ( i < DSR_MAX_DRIVES - 1 ) ? DSR_LIST + ( i + 1 ) * 10 : 0 );
+        PutUSHORT ( entry + 2, DSR_CODE + i * 16 );
+        entry [4] = 4;
+        sprintf (( char * ) entry + 5, "DSK%d", i + 1 );
+        PutUSHORT ( code + 0, 0xC020 );                         // MOV  @trap,R0
+        PutUSHORT ( code + 2, DSR_TRAP_BASE + i * 2 );
+        PutUSHORT ( code + 4, 0x1301 );                         // JEQ  $+4
+        PutUSHORT ( code + 6, 0x05CB );                         // INCT R11
+        PutUSHORT ( code + 8, 0x045B );                         // B    *R11
+    }
+}
+
+void cDsrDiskDevice::SaveImage ( FILE *file )
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::SaveImage", true );
+
+    for ( unsigned i = 0; i < SIZE ( m_Drive ); i++ ) {
+        char name [ MAXPATH ];
+        if (( m_Drive [i] != NULL ) && ( m_Drive [i]->GetPath ( name, sizeof ( name )) == true )) {
+            fputc ( strlen ( name ), file );
+            fwrite ( name, strlen ( name ), 1, file );
+        } else {
+            fputc ( 0, file );
+        }
+    }
+}
+
+void cDsrDiskDevice::LoadImage ( FILE *file )
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::LoadImage", true );
+
+    // Files that were open when the image was saved can't be restored
+    CloseAll ();
+
+    for ( unsigned i = 0; i < SIZE ( m_Drive ); i++ ) {
+        int length = fgetc ( file );
+        if ( length != 0 ) {
+            char * name = ( char * ) malloc ( length + 1 );
+            fread ( name, length, 1, file );
+            name [length] = '\0';
+            LoadDisk ( i, name );
+            free ( name );
+        } else {
+            UnLoadDisk ( i );
+        }
+    }
+}
+
+bool cDsrDiskDevice::LoadDisk ( int index, const char *filename )
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::LoadDisk", true );
+
+    EVENT ( "Loading file: " << filename );
+
+    UnLoadDisk ( index );
+
+    struct stat info;
+    if (( stat ( filename, &info ) == 0 ) && S_ISDIR ( info.st_mode )) {
+        m_Drive [index] = cDirectoryFileSystem::Open ( filename );
+    } else {
+        m_Drive [index] = cDiskFileSystem::Open ( filename );
+    }
+
+    if ( m_Drive [index] == NULL ) {
+        WARNING ( "Error loading disk \"" << filename << "\"" );
+        return false;
+    }
+
+    return true;
+}
+
+void cDsrDiskDevice::UnLoadDisk ( int index )
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::UnLoadDisk", true );
+
+    if ( m_Drive [index] == NULL ) return;
+
+    for ( unsigned i = 0; i < SIZE ( m_File ); i++ ) {
+        if (( m_File [i].PAB != 0 ) && ( m_File [i].Drive == index )) {
+            SaveFile ( &m_File [i] );
+            CloseFile ( &m_File [i] );
+        }
+    }
+
+    m_Drive [index]->Flush ();
+    m_Drive [index]->Release ( NULL );
+    m_Drive [index] = NULL;
+}
+
+void cDsrDiskDevice::CloseAll ()
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::CloseAll", true );
+
+    for ( unsigned i = 0; i < SIZE ( m_File ); i++ ) {
+        if ( m_File [i].PAB != 0 ) {
+            SaveFile ( &m_File [i] );
+            CloseFile ( &m_File [i] );
+        }
+    }
+}
+
+USHORT cDsrDiskDevice::TrapFunction ( void *ptr, int, bool read, const ADDRESS address, USHORT value )
+{
+    FUNCTION_ENTRY ( ptr, "cDsrDiskDevice::Trap", false );
+
+    cDsrDiskDevice *pThis = ( cDsrDiskDevice * ) ptr;
+
+    if ( read == true ) {
+        int drive = ( address - DSR_TRAP_BASE ) / 2;
+        value = ( pThis->HandleRequest ( drive ) == true ) ? 0xFFFF : 0x0000;
+    }
+
+    return value;
+}
+
+void cDsrDiskDevice::Activate ()
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::Activate", true );
+
+    if ( m_TrapIndex != ( UCHAR ) -1 ) return;
+
+    m_TrapIndex = m_pCPU->RegisterBreakpoint ( TrapFunction, this, TRAP_DSR );
+
+    for ( int i = 0; i < DSR_MAX_DRIVES; i++ ) {
+        m_pCPU->SetBreakpoint (( ADDRESS ) ( DSR_TRAP_BASE + i * 2 ), ( UCHAR ) MEMFLG_READ, false, m_TrapIndex );
+    }
+}
+
+void cDsrDiskDevice::DeActivate ()
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::DeActivate", true );
+
+    if ( m_TrapIndex != ( UCHAR ) -1 ) {
+        m_pCPU->DeRegisterBreakpoint ( m_TrapIndex );
+        m_TrapIndex = ( UCHAR ) -1;
+    }
+}
+
+void cDsrDiskDevice::WriteCRU ( ADDRESS, int )
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::WriteCRU", true );
+}
+
+int cDsrDiskDevice::ReadCRU ( ADDRESS )
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::ReadCRU", true );
+
+    return 1;
+}
+
+UCHAR *cDsrDiskDevice::VdpPtr ( ADDRESS address ) const
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::VdpPtr", false );
+
+    return m_pVDP->GetMemory () + ( address & 0x3FFF );
+}
+
+void cDsrDiskDevice::ReadVDP ( ADDRESS address, void *buffer, int count ) const
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::ReadVDP", false );
+
+    UCHAR *ptr = ( UCHAR * ) buffer;
+    for ( int i = 0; i < count; i++ ) {
+        *ptr++ = *VdpPtr (( ADDRESS ) ( address + i ));
+    }
+}
+
+void cDsrDiskDevice::WriteVDP ( ADDRESS address, const void *buffer, int count ) const
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::WriteVDP", false );
+
+    const UCHAR *ptr = ( const UCHAR * ) buffer;
+    for ( int i = 0; i < count; i++ ) {
+        *VdpPtr (( ADDRESS ) ( address + i )) = *ptr++;
+    }
+}
+
+//
+// Called from the DSR entry point of drive 'drive' - returns false if the
+//   request isn't for us so DSRLNK can try the next device
+//
+bool cDsrDiskDevice::HandleRequest ( int drive )
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::HandleRequest", true );
+
+    if (( drive < 0 ) || ( drive >= DSR_MAX_DRIVES )) return false;
+
+    int     nameLength = GetUSHORT ( &CpuMemory [ DSR_NAME_LENGTH ] );
+    ADDRESS namePtr    = GetUSHORT ( &CpuMemory [ DSR_NAME_POINTER ] );
+    ADDRESS pabAddress = ( ADDRESS ) ( namePtr - nameLength - 10 );
+
+    UCHAR pab [10];
+    ReadVDP ( pabAddress, pab, sizeof ( pab ));
+
+    // Whatever follows "DSKn." is the filename, padded like an FDR
+    char fullName [256];
+    ReadVDP (( ADDRESS ) ( pabAddress + 10 ), fullName, pab [9] );
+    fullName [ pab [9]] = '\0';
+
+    const char *ptr = fullName + nameLength;
+    if ( *ptr == '.' ) ptr++;
+
+    char name [ MAX_FILENAME + 1 ];
+    memset ( name, ' ', MAX_FILENAME );
+    name [ MAX_FILENAME ] = '\0';
+
+    int error = ERR_NONE;
+
+    if (( strlen ( ptr ) > MAX_FILENAME ) || ( strchr ( ptr, '.' ) != NULL ) || ( strchr ( ptr, ' ' ) != NULL )) {
+        error = ERR_FILE_ERROR;
+    } else {
+        memcpy ( name, ptr, strlen ( ptr ));
+    }
+
+    TRACE ( "DSK" << drive + 1 << " opcode " << ( int ) pab [0] << " file '" << name << "'" );
+
+    if ( m_Drive [drive] == NULL ) {
+        error = ERR_DEVICE_ERROR;
+    } else if ( error == ERR_NONE ) {
+        switch ( pab [0] ) {
+            case PAB_OPEN :
+                error = Open ( pab, pabAddress, drive, name );
+                break;
+            case PAB_CLOSE :
+                error = Close ( pab, pabAddress );
+                break;
+            case PAB_READ :
+                error = Read ( pab, pabAddress );
+                break;
+            case PAB_WRITE :
+                error = Write ( pab, pabAddress );
+                break;
+            case PAB_RESTORE :
+                error = Restore ( pab, pabAddress );
+                break;
+            case PAB_LOAD :
+                error = Load ( pab, drive, name );
+                break;
+            case PAB_SAVE :
+                error = Save ( pab, drive, name );
+                break;
+            case PAB_DELETE :
+                error = Delete ( pab, drive, name );
+                break;
+            case PAB_STATUS :
+                error = Status ( pab, pabAddress, drive, name );
+                break;
+            default :
+                error = ERR_ILLEGAL_OPERATION;
+                break;
+        }
+    }
+
+    pab [1] = ( UCHAR ) (( pab [1] & ~PAB_ERROR_MASK ) | ( error << 5 ));
+
+    WriteVDP (( ADDRESS ) ( pabAddress + 1 ), pab + 1, sizeof ( pab ) - 1 );
+
+    return true;
+}
+
+sOpenFile *cDsrDiskDevice::FindFile ( ADDRESS pabAddress )
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::FindFile", true );
+
+    for ( unsigned i = 0; i < SIZE ( m_File ); i++ ) {
+        if ( m_File [i].PAB == pabAddress ) return &m_File [i];
+    }
+
+    return NULL;
+}
+
+// Make sure there is room for 'sectors' sectors in the file's buffer
+bool cDsrDiskDevice::Reserve ( sOpenFile *file, int sectors )
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::Reserve", true );
+
+    if ( sectors <= file->Allocated ) return true;
+
+    int allocated = ( file->Allocated < 4 ) ? 4 : file->Allocated;
+    while ( allocated < sectors ) allocated *= 2;
+
+    UCHAR *data = new UCHAR [ allocated * DEFAULT_SECTOR_SIZE ];
+    memset ( data, 0, allocated * DEFAULT_SECTOR_SIZE );
+    if ( file->Data != NULL ) {
+        memcpy ( data, file->Data, file->Allocated * DEFAULT_SECTOR_SIZE );
+        delete [] file->Data;
+    }
+
+    file->Data      = data;
+    file->Allocated = allocated;
+
+    return true;
+}
+
+bool cDsrDiskDevice::LoadFile ( sOpenFile *file )
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::LoadFile", true );
+
+    Reserve ( file, file->Sectors );
+
+    for ( int i = 0; i < file->Sectors; i++ ) {
+        if ( file->File->ReadSector ( i, file->Data + i * DEFAULT_SECTOR_SIZE ) != 0 ) return false;
+    }
+
+    return true;
+}
+
+// Write the buffer of a modified file back to its filesystem
+bool cDsrDiskDevice::SaveFile ( sOpenFile *file )
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::SaveFile", true );
+
+    if (( file->File == NULL ) || ( file->Modified == false )) return true;
+
+    cFileSystem *disk = m_Drive [ file->Drive ];
+    sFileDescriptorRecord *fdr = file->File->GetFDR ();
+
+    // Grow the file in one go so the allocator can find it a single run
+    int missing = file->Sectors - GetUSHORT ( &fdr->TotalSectors );
+    if (( missing > 0 ) && ( disk->ExtendFile ( fdr, missing ) != missing )) {
+        WARNING ( "Unable to extend file" );
+        return false;
+    }
+
+    for ( int i = 0; i < file->Sectors; i++ ) {
+        if ( file->File->WriteSector ( i, file->Data + i * DEFAULT_SECTOR_SIZE ) != 0 ) {
+            WARNING ( "Unable to extend file" );
+            return false;
+        }
+    }
+
+    if ( GetUSHORT ( &fdr->TotalSectors ) > file->Sectors ) {
+        disk->TruncateFile ( fdr, file->Sectors );
+    }
+
+    fdr->RecordsPerSector = ( UCHAR ) file->RecordsPerSector;
+    fdr->RecordLength     = ( UCHAR ) file->RecordLength;
+
+    if ( file->Status & VARIABLE_TYPE ) {
+        fdr->EOF_Offset = ( UCHAR ) file->EOF_Offset;
+        PutUSHORT_LE ( &fdr->NoFixedRecords, file->Sectors );
+    } else {
+        fdr->EOF_Offset = 0;
+        PutUSHORT_LE ( &fdr->NoFixedRecords, file->Records );
+    }
+
+    disk->DiskModified ();
+
+    file->Modified = false;
+
+    return disk->Flush ();
+}
+
+void cDsrDiskDevice::CloseFile ( sOpenFile *file )
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::CloseFile", true );
+
+    if ( file->File != NULL ) file->File->Release ( NULL );
+
+    delete [] file->Data;
+
+    memset ( file, 0, sizeof ( sOpenFile ));
+}
+
+//
+// The catalog is an INT/FIX 38 file: the volume record, one record per file
+//   and an empty record to mark the end
+//
+int cDsrDiskDevice::ReadCatalog ( int drive, int record, UCHAR *buffer )
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::ReadCatalog", true );
+
+    cFileSystem *disk = m_Drive [drive];
+
+    int fileCount = disk->FileCount ();
+    if ( record > fileCount + 1 ) return -1;
+
+    char name [ MAX_FILENAME + 1 ];
+    int  type   = 0;
+    int  size   = 0;
+    int  length = 0;
+
+    if ( record == 0 ) {
+        if ( disk->GetName ( name, sizeof ( name )) == false ) name [0] = '\0';
+        size   = disk->TotalSectors ();
+        length = disk->FreeSectors ();
+    } else if ( record <= fileCount ) {
+        const sFileDescriptorRecord *fdr = disk->GetFileDescriptor ( record - 1 );
+        memcpy ( name, fdr->FileName, MAX_FILENAME );
+        name [ MAX_FILENAME ] = '\0';
+        for ( int i = MAX_FILENAME - 1; ( i >= 0 ) && ( name [i] == ' ' ); i-- ) name [i] = '\0';
+        if ( fdr->FileStatus & PROGRAM_TYPE ) {
+            type = 5;
+        } else {
+            type = 1 + (( fdr->FileStatus & INTERNAL_TYPE ) ? 2 : 0 ) + (( fdr->FileStatus & VARIABLE_TYPE ) ? 1 : 0 );
+            length = fdr->RecordLength;
+        }
+        if ( fdr->FileStatus & WRITE_PROTECTED_TYPE ) type = -type;
+        size = GetUSHORT ( &fdr->TotalSectors ) + 1;
+    } else {
+        name [0] = '\0';
+    }
+
+    UCHAR *ptr = buffer;
+    *ptr++ = ( UCHAR ) strlen ( name );
+    memcpy ( ptr, name, strlen ( name ));
+    ptr += strlen ( name );
+    ptr = PutNumber ( ptr, type );
+    ptr = PutNumber ( ptr, size );
+    ptr = PutNumber ( ptr, length );
+
+    return ptr - buffer;
+}
+
+int cDsrDiskDevice::Open ( UCHAR *pab, ADDRESS pabAddress, int drive, const char *name )
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::Open", true );
+
+    // A PAB that is opened again without being closed first
+    sOpenFile *file = FindFile ( pabAddress );
+    if ( file != NULL ) {
+        SaveFile ( file );
+        CloseFile ( file );
+    }
+
+    file = FindFile ( 0 );
+    if ( file == NULL ) return ERR_NO_SPACE;
+
+    cFileSystem *disk = m_Drive [drive];
+
+    UCHAR flags  = pab [1];
+    UCHAR mode   = flags & PAB_MODE_MASK;
+    int   length = pab [4];
+    UCHAR status = ( UCHAR ) ((( flags & PAB_INTERNAL ) ? INTERNAL_TYPE : 0 ) | (( flags & PAB_VARIABLE ) ? VARIABLE_TYPE : 0 ));
+
+    if ( name [0] == ' ' ) {
+        if (( mode != PAB_MODE_INPUT ) || ( status != INTERNAL_TYPE )) return ERR_BAD_ATTRIBUTE;
+        if (( length != 0 ) && ( length != CATALOG_RECORD_LENGTH )) return ERR_BAD_ATTRIBUTE;
+        pab [4] = CATALOG_RECORD_LENGTH;
+        file->PAB          = pabAddress;
+        file->Drive        = drive;
+        file->Status       = status;
+        file->Mode         = mode;
+        file->RecordLength = CATALOG_RECORD_LENGTH;
+        return ERR_NONE;
+    }
+
+    if (( mode == PAB_MODE_APPEND ) && (( status & VARIABLE_TYPE ) == 0 )) return ERR_BAD_ATTRIBUTE;
+    if (( flags & PAB_RELATIVE ) && ( status & VARIABLE_TYPE )) return ERR_BAD_ATTRIBUTE;
+
+    cFile *tiFile = disk->OpenFile ( name );
+
+    if ( tiFile != NULL ) {
+        const sFileDescriptorRecord *fdr = tiFile->GetFDR ();
+        int error = ERR_NONE;
+        if ( fdr->FileStatus & PROGRAM_TYPE ) {
+            error = ERR_FILE_ERROR;
+        } else if (( fdr->FileStatus & ( INTERNAL_TYPE | VARIABLE_TYPE )) != status ) {
+            error = ERR_BAD_ATTRIBUTE;
+        } else if (( length != 0 ) && ( length != fdr->RecordLength )) {
+            error = ERR_BAD_ATTRIBUTE;
+        } else if (( mode != PAB_MODE_INPUT ) && ( fdr->FileStatus & WRITE_PROTECTED_TYPE )) {
+            error = ERR_WRITE_PROTECTED;
+        }
+        if (( error == ERR_NONE ) && ( mode == PAB_MODE_OUTPUT )) {
+            // Output always starts a new file
+            tiFile->Release ( NULL );
+            tiFile = NULL;
+        }
+        if ( error != ERR_NONE ) {
+            tiFile->Release ( NULL );
+            return error;
+        }
+    } else if ( mode == PAB_MODE_INPUT ) {
+        return ERR_FILE_ERROR;
+    }
+
+    bool created = false;
+
+    if ( tiFile == NULL ) {
+        if ( length == 0 ) length = DEFAULT_RECORD_LENGTH;
+        if (( status & VARIABLE_TYPE ) && ( length > 254 )) return ERR_BAD_ATTRIBUTE;
+        tiFile = disk->CreateFile ( name, status, length );
+        if ( tiFile == NULL ) return ERR_NO_SPACE;
+        created = true;
+    }
+
+    const sFileDescriptorRecord *fdr = tiFile->GetFDR ();
+
+    file->PAB              = pabAddress;
+    file->Drive            = drive;
+    file->File             = tiFile;
+    file->Status           = fdr->FileStatus;
+    file->Mode             = mode;
+    file->RecordLength     = fdr->RecordLength;
+    file->RecordsPerSector = fdr->RecordsPerSector;
+    file->Sectors          = GetUSHORT ( &fdr->TotalSectors );
+    file->Records          = ( status & VARIABLE_TYPE ) ? 0 : GetUSHORT_LE ( &fdr->NoFixedRecords );
+    file->EOF_Offset       = fdr->EOF_Offset;
+    file->Modified         = created;
+
+    if ( file->RecordsPerSector == 0 ) {
+        file->RecordsPerSector = ( status & VARIABLE_TYPE ) ? ( 255 / ( file->RecordLength + 1 )) : 256 / file->RecordLength;
+    }
+
+    if ( LoadFile ( file ) == false ) {
+        CloseFile ( file );
+        return ERR_DEVICE_ERROR;
+    }
+
+    if (( mode == PAB_MODE_APPEND ) && ( file->Sectors > 0 )) {
+        file->Position = ( file->Sectors - 1 ) * DEFAULT_SECTOR_SIZE + file->EOF_Offset;
+    }
+
+    pab [4] = ( UCHAR ) file->RecordLength;
+
+    return ERR_NONE;
+}
+
+int cDsrDiskDevice::Close ( UCHAR *, ADDRESS pabAddress )
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::Close", true );
+
+    sOpenFile *file = FindFile ( pabAddress );
+    if ( file == NULL ) return ERR_FILE_ERROR;
+
+    int error = ( SaveFile ( file ) == true ) ? ERR_NONE : ERR_NO_SPACE;
+
+    CloseFile ( file );
+
+    return error;
+}
+
+int cDsrDiskDevice::Read ( UCHAR *pab, ADDRESS pabAddress )
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::Read", true );
+
+    sOpenFile *file = FindFile ( pabAddress );
+    if ( file == NULL ) return ERR_FILE_ERROR;
+
+    if (( file->Mode == PAB_MODE_OUTPUT ) || ( file->Mode == PAB_MODE_APPEND )) return ERR_ILLEGAL_OPERATION;
+
+    ADDRESS buffer = GetUSHORT ( pab + 2 );
+    int     record = GetUSHORT ( pab + 6 );
+
+    if ( file->File == NULL ) {
+        UCHAR data [ CATALOG_RECORD_LENGTH ];
+        int count = ReadCatalog ( file->Drive, record, data );
+        if ( count < 0 ) return ERR_END_OF_FILE;
+        WriteVDP ( buffer, data, count );
+        pab [5] = ( UCHAR ) count;
+        PutUSHORT ( pab + 6, record + 1 );
+        return ERR_NONE;
+    }
+
+    if (( file->Status & VARIABLE_TYPE ) == 0 ) {
+        if ( record >= file->Records ) return ERR_END_OF_FILE;
+        int sector = record / file->RecordsPerSector;
+        int offset = ( record % file->RecordsPerSector ) * file->RecordLength;
+        WriteVDP ( buffer, file->Data + sector * DEFAULT_SECTOR_SIZE + offset, file->RecordLength );
+        pab [5] = ( UCHAR ) file->RecordLength;
+        PutUSHORT ( pab + 6, record + 1 );
+        return ERR_NONE;
+    }
+
+    for ( EVER ) {
+        int sector = file->Position / DEFAULT_SECTOR_SIZE;
+        int offset = file->Position % DEFAULT_SECTOR_SIZE;
+        if ( sector >= file->Sectors ) return ERR_END_OF_FILE;
+        if (( sector == file->Sectors - 1 ) && ( file->EOF_Offset != 0 ) && ( offset >= file->EOF_Offset )) return ERR_END_OF_FILE;
+        UCHAR *ptr = file->Data + file->Position;
+        if ( *ptr == 0xFF ) {
+            // End of the records in this sector
+            file->Position = ( sector + 1 ) * DEFAULT_SECTOR_SIZE;
+            continue;
+        }
+        int count = ( *ptr < file->RecordLength ) ? *ptr : file->RecordLength;
+        if ( offset + 1 + *ptr > DEFAULT_SECTOR_SIZE ) return ERR_DEVICE_ERROR;
+        WriteVDP ( buffer, ptr + 1, count );
+        pab [5] = ( UCHAR ) count;
+        file->Position += 1 + *ptr;
+        return ERR_NONE;
+    }
+}
+
+int cDsrDiskDevice::Write ( UCHAR *pab, ADDRESS pabAddress )
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::Write", true );
+
+    sOpenFile *file = FindFile ( pabAddress );
+    if ( file == NULL ) return ERR_FILE_ERROR;
+
+    if (( file->Mode == PAB_MODE_INPUT ) || ( file->File == NULL )) return ERR_ILLEGAL_OPERATION;
+
+    ADDRESS buffer = GetUSHORT ( pab + 2 );
+    int     record = GetUSHORT ( pab + 6 );
+
+    if (( file->Status & VARIABLE_TYPE ) == 0 ) {
+        int sector = record / file->RecordsPerSector;
+        int offset = ( record % file->RecordsPerSector ) * file->RecordLength;
+        Reserve ( file, sector + 1 );
+        ReadVDP ( buffer, file->Data + sector * DEFAULT_SECTOR_SIZE + offset, file->RecordLength );
+        if ( record >= file->Records ) {
+            file->Records = record + 1;
+            file->Sectors = ( file->Records + file->RecordsPerSector - 1 ) / file->RecordsPerSector;
+        }
+        PutUSHORT ( pab + 6, record + 1 );
+        file->Modified = true;
+        return ERR_NONE;
+    }
+
+    // Variable records are always written at the current position, anything
+    //   after it is dropped
+    int count  = ( pab [5] < file->RecordLength ) ? pab [5] : file->RecordLength;
+    int sector = file->Position / DEFAULT_SECTOR_SIZE;
+    int offset = file->Position % DEFAULT_SECTOR_SIZE;
+
+    // The record and the end of sector marker must fit in the sector
+    if ( offset + count + 2 > DEFAULT_SECTOR_SIZE ) {
+        Reserve ( file, sector + 1 );
+        file->Data [ file->Position ] = 0xFF;
+        sector++;
+        offset = 0;
+    }
+
+    Reserve ( file, sector + 1 );
+
+    UCHAR *ptr = file->Data + sector * DEFAULT_SECTOR_SIZE + offset;
+    *ptr = ( UCHAR ) count;
+    ReadVDP ( buffer, ptr + 1, count );
+    ptr [ count + 1 ] = 0xFF;
+
+    offset += count + 1;
+
+    file->Position   = sector * DEFAULT_SECTOR_SIZE + offset;
+    file->Sectors    = sector + 1;
+    file->EOF_Offset = offset;
+    file->Modified   = true;
+
+    return ERR_NONE;
+}
+
+int cDsrDiskDevice::Restore ( UCHAR *, ADDRESS pabAddress )
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::Restore", true );
+
+    sOpenFile *file = FindFile ( pabAddress );
+    if ( file == NULL ) return ERR_FILE_ERROR;
+
+    // Fixed records are located by the record number in the PAB
+    file->Position = 0;
+
+    return ERR_NONE;
+}
+
+int cDsrDiskDevice::Load ( UCHAR *pab, int drive, const char *name )
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::Load", true );
+
+    cFile *tiFile = m_Drive [drive]->OpenFile ( name );
+    if ( tiFile == NULL ) return ERR_FILE_ERROR;
+
+    int error = ERR_NONE;
+
+    ADDRESS buffer  = GetUSHORT ( pab + 2 );
+    int     maxSize = GetUSHORT ( pab + 6 );
+    int     size    = tiFile->FileSize ();
+
+    if (( tiFile->GetFDR ()->FileStatus & PROGRAM_TYPE ) == 0 ) {
+        error = ERR_FILE_ERROR;
+    } else if ( size > maxSize ) {
+        error = ERR_NO_SPACE;
+    } else {
+        UCHAR data [ DEFAULT_SECTOR_SIZE ];
+        for ( int i = 0; i * DEFAULT_SECTOR_SIZE < size; i++ ) {
+            int count = size - i * DEFAULT_SECTOR_SIZE;
+            if ( count > DEFAULT_SECTOR_SIZE ) count = DEFAULT_SECTOR_SIZE;
+            tiFile->ReadSector ( i, data );
+            WriteVDP (( ADDRESS ) ( buffer + i * DEFAULT_SECTOR_SIZE ), data, count );
+        }
+    }
+
+    tiFile->Release ( NULL );
+
+    return error;
+}
+
+int cDsrDiskDevice::Save ( UCHAR *pab, int drive, const char *name )
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::Save", true );
+
+    cFileSystem *disk = m_Drive [drive];
+
+    cFile *tiFile = disk->OpenFile ( name );
+    if ( tiFile != NULL ) {
+        bool isProtected = ( tiFile->GetFDR ()->FileStatus & WRITE_PROTECTED_TYPE ) ? true : false;
+        tiFile->Release ( NULL );
+        if ( isProtected == true ) return ERR_WRITE_PROTECTED;
+    }
+
+    tiFile = disk->CreateFile ( name, PROGRAM_TYPE, 0 );
+    if ( tiFile == NULL ) return ERR_NO_SPACE;
+
+    int error = ERR_NONE;
+
+    ADDRESS buffer = GetUSHORT ( pab + 2 );
+    int     size   = GetUSHORT ( pab + 6 );
+
+    UCHAR data [ DEFAULT_SECTOR_SIZE ];
+    for ( int i = 0; i * DEFAULT_SECTOR_SIZE < size; i++ ) {
+        int count = size - i * DEFAULT_SECTOR_SIZE;
+        if ( count > DEFAULT_SECTOR_SIZE ) count = DEFAULT_SECTOR_SIZE;
+        memset ( data, 0, sizeof ( data ));
+        ReadVDP (( ADDRESS ) ( buffer + i * DEFAULT_SECTOR_SIZE ), data, count );
+        if ( tiFile->WriteSector ( i, data ) != 0 ) {
+            error = ERR_NO_SPACE;
+            break;
+        }
+    }
+
+    tiFile->GetFDR ()->EOF_Offset = ( UCHAR ) ( size % DEFAULT_SECTOR_SIZE );
+
+    tiFile->Release ( NULL );
+
+    if ( error != ERR_NONE ) disk->DeleteFile ( name );
+
+    disk->DiskModified ();
+
+    if (( disk->Flush () == false ) && ( error == ERR_NONE )) error = ERR_DEVICE_ERROR;
+
+    return error;
+}
+
+int cDsrDiskDevice::Delete ( UCHAR *, int drive, const char *name )
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::Delete", true );
+
+    cFileSystem *disk = m_Drive [drive];
+
+    cFile *tiFile = disk->OpenFile ( name );
+    if ( tiFile == NULL ) return ERR_FILE_ERROR;
+
+    bool isProtected = ( tiFile->GetFDR ()->FileStatus & WRITE_PROTECTED_TYPE ) ? true : false;
+    tiFile->Release ( NULL );
+
+    if ( isProtected == true ) return ERR_WRITE_PROTECTED;
+
+    if ( disk->DeleteFile ( name ) == false ) return ERR_FILE_ERROR;
+
+    return ( disk->Flush () == true ) ? ERR_NONE : ERR_DEVICE_ERROR;
+}
+
+int cDsrDiskDevice::Status ( UCHAR *pab, ADDRESS pabAddress, int drive, const char *name )
+{
+    FUNCTION_ENTRY ( this, "cDsrDiskDevice::Status", true );
+
+    UCHAR result = 0;
+    UCHAR status = 0;
+
+    sOpenFile *file = FindFile ( pabAddress );
+
+    if ( file != NULL ) {
+        status = file->Status;
+        if ( file->File == NULL ) {
+            if ( GetUSHORT ( pab + 6 ) > m_Drive [drive]->FileCount ()) result |= STAT_END_OF_FILE;
+        } else if ( file->Status & VARIABLE_TYPE ) {
+            int end = ( file->Sectors > 0 ) ? ( file->Sectors - 1 ) * DEFAULT_SECTOR_SIZE + file->EOF_Offset : 0;
+            if ( file->Position >= end ) result |= STAT_END_OF_FILE;
+        } else {
+            if ( GetUSHORT ( pab + 6 ) >= file->Records ) result |= STAT_END_OF_FILE;
+        }
+    } else if ( name [0] != ' ' ) {
+        cFile *tiFile = m_Drive [drive]->OpenFile ( name );
+        if ( tiFile != NULL ) {
+            status = tiFile->GetFDR ()->FileStatus;
+            tiFile->Release ( NULL );
+        } else {
+            result |= STAT_NO_FILE;
+        }
+    }
+
+    if ( status & WRITE_PROTECTED_TYPE ) result |= STAT_PROTECTED;
+    if ( status & INTERNAL_TYPE )        result |= STAT_INTERNAL;
+    if ( status & PROGRAM_TYPE )         result |= STAT_PROGRAM;
+    if ( status & VARIABLE_TYPE )        result |= STAT_VARIABLE;
+
+    pab [8] = result;
+
+    return ERR_NONE;
+}
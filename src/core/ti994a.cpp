@@ -40,6 +40,7 @@
 #include "ti994a.hpp"
 #include "device.hpp"
 #include "tms9901.hpp"
+#include "vgm.hpp"
 
 DBG_REGISTER ( __FILE__ );
 
@@ -77,6 +78,7 @@ cTI994A::cTI994A ( cCartridge *_console, cTMS9918A *_vdp, cTMS9919 *_sound, cTMS
     m_SoundGenerator = ( _sound != NULL ) ? _sound : new cTMS9919;
 
     m_SpeechSynthesizer = _speech;
+    m_Recorder          = NULL;
     if ( m_SpeechSynthesizer != NULL ) {
         m_SpeechSynthesizer->SetComputer ( this );
     }
@@ -265,6 +267,10 @@ USHORT cTI994A::SoundBreakPoint ( const ADDRESS, USHORT data )
 {
     FUNCTION_ENTRY ( this, "cTI994A::SoundBreakPoint", false );
 
+    if ( m_Recorder != NULL ) {
+        m_Recorder->WritePSG ( m_CPU->GetClocks (), ( UCHAR ) data );
+    }
+
     m_SoundGenerator->WriteData (( UCHAR ) data );
 
     return data;
@@ -276,6 +282,10 @@ USHORT cTI994A::SpeechWriteBreakPoint ( const ADDRESS, USHORT data )
 
     if ( m_SpeechSynthesizer != NULL ) {
         m_SpeechSynthesizer->WriteData (( UCHAR ) data );
+        // Logged after a FIFO stall so the replay finds room for it
+        if ( m_Recorder != NULL ) {
+            m_Recorder->WriteSpeech ( m_CPU->GetClocks (), ( UCHAR ) data );
+        }
     }
 
     return data;
@@ -286,6 +296,10 @@ USHORT cTI994A::SpeechReadBreakPoint ( const ADDRESS, USHORT data )
     FUNCTION_ENTRY ( this, "cTI994A::SpeechReadBreakPoint", false );
 
     if ( m_SpeechSynthesizer != NULL ) {
+        // Only Read-Byte reads change the chip state
+        if (( m_Recorder != NULL ) && ( m_SpeechSynthesizer->IsReadingByte () == true )) {
+            m_Recorder->ReadSpeech ( m_CPU->GetClocks ());
+        }
         data = m_SpeechSynthesizer->ReadData (( UCHAR ) data );
     }
 
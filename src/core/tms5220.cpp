@@ -30,12 +30,12 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <setjmp.h>
 #include <string.h>
 #include "common.hpp"
 #include "logger.hpp"
 #include "support.hpp"
 #include "tms5220.hpp"
+#include "resampler.hpp"
 #include "tms9919.hpp"
 #include "tms9900.hpp"
 #include "ti994a.hpp"
@@ -56,56 +56,59 @@ const int COEFF_PITCH [0x40] = {
     91,  94,  98, 101, 105, 109, 114, 118, 122, 127, 132, 137, 142, 148, 153, 159
 };
 
-const double COEFF_K1 [0x20] = {
-  -0.97850, -0.97270, -0.97070, -0.96680, -0.96290, -0.95900, -0.95310, -0.94140,
-  -0.93360, -0.92580, -0.91600, -0.90620, -0.89650, -0.88280, -0.86910, -0.85350,
-  -0.80420, -0.74058, -0.66019, -0.56116, -0.44296, -0.30706, -0.15735, -0.00005,
-   0.15725,  0.30696,  0.44288,  0.56109,  0.66013,  0.74054,  0.80416,  0.85350
+// Reflection coefficients are stored in Q15
+#define Q15(x)      (( int ) (( x ) * 32768.0 + ((( x ) < 0 ) ? -0.5 : 0.5 )))
+
+const int COEFF_K1 [0x20] = {
+  Q15(-0.97850), Q15(-0.97270), Q15(-0.97070), Q15(-0.96680), Q15(-0.96290), Q15(-0.95900), Q15(-0.95310), Q15(-0.94140),
+  Q15(-0.93360), Q15(-0.92580), Q15(-0.91600), Q15(-0.90620), Q15(-0.89650), Q15(-0.88280), Q15(-0.86910), Q15(-0.85350),
+  Q15(-0.80420), Q15(-0.74058), Q15(-0.66019), Q15(-0.56116), Q15(-0.44296), Q15(-0.30706), Q15(-0.15735), Q15(-0.00005),
+  Q15( 0.15725), Q15( 0.30696), Q15( 0.44288), Q15( 0.56109), Q15( 0.66013), Q15( 0.74054), Q15( 0.80416), Q15( 0.85350)
 };
 
 
-const double COEFF_K2 [0x20] = {
-  -0.64000, -0.58999, -0.53500, -0.47507, -0.41039, -0.34129, -0.26830, -0.19209,
-  -0.11350, -0.03345,  0.04702,  0.12690,  0.20515,  0.28087,  0.35325,  0.42163,
-   0.48553,  0.54464,  0.59878,  0.64796,  0.69227,  0.73190,  0.76714,  0.79828,
-   0.82567,  0.84965,  0.87057,  0.88875,  0.90451,  0.91813,  0.92988,  0.98830
+const int COEFF_K2 [0x20] = {
+  Q15(-0.64000), Q15(-0.58999), Q15(-0.53500), Q15(-0.47507), Q15(-0.41039), Q15(-0.34129), Q15(-0.26830), Q15(-0.19209),
+  Q15(-0.11350), Q15(-0.03345), Q15( 0.04702), Q15( 0.12690), Q15( 0.20515), Q15( 0.28087), Q15( 0.35325), Q15( 0.42163),
+  Q15( 0.48553), Q15( 0.54464), Q15( 0.59878), Q15( 0.64796), Q15( 0.69227), Q15( 0.73190), Q15( 0.76714), Q15( 0.79828),
+  Q15( 0.82567), Q15( 0.84965), Q15( 0.87057), Q15( 0.88875), Q15( 0.90451), Q15( 0.91813), Q15( 0.92988), Q15( 0.98830)
 };
 
-const double COEFF_K3 [0x10] = {
-  -0.86000, -0.75467, -0.64933, -0.54400, -0.43867, -0.33333, -0.22800, -0.12267,
-  -0.01733,  0.08800,  0.19333,  0.29867,  0.40400,  0.50933,  0.61467,  0.72000
+const int COEFF_K3 [0x10] = {
+  Q15(-0.86000), Q15(-0.75467), Q15(-0.64933), Q15(-0.54400), Q15(-0.43867), Q15(-0.33333), Q15(-0.22800), Q15(-0.12267),
+  Q15(-0.01733), Q15( 0.08800), Q15( 0.19333), Q15( 0.29867), Q15( 0.40400), Q15( 0.50933), Q15( 0.61467), Q15( 0.72000)
 };
 
-const double COEFF_K4 [0x10] = {
-  -0.64000, -0.53145, -0.42289, -0.31434, -0.20579, -0.09723,  0.01132,  0.11987,
-   0.22843,  0.33698,  0.44553,  0.55409,  0.66264,  0.77119,  0.87975,  0.98830
+const int COEFF_K4 [0x10] = {
+  Q15(-0.64000), Q15(-0.53145), Q15(-0.42289), Q15(-0.31434), Q15(-0.20579), Q15(-0.09723), Q15( 0.01132), Q15( 0.11987),
+  Q15( 0.22843), Q15( 0.33698), Q15( 0.44553), Q15( 0.55409), Q15( 0.66264), Q15( 0.77119), Q15( 0.87975), Q15( 0.98830)
 };
 
-const double COEFF_K5 [0x10] = {
-  -0.64000, -0.54933, -0.45867, -0.36800, -0.27733, -0.18667, -0.09600, -0.00533,
-   0.08533,  0.17600,  0.26667,  0.35733,  0.44800,  0.53867,  0.62933,  0.72000
+const int COEFF_K5 [0x10] = {
+  Q15(-0.64000), Q15(-0.54933), Q15(-0.45867), Q15(-0.36800), Q15(-0.27733), Q15(-0.18667), Q15(-0.09600), Q15(-0.00533),
+  Q15( 0.08533), Q15( 0.17600), Q15( 0.26667), Q15( 0.35733), Q15( 0.44800), Q15( 0.53867), Q15( 0.62933), Q15( 0.72000)
 };
 
-const double COEFF_K6 [0x10] = {
-  -0.50000, -0.41333, -0.32667, -0.24000, -0.15333, -0.06667,  0.02000,  0.10667,
-   0.19333,  0.28000,  0.36667,  0.45333,  0.54000,  0.62667,  0.71333,  0.80000
+const int COEFF_K6 [0x10] = {
+  Q15(-0.50000), Q15(-0.41333), Q15(-0.32667), Q15(-0.24000), Q15(-0.15333), Q15(-0.06667), Q15( 0.02000), Q15( 0.10667),
+  Q15( 0.19333), Q15( 0.28000), Q15( 0.36667), Q15( 0.45333), Q15( 0.54000), Q15( 0.62667), Q15( 0.71333), Q15( 0.80000)
 };
 
-const double COEFF_K7 [0x10] = {
-  -0.60000, -0.50667, -0.41333, -0.32000, -0.22667, -0.13333, -0.04000,  0.05333,
-   0.14667,  0.24000,  0.33333,  0.42667,  0.52000,  0.61333,  0.70667,  0.80000
+const int COEFF_K7 [0x10] = {
+  Q15(-0.60000), Q15(-0.50667), Q15(-0.41333), Q15(-0.32000), Q15(-0.22667), Q15(-0.13333), Q15(-0.04000), Q15( 0.05333),
+  Q15( 0.14667), Q15( 0.24000), Q15( 0.33333), Q15( 0.42667), Q15( 0.52000), Q15( 0.61333), Q15( 0.70667), Q15( 0.80000)
 };
 
-const double COEFF_K8 [0x08] = {
-  -0.50000, -0.31429, -0.12857,  0.05714,  0.24286,  0.42857,  0.61429,  0.80000
+const int COEFF_K8 [0x08] = {
+  Q15(-0.50000), Q15(-0.31429), Q15(-0.12857), Q15( 0.05714), Q15( 0.24286), Q15( 0.42857), Q15( 0.61429), Q15( 0.80000)
 };
 
-const double COEFF_K9 [0x08] = {
-  -0.50000, -0.34286, -0.18571, -0.02857,  0.12857,  0.28571,  0.44286,  0.60000
+const int COEFF_K9 [0x08] = {
+  Q15(-0.50000), Q15(-0.34286), Q15(-0.18571), Q15(-0.02857), Q15( 0.12857), Q15( 0.28571), Q15( 0.44286), Q15( 0.60000)
 };
 
-const double COEFF_K10 [0x08] = {
-  -0.40000, -0.25714, -0.11429,  0.02857,  0.17143,  0.31429,  0.45714,  0.60000
+const int COEFF_K10 [0x08] = {
+  Q15(-0.40000), Q15(-0.25714), Q15(-0.11429), Q15( 0.02857), Q15( 0.17143), Q15( 0.31429), Q15( 0.45714), Q15( 0.60000)
 };
 
 #define CHIRP 2
@@ -152,6 +155,27 @@ static const char chirpTable [41] = {
 
 #endif
 
+// Integer square root, keeps the gain computation free of floating point
+static int ISqrt ( unsigned long long value )
+{
+    unsigned long long root = 0;
+    unsigned long long bit  = 1ULL << 62;
+
+    while ( bit > value ) bit >>= 2;
+
+    while ( bit != 0 ) {
+        if ( value >= root + bit ) {
+            value -= root + bit;
+            root   = ( root >> 1 ) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return ( int ) root;
+}
+
 cTMS5220::cTMS5220 ( cTMS9919 *pSound ) :
     m_SpeechRom ( NULL ),
     m_LoadPointer ( 0 ),
@@ -164,20 +188,38 @@ cTMS5220::cTMS5220 ( cTMS9919 *pSound ) :
     m_BitsLeft ( 0 ),
     m_ReadByte ( false ),
     m_SpeakExternal ( false ),
+    m_ReadUnderrun ( false ),
+    m_Stopping ( false ),
     m_BufferEmpty ( true ),
     m_TalkStatus ( false ),
     m_Data ( 0x00 ),
     m_Command ( 0x00 ),
+    m_FrameHead ( 0 ),
+    m_FrameTail ( 0 ),
+    m_DecodeAhead ( 0 ),
     m_InterpolationStage ( 0 ),
     m_Computer ( NULL ),
     m_SoundChip ( pSound ),
     m_PitchIndex ( 0 ),
-    m_NonVoicedLevel ( 0.0 ),
+    m_NonVoicedLevel ( 0 ),
+    m_NoiseSeed ( 1 ),
     m_PlaybackFrequency ( -1 ),
     m_PlaybackInterval ( 0 ),
     m_PlaybackBuffer ( NULL ),
-    m_PlaybackSamplesLeft ( 0 ),
-    m_PlaybackDataPtr ( NULL )
+    m_Resampler ( NULL ),
+    m_Ring ( NULL ),
+    m_RingSize ( 0 ),
+    m_RingHead ( 0 ),
+    m_RingTail ( 0 ),
+    m_PhraseCount ( 0 ),
+    m_CacheBytes ( 0 ),
+    m_PlayPhrase ( NULL ),
+    m_PlayOffset ( 0 ),
+    m_PlayFrames ( 0 ),
+    m_RecordKey ( -1 ),
+    m_Record ( NULL ),
+    m_RecordLength ( 0 ),
+    m_RecordSize ( 0 )
 {
     FUNCTION_ENTRY ( this, "cTMS5220 ctor", true );
 
@@ -205,6 +247,7 @@ cTMS5220::cTMS5220 ( cTMS9919 *pSound ) :
     }
 
     memset ( m_FIFO, 0, sizeof ( m_FIFO ));
+    memset ( m_Phrases, 0, sizeof ( m_Phrases ));
 
     memset ( &m_StartParams, 0, sizeof ( m_StartParams ));
     memset ( &m_TargetParams, 0, sizeof ( m_TargetParams ));
@@ -214,8 +257,19 @@ cTMS5220::cTMS5220 ( cTMS9919 *pSound ) :
 
     if ( m_SoundChip != NULL ) {
         m_PlaybackFrequency = m_SoundChip->SetSpeechSynthesizer ( this );
-        m_PlaybackInterval  = ( int ) ( m_PlaybackFrequency * 0.003125 );
-        m_PlaybackBuffer    = new double [ m_PlaybackInterval ];
+        if ( m_PlaybackFrequency <= 0 ) {
+            // No audio device - run without audio callbacks
+            m_PlaybackFrequency = -1;
+        } else {
+            m_Resampler        = new cResampler ( SAMPLE_RATE, m_PlaybackFrequency );
+            m_PlaybackInterval = m_Resampler->MaxOutput ( INTERPOLATION_INTERVAL );
+            m_PlaybackBuffer   = new int [ m_PlaybackInterval ];
+
+            // Room for the frames decoded ahead plus one being played
+            m_RingSize = 1;
+            while ( m_RingSize <= ( SPEECH_FRAME_LEAD + 1 ) * 8 * m_PlaybackInterval ) m_RingSize <<= 1;
+            m_Ring = new int [ m_RingSize ];
+        }
     }
 
     // Calculate the RMS level to use for non-voiced sounds
@@ -223,7 +277,7 @@ cTMS5220::cTMS5220 ( cTMS9919 *pSound ) :
     for ( unsigned  i = 0; i < SIZE ( chirpTable ); i++ ) {
         sum += ( double ) chirpTable [i] * ( double ) chirpTable [i];
     }
-    m_NonVoicedLevel = sqrt ( sum / SIZE ( chirpTable ));
+    m_NonVoicedLevel = ( int ) ( sqrt ( sum / SIZE ( chirpTable )) * ( 1 << SAMPLE_BITS ));
 
     Reset ();
 }
@@ -239,6 +293,20 @@ cTMS5220::~cTMS5220 ()
     delete [] m_PlaybackBuffer;
     m_PlaybackBuffer = NULL;
 
+    delete [] m_Ring;
+    m_Ring = NULL;
+
+    for ( int i = 0; i < m_PhraseCount; i++ ) {
+        delete [] m_Phrases [i].Samples;
+    }
+    m_PhraseCount = 0;
+
+    delete [] m_Record;
+    m_Record = NULL;
+
+    delete m_Resampler;
+    m_Resampler = NULL;
+
     delete [] m_SpeechRom;
     m_SpeechRom = NULL;
 }
@@ -308,8 +376,6 @@ void cTMS5220::RestoreReadState ( const sReadState &state )
     }
 }
 
-static jmp_buf jump_buffer;
-
 UCHAR cTMS5220::ReadBits ( int count )
 {
     FUNCTION_ENTRY ( this, "cTMS5220::ReadBits", true );
@@ -350,25 +416,16 @@ UCHAR cTMS5220::ReadBitsFIFO ( int count )
 
     TRACE ( "Reading " << count << "/" << m_BitsLeft << " bits" );
 
-    // Last chance for the CPU thread...
-    for ( int retry = 0; ( m_BitsLeft < count ) && ( retry < 10 ); retry++ ) {
-        TRACE ( "waiting for bits..." );
-        if ( m_Computer != NULL ) {
-            m_Computer->WakeCPU ( 1 );
-        }
-    }
-
-    // TBD - Acquire MUTEX
+    // NOTE: Frames are decoded on the CPU thread, there is no point in
+    //   waiting for it to write more data here - ReadFrame backs out
 
     UCHAR data = 0;
 
     if ( m_BitsLeft < count ) {
 
-        ERROR ( "Not enough bits (" << m_BitsLeft << ") left in the FIFO - " << count << " needed" );
-
-        // TBD - Release MUTEX
+        TRACE ( "Not enough bits (" << m_BitsLeft << ") left in the FIFO - " << count << " needed" );
 
-        longjmp ( jump_buffer, -1 );
+        m_ReadUnderrun = true;
 
     } else {
 
@@ -395,8 +452,6 @@ UCHAR cTMS5220::ReadBitsFIFO ( int count )
         }
     }
 
-    // TBD - Release MUTEX
-
     return data;
 }
 
@@ -404,7 +459,6 @@ void cTMS5220::StoreDataFIFO ( UCHAR data )
 {
     FUNCTION_ENTRY ( this, "cTMS5220::StoreDataFIFO", true );
 
-    // TBD - Acquire MUTEX
     m_FIFO [ m_PutIndex ] = data;
 
 //data = (( data >> 1 ) & 0x55 ) | (( data << 1 ) & 0xAA );
@@ -416,15 +470,18 @@ void cTMS5220::StoreDataFIFO ( UCHAR data )
 
     int nextIndex = ( m_PutIndex + 1 ) % FIFO_BYTES;
 
-    if (( m_PlaybackFrequency != -1 ) && ( nextIndex == m_GetIndex )) {
+    if (( m_PlaybackFrequency > 0 ) && ( nextIndex == m_GetIndex )) {
         TRACE ( "FIFO full - stalling CPU... (" << m_PutIndex << "/" << m_GetIndex << ")" );
-        while ( nextIndex == m_GetIndex ) {
+        // Stall the CPU (3 cycles/us) until the chip reads its next frame and
+        //   let the sound chip play that time, which takes the frame
+        for ( int retry = 0; ( nextIndex == m_GetIndex ) && ( retry < SPEECH_FRAME_QUEUE ); retry++ ) {
+            if (( m_TalkStatus == false ) || ( m_Stopping == true )) break;
+            int wait = m_DecodeAhead - SPEECH_FRAME_LEAD * m_PlaybackFrequency;
+            if ( wait < 0 ) wait = 0;
             if ( m_Computer != NULL ) {
-                // TBD - calculate a good approximation for the # of CPU cycles to stall
-                m_Computer->Sleep ( 100, 1 );
+                m_Computer->Sleep (( int ) (( long long ) wait * TMS5220_FRAME_PERIOD * 3 / m_PlaybackFrequency ) + TMS5220_SAMPLE_PERIOD * 3, 0 );
             }
-            // Check TalkStatus in case we stalled
-            if ( m_TalkStatus == false ) break;
+            m_SoundChip->Flush ();
         }
         TRACE ( "CPU stall complete... (" << m_PutIndex << "/" << m_GetIndex << ")" );
     }
@@ -437,8 +494,6 @@ void cTMS5220::StoreDataFIFO ( UCHAR data )
 
     m_BufferEmpty = false;
 
-    // TBD - Release MUTEX
-
     // If we aren't getting audio callbacks, try to empty the buffer
     if (( m_PlaybackFrequency == -1 ) && ( m_TalkStatus == true )) {
         sSpeechParams temp;
@@ -446,53 +501,37 @@ void cTMS5220::StoreDataFIFO ( UCHAR data )
     }
 }
 
-void deemp ( double *x, int count )
+// De-emphasis filter coefficients in Q16
+#define DEEMP_B1    131059      // 1.9998
+#define DEEMP_A1    163840      // 2.5
+#define DEEMP_A2    137134      // 2.0925
+#define DEEMP_A3     38339      // 0.585
+
+void cTMS5220::Deemphasize ( int *x, int count )
 {
-    static double dei [4] = { 0, 0, 0, 0 };
-    static double deo [4] = { 0, 0, 0, 0 };
+    FUNCTION_ENTRY ( this, "cTMS5220::Deemphasize", false );
+
+    int *dei = m_DeempInput;
+    int *deo = m_DeempOutput;
 
     for ( int i = 0; i < count; i++ ) {
-	dei [0] = x [i];
-	x [i] = dei [0] - dei [1] * 1.9998f + dei [2] + deo [1] * 2.5f - deo [2] * 2.0925f + deo [3] * .585f;
-	dei [2] = dei [1];
-	dei [1] = dei [0];
-	deo [3] = deo [2];
-	deo [2] = deo [1];
-	deo [1] = x [i];
-x[i] *= 0.5;
+        dei [0] = x [i];
+        long long acc = (( long long ) dei [0] << 16 ) - ( long long ) dei [1] * DEEMP_B1 + (( long long ) dei [2] << 16 ) +
+                        ( long long ) deo [1] * DEEMP_A1 - ( long long ) deo [2] * DEEMP_A2 + ( long long ) deo [3] * DEEMP_A3;
+        x [i] = ( int ) ( acc >> 16 );
+        dei [2] = dei [1];
+        dei [1] = dei [0];
+        deo [3] = deo [2];
+        deo [2] = deo [1];
+        deo [1] = x [i];
+        x [i] >>= 1;
     }
 }
 
-bool cTMS5220::CreateNextBuffer ()
+void cTMS5220::CreateNextBuffer ()
 {
     FUNCTION_ENTRY ( this, "cTMS5220::CreateNextBuffer", true );
 
-    if ( m_InterpolationStage == 0 ) {
-
-        // Try to get the next set of parameters
-        sSpeechParams temp;
-        if ( ReadFrame ( &temp, true ) == false ) {
-            TRACE ( "** UNDER-RUN **" );
-            return false;
-        }
-
-        // Update the start & target parameters
-        memcpy ( &m_StartParams, &m_TargetParams, sizeof ( sSpeechParams ));
-
-        // TBD: SILENCE - copy all parameters except energy
-
-        if (( temp.Repeat == false ) && ( temp.Stop == false )) {
-            memcpy ( &m_TargetParams, &temp, sizeof ( sSpeechParams ));
-        } else {
-            m_TargetParams.Energy = temp.Energy;
-            if ( temp.Stop == false ) {
-                m_TargetParams.Pitch  = temp.Pitch;
-            }
-        }
-
-        m_TargetParams.Stop = temp.Stop;
-    }
-
     sSpeechParams param;
     InterpolateParameters ( m_InterpolationStage, m_StartParams, m_TargetParams, &param );
     m_InterpolationStage = ( m_InterpolationStage + 1 ) % 8;
@@ -501,102 +540,304 @@ bool cTMS5220::CreateNextBuffer ()
         m_PitchIndex = 0;
     }
 
+    int *forward  = m_FilterHistory [ 0 ];
+    int *backward = m_FilterHistory [ 1 ];
+
     for ( int i = 0; i < INTERPOLATION_INTERVAL; i++ ) {
 
-        double sample = 0.0;
+        int sample = 0;
 
         if ( param.Pitch == 0 ) {
-            double random = ( rand () % 32768 ) / 16384.0 - 1.0;
-            sample = m_NonVoicedLevel * random;
-sample *= 0.25;
+            // Same spread as rand () % 32768, scaled to [-0.25,0.25)
+            m_NoiseSeed = m_NoiseSeed * 1103515245 + 12345;
+            int random  = (( int ) (( m_NoiseSeed >> 16 ) & 0x7FFF )) - 16384;
+            sample = ( int ) ((( long long ) m_NonVoicedLevel * random ) >> 16 );
         } else {
             if ( m_PitchIndex < ( int ) SIZE ( chirpTable )) {
-                sample = chirpTable [ m_PitchIndex ];
-sample *= param.Gain;
+                sample = ( chirpTable [ m_PitchIndex ] * param.Gain ) >> ( GAIN_BITS - SAMPLE_BITS );
             }
             m_PitchIndex = ( m_PitchIndex + 1 ) % param.Pitch;
         }
 
         // Synthesize...
-//        m_FilterHistory [ 0 ][ RC_ORDER ] = sample * param.Gain;
-        m_FilterHistory [ 0 ][ RC_ORDER ] = sample;
+        forward [ RC_ORDER ] = sample;
 
         // Forward path
         for ( int j = RC_ORDER - 1; j >= 0; j-- ) {
-            m_FilterHistory [ 0 ][ j ] = m_FilterHistory [ 0 ][ j + 1 ] - param.Reflection [ j ] * m_FilterHistory [ 1 ][ j ];
+            forward [ j ] = forward [ j + 1 ] - ( int ) ((( long long ) param.Reflection [ j ] * backward [ j ] ) >> COEFF_BITS );
         }
 
         // Backward path
         for ( int j = RC_ORDER - 1; j >= 1; j-- ) {
-            m_FilterHistory [ 1 ][ j ] = m_FilterHistory [ 1 ][ j - 1 ] + param.Reflection [ j - 1 ] * m_FilterHistory [ 0 ][ j - 1 ];
+            backward [ j ] = backward [ j - 1 ] + ( int ) ((( long long ) param.Reflection [ j - 1 ] * forward [ j - 1 ] ) >> COEFF_BITS );
         }
 
-        m_RawDataBuffer [ i ] = m_FilterHistory [ 1 ][ 0 ] = m_FilterHistory [ 0 ][ 0 ];
+        m_RawDataBuffer [ i ] = backward [ 0 ] = forward [ 0 ];
 
     }
 
-    deemp ( m_RawDataBuffer, INTERPOLATION_INTERVAL );
+    Deemphasize ( m_RawDataBuffer, INTERPOLATION_INTERVAL );
+}
 
-    if (( m_InterpolationStage == 0 ) && ( m_TargetParams.Stop == true )) {
-        m_BufferEmpty   = false;
-        m_TalkStatus    = false;
-        m_SpeakExternal = false;
+int cTMS5220::RingFill () const
+{
+    return ( m_RingHead - m_RingTail ) & ( m_RingSize - 1 );
+}
+
+void cTMS5220::ConvertBuffer ()
+{
+    FUNCTION_ENTRY ( this, "cTMS5220::ConvertBuffer", true );
+
+    // Bring the 8KHz samples to m_PlaybackFrequency, the number of samples
+    //   varies slightly from one buffer to the next
+    int count = m_Resampler->Process ( m_RawDataBuffer, INTERPOLATION_INTERVAL, m_PlaybackBuffer );
+
+    if ( m_RecordKey != -1 ) {
+        RecordSamples ( m_PlaybackBuffer, count );
     }
 
-    return true;
+    PushSamples ( m_PlaybackBuffer, count );
 }
 
-bool cTMS5220::ConvertBuffer ()
+void cTMS5220::PushSamples ( const int *src, int count )
 {
-    FUNCTION_ENTRY ( this, "cTMS5220::ConvertBuffer", true );
+    FUNCTION_ENTRY ( this, "cTMS5220::PushSamples", true );
 
-    // TBD - Convert buffer from 8KHz to m_PlaybackFrequency here
+    int head  = m_RingHead;
+    int first = m_RingSize - head;
+    if ( first > count ) first = count;
 
-    // NOTE: This is a simple way to do it - linearly interpolate the samples (introduces some high-frequecy artifacts)
-    double ratio = ( double ) m_PlaybackInterval / ( double ) INTERPOLATION_INTERVAL;
-    double count = ratio;
-    int j = 0;
-    static double last = 0.0;
-    for ( int i = 0; i < INTERPOLATION_INTERVAL; i++ ) {
-        double next = m_RawDataBuffer [i];
-        double max  = ( int ) count;
-        while ( count >= 1.0 ) {
-            double x = ( int ) count / max;
-            m_PlaybackBuffer [j++] = x * last + ( 1.0 - x ) * next;
-            count -= 1.0;
+    memcpy ( m_Ring + head, src, first * sizeof ( int ));
+    memcpy ( m_Ring, src + first, ( count - first ) * sizeof ( int ));
+
+    __sync_synchronize ();
+    m_RingHead = ( head + count ) & ( m_RingSize - 1 );
+}
+
+// Synthesizer : interpolates from the current target towards the new frame
+void cTMS5220::SynthesizeFrame ( const sSpeechParams &frame )
+{
+    FUNCTION_ENTRY ( this, "cTMS5220::SynthesizeFrame", true );
+
+    if ( m_PlayPhrase != NULL ) {
+        PlayPhrase ( frame );
+        return;
+    }
+
+    // Update the start & target parameters
+    memcpy ( &m_StartParams, &m_TargetParams, sizeof ( sSpeechParams ));
+
+    // TBD: SILENCE - copy all parameters except energy
+
+    if (( frame.Repeat == false ) && ( frame.Stop == false )) {
+        memcpy ( &m_TargetParams, &frame, sizeof ( sSpeechParams ));
+    } else {
+        m_TargetParams.Energy = frame.Energy;
+        if ( frame.Stop == false ) {
+            m_TargetParams.Pitch  = frame.Pitch;
         }
-        last = next;
-        count += ratio;
     }
 
-    // Finish what's left over (will be less than n=ratio samples)
-    while ( j < m_PlaybackInterval ) {
-        m_PlaybackBuffer [j++] = m_RawDataBuffer [INTERPOLATION_INTERVAL-1];
+    m_TargetParams.Stop = frame.Stop;
+
+    for ( int i = 0; i < 8; i++ ) {
+        CreateNextBuffer ();
+        ConvertBuffer ();
     }
 
-    last = m_RawDataBuffer [INTERPOLATION_INTERVAL-1];
+    if (( frame.Stop == true ) && ( m_RecordKey != -1 )) {
+        StorePhrase ();
+    }
+}
 
-    return true;
+// CPU thread : called on a Speak command with the synthesizer idle
+void cTMS5220::StartPhrase ()
+{
+    FUNCTION_ENTRY ( this, "cTMS5220::StartPhrase", true );
+
+    m_PlayPhrase   = NULL;
+    m_PlayOffset   = 0;
+    m_PlayFrames   = 0;
+    m_RecordKey    = -1;
+    m_RecordLength = 0;
+
+    // Phrases are only known by their first byte
+    if (( m_Ring == NULL ) || ( m_VsmBitsLeft != 0 )) return;
+
+    int key = ( m_ChipSelect << 14 ) | m_Address;
+
+    m_PlayPhrase = FindPhrase ( key );
+    if ( m_PlayPhrase == NULL ) {
+        m_RecordKey = key;
+    } else {
+        TRACE ( "Speaking cached phrase at " << hex << key );
+    }
+}
+
+const cTMS5220::sSpeechPhrase *cTMS5220::FindPhrase ( int key ) const
+{
+    FUNCTION_ENTRY ( this, "cTMS5220::FindPhrase", true );
+
+    int count = m_PhraseCount;
+
+    __sync_synchronize ();
+
+    for ( int i = 0; i < count; i++ ) {
+        const sSpeechPhrase *phrase = &m_Phrases [i];
+        if (( phrase->Key == key ) && ( phrase->Rate == m_PlaybackFrequency )) {
+            return phrase;
+        }
+    }
+
+    return NULL;
+}
+
+// Synthesizer : hand out the part of the cached phrase this frame would
+//   have produced, the rest of it with the stop frame
+void cTMS5220::PlayPhrase ( const sSpeechParams &frame )
+{
+    FUNCTION_ENTRY ( this, "cTMS5220::PlayPhrase", true );
+
+    m_PlayFrames++;
+
+    int end = m_PlayPhrase->Length;
+    if ( frame.Stop == false ) {
+        end = min ( end, ( int ) (( long long ) m_PlayFrames * m_PlaybackFrequency / TMS5220_FRAME_RATE ));
+    }
+    end = min ( end, m_PlayOffset + m_RingSize - 1 - RingFill ());
+
+    while ( m_PlayOffset < end ) {
+        int count = min ( end - m_PlayOffset, m_PlaybackInterval );
+        const short *src = m_PlayPhrase->Samples + m_PlayOffset;
+        for ( int i = 0; i < count; i++ ) {
+            m_PlaybackBuffer [i] = src [i] << ( SAMPLE_BITS - 8 );
+        }
+        PushSamples ( m_PlaybackBuffer, count );
+        m_PlayOffset += count;
+    }
+}
+
+void cTMS5220::RecordSamples ( const int *src, int count )
+{
+    FUNCTION_ENTRY ( this, "cTMS5220::RecordSamples", true );
+
+    if ( m_RecordLength + count > m_RecordSize ) {
+        int size = ( m_RecordSize != 0 ) ? m_RecordSize * 2 : m_PlaybackFrequency;
+        if ( size > SPEECH_PHRASE_MAX * m_PlaybackFrequency ) {
+            TRACE ( "Phrase too long to be cached" );
+            m_RecordKey = -1;
+            return;
+        }
+        short *record = new short [ size ];
+        memcpy ( record, m_Record, m_RecordLength * sizeof ( short ));
+        delete [] m_Record;
+        m_Record     = record;
+        m_RecordSize = size;
+    }
+
+    // Kept at the mixer's 16-bit scale, a cached phrase sounds the same as
+    //   the synthesizer's own output
+    for ( int i = 0; i < count; i++ ) {
+        int sample = src [i] >> ( SAMPLE_BITS - 8 );
+        m_Record [ m_RecordLength++ ] = ( short ) min ( 32767, max ( -32768, sample ));
+    }
+}
+
+// Synthesizer : the recorded phrase reached its stop frame
+void cTMS5220::StorePhrase ()
+{
+    FUNCTION_ENTRY ( this, "cTMS5220::StorePhrase", true );
+
+    int count = m_PhraseCount;
+    int bytes = m_RecordLength * sizeof ( short );
+
+    if (( count < SPEECH_CACHE_PHRASES ) && ( m_CacheBytes + bytes <= SPEECH_CACHE_BYTES )) {
+        sSpeechPhrase *phrase = &m_Phrases [ count ];
+        phrase->Key     = m_RecordKey;
+        phrase->Rate    = m_PlaybackFrequency;
+        phrase->Length  = m_RecordLength;
+        phrase->Samples = new short [ m_RecordLength ];
+        memcpy ( phrase->Samples, m_Record, bytes );
+        m_CacheBytes += bytes;
+        TRACE ( "Cached phrase at " << hex << m_RecordKey << " (" << dec << m_RecordLength << " samples)" );
+        __sync_synchronize ();
+        m_PhraseCount = count + 1;
+    }
+
+    m_RecordKey = -1;
+}
+
+// Synthesizer : turns the queued frames into samples for as long as the
+//   ring has room for a whole frame
+void cTMS5220::SynthesizeFrames ()
+{
+    FUNCTION_ENTRY ( this, "cTMS5220::SynthesizeFrames", false );
+
+    if ( m_Ring == NULL ) return;
+
+    while ( m_FrameTail != m_FrameHead ) {
+        if ( m_RingSize - 1 - RingFill () < 8 * m_PlaybackInterval ) break;
+        __sync_synchronize ();
+        int tail = m_FrameTail;
+        SynthesizeFrame ( m_FrameQueue [ tail ] );
+        __sync_synchronize ();
+        m_FrameTail = ( tail + 1 ) & ( SPEECH_FRAME_QUEUE - 1 );
+    }
 }
 
-bool cTMS5220::GetNextBuffer ()
+void cTMS5220::FramesQueued ()
 {
-    FUNCTION_ENTRY ( this, "cTMS5220::GetNextBuffer", true );
+    FUNCTION_ENTRY ( this, "cTMS5220::FramesQueued", false );
 
-    if ( CreateNextBuffer () == false ) {
+    SynthesizeFrames ();
+}
+
+// CPU thread : reads the next frame from the ROM/FIFO into the queue
+bool cTMS5220::DecodeFrame ()
+{
+    FUNCTION_ENTRY ( this, "cTMS5220::DecodeFrame", true );
+
+    int head = m_FrameHead;
+    int next = ( head + 1 ) & ( SPEECH_FRAME_QUEUE - 1 );
+
+    if ( next == m_FrameTail ) {
+        TRACE ( "Frame queue full" );
         return false;
     }
 
-    if ( ConvertBuffer () == false ) {
+    if ( ReadFrame ( &m_FrameQueue [ head ], true ) == false ) {
+        TRACE ( "** UNDER-RUN **" );
         return false;
     }
 
-    m_PlaybackDataPtr     = m_PlaybackBuffer;
-    m_PlaybackSamplesLeft = m_PlaybackInterval;
+    if ( m_FrameQueue [ head ].Stop == true ) {
+        m_Stopping = true;
+    }
+
+    m_DecodeAhead += m_PlaybackFrequency;
+
+    __sync_synchronize ();
+    m_FrameHead = next;
 
     return true;
 }
 
+// CPU thread : count samples have been played, read the frames that fall
+//   due to stay SPEECH_FRAME_LEAD frames ahead
+void cTMS5220::DecodeFrames ( int count )
+{
+    FUNCTION_ENTRY ( this, "cTMS5220::DecodeFrames", false );
+
+    m_DecodeAhead -= count * TMS5220_FRAME_RATE;
+    if ( m_DecodeAhead < 0 ) {
+        m_DecodeAhead = 0;
+    }
+
+    while (( m_Stopping == false ) && ( m_DecodeAhead < SPEECH_FRAME_LEAD * m_PlaybackFrequency )) {
+        if ( DecodeFrame () == false ) break;
+    }
+}
+
 char *cTMS5220::FormatParameters ( const sSpeechParams &param, bool showAll )
 {
     FUNCTION_ENTRY ( NULL, "cTMS5220::FormatParameters", true );
@@ -611,7 +852,7 @@ char *cTMS5220::FormatParameters ( const sSpeechParams &param, bool showAll )
         int max = (( showAll == true ) || ( param.Pitch != 0 ))? 10 : 4;
         ptr += sprintf ( ptr, "  K:" );
         for ( int i = 0; i < max; i++ ) {
-            ptr += sprintf ( ptr, " %8.5f", param.Reflection [i] );
+            ptr += sprintf ( ptr, " %8.5f", ( double ) param.Reflection [i] / ( 1 << COEFF_BITS ));
         }
     }
 
@@ -633,14 +874,17 @@ void cTMS5220::InterpolateParameters ( int stage, const sSpeechParams &start, co
         param->Pitch = 0;
     }
 
-    double gain = 1.0;
+    // Gain = 0.001 * sqrt ( Energy * Pitch ) * ( prod ( 1 - k^2 )) ^ 1/4
+    int residual = 1 << 30;
     for ( int i = 0; i < RC_ORDER; i++ ) {
-        param->Reflection [i] = start.Reflection [i] + stage * ( end.Reflection [i] - start.Reflection [i] ) / 8;
-        gain /= ( 1 - ( param->Reflection [i] * param->Reflection [i] ));
+        int k = start.Reflection [i] + stage * ( end.Reflection [i] - start.Reflection [i] ) / 8;
+        param->Reflection [i] = k;
+        residual = ( int ) ((( long long ) residual * (( 1 << 30 ) - k * k )) >> 30 );
     }
 
-//    param->Gain = 0.01 * sqrt ( param->Energy / sqrt ( gain ));
-    param->Gain = 0.001 * sqrt ( param->Energy / sqrt ( gain )) * sqrt (( double ) param->Pitch );
+    int root  = ISqrt (( unsigned long long ) ISqrt (( unsigned long long ) residual << 30 ) << 30 );     // Q30
+    int level = ISqrt (( unsigned long long ) ( param->Energy * param->Pitch ) << 16 );                   // Q8
+    param->Gain = ( int ) (((( long long ) level * root ) >> ( 38 - GAIN_BITS )) / 1000 );
 
 //fprintf ( stderr, "%s  gain: %15.10f\n", FormatParameters ( *param, true ), 1.0 / gain );
 }
@@ -654,14 +898,7 @@ bool cTMS5220::ReadFrame ( sSpeechParams *info, bool restore )
     sReadState state;
     SaveReadState ( &state );
 
-    if ( setjmp ( jump_buffer ) != 0 ) {
-        if ( restore == true ) {
-            RestoreReadState ( state );
-        } else {
-            Reset ();
-        }
-        return false;
-    }
+    m_ReadUnderrun = false;
 
     int index = ReadBits ( 4 );
 
@@ -712,6 +949,16 @@ bool cTMS5220::ReadFrame ( sSpeechParams *info, bool restore )
 
     }
 
+    // Back out of a partial frame, ReadBitsFIFO returned 0s past the end
+    if ( m_ReadUnderrun == true ) {
+        if ( restore == true ) {
+            RestoreReadState ( state );
+        } else {
+            Reset ();
+        }
+        return false;
+    }
+
     if ( m_SpeakExternal == true ) {
         if ( m_BitsLeft == 0 ) {
             m_BufferEmpty = true;
@@ -728,46 +975,48 @@ void cTMS5220::SetComputer ( cTI994A *computer )
     m_Computer = computer;
 }
 
-bool cTMS5220::AudioCallback ( UCHAR *buffer, int count )
+// Adds the speech to a signed 16-bit scale mix, a NULL buffer just drains the
+//   samples that would have been played
+bool cTMS5220::AudioCallback ( int *buffer, int count )
 {
     FUNCTION_ENTRY ( this, "cTMS5220::AudioCallback", false );
 
-    if ( m_TalkStatus == false ) {
+    if (( m_TalkStatus == false ) || ( m_Ring == NULL )) {
         return false;
     }
 
-    bool modified = false;
+    DecodeFrames ( count );
 
-# if 0 //LUDO: DISABLE !
-    while (( count > 0 ) && ( m_TalkStatus == true )) {
+    if ( m_FrameTail != m_FrameHead ) {
+        FramesQueued ();
+    }
 
-        if (( m_PlaybackSamplesLeft == 0 ) && ( GetNextBuffer () == false )) {
-            break;
-        }
+    // Only copy what the synthesizer has ready, it catches up on the next call
+    int tail = m_RingTail;
+    int size = min ( count, RingFill ());
 
-        modified = true;
+    __sync_synchronize ();
 
-        int size = min ( count, m_PlaybackSamplesLeft );
+    if ( buffer != NULL ) {
         for ( int i = 0; i < size; i++ ) {
-            int sample = ( int ) ( *buffer + *m_PlaybackDataPtr++ );
-            *buffer++ = min ( 255, max ( 0, sample ));
+            buffer [i] += m_Ring [ tail ] >> ( SAMPLE_BITS - 8 );
+            tail = ( tail + 1 ) & ( m_RingSize - 1 );
         }
-
-        count -= size;
-        m_PlaybackSamplesLeft -= size;
+    } else {
+        tail = ( tail + size ) & ( m_RingSize - 1 );
     }
 
-    if ( m_TalkStatus == false ) {
+    __sync_synchronize ();
+    m_RingTail = tail;
+
+    // The stop frame has been played out
+    if (( m_Stopping == true ) && ( m_DecodeAhead == 0 )) {
         Reset ();
     }
-# else
-    m_TalkStatus = false;
-    Reset ();
-# endif
 
-    return modified;
+    return ( size > 0 ) ? true : false;
 }
-
+
 void cTMS5220::Reset ()
 {
     FUNCTION_ENTRY ( this, "cTMS5220::Reset", true );
@@ -782,6 +1031,8 @@ void cTMS5220::Reset ()
 
     m_ReadByte      = false;
     m_SpeakExternal = false;
+    m_ReadUnderrun  = false;
+    m_Stopping      = false;
 
     m_BufferEmpty   = true;
     m_TalkStatus    = false;
@@ -795,14 +1046,41 @@ void cTMS5220::Reset ()
     m_VsmData       = 0;
     m_VsmBitsLeft   = 0;
 
+    m_FrameHead     = 0;
+    m_FrameTail     = 0;
+    m_DecodeAhead   = 0;
+
+    ResetSynthesizer ();
+}
+
+void cTMS5220::ResetSynthesizer ()
+{
+    FUNCTION_ENTRY ( this, "cTMS5220::ResetSynthesizer", true );
+
     memset ( &m_StartParams, 0, sizeof ( m_StartParams ));
     memset ( &m_TargetParams, 0, sizeof ( m_TargetParams ));
 
     memset ( m_FilterHistory, 0, sizeof ( m_FilterHistory ));
+    memset ( m_DeempInput, 0, sizeof ( m_DeempInput ));
+    memset ( m_DeempOutput, 0, sizeof ( m_DeempOutput ));
     memset ( m_RawDataBuffer, 0, sizeof ( m_RawDataBuffer ));
 
-    m_InterpolationStage  = 0;
-    m_PlaybackSamplesLeft = 0;
+    m_InterpolationStage = 0;
+    m_RingHead           = 0;
+    m_RingTail           = 0;
+
+    // Start every phrase from the same state so that cached ones sound
+    //   the same as synthesized ones
+    m_PitchIndex         = 0;
+    m_NoiseSeed          = 1;
+
+    m_PlayPhrase         = NULL;
+    m_RecordKey          = -1;
+    m_RecordLength       = 0;
+
+    if ( m_Resampler != NULL ) {
+        m_Resampler->Reset ();
+    }
 }
 
 UCHAR cTMS5220::WriteData ( UCHAR data )
@@ -840,6 +1118,9 @@ UCHAR cTMS5220::WriteData ( UCHAR data )
                 break;
             case 0x50 : // Speak
                 TRACE ( "CMD: Speak" );
+                if ( m_TalkStatus == false ) {
+                    StartPhrase ();
+                }
                 m_TalkStatus = true;
                 break;
             case 0x60 : // Speak-External (accepts an unlimited number of data bytes)
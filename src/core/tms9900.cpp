@@ -153,6 +153,10 @@ int cTMS9900::sortFunction ( const sOpCode *p1, const sOpCode *p2 )
     return 0;
 }
 
+UCHAR ReadMemoryB ( USHORT );
+void  WriteMemoryB ( USHORT, UCHAR, int );
+void  WriteMemoryW ( USHORT, USHORT, int );
+
 extern "C" USHORT CallTrapB ( bool read, int index, const ADDRESS address, USHORT value )
 {
     FUNCTION_ENTRY ( NULL, "CallTrapB", false );
@@ -276,6 +280,44 @@ void  cTMS9900::ResetClocks ()			{ ClockCycleCounter = 0; }
 ULONG cTMS9900::GetCounter ()			{ return InstructionCounter; }
 void  cTMS9900::ResetCounter ()			{ InstructionCounter = 0; }
 
+USHORT cTMS9900::GetRegister ( int reg )
+{
+    FUNCTION_ENTRY ( this, "cTMS9900::GetRegister", false );
+
+    ADDRESS address = ( ADDRESS ) ( WorkspacePtr + 2 * reg );
+
+    return ( USHORT ) (( ReadMemory ( address ) << 8 ) | ReadMemory (( ADDRESS ) ( address + 1 )));
+}
+
+void cTMS9900::SetRegister ( int reg, USHORT value )
+{
+    FUNCTION_ENTRY ( this, "cTMS9900::SetRegister", false );
+
+    ULONG clocks = ClockCycleCounter;
+    ::WriteMemoryW (( USHORT ) ( WorkspacePtr + 2 * reg ), value, 0 );
+    ClockCycleCounter = clocks;
+}
+
+UCHAR cTMS9900::ReadMemory ( ADDRESS address )
+{
+    FUNCTION_ENTRY ( this, "cTMS9900::ReadMemory", false );
+
+    ULONG clocks = ClockCycleCounter;
+    UCHAR value = ::ReadMemoryB ( address );
+    ClockCycleCounter = clocks;
+
+    return value;
+}
+
+void cTMS9900::WriteMemory ( ADDRESS address, UCHAR value )
+{
+    FUNCTION_ENTRY ( this, "cTMS9900::WriteMemory", false );
+
+    ULONG clocks = ClockCycleCounter;
+    ::WriteMemoryB ( address, value, 0 );
+    ClockCycleCounter = clocks;
+}
+
 void cTMS9900::SaveImage ( FILE *file )
 {
     FUNCTION_ENTRY ( this, "cTMS9900::SaveImage", true );
@@ -99,6 +99,12 @@ int cTMS9919::SetSpeechSynthesizer ( cTMS5220 *speech )
     return -1;
 }
 
+// Called by the emulation loop once per frame to render what was written
+void cTMS9919::Flush ()
+{
+    FUNCTION_ENTRY ( this, "cTMS9919::Flush", false );
+}
+
 void cTMS9919::WriteData ( UCHAR data )
 {
     FUNCTION_ENTRY ( this, "cTMS9919::WriteData", true );
@@ -0,0 +1,187 @@
+//----------------------------------------------------------------------------
+//
+// File:        vgm.cpp
+// Date:        19-Oct-2026
+//
+// Description: VGM log of the sound and speech chip writes
+//
+//   Every write is stamped with the CPU clock it happened at.  The clock is
+//   turned into 44.1 KHz sample waits between writes, so a log can be
+//   played back by any VGM player (sound chip only) or rendered offline by
+//   util/vgmrender with speech.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include "common.hpp"
+#include "logger.hpp"
+#include "vgm.hpp"
+
+DBG_REGISTER ( __FILE__ );
+
+static void PutLong ( UCHAR *ptr, ULONG value )
+{
+    ptr [0] = ( UCHAR ) ( value >>  0 );
+    ptr [1] = ( UCHAR ) ( value >>  8 );
+    ptr [2] = ( UCHAR ) ( value >> 16 );
+    ptr [3] = ( UCHAR ) ( value >> 24 );
+}
+
+cVgmRecorder::cVgmRecorder () :
+    m_File ( NULL ),
+    m_LastClock ( 0 ),
+    m_Cycles ( 0 ),
+    m_Samples ( 0 ),
+    m_CpuFrequency ( 3000000 )
+{
+    FUNCTION_ENTRY ( this, "cVgmRecorder ctor", true );
+}
+
+cVgmRecorder::~cVgmRecorder ()
+{
+    FUNCTION_ENTRY ( this, "cVgmRecorder dtor", true );
+
+    Close ();
+}
+
+bool cVgmRecorder::Open ( const char *filename, ULONG clock, int cpuFrequency )
+{
+    FUNCTION_ENTRY ( this, "cVgmRecorder::Open", true );
+
+    Close ();
+
+    m_File = fopen ( filename, "wb" );
+    if ( m_File == NULL ) {
+        ERROR ( "Unable to create VGM file \"" << filename << "\"" );
+        return false;
+    }
+
+    // The sizes are filled in by Close
+    UCHAR header [ VGM_HEADER_SIZE ];
+    memset ( header, 0, sizeof ( header ));
+    memcpy ( header, "Vgm ", 4 );
+    PutLong ( header + 0x08, VGM_VERSION );
+    PutLong ( header + 0x0C, VGM_PSG_CLOCK );
+    PutLong ( header + 0x24, 60 );
+    header [ 0x28 ] = ( UCHAR ) ( VGM_PSG_FEEDBACK & 0xFF );
+    header [ 0x29 ] = ( UCHAR ) ( VGM_PSG_FEEDBACK >> 8 );
+    header [ 0x2A ] = VGM_PSG_SHIFT_WIDTH;
+    PutLong ( header + 0x34, VGM_HEADER_SIZE - 0x34 );
+
+    fwrite ( header, sizeof ( header ), 1, m_File );
+
+    m_LastClock    = clock;
+    m_Cycles       = 0;
+    m_Samples      = 0;
+    m_CpuFrequency = cpuFrequency;
+
+    return true;
+}
+
+void cVgmRecorder::Close ()
+{
+    FUNCTION_ENTRY ( this, "cVgmRecorder::Close", true );
+
+    if ( m_File == NULL ) return;
+
+    fputc ( VGM_CMD_END, m_File );
+
+    UCHAR data [4];
+    PutLong ( data, ( ULONG ) ftell ( m_File ) - 4 );
+    fseek ( m_File, 0x04, SEEK_SET );
+    fwrite ( data, 4, 1, m_File );
+
+    PutLong ( data, m_Samples );
+    fseek ( m_File, 0x18, SEEK_SET );
+    fwrite ( data, 4, 1, m_File );
+
+    fclose ( m_File );
+    m_File = NULL;
+}
+
+// Emits the waits that bring the log up to the given CPU clock
+void cVgmRecorder::Wait ( ULONG clock )
+{
+    FUNCTION_ENTRY ( this, "cVgmRecorder::Wait", false );
+
+    m_Cycles   += ( ULONG ) ( clock - m_LastClock );
+    m_LastClock = clock;
+
+    ULONG target = ( ULONG ) ( m_Cycles * VGM_SAMPLE_RATE / m_CpuFrequency );
+    ULONG wait   = target - m_Samples;
+
+    while ( wait > 0 ) {
+        if ( wait <= 16 ) {
+            fputc ( VGM_CMD_WAIT_SHORT | ( wait - 1 ), m_File );
+            m_Samples += wait;
+            break;
+        }
+        ULONG count = ( wait > 0xFFFF ) ? 0xFFFF : wait;
+        if ( count == 735 ) {
+            fputc ( VGM_CMD_WAIT_NTSC, m_File );
+        } else if ( count == 882 ) {
+            fputc ( VGM_CMD_WAIT_PAL, m_File );
+        } else {
+            fputc ( VGM_CMD_WAIT, m_File );
+            fputc (( int ) ( count & 0xFF ), m_File );
+            fputc (( int ) ( count >> 8 ), m_File );
+        }
+        m_Samples += count;
+        wait      -= count;
+    }
+}
+
+void cVgmRecorder::Command ( UCHAR command, UCHAR data )
+{
+    FUNCTION_ENTRY ( this, "cVgmRecorder::Command", false );
+
+    fputc ( command, m_File );
+    fputc ( data, m_File );
+}
+
+void cVgmRecorder::WritePSG ( ULONG clock, UCHAR data )
+{
+    FUNCTION_ENTRY ( this, "cVgmRecorder::WritePSG", false );
+
+    if ( m_File == NULL ) return;
+
+    Wait ( clock );
+    Command ( VGM_CMD_PSG, data );
+}
+
+void cVgmRecorder::WriteSpeech ( ULONG clock, UCHAR data )
+{
+    FUNCTION_ENTRY ( this, "cVgmRecorder::WriteSpeech", false );
+
+    if ( m_File == NULL ) return;
+
+    Wait ( clock );
+    Command ( VGM_CMD_SPEECH_WRITE, data );
+}
+
+void cVgmRecorder::ReadSpeech ( ULONG clock )
+{
+    FUNCTION_ENTRY ( this, "cVgmRecorder::ReadSpeech", false );
+
+    if ( m_File == NULL ) return;
+
+    Wait ( clock );
+    Command ( VGM_CMD_SPEECH_READ, 0x00 );
+}
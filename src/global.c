@@ -28,6 +28,7 @@
 #include "psp_joy.h"
 #include "psp_menu.h"
 #include "psp_fmgr.h"
+#include "psp_pacer.h"
 
 //LUDO:
   TI99_t TI99;
@@ -345,8 +346,14 @@ void
 ti99_default_settings()
 {
   TI99.ti99_snd_enable     = 1;
+  TI99.ti99_snd_buffer     = 0;
+  TI99.ti99_snd_latency    = 60;
   TI99.ti99_render_mode    = TI99_RENDER_FIT;
+  TI99.ti99_render_thread  = 0;
+  TI99.ti99_scaler_threads = 1;
   TI99.ti99_speed_limiter  = 60;
+  TI99.psp_skip_max_frame  = TI99_SKIP_AUTO;
+  TI99.ti99_pacing         = TI99_PACING_TIMER;
   TI99.psp_screenshot_id   = 0;
   TI99.psp_cpu_clock       = GP2X_DEF_EMU_CLOCK;
   TI99.ti99_vsync          = 0;
@@ -369,8 +376,13 @@ loc_ti99_save_settings(char *chFileName)
     fprintf(FileDesc, "danzeff_trans=%d\n"      , TI99.danzeff_trans);
     fprintf(FileDesc, "psp_skip_max_frame=%d\n"  , TI99.psp_skip_max_frame);
     fprintf(FileDesc, "ti99_snd_enable=%d\n"     , TI99.ti99_snd_enable);
+    fprintf(FileDesc, "ti99_snd_buffer=%d\n"     , TI99.ti99_snd_buffer);
+    fprintf(FileDesc, "ti99_snd_latency=%d\n"    , TI99.ti99_snd_latency);
     fprintf(FileDesc, "ti99_render_mode=%d\n"    , TI99.ti99_render_mode);
+    fprintf(FileDesc, "ti99_render_thread=%d\n"  , TI99.ti99_render_thread);
+    fprintf(FileDesc, "ti99_scaler_threads=%d\n" , TI99.ti99_scaler_threads);
     fprintf(FileDesc, "ti99_speed_limiter=%d\n"  , TI99.ti99_speed_limiter);
+    fprintf(FileDesc, "ti99_pacing=%d\n"         , TI99.ti99_pacing);
     fprintf(FileDesc, "ti99_view_fps=%d\n"       , TI99.ti99_view_fps);
     fprintf(FileDesc, "ti99_vsync=%d\n"        , TI99.ti99_vsync);
 
@@ -431,10 +443,20 @@ loc_ti99_load_settings(char *chFileName)
     else
     if (!strcasecmp(Buffer,"ti99_snd_enable"))     TI99.ti99_snd_enable = Value;
     else
+    if (!strcasecmp(Buffer,"ti99_snd_buffer"))     TI99.ti99_snd_buffer = Value;
+    else
+    if (!strcasecmp(Buffer,"ti99_snd_latency"))    TI99.ti99_snd_latency = Value;
+    else
     if (!strcasecmp(Buffer,"ti99_render_mode"))    TI99.ti99_render_mode = Value;
     else
+    if (!strcasecmp(Buffer,"ti99_render_thread"))  TI99.ti99_render_thread = Value;
+    else
+    if (!strcasecmp(Buffer,"ti99_scaler_threads")) TI99.ti99_scaler_threads = Value;
+    else
     if (!strcasecmp(Buffer,"ti99_speed_limiter"))  TI99.ti99_speed_limiter = Value;
     else
+    if (!strcasecmp(Buffer,"ti99_pacing"))  TI99.ti99_pacing = Value;
+    else
     if (!strcasecmp(Buffer,"ti99_view_fps"))  TI99.ti99_view_fps = Value;
     else
     if (!strcasecmp(Buffer,"ti99_vsync"))  TI99.ti99_vsync = Value;
@@ -442,6 +464,11 @@ loc_ti99_load_settings(char *chFileName)
 
   fclose(FileDesc);
 
+  /* The render mode indexes the scaler table, don't trust the file */
+  if ((TI99.ti99_render_mode < 0) || (TI99.ti99_render_mode > TI99_LAST_RENDER)) {
+    TI99.ti99_render_mode = TI99_RENDER_FIT;
+  }
+
   myPowerSetClockFrequency(TI99.psp_cpu_clock);
 
   return 0;
@@ -845,17 +872,21 @@ ti99_treat_command_key(int ti99_idx)
     case TI99_C_JOY: TI99.psp_reverse_analog = ! TI99.psp_reverse_analog;
     break;
     case TI99_C_RENDER: 
+      ti99_video_flush();
       psp_sdl_black_screen();
       new_render = TI99.ti99_render_mode + 1;
       if (new_render > TI99_LAST_RENDER) new_render = 0;
       TI99.ti99_render_mode = new_render;
+      ti99_dirty_all();
     break;
     case TI99_C_LOAD: psp_main_menu_load_current();
     break;
     case TI99_C_SAVE: psp_main_menu_save_current(); 
     break;
     case TI99_C_RESET: 
+       ti99_video_flush();
        psp_sdl_black_screen();
+       ti99_dirty_all();
        ti99_reset_computer();
        reset_save_name();
     break;
@@ -22,7 +22,16 @@ typedef unsigned int   u32;
 
 # define TI99_RENDER_NORMAL      0
 # define TI99_RENDER_FIT         1
-# define TI99_LAST_RENDER        1
+# define TI99_RENDER_NEAREST     2
+# define TI99_RENDER_BILINEAR    3
+# define TI99_RENDER_EDGE        4
+# define TI99_LAST_RENDER        4
+
+# define TI99_SKIP_AUTO         -1
+# define TI99_SKIP_AUTO_MAX      8
+
+# define TI99_SND_LATENCY_MIN   20
+# define TI99_SND_LATENCY_MAX  250
 
 # define MAX_PATH            256
 # define TI99_MAX_SAVE_STATE    5
@@ -82,14 +91,19 @@ typedef unsigned int   u32;
     int        ti99_current_fps;
     int        ti99_current_clock;
     int        ti99_snd_enable;
+    int        ti99_snd_buffer;
+    int        ti99_snd_latency;
     char       psp_irdajoy_type;
     char       psp_irdajoy_debug;
     int        ti99_render_mode;
+    int        ti99_render_thread;
+    int        ti99_scaler_threads;
     int        ti99_vsync;
     int        danzeff_trans;
     int        psp_skip_max_frame;
     int        psp_skip_cur_frame;
     int        ti99_speed_limiter;
+    int        ti99_pacing;
     int        ti99_auto_fire;
     int        ti99_auto_fire_pressed;
     int        ti99_auto_fire_period;
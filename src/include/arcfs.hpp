@@ -38,9 +38,12 @@ class cArchiveFileSystem : public cFileSystem {
 
     cPseudoFileSystem     *m_Container;
     cDecodeLZW            *m_Decoder;
+    UCHAR                 *m_Input;
+    size_t                 m_InputSize;
+    size_t                 m_DataStart;         // Offset of the first file in the decoded stream
     sFileDescriptorRecord  m_Directory [128];
     int                    m_FileCount;
-    int                    m_FileIndex;
+    int                    m_FileIndex;         // The file the decoder is positioned at
     int                    m_TotalSectors;
 
 protected:
@@ -48,10 +51,9 @@ protected:
     cArchiveFileSystem ( cPseudoFileSystem * );
     ~cArchiveFileSystem ();
 
-    static bool DirectoryCallback ( void *, size_t, void * );
-    static bool DataCallback ( void *, size_t, void * );
-    
+    bool LoadDirectory ( const UCHAR * );
     void LoadFile ();
+    bool LoadMember ( int );
  
     // cFileSystem non-public methods
     virtual int FileCount () const;
@@ -93,6 +93,7 @@ public:
     SDL_Surface *GetSurface () const    { return m_pSurface; }
 
     void  Copy ( cBitMap * );
+    void  Copy ( cBitMap *, const sRECT * );
 
 };
 
@@ -60,6 +60,15 @@ class cCartridge {
     char          *m_Title;
     USHORT         m_BaseCRU;
 
+    // The image file, read into memory - ROM banks stored as a single
+    //   literal block point straight into it
+    UCHAR         *m_Image;
+    ULONG          m_ImageSize;
+
+    // RAM banks and compressed ROM banks are carved out of this block
+    UCHAR         *m_Block;
+    ULONG          m_BlockSize;
+
 // Manufacturer
 // Copyright/date
 // Catalog Number
@@ -67,9 +76,14 @@ class cCartridge {
 
     void SetFileName ( const char * );
 
+    bool HasBatteryRAM () const;
     void LoadRAM ();
     void SaveRAM ();
 
+    bool ReadImage ( FILE * );
+    void ReleaseImage ();
+    bool IsShared ( const UCHAR * ) const;
+
     bool LoadOldImage ( FILE * );
 
 public:
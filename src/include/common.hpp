@@ -57,10 +57,12 @@ typedef unsigned long  ULONG;
     typedef unsigned short WORD;
     typedef unsigned long  DWORD;
     typedef long long      LLONG;
+    typedef unsigned long long ULLONG;
 
 #else
 
     typedef __int64        LLONG;
+    typedef unsigned __int64 ULLONG;
 
 #endif
 
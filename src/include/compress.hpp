@@ -30,6 +30,11 @@
 #define COMPRESS_HPP_
 
 void SaveBuffer ( int length, UCHAR *ptr, FILE *file );
+void SaveRawBuffer ( int length, UCHAR *ptr, FILE *file );
 void LoadBuffer ( int length, UCHAR *ptr, FILE *file );
 
+const UCHAR *LoadBuffer ( int length, UCHAR *ptr, const UCHAR *data, const UCHAR *end );
+
+int CompressedSize ( int length, UCHAR *ptr );
+
 #endif
@@ -34,46 +34,56 @@ const int CODE_EOF        = 257;    // EOF marker
 const int CODE_FIRST_FREE = 258;    // first free code
 const int CODE_MAX        = 4096;   // Max codes + 1
 
+// The decoder is a stream - Read pulls as many bytes as are asked for and
+//   decodes only as much of the input as it needs to.  Every code since the
+//   last clear code is a string that is already in the output window, so the
+//   dictionary is just an offset and a length into it.
+
 class cDecodeLZW {
 
-    // Used for reading the next token
-    USHORT  m_nBits;
-    USHORT  m_nBitsB;
-    USHORT  m_BitOff;
-    USHORT  m_CurWord;
-    USHORT  m_MaxCode;
-
-    // History tables
-    UCHAR   m_CHAR [CODE_MAX];
-    USHORT  m_NextCode [CODE_MAX];
-    USHORT  m_FreeCode;
-
-    // Input buffer related
-    USHORT  *m_InPtr;
-
-    // Output buffer related
-    bool   (*m_WriteCallback) ( void *, size_t, void * );
-    void    *m_CallbackToken;
-    size_t   m_MaxWriteSize;
-    UCHAR   *m_WriteBuffer;
-    UCHAR   *m_OutPtr;
-
-    void Init ();
-    void Reset ();
-    void Done ();
+    // Input buffer related - codes are taken from the top of the bit buffer
+    const UCHAR  *m_InStart;
+    const UCHAR  *m_InEnd;
+    const UCHAR  *m_InPtr;
+    ULLONG        m_BitBuffer;
+    int           m_BitCount;
+    int           m_nBits;
+    int           m_MaxCode;
 
-    USHORT ReadCode ();
+    // Dictionary
+    ULONG         m_Offset [CODE_MAX];
+    USHORT        m_Length [CODE_MAX];
+    int           m_FreeCode;
+    ULONG         m_LastOffset;
+    int           m_LastLength;             // 0 before the first code after a clear
 
-    void AddCode ( UCHAR, USHORT );
-    bool WriteChar ( UCHAR ch );
+    // Output window - everything decoded since the last clear code
+    UCHAR        *m_Window;
+    ULONG         m_WindowSize;
+    ULONG         m_WindowEnd;
+    ULONG         m_ReadPtr;
+
+    size_t        m_Position;
+    bool          m_Done;
+    bool          m_Error;
+
+    void Reset ();
+
+    int  ReadCode ();
+    bool Reserve ( ULONG );
+    bool DecodeCode ();
 
 public:
 
     cDecodeLZW ();
     ~cDecodeLZW ();
 
-    void SetWriteCallback ( bool (*) ( void *, size_t, void * ), void *, size_t, void * );
-    int  ParseBuffer ( void *, size_t );
+    void   SetInput ( const void *, size_t );
+    size_t Read ( void *, size_t );
+
+    size_t Position () const                { return m_Position; }
+    bool   IsDone () const                  { return m_Done && ( m_ReadPtr == m_WindowEnd ); }
+    bool   HasError () const                { return m_Error; }
 
 };
 
@@ -0,0 +1,81 @@
+//----------------------------------------------------------------------------
+//
+// File:        dirfs.hpp
+// Date:        19-Oct-2026
+//
+// Description: A class to present a host directory of TIFILES & FIAD files
+//              as a TI disk filesystem
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#ifndef DIRFS_HPP_
+#define DIRFS_HPP_
+
+#include "fs.hpp"
+
+// Size reported for a directory, there is no real limit
+const int DIRECTORY_SECTORS     = 0xFFFF;
+
+class cPseudoFileSystem;
+
+class cDirectoryFileSystem : public cFileSystem {
+
+    char                    *m_PathName;
+    bool                     m_IsValid;
+    int                      m_FileCount;
+    cPseudoFileSystem       *m_File [ MAX_FILES ];
+
+protected:
+
+    cDirectoryFileSystem ( const char * );
+    ~cDirectoryFileSystem ();
+
+    void LoadDirectory ();
+
+    int FindFile ( const char * ) const;
+    int FindFile ( const sFileDescriptorRecord * ) const;
+
+    // cFileSystem methods
+    virtual int FileCount () const;
+    virtual const sFileDescriptorRecord * GetFileDescriptor ( int ) const;
+    virtual int FreeSectors() const;
+    virtual int TotalSectors() const;
+    virtual sSector *GetFileSector ( sFileDescriptorRecord *FDR, int index );
+    virtual int ExtendFile ( sFileDescriptorRecord *FDR, int count );
+    virtual void TruncateFile ( sFileDescriptorRecord *FDR, int limit );
+    virtual void DiskModified ();
+    virtual bool Flush ();
+
+public:
+
+    static cDirectoryFileSystem *Open ( const char * );
+
+    // cFileSystem public methods
+    virtual bool GetPath ( char *, size_t ) const;
+    virtual bool GetName ( char *, size_t ) const;
+    virtual bool IsValid () const;
+    virtual bool IsCollection () const;
+    virtual cFile *OpenFile ( const char * );
+    virtual cFile *CreateFile ( const char *, UCHAR, int );
+    virtual bool AddFile ( cFile * );
+    virtual bool DeleteFile ( const char * );
+
+};
+
+#endif
@@ -36,20 +36,37 @@ struct sSector;
 
 class cDiskMedia;
 
-class cDiskFileSystem : public cFileSystem {
+// Size of the filename hash, a power of 2 at least twice MAX_FILES
+const int DIRECTORY_HASH_SIZE   = 256;
+
+struct sDirectoryEntry {
+    int                      Sector;        // 0 marks an empty hash slot
+    sFileDescriptorRecord   *FDR;
+};
 
-    static cDiskFileSystem *sm_SortDisk;
+class cDiskFileSystem : public cFileSystem {
 
     cDiskMedia    *m_Media;
     VIB           *m_VIB;
 
+    // The file descriptor index (sector 1) in catalog order and a hash of the
+    //   same entries by name - both are kept up to date as files come and go
+    sDirectoryEntry          m_Directory [ MAX_FILES ];
+    int                      m_FileCount;
+    int                      m_FirstEntry;  // 1 if the files are hidden from the TI
+    bool                     m_Sorted;
+    sDirectoryEntry          m_Hash [ DIRECTORY_HASH_SIZE ];
+
 protected:
 
     cDiskFileSystem ( const char * );
     ~cDiskFileSystem ();
 
     int FindFreeSector ( int start = 0 ) const;
+    int FindUsedSector ( int start ) const;
+    int FindFreeRun ( int start, int limit, int count, bool bestFit, int *length ) const;
     void SetSectorAllocation ( int index, bool bUsed );
+    void SetSectorRange ( int index, int count, bool bUsed );
 
     int FindLastSector ( sFileDescriptorRecord *FDR ) const;
     bool AddFileSector ( sFileDescriptorRecord *FDR, int );
@@ -57,7 +74,13 @@ protected:
     const sSector *FindSector ( int index ) const;
     sSector *FindSector ( int index );
 
-    int FindFileDescriptorIndex ( const char *name );
+    static int HashName ( const char *name );
+
+    void LoadDirectory ();
+    void HashDirectory ();
+    void WriteDirectory ();
+
+    int FindFileDescriptorIndex ( const char *name ) const;
 
     static int sortDirectoryIndex ( const void *ptr1, const void *ptr2 );
 
@@ -76,6 +99,7 @@ protected:
     virtual int ExtendFile ( sFileDescriptorRecord *FDR, int count );
     virtual void TruncateFile ( sFileDescriptorRecord *FDR, int limit );
     virtual void DiskModified ();
+    virtual bool Flush ();
 
 public:
 
@@ -0,0 +1,60 @@
+//----------------------------------------------------------------------------
+//
+// File:        diskio-sdl.hpp
+// Date:        19-Oct-2026
+//
+// Description: SDL class that writes disk image changes on its own thread
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#ifndef DISKIO_SDL_HPP_
+#define DISKIO_SDL_HPP_
+
+#if ! defined ( DISKIO_HPP_ )
+    #error You must include diskio.hpp before diskio-sdl.hpp
+#endif
+
+class cSdlDiskWriter : public cDiskWriter {
+
+    // Batches wait in m_Head..m_Tail for the writer thread, which lets them
+    //   pile up for a moment so a whole DSR operation goes in one commit
+    SDL_mutex          *m_Mutex;
+    SDL_cond           *m_IdleCond;
+    SDL_sem            *m_WorkSem;
+    SDL_sem            *m_FlushSem;
+    SDL_Thread         *m_Thread;
+    volatile bool       m_Quit;
+    bool                m_Busy;
+    sDiskBatch         *m_Head;
+    sDiskBatch         *m_Tail;
+
+    static int _WriterThreadProc ( void * );
+    int WriterThreadProc ();
+
+public:
+
+    cSdlDiskWriter ();
+    ~cSdlDiskWriter ();
+
+    virtual void Submit ( sDiskBatch * );
+    virtual void Sync ();
+
+};
+
+#endif
@@ -190,6 +190,61 @@ struct sTrack {
     UCHAR         *Data;
 };
 
+// Where a track that has not been decoded yet lies in the image file
+struct sTrackImage {
+    bool           Pending;
+    ULONG          Offset;
+    int            Size;
+};
+
+// A run of bytes to be written at a given offset of an image file
+struct sDiskWrite {
+    ULONG          Offset;
+    int            Size;
+    UCHAR         *Data;
+};
+
+// The writes that bring an image file up to date, applied all or nothing
+struct sDiskBatch {
+    char          *FileName;
+    int            Count;
+    sDiskWrite    *Write;
+    sDiskBatch    *Next;
+};
+
+//----------------------------------------------------------------------------
+//
+// Writes batches into the image files through a journal (<image>.jnl) that
+// is committed before the image is touched, so an interrupted write can be
+// replayed the next time the image is loaded.  The base class writes on the
+// calling thread, derived classes may queue the batches to another thread.
+//
+//----------------------------------------------------------------------------
+
+class cDiskWriter {
+
+    static char *JournalName ( const char * );
+    static bool WriteJournal ( const char *, const sDiskBatch * );
+    static bool ApplyWrites ( const char *, const sDiskBatch * );
+
+public:
+
+    cDiskWriter ();
+    virtual ~cDiskWriter ();
+
+    // Takes ownership of the batch
+    virtual void Submit ( sDiskBatch * );
+    // Returns once everything submitted so far is in the image files
+    virtual void Sync ();
+
+    static sDiskBatch *CreateBatch ( const char *, int );
+    static void FreeBatch ( sDiskBatch * );
+
+    static bool WriteBatches ( sDiskBatch * );
+    static bool Recover ( const char * );
+    static void Discard ( const char * );
+};
+
 class cDiskMedia : public cBaseObject {
 
     bool           m_HasChanged;
@@ -203,6 +258,27 @@ class cDiskMedia : public cBaseObject {
     UCHAR         *m_RawData;
     sTrack         m_Track [ 2 ][ MAX_TRACKS ];
 
+    // The image file stays in memory and each track is decoded the first
+    //   time it is used
+    UCHAR         *m_ImageData;
+    ULONG          m_ImageSize;
+    int            m_ImageSectors;          // Raw sector images only
+    eDiskDensity   m_ImageDensity;          // Raw sector images only
+    sTrackImage    m_Image [ 2 ][ MAX_TRACKS ];
+
+    // Sectors changed since the last write back, a bit per entry of
+    //   sTrack::Sector.  m_Rewrite is set by changes that can't be located
+    //   and calls for a full save
+    ULONG          m_Dirty [ 2 ][ MAX_TRACKS ];
+    bool           m_Rewrite;
+
+    // Layout of the raw sector image file on disk, 0 sectors when unknown
+    int            m_FileSectors;
+    int            m_FileTracks;
+    int            m_FileSides;
+
+    static cDiskWriter *sm_Writer;
+
     static eDiskFormat DetermineFormat ( FILE * );
     static UCHAR *FindAddressMark ( UCHAR, UCHAR, eDiskDensity, UCHAR *, UCHAR * );
     static UCHAR *FindEndOfTrack ( eDiskDensity, UCHAR, int, UCHAR *, UCHAR * );
@@ -212,13 +288,22 @@ class cDiskMedia : public cBaseObject {
     void FormatTrack ( int, int, eDiskDensity, int, sSector * );
     void FormatDisk ( int, int, eDiskDensity );
 
-    bool ReadDiskRawTrack ( FILE * );
-    bool ReadDiskRawSector ( FILE * );
+    bool ReadImage ( FILE * );
+    void ReleaseImage ();
+    void DecodeTrack ( int, int );
+    void DecodeAll ();
+
+    bool ReadDiskRawTrack ();
+    bool ReadDiskRawSector ();
     bool ReadDiskAnadisk ( FILE * );
 
     bool LoadFile ();
 
     bool IsValidRawSector ();
+    bool IsRegularTrack ( int, int, int );
+    void SetFileLayout ();
+    bool CanWriteInPlace ();
+    bool WriteInPlace ();
 
     bool SaveDiskRawTrack ( FILE * );
     bool SaveDiskRawSector ( FILE * );
@@ -233,7 +318,7 @@ public:
     cDiskMedia ( const char * );
     cDiskMedia ( int = MAX_TRACKS, int = 2 );
 
-    void DiskModified ()            { m_HasChanged = true; }
+    void DiskModified ()            { m_HasChanged = m_Rewrite = true; }
     bool HasChanged () const        { return m_HasChanged; }
     bool IsWriteProtected () const  { return m_IsWriteProtected; }
 
@@ -249,6 +334,10 @@ public:
 
     bool LoadFile ( const char * );
     bool SaveFile ( eDiskFormat = FORMAT_UNKNOWN, bool = false );
+    bool WriteBack ( bool = true );
+
+    static void SetWriter ( cDiskWriter * );
+    static cDiskWriter *GetWriter ();
 
     sTrack  *GetTrack ( int, int );
     sSector *GetSector ( int, int, int, int = -1 );
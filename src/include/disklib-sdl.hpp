@@ -0,0 +1,56 @@
+//----------------------------------------------------------------------------
+//
+// File:        disklib-sdl.hpp
+// Date:        19-Oct-2026
+//
+// Description: SDL class that scans disk images on several threads
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#ifndef DISKLIB_SDL_HPP_
+#define DISKLIB_SDL_HPP_
+
+#if ! defined ( DISKLIB_HPP_ )
+    #error You must include disklib.hpp before disklib-sdl.hpp
+#endif
+
+#define MAX_SCAN_THREADS        16
+
+class cSdlDiskScanner : public cDiskScanner {
+
+    // The threads take the next job from the list until there are none left
+    SDL_mutex          *m_Mutex;
+    int                 m_Threads;
+    sLibraryJob        *m_Job;
+    int                 m_JobCount;
+    int                 m_NextJob;
+
+    static int _ScanThreadProc ( void * );
+    int ScanThreadProc ();
+
+public:
+
+    cSdlDiskScanner ( int );
+    ~cSdlDiskScanner ();
+
+    virtual void Scan ( sLibraryJob *, int );
+
+};
+
+#endif
@@ -0,0 +1,135 @@
+//----------------------------------------------------------------------------
+//
+// File:        disklib.hpp
+// Date:        19-Oct-2026
+//
+// Description: An index of the disk images found under a directory tree
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#ifndef DISKLIB_HPP_
+#define DISKLIB_HPP_
+
+#if ! defined ( FS_HPP_ )
+    #error You must include fs.hpp before disklib.hpp
+#endif
+
+// The index is kept in the root of the tree it describes
+#define LIBRARY_FILENAME        "disklib.idx"
+#define LIBRARY_MAGIC           "TIDL"
+#define LIBRARY_VERSION         1
+
+// The index file is the header followed by the disk records, the file records
+//   and the path names.  It is written in the native byte order so it can be
+//   mapped and used as is - an index from another machine is simply rebuilt.
+
+struct sLibraryHeader {
+    char           Magic [ 4 ];
+    USHORT         Version;
+    USHORT         ByteOrder;               // 0x1234 in native order
+    USHORT         DiskSize;                // sizeof ( sLibraryDisk )
+    USHORT         FileSize;                // sizeof ( sLibraryFile )
+    ULONG          DiskCount;
+    ULONG          FileCount;
+    ULONG          StringSize;
+};
+
+struct sLibraryDisk {
+    ULONG          PathOffset;              // Path relative to the root
+    ULONG          ModTime;                 // Used to tell if the image has
+    ULONG          ImageSize;               //   changed since it was scanned
+    ULONG          FirstFile;
+    USHORT         FileCount;
+    USHORT         TotalSectors;
+    USHORT         FreeSectors;
+    bool           IsValid;                 // false if it isn't a TI disk
+    char           VolumeName [ MAX_FILENAME ];
+};
+
+struct sLibraryFile {
+    char           FileName [ MAX_FILENAME ];
+    UCHAR          FileStatus;
+    UCHAR          RecordLength;
+    USHORT         TotalSectors;
+    ULONG          Disk;
+};
+
+// A disk that has to be (re)scanned
+struct sLibraryJob {
+    char          *PathName;
+    sLibraryDisk   Disk;
+    sLibraryFile   File [ MAX_FILES ];
+};
+
+class cDiskScanner {
+
+public:
+
+    cDiskScanner ();
+    virtual ~cDiskScanner ();
+
+    // Scan all the jobs before returning - this one does them one at a time
+    virtual void Scan ( sLibraryJob *, int );
+
+    static void ScanDisk ( sLibraryJob * );
+
+};
+
+class cDiskLibrary {
+
+    char                    *m_RootPath;
+    char                    *m_IndexName;
+
+    // The current index, mapped or read into memory
+    UCHAR                   *m_Data;
+    ULONG                    m_Size;
+    bool                     m_Mapped;
+
+    const sLibraryHeader    *m_Header;
+    const sLibraryDisk      *m_Disk;
+    const sLibraryFile      *m_File;
+    const char              *m_String;
+
+    bool MapIndex ( FILE * );
+    void ReleaseIndex ();
+
+    bool WriteIndex ( int, const sLibraryDisk *, int, const sLibraryFile *, int, const char * ) const;
+
+public:
+
+    cDiskLibrary ( const char * );
+    ~cDiskLibrary ();
+
+    bool Load ();
+    int  Update ( cDiskScanner * = NULL );
+
+    const char *GetRootPath () const        { return m_RootPath; }
+
+    int DiskCount () const;
+    int FileCount () const;
+    const sLibraryDisk *GetDisk ( int ) const;
+    const sLibraryFile *GetFile ( int ) const;
+    const char *GetPath ( const sLibraryDisk * ) const;
+
+    int FindDisk ( const char * ) const;
+    int FindFile ( const char *, int = 0 ) const;
+
+};
+
+#endif
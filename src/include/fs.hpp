@@ -88,6 +88,9 @@ class cFile;
 
 class cFileSystem : public cBaseObject {
 
+    friend class cDsrDiskDevice;
+    friend class cDiskScanner;
+
 private:
 
     // Disable the copy constructor and assignment operator defaults
@@ -123,6 +126,7 @@ public:
     virtual int ExtendFile ( sFileDescriptorRecord *FDR, int count ) = 0;
     virtual void TruncateFile ( sFileDescriptorRecord *FDR, int limit ) = 0;
     virtual void DiskModified () = 0;
+    virtual bool Flush ()                               { return true; }
 
     // Generic file system functions 
     virtual bool GetPath ( char *, size_t ) const = 0;
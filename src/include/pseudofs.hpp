@@ -100,12 +100,16 @@ struct sTIFILES_Header {
 
 class cPseudoFileSystem : public cFileSystem {
 
+    friend class cDirectoryFileSystem;
+
     char                    *m_PathName;
     char                    *m_FileName;
     UCHAR                   *m_FileBuffer;
     FILE                    *m_File;
     sFileDescriptorRecord    m_FDR;
     sSector                 *m_CurrentSector;
+    bool                     m_IsFIAD;
+    bool                     m_Modified;
 
 protected:
 
@@ -117,6 +121,7 @@ protected:
     bool ConstructFDR_FIAD ( char * );
 
     void LoadFileBuffer ();
+    bool SaveFileBuffer ();
 
     // cFileSystem methods
     virtual int FileCount () const;
@@ -127,10 +132,12 @@ protected:
     virtual int ExtendFile ( sFileDescriptorRecord *FDR, int count );
     virtual void TruncateFile ( sFileDescriptorRecord *FDR, int limit );
     virtual void DiskModified ();
+    virtual bool Flush ();
 
 public:
 
     static cPseudoFileSystem *Open ( const char * );
+    static cPseudoFileSystem *Create ( const char *, const char *, UCHAR, int );
 
     // cFileSystem public methods
     virtual bool GetPath ( char *, size_t ) const;
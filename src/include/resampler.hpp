@@ -0,0 +1,68 @@
+//----------------------------------------------------------------------------
+//
+// File:        resampler.hpp
+// Date:        19-Oct-2026
+//
+// Description: Polyphase FIR sample rate converter
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#ifndef RESAMPLER_HPP_
+#define RESAMPLER_HPP_
+
+#define RESAMPLER_TAPS          16          // Taps per phase, must be even
+#define RESAMPLER_MAX_PHASES    512         // Larger ratios use the nearest phase
+
+class cResampler {
+
+    int                 m_InputRate;
+    int                 m_OutputRate;
+
+    // Output rate / input rate reduced to m_Up / m_Down
+    int                 m_Up;
+    int                 m_Down;
+
+    // One row of RESAMPLER_TAPS Q15 coefficients per phase
+    int                 m_Phases;
+    short              *m_Table;
+
+    // The last RESAMPLER_TAPS inputs are stored twice so the window never
+    //   wraps, the next output lies m_Phase/m_Up after the middle of it
+    int                 m_History [ 2 * RESAMPLER_TAPS ];
+    int                 m_Index;
+    int                 m_Phase;
+
+    void BuildTable ();
+
+public:
+
+    cResampler ( int, int );
+    ~cResampler ();
+
+    int  GetInputRate () const		{ return m_InputRate; }
+    int  GetOutputRate () const		{ return m_OutputRate; }
+
+    int  MaxOutput ( int ) const;
+
+    void Reset ();
+    int  Process ( const int *, int, int * );
+
+};
+
+#endif
@@ -67,6 +67,20 @@
 
 #define STATUS_NOT_FOUND	( STATUS_CRC_ERROR | STATUS_LOST_DATA )
 
+// A DSR loop moving bytes between memory and the data register:
+//
+//	LOOP	MOVB @>5FF6,*R2+	; or MOVB *R2+,@>5FFE
+//		DEC  R3
+//		JNE  LOOP
+//
+struct sTransferLoop {
+    ADDRESS        PC;                      // Address of the MOVB
+    int            Mode;                    // Addressing mode of the memory operand
+    int            Register;                // Register of the memory operand
+    ADDRESS        Address;                 // Address of a symbolic memory operand
+    int            Counter;                 // Register counting the bytes
+};
+
 class cDiskDevice : public cDevice {
 
     enum TRAP_TYPE_E {
@@ -114,6 +128,12 @@ class cDiskDevice : public cDevice {
     CMD_STATE_E    m_CmdInProgress;
     UCHAR          m_TrapIndex;
 
+    // Data register loops are done in one go unless timing has to be exact
+    bool           m_StrictTiming;
+    ADDRESS        m_LoopPC;
+    ULONG          m_LoopClocks;
+    int            m_LoopBytes;
+
     static USHORT TrapFunction ( void *, int, bool, const ADDRESS, USHORT );
 
     void FindSector ();
@@ -123,6 +143,11 @@ class cDiskDevice : public cDevice {
     UCHAR ReadByte ();
     void  WriteByte ( UCHAR );
 
+    bool  FindTransferLoop ( bool, sTransferLoop * ) const;
+    int   CountTransfer ( bool, const sTransferLoop &, ULONG * );
+    UCHAR ReadBlock ();
+    void  WriteBlock ();
+
     void Restore ( UCHAR );
     void Seek ( UCHAR );
     void Step ( UCHAR );
@@ -149,6 +174,8 @@ public:
     void LoadDisk ( int, const char * );
     void UnLoadDisk ( int );
 
+    void SetStrictTiming ( bool strict )	{ m_StrictTiming = strict; }
+
     //
     // cDevice methods
     //
@@ -0,0 +1,168 @@
+//----------------------------------------------------------------------------
+//
+// File:        ti-dsr.hpp
+// Date:        19-Oct-2026
+//
+// Description: A disk controller that handles the file level (PAB) requests
+//              itself instead of emulating the FD1771
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#ifndef TIDSR_HPP_
+#define TIDSR_HPP_
+
+#if ! defined ( DEVICE_HPP_ )
+    #error You must include device.hpp before ti-dsr.hpp
+#endif
+
+// Each DSKn entry point reads its own word here, the read is trapped and
+//   the value tells the DSR whether the request was handled
+#define DSR_TRAP_BASE		0x4FF0
+
+#define DSR_MAX_DRIVES		3
+#define DSR_MAX_FILES		16
+
+// PAB opcodes
+#define PAB_OPEN		0x00
+#define PAB_CLOSE		0x01
+#define PAB_READ		0x02
+#define PAB_WRITE		0x03
+#define PAB_RESTORE		0x04
+#define PAB_LOAD		0x05
+#define PAB_SAVE		0x06
+#define PAB_DELETE		0x07
+#define PAB_SCRATCH		0x08
+#define PAB_STATUS		0x09
+
+// PAB flags (byte 1)
+#define PAB_RELATIVE		0x01
+#define PAB_MODE_MASK		0x06
+#define PAB_MODE_UPDATE		0x00
+#define PAB_MODE_OUTPUT		0x02
+#define PAB_MODE_INPUT		0x04
+#define PAB_MODE_APPEND		0x06
+#define PAB_INTERNAL		0x08
+#define PAB_VARIABLE		0x10
+#define PAB_ERROR_MASK		0xE0
+
+// Error codes returned in the top 3 bits of the PAB flags
+#define ERR_NONE		0
+#define ERR_BAD_NAME		0
+#define ERR_WRITE_PROTECTED	1
+#define ERR_BAD_ATTRIBUTE	2
+#define ERR_ILLEGAL_OPERATION	3
+#define ERR_NO_SPACE		4
+#define ERR_END_OF_FILE		5
+#define ERR_DEVICE_ERROR	6
+#define ERR_FILE_ERROR		7
+
+// Bits returned by the STATUS request
+#define STAT_NO_FILE		0x80
+#define STAT_PROTECTED		0x40
+#define STAT_INTERNAL		0x10
+#define STAT_PROGRAM		0x08
+#define STAT_VARIABLE		0x04
+#define STAT_DISK_FULL		0x02
+#define STAT_END_OF_FILE	0x01
+
+class cTMS9918A;
+class cFileSystem;
+class cFile;
+
+struct sOpenFile {
+    ADDRESS        PAB;                     // 0 if the slot is free
+    int            Drive;
+    cFile         *File;                    // NULL for the catalog
+    UCHAR          Status;                  // TI file status flags
+    UCHAR          Mode;
+    int            RecordLength;
+    int            RecordsPerSector;
+    int            Records;                 // Fixed files only
+    int            Sectors;
+    int            EOF_Offset;              // Variable files only
+    int            Position;                // Offset of the next variable record
+    int            Allocated;               // Sectors in Data
+    UCHAR         *Data;
+    bool           Modified;
+};
+
+class cDsrDiskDevice : public cDevice {
+
+    enum TRAP_TYPE_E {
+        TRAP_DSR
+    };
+
+    cTMS9918A     *m_pVDP;
+    cFileSystem   *m_Drive [ DSR_MAX_DRIVES ];
+    sOpenFile      m_File [ DSR_MAX_FILES ];
+    UCHAR          m_TrapIndex;
+
+    static USHORT TrapFunction ( void *, int, bool, const ADDRESS, USHORT );
+
+    void BuildROM ();
+
+    UCHAR *VdpPtr ( ADDRESS ) const;
+    void ReadVDP ( ADDRESS, void *, int ) const;
+    void WriteVDP ( ADDRESS, const void *, int ) const;
+
+    bool HandleRequest ( int );
+
+    sOpenFile *FindFile ( ADDRESS );
+    bool Reserve ( sOpenFile *, int );
+    bool LoadFile ( sOpenFile * );
+    bool SaveFile ( sOpenFile * );
+    void CloseFile ( sOpenFile * );
+
+    int ReadCatalog ( int, int, UCHAR * );
+
+    int Open ( UCHAR *, ADDRESS, int, const char * );
+    int Close ( UCHAR *, ADDRESS );
+    int Read ( UCHAR *, ADDRESS );
+    int Write ( UCHAR *, ADDRESS );
+    int Restore ( UCHAR *, ADDRESS );
+    int Load ( UCHAR *, int, const char * );
+    int Save ( UCHAR *, int, const char * );
+    int Delete ( UCHAR *, int, const char * );
+    int Status ( UCHAR *, ADDRESS, int, const char * );
+
+public:
+
+    cDsrDiskDevice ( cTMS9918A * );
+    ~cDsrDiskDevice ();
+
+    bool LoadDisk ( int, const char * );
+    void UnLoadDisk ( int );
+
+    void CloseAll ();
+
+    //
+    // cDevice methods
+    //
+    void Activate ();
+    void DeActivate ();
+
+    void WriteCRU ( ADDRESS, int );
+    int  ReadCRU ( ADDRESS );
+
+    void SaveImage ( FILE * );
+    void LoadImage ( FILE * );
+
+};
+
+#endif
@@ -40,6 +40,7 @@ class  cTMS9918A;
 class  cTMS9919;
 class  cCartridge;
 class  cDevice;
+class  cVgmRecorder;
 
 struct sMemoryRegion;
 
@@ -89,6 +90,7 @@ protected:
     cTMS9918A          *m_VDP;
     cTMS9919           *m_SoundGenerator;
     cTMS5220           *m_SpeechSynthesizer;
+    cVgmRecorder       *m_Recorder;
 
     ULONG               m_RefreshInterval;
 
@@ -136,6 +138,8 @@ public:
     cTMS9918A *GetVDP ()			{ return m_VDP; }
     cTMS9919  *GetSoundGenerator ()		{ return m_SoundGenerator; }
 
+    void SetRecorder ( cVgmRecorder *recorder )	{ m_Recorder = recorder; }
+
     UCHAR   *GetCpuMemory () const		{ return m_CpuMemory; }
     UCHAR   *GetGromMemory () const		{ return m_GromMemory; }
     UCHAR   *GetVideoMemory () const		{ return m_VideoMemory; }
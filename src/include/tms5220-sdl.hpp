@@ -0,0 +1,59 @@
+//----------------------------------------------------------------------------
+//
+// File:        tms5220-sdl.hpp
+// Date:        27-Nov-2000
+// Programmer:  Marc Rousseau
+//
+// Description: SDL class for the TMS5220 Speech Synthesizer Chip
+//
+// Copyright (c) 2000-2003 Marc Rousseau, All Rights Reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#ifndef TMS5220_SDL_HPP_
+#define TMS5220_SDL_HPP_
+
+#if ! defined ( TMS5220_HPP_ )
+    #error You must include tms5220.hpp before tms5220-sdl.hpp
+#endif
+
+class cSdlTMS5220 : public cTMS5220 {
+
+    // Synthesis runs on its own thread, the CPU thread only decodes frames
+    //   and m_Mutex keeps Reset out of the middle of a frame
+    SDL_mutex          *m_Mutex;
+    SDL_sem            *m_FramesSem;
+    SDL_Thread         *m_Thread;
+    volatile bool       m_Quit;
+
+    static int _SynthesizerThreadProc ( void * );
+    int SynthesizerThreadProc ();
+
+    virtual void FramesQueued ();
+
+public:
+
+    cSdlTMS5220 ( cTMS9919 * );
+    ~cSdlTMS5220 ();
+
+    virtual void Reset ();
+
+};
+
+#endif
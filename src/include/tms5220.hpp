@@ -49,6 +49,13 @@
 #define FIFO_BYTES         16
 #define FIFO_BITS          (FIFO_BYTES * 8)
 
+#define SPEECH_FRAME_QUEUE  8       // Decoded frames waiting for synthesis (power of 2)
+#define SPEECH_FRAME_LEAD   2       // Frames decoded ahead of playback
+
+#define SPEECH_CACHE_PHRASES    64                  // ROM phrases kept pre-rendered
+#define SPEECH_CACHE_BYTES      ( 4 * 1024 * 1024 ) // Memory allowed for their samples
+#define SPEECH_PHRASE_MAX       10                  // Longest phrase recorded (seconds)
+
 const int TMS5220_FRAME_RATE             = 40;      // 40 Hz
 const int TMS5220_FRAME_PERIOD           = 25000;   // 25 ms
 const int TMS5220_INTERPOLATION_RATE     = 320;     // 320 Hz
@@ -64,8 +71,14 @@ const int RC_ORDER               = 10;      // # of Reflection Coefficients
 const int SAMPLE_RATE            = 8000;    // 8 KHz
 const int INTERPOLATION_INTERVAL = 25;      // 3.125 ms
 
+// Fixed point formats used by the synthesizer
+const int COEFF_BITS             = 15;      // Reflection coefficients (Q15)
+const int GAIN_BITS              = 16;      // Excitation gain (Q16)
+const int SAMPLE_BITS            = 12;      // Samples, 1.0 = one 8-bit output step (Q12)
+
 class cTI994A;
 class cTMS9919;
+class cResampler;
 
 class cTMS5220 {
 
@@ -76,8 +89,16 @@ protected:
         int        Pitch;
         bool       Repeat;
         bool       Stop;
-        double     Reflection [ RC_ORDER ];
-        double     Gain;
+        int        Reflection [ RC_ORDER ];
+        int        Gain;
+    };
+
+    // A phrase spoken from the ROM, as the synthesizer rendered it
+    struct sSpeechPhrase {
+        int        Key;             // ( ChipSelect << 14 ) | Address at the Speak command
+        int        Rate;            // Playback frequency the samples are at
+        int        Length;
+        short     *Samples;         // Resampled output >> ( SAMPLE_BITS - 8 )
     };
 
     union sReadState {
@@ -104,13 +125,15 @@ protected:
 
     // 16-byte/128-bit parallel-serial FIFO
     UCHAR          m_FIFO [ FIFO_BYTES ];
-    volatile int   m_GetIndex;
-    volatile int   m_PutIndex;
-    volatile int   m_BitsLeft;
+    int            m_GetIndex;
+    int            m_PutIndex;
+    int            m_BitsLeft;
 
     // State variables
     bool           m_ReadByte;
     bool           m_SpeakExternal;
+    bool           m_ReadUnderrun;
+    bool           m_Stopping;
 
     // Hardware registers
     bool           m_BufferLow;
@@ -119,6 +142,15 @@ protected:
     UCHAR          m_Data;
     UCHAR          m_Command;
 
+    // Frames are decoded on the CPU thread at the rate the chip would read
+    //   them and handed to the synthesizer through a single producer/single
+    //   consumer queue, m_DecodeAhead is the decoded time not played yet in
+    //   1/TMS5220_FRAME_RATE of a playback sample
+    sSpeechParams  m_FrameQueue [ SPEECH_FRAME_QUEUE ];
+    volatile int   m_FrameHead;
+    volatile int   m_FrameTail;
+    int            m_DecodeAhead;
+
     // Current/Target parameters & interpolation information
     sSpeechParams  m_StartParams;
     sSpeechParams  m_TargetParams;
@@ -129,16 +161,38 @@ protected:
 
     // 8 KHz speech buffer
     int            m_PitchIndex;
-    double         m_NonVoicedLevel;
-    double         m_FilterHistory [ 2 ][ RC_ORDER + 1 ];
-    double         m_RawDataBuffer [ INTERPOLATION_INTERVAL ];
-
-    // Resampled synthesized speech buffer
+    int            m_NonVoicedLevel;
+    ULONG          m_NoiseSeed;
+    int            m_FilterHistory [ 2 ][ RC_ORDER + 1 ];
+    int            m_DeempInput [ 3 ];
+    int            m_DeempOutput [ 4 ];
+    int            m_RawDataBuffer [ INTERPOLATION_INTERVAL ];
+
+    // Resampled synthesized speech, the synthesizer only moves m_RingHead
+    //   and AudioCallback only m_RingTail
     int            m_PlaybackFrequency;
     int            m_PlaybackInterval;
-    double        *m_PlaybackBuffer;
-    int            m_PlaybackSamplesLeft;
-    double        *m_PlaybackDataPtr;
+    int           *m_PlaybackBuffer;
+    cResampler    *m_Resampler;
+    int           *m_Ring;
+    int            m_RingSize;              // Must be a power of 2
+    volatile int   m_RingHead;
+    volatile int   m_RingTail;
+
+    // Phrase cache - the synthesizer records the phrases spoken from the ROM
+    //   and publishes them through m_PhraseCount, the CPU thread looks them
+    //   up on Speak and the synthesizer copies m_PlayPhrase instead of
+    //   running the filter
+    sSpeechPhrase  m_Phrases [ SPEECH_CACHE_PHRASES ];
+    volatile int   m_PhraseCount;
+    int            m_CacheBytes;
+    const sSpeechPhrase *m_PlayPhrase;
+    int            m_PlayOffset;
+    int            m_PlayFrames;
+    int            m_RecordKey;
+    short         *m_Record;
+    int            m_RecordLength;
+    int            m_RecordSize;
 
     void LoadAddress ( UCHAR data );
 
@@ -151,9 +205,28 @@ protected:
 
     void StoreDataFIFO ( UCHAR data );
 
-    bool CreateNextBuffer ();
-    bool ConvertBuffer ();
-    bool GetNextBuffer ();
+    void Deemphasize ( int *, int );
+
+    void CreateNextBuffer ();
+    void ConvertBuffer ();
+    void SynthesizeFrame ( const sSpeechParams & );
+    void PushSamples ( const int *, int );
+    int  RingFill () const;
+
+    const sSpeechPhrase *FindPhrase ( int ) const;
+    void StartPhrase ();
+    void PlayPhrase ( const sSpeechParams & );
+    void RecordSamples ( const int *, int );
+    void StorePhrase ();
+
+    bool DecodeFrame ();
+    void DecodeFrames ( int );
+    void ResetSynthesizer ();
+
+    // Called on the CPU thread once frames have been queued, the default
+    //   synthesizes them right away
+    virtual void FramesQueued ();
+    void SynthesizeFrames ();
 
     static char *FormatParameters ( const sSpeechParams &, bool );
     static void InterpolateParameters ( int, const sSpeechParams &, const sSpeechParams &, sSpeechParams * );
@@ -167,10 +240,12 @@ public:
 
     void SetComputer ( cTI994A * );
 
-    virtual bool AudioCallback ( UCHAR *, int );
+    virtual bool AudioCallback ( int *, int );
 
     virtual void Reset ();
 
+    bool IsReadingByte () const		{ return m_ReadByte; }
+
     UCHAR WriteData ( UCHAR );
     UCHAR ReadData ( UCHAR );
 
@@ -111,6 +111,12 @@ public:
     ULONG GetCounter ();
     void  ResetCounter ();
 
+    // Memory & register access on behalf of devices - no clocks are counted
+    USHORT GetRegister ( int );
+    void   SetRegister ( int, USHORT );
+    UCHAR  ReadMemory ( ADDRESS );
+    void   WriteMemory ( ADDRESS, UCHAR );
+
     void SaveImage ( FILE * );
     void LoadImage ( FILE * );
 
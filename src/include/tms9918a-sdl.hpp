@@ -40,6 +40,40 @@ class cBitMap;
 typedef SDL_Color  sRGBQUAD;
 typedef SDL_mutex *MUTEX;
 
+// Everything the renderer looks at while drawing a frame.  When rendering
+// synchronously the pointers refer to the live VDP state, when the render
+// thread is used they refer to the copy taken at vertical retrace.
+struct sVDPFrame {
+    UCHAR              *Memory;
+    sScreenImage       *ImageTable;
+    sColorTable        *ColorTable;
+    sPatternDescriptor *PatternTable;
+    sSpriteAttribute   *SpriteAttrTable;
+    sSpriteDescriptor  *SpriteDescTable;
+    int                 ImageTableSize;
+    UCHAR               Register [8];
+    UCHAR               Mode;
+    bool                TextMode;
+    UCHAR               MaxSprite [256];
+    sRGBQUAD            SDLColorTable [17];
+    bool               *ScreenChanged;
+    bool               *PatternChanged;
+    int                *CharUse;
+    bool                ChangesMade;
+    bool                BlankChanged;
+    bool                ColorsChanged;
+    bool                SpritesChanged;
+    bool                PaletteChanged;         // 8-bit surfaces need SDLColorTable
+};
+
+// Private copy of the VRAM and dirty sets owned by the render thread
+struct sVDPSnapshot {
+    UCHAR               Memory [0x4000];
+    bool                ScreenChanged [ 0x03C0 ];
+    bool                PatternChanged [ 256 * 3 ];
+    int                 CharUse [ 256 * 3 ];
+};
+
 class cSdlTMS9918A : public cTMS9918A {
 
     sRGBQUAD      m_RawColorTable [17];
@@ -51,6 +85,7 @@ class cSdlTMS9918A : public cTMS9918A {
     bool          m_BlankChanged;
     bool          m_ColorsChanged;
     bool          m_SpritesChanged;
+    bool          m_PaletteChanged;
     bool          m_NeedsUpdate;
 
     bool          m_ScreenChanged [ 0x03C0 ];
@@ -59,6 +94,13 @@ class cSdlTMS9918A : public cTMS9918A {
     int           m_CharUse        [ 256 * 3 ];
     int           m_SpriteCharUse  [ 256 ];
 
+    short         m_DirtyLeft   [ VDP_HEIGHT ];
+    short         m_DirtyRight  [ VDP_HEIGHT ];
+    short         m_SpriteLeft  [ VDP_HEIGHT ];
+    short         m_SpriteRight [ VDP_HEIGHT ];
+    int           m_DirtyLines;
+    bool          m_LastTextMode;
+
     bool          m_Scale2x;
     cBitMap      *m_Screen;
     cBitMap      *m_BitmapScreen;
@@ -68,6 +110,15 @@ class cSdlTMS9918A : public cTMS9918A {
 
     SDL_mutex    *m_Mutex;
 
+    sVDPFrame     m_Frame;
+    sVDPSnapshot *m_Snapshot;
+    bool          m_Threaded;
+    volatile bool m_RenderQuit;
+    SDL_Thread   *m_RenderThread;
+    SDL_sem      *m_FrameReadySem;
+    SDL_sem      *m_RenderIdleSem;
+    int           m_FramesDropped;
+
     bool          m_FullScreen;
 
     int           m_OnFrames;
@@ -79,6 +130,7 @@ class cSdlTMS9918A : public cTMS9918A {
     cBitMap *CreateBitMap ( int, int );
 
     void ConvertColors ();
+    void ApplyPalette ();
 
     void DrawSprite ( int );
     void UpdateSprites ();
@@ -90,12 +142,14 @@ class cSdlTMS9918A : public cTMS9918A {
     void UpdateScreenText ( int x, int y, int ch );
     void UpdateScreenMultiColor ( int x, int y, int ch );
 
-    int ScreenSize ()		{ return m_TextMode ? 24 * 40 : 24 * 32; }
-    int GetCellWidth ()		{ return m_TextMode ? 6 : 8; }
-    int GetScreenWidth ()	{ return m_TextMode ? 40 : 32; }
+    int ScreenSize ()		{ return m_Frame.TextMode ? 24 * 40 : 24 * 32; }
+    int GetCellWidth ()		{ return m_Frame.TextMode ? 6 : 8; }
+    int GetScreenWidth ()	{ return m_Frame.TextMode ? 40 : 32; }
     int GetScreenHeight ()	{ return 24; }
 
     void MarkScreenChanges ( int );
+    void MarkDirty ( int, int, int, int );
+    void MarkSpriteExtents ();
 
     bool RefreshGraphics ();
     bool RefreshBitMap ();
@@ -104,6 +158,14 @@ class cSdlTMS9918A : public cTMS9918A {
     void BlankScreen ( bool );
     void UpdateScreen ();
 
+    bool StartRenderThread ();
+    void StopRenderThread ();
+    void PublishFrame ( bool );
+    bool RenderFrame ();
+
+    static int _RenderThreadProc ( void * );
+    int RenderThreadProc ();
+
     // cTMS9918A protected methods
     virtual bool SetMode ( int );
     virtual void Refresh ( bool );
@@ -122,6 +184,9 @@ public:
 
     cBitMap *GetScreen ();
 
+    void WaitForRender ();
+    int  GetFramesDropped ()		{ return m_FramesDropped; }
+
     // cTMS9918A public methods
     virtual void Reset ();
     virtual void WriteData ( UCHAR );
@@ -33,42 +33,121 @@
     #error You must include tms9919.hpp before tms9919-sdl.hpp
 #endif
 
+#define SOUND_QUEUE_SIZE	1024		// Must be a power of 2
+
 class cSdlTMS9919 : public cTMS9919 {
 
+    // Times are in 1/65536th of a sample from the start of the buffer
+    //   being generated
     struct sVoiceInfo {
-        float  period;
-        float  toggle;
-        int    setting;
+        int    period;          // time between two edges, 0 when silent
+        int    phase;           // time of the next edge
+        int    sign;            // +1 / -1
+        int    level;           // what the voice adds to the output now
+    };
+
+    enum SOUND_EVENT_E {
+        EVENT_FREQUENCY,
+        EVENT_ATTENUATION,
+        EVENT_NOISE
+    };
+
+    // A sound register write, stamped with the CPU clock it happened at
+    struct sSoundEvent {
+        ULONG  clock;
+        UCHAR  type;
+        UCHAR  tone;
+        int    value;
     };
 
     int                 m_VolumeTable [16];
 
     bool                m_Initialized;
+    bool                m_Offline;              // No device, see ReadSamples
     int                 m_MasterVolume;
 
     SDL_AudioSpec       m_AudioSpec;
     sVoiceInfo          m_Info [4];
     int                 m_ShiftRegister;
     int                 m_NoiseGenerator;
-    Uint8              *m_MixBuffer;
+    int                *m_Delta;
+    int                 m_Integrator;
+    bool                m_Muted;
+
+    // Register writes wait here, stamped with their CPU clock, until the
+    //   next Flush renders the samples they fall in
+    sSoundEvent         m_Queue [ SOUND_QUEUE_SIZE ];
+    int                 m_QueueHead;
+    int                 m_QueueTail;
+    int                 m_EventsDropped;
+
+    // Rendering copy of the registers and position of the next sample on
+    //   the CPU clock, in 1/2^32th of a sample
+    int                 m_AudioFrequency [4];
+    int                 m_AudioAttenuation [4];
+    NOISE_COLOR_E       m_AudioNoiseColor;
+    int                 m_AudioNoiseType;
+    ULONG               m_AudioClock;
+    ULONG               m_AudioFraction;
+    int                 m_DeltaSize;
+
+    // Rendered samples travel from the CPU thread to the audio thread
+    //   through a single producer/single consumer ring, the CPU thread
+    //   only moves m_RingHead and the audio thread only m_RingTail
+    Sint16             *m_Ring;
+    int                 m_RingSize;             // Must be a power of 2
+    volatile int        m_RingHead;
+    volatile int        m_RingTail;
+    Sint16             *m_OutBuffer;
+    Sint16              m_LastSample;
+    bool                m_Priming;
+    int                 m_Underruns;
+    int                 m_Overruns;
+
+    // Resampling ratio correction in 1/65536th, keeps the ring around the
+    //   target latency
+    int                 m_TargetFill;
+    int                 m_RateAdjust;
 
     static void _AudioCallback ( void *, Uint8 *, int );
     void AudioCallback ( Uint8 *, int );
 
+    void PostEvent ( SOUND_EVENT_E, int, int );
+    void ApplyEvent ( const sSoundEvent *, int );
+    void ApplyNoise ( NOISE_COLOR_E, int, int );
+    void ApplyFrequency ( int, int, int );
+    void ApplyAttenuation ( int, int, int );
+    void SetPeriod ( sVoiceInfo *, int, int );
+    void UpdateNoisePeriod ( int );
+    void AdjustRate ();
+    void Resync ();
+    void RenderSamples ( int );
+    void PushSamples ( const int *, int );
+    int  RingFill () const;
+
+    void AddStep ( int, int );
+    void SetLevel ( sVoiceInfo *, int, int );
+    void RunVoices ( int );
+    void ResetDelta ();
+
     virtual void SetNoise ( NOISE_COLOR_E, int );
     virtual void SetFrequency ( int, int );
     virtual void SetAttenuation ( int, int );
 
 public:
 
-    cSdlTMS9919 ( int = 44100 );
+    cSdlTMS9919 ( int = 44100, bool = true );
     ~cSdlTMS9919 ();
 
     virtual int SetSpeechSynthesizer ( cTMS5220 * );
+    virtual void Flush ();
 
+    int  GetUnderruns () const			{ return m_Underruns; }
     int  GetMasterVolume () const		{ return m_MasterVolume; }
     void SetMasterVolume ( int );
 
+    int  ReadSamples ( Sint16 *, int );
+
 };
 
 #endif
@@ -59,6 +59,7 @@ public:
     virtual ~cTMS9919 ();
 
     virtual int SetSpeechSynthesizer ( cTMS5220 * );
+    virtual void Flush ();
 
     void WriteData ( UCHAR data );
 
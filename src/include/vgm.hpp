@@ -0,0 +1,78 @@
+//----------------------------------------------------------------------------
+//
+// File:        vgm.hpp
+// Date:        19-Oct-2026
+//
+// Description: VGM log of the sound and speech chip writes
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#ifndef VGM_HPP_
+#define VGM_HPP_
+
+// VGM 1.50 : a 0x40 byte header followed by chip writes and waits counted
+//   in 44.1 KHz samples
+#define VGM_SAMPLE_RATE         44100
+#define VGM_VERSION             0x00000150
+#define VGM_HEADER_SIZE         0x40
+
+#define VGM_CMD_PSG             0x50        // dd : SN76489/TMS9919 write
+#define VGM_CMD_WAIT            0x61        // nnnn : wait n samples
+#define VGM_CMD_WAIT_NTSC       0x62        // wait 735 samples
+#define VGM_CMD_WAIT_PAL        0x63        // wait 882 samples
+#define VGM_CMD_END             0x66
+#define VGM_CMD_WAIT_SHORT      0x70        // 0x7n : wait n+1 samples
+
+// There is no TMS5220 in the VGM spec, these sit in the reserved single
+//   operand range that players skip
+#define VGM_CMD_SPEECH_WRITE    0x32        // dd : TMS5220 write
+#define VGM_CMD_SPEECH_READ     0x33        // 00 : TMS5220 Read-Byte read
+
+#define VGM_PSG_CLOCK           3579545
+#define VGM_PSG_FEEDBACK        0x0003
+#define VGM_PSG_SHIFT_WIDTH     15
+
+class cVgmRecorder {
+
+    FILE               *m_File;
+    ULONG               m_LastClock;
+    unsigned long long  m_Cycles;           // CPU cycles since Open
+    ULONG               m_Samples;          // Samples waited so far
+    int                 m_CpuFrequency;
+
+    void Wait ( ULONG );
+    void Command ( UCHAR, UCHAR );
+
+public:
+
+    cVgmRecorder ();
+    ~cVgmRecorder ();
+
+    bool Open ( const char *, ULONG, int = 3000000 );
+    void Close ();
+
+    bool IsOpen () const			{ return ( m_File != NULL ) ? true : false; }
+
+    void WritePSG ( ULONG, UCHAR );
+    void WriteSpeech ( ULONG, UCHAR );
+    void ReadSpeech ( ULONG );
+
+};
+
+#endif
@@ -1,9 +1,11 @@
 #include <stdio.h>
 #include <zlib.h>
 #include "global.h"
+#include "psp_scaler.h"
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #define STDOUT_FILE  "stdout.txt"
 #define STDERR_FILE  "stderr.txt"
@@ -73,6 +75,11 @@ main(int argc, char *argv[])
   gp2xInsmodMMUhack();
 #endif
 
+  if ((argc > 1) && !strcmp(argv[1], "--bench-scalers")) {
+    ti99_scaler_benchmark(stdout);
+    return 0;
+  }
+
   SDL_main(argc,argv);
 
   return 0;
@@ -41,6 +41,8 @@
 #include "psp_menu_cheat.h"
 #include "psp_menu_help.h"
 #include "psp_editor.h"
+#include "psp_ti99.h"
+#include "psp_pacer.h"
 
 extern SDL_Surface *back_surface;
 
@@ -450,6 +452,7 @@ psp_main_menu(void)
   ti99_audio_pause();
  
   ti99_in_menu = 1;
+  ti99_video_flush();
 
   psp_kbd_wait_no_button();
 
@@ -589,6 +592,8 @@ psp_main_menu(void)
   psp_sdl_flip();
 
   psp_sdl_clear_blit(0);
+  ti99_dirty_all();
+  ti99_pacer_reset();
 
   ti99_audio_resume();
 
@@ -37,32 +37,45 @@
 #include "psp_fmgr.h"
 #include "psp_menu_kbd.h"
 #include "psp_menu_set.h"
+#include "psp_scaler.h"
+#include "psp_pacer.h"
+#include "psp_ti99.h"
 
 extern SDL_Surface *back_surface;
 
 # define MENU_SET_SOUND         0
-# define MENU_SET_VIEW_FPS      1
-# define MENU_SET_SPEED_LIMIT   2
-# define MENU_SET_SKIP_FPS      3
-# define MENU_SET_RENDER        4
-# define MENU_SET_DANZEFF       5
-# define MENU_SET_VSYNC         6
-# define MENU_SET_CLOCK         7
-
-# define MENU_SET_LOAD          8
-# define MENU_SET_SAVE          9
-# define MENU_SET_RESET        10
-# define MENU_SET_BACK         11
+# define MENU_SET_LATENCY       1
+# define MENU_SET_RECORD        2
+# define MENU_SET_VIEW_FPS      3
+# define MENU_SET_SPEED_LIMIT   4
+# define MENU_SET_PACING        5
+# define MENU_SET_SKIP_FPS      6
+# define MENU_SET_RENDER        7
+# define MENU_SET_THREAD        8
+# define MENU_SET_SCALER_THREAD 9
+# define MENU_SET_DANZEFF      10
+# define MENU_SET_VSYNC        11
+# define MENU_SET_CLOCK        12
+
+# define MENU_SET_LOAD         13
+# define MENU_SET_SAVE         14
+# define MENU_SET_RESET        15
+# define MENU_SET_BACK         16
 
 # define MAX_MENU_SET_ITEM (MENU_SET_BACK + 1)
 
   static menu_item_t menu_list[] =
   {
     { "Sound enable       :"},
+    { "Sound latency      :"},
+    { "Record sound (VGM) :"},
     { "Display fps        :"},
     { "Speed limiter      :"},
+    { "Frame pacing       :"},
     { "Skip frame         :"},
     { "Render mode        :"},
+    { "Render thread      :"},
+    { "Scaler threads     :"},
     { "Virtual keyboard   :"},
     { "Vsync              :"},
     { "Clock frequency    :"},
@@ -75,9 +88,14 @@ extern SDL_Surface *back_surface;
   static int cur_menu_id = MENU_SET_LOAD;
 
   static int ti99_snd_enable       = 0;
+  static int ti99_snd_latency      = 60;
+  static int ti99_snd_record       = 0;
   static int ti99_view_fps         = 0;
   static int ti99_speed_limiter    = 50;
+  static int ti99_pacing           = 0;
   static int ti99_render_mode      = 0;
+  static int ti99_render_thread    = 0;
+  static int ti99_scaler_threads   = 1;
   static int danzeff_trans        = 0;
   static int ti99_vsync          = 0;
   static int psp_cpu_clock         = 266;
@@ -112,6 +130,17 @@ psp_display_screen_settings_menu(void)
       string_fill_with_space(buffer, 4);
       psp_sdl_back2_print(140, y, buffer, color);
     } else
+    if (menu_id == MENU_SET_LATENCY) {
+      sprintf(buffer,"%d ms", ti99_snd_latency);
+      string_fill_with_space(buffer, 7);
+      psp_sdl_back2_print(140, y, buffer, color);
+    } else
+    if (menu_id == MENU_SET_RECORD) {
+      if (ti99_snd_record) strcpy(buffer,"yes");
+      else                 strcpy(buffer,"no ");
+      string_fill_with_space(buffer, 4);
+      psp_sdl_back2_print(140, y, buffer, color);
+    } else
     if (menu_id == MENU_SET_VIEW_FPS) {
       if (ti99_view_fps) strcpy(buffer,"yes");
       else                strcpy(buffer,"no ");
@@ -119,7 +148,8 @@ psp_display_screen_settings_menu(void)
       psp_sdl_back2_print(140, y, buffer, color);
     } else
     if (menu_id == MENU_SET_SKIP_FPS) {
-      sprintf(buffer,"%d", ti99_skip_fps);
+      if (ti99_skip_fps == TI99_SKIP_AUTO) strcpy(buffer,"auto");
+      else sprintf(buffer,"%d", ti99_skip_fps);
       string_fill_with_space(buffer, 4);
       psp_sdl_back2_print(140, y, buffer, color);
     } else
@@ -129,6 +159,13 @@ psp_display_screen_settings_menu(void)
       string_fill_with_space(buffer, 7);
       psp_sdl_back2_print(140, y, buffer, color);
     } else
+    if (menu_id == MENU_SET_PACING) {
+      if (ti99_pacing == TI99_PACING_DRIVEN)     strcpy(buffer,"driven");
+      else if (ti99_pacing == TI99_PACING_AUDIO) strcpy(buffer,"audio");
+      else                                       strcpy(buffer,"timer");
+      string_fill_with_space(buffer, 6);
+      psp_sdl_back2_print(140, y, buffer, color);
+    } else
     if (menu_id == MENU_SET_VSYNC) {
       if (ti99_vsync) strcpy(buffer,"yes");
       else                strcpy(buffer,"no ");
@@ -137,12 +174,22 @@ psp_display_screen_settings_menu(void)
     } else
     if (menu_id == MENU_SET_RENDER) {
 
-      if (ti99_render_mode == TI99_RENDER_NORMAL) strcpy(buffer, "normal");
-      else                                        strcpy(buffer, "fit");
+      strcpy(buffer, ti99_render_name(ti99_render_mode));
 
       string_fill_with_space(buffer, 13);
       psp_sdl_back2_print(140, y, buffer, color);
     } else
+    if (menu_id == MENU_SET_THREAD) {
+      if (ti99_render_thread) strcpy(buffer,"yes");
+      else                    strcpy(buffer,"no ");
+      string_fill_with_space(buffer, 4);
+      psp_sdl_back2_print(140, y, buffer, color);
+    } else
+    if (menu_id == MENU_SET_SCALER_THREAD) {
+      sprintf(buffer,"%d", ti99_scaler_threads);
+      string_fill_with_space(buffer, 4);
+      psp_sdl_back2_print(140, y, buffer, color);
+    } else
     if (menu_id == MENU_SET_DANZEFF) {
 
       if (danzeff_trans) strcpy(buffer, "transparent");
@@ -178,6 +225,28 @@ psp_settings_menu_render(int step)
   }
 }
 
+static void
+psp_settings_menu_pacing(int step)
+{
+  if (step > 0) {
+    if (ti99_pacing < TI99_LAST_PACING) ti99_pacing++;
+    else                                ti99_pacing = 0;
+  } else {
+    if (ti99_pacing > 0) ti99_pacing--;
+    else                 ti99_pacing = TI99_LAST_PACING;
+  }
+}
+
+static void
+psp_settings_menu_scaler_threads(int step)
+{
+  if (step > 0) {
+    if (ti99_scaler_threads < TI99_SCALER_MAX_THREADS) ti99_scaler_threads++;
+  } else {
+    if (ti99_scaler_threads > 1) ti99_scaler_threads--;
+  }
+}
+
 static void
 psp_settings_menu_clock(int step)
 {
@@ -196,7 +265,19 @@ psp_settings_menu_skip_fps(int step)
   if (step > 0) {
     if (ti99_skip_fps < 25) ti99_skip_fps++;
   } else {
-    if (ti99_skip_fps > 0) ti99_skip_fps--;
+    if (ti99_skip_fps > TI99_SKIP_AUTO) ti99_skip_fps--;
+  }
+}
+
+static void
+psp_settings_menu_latency(int step)
+{
+  if (step > 0) {
+    ti99_snd_latency += 10;
+    if (ti99_snd_latency > TI99_SND_LATENCY_MAX) ti99_snd_latency = TI99_SND_LATENCY_MAX;
+  } else {
+    ti99_snd_latency -= 10;
+    if (ti99_snd_latency < TI99_SND_LATENCY_MIN) ti99_snd_latency = TI99_SND_LATENCY_MIN;
   }
 }
 
@@ -216,9 +297,14 @@ static void
 psp_settings_menu_init(void)
 {
   ti99_snd_enable      = TI99.ti99_snd_enable;
+  ti99_snd_latency     = TI99.ti99_snd_latency;
+  ti99_snd_record      = ti99_sound_recording();
   ti99_render_mode     = TI99.ti99_render_mode;
+  ti99_render_thread   = TI99.ti99_render_thread;
+  ti99_scaler_threads  = TI99.ti99_scaler_threads;
   danzeff_trans        = TI99.danzeff_trans;
   ti99_speed_limiter   = TI99.ti99_speed_limiter;
+  ti99_pacing          = TI99.ti99_pacing;
   ti99_skip_fps        = TI99.psp_skip_max_frame;
   ti99_view_fps        = TI99.ti99_view_fps;
   psp_cpu_clock        = TI99.psp_cpu_clock;
@@ -255,11 +341,19 @@ static void
 psp_settings_menu_validate(void)
 {
   TI99.ti99_snd_enable      = ti99_snd_enable;
+  TI99.ti99_snd_latency     = ti99_snd_latency;
+  /* Not a setting, the log stops with the emulator */
+  if (ti99_sound_record( ti99_snd_record )) {
+    ti99_snd_record = 0;
+  }
   TI99.ti99_render_mode     = ti99_render_mode;
+  TI99.ti99_render_thread   = ti99_render_thread;
+  TI99.ti99_scaler_threads  = ti99_scaler_threads;
   TI99.ti99_vsync         = ti99_vsync;
   TI99.danzeff_trans       = danzeff_trans;
   TI99.psp_cpu_clock       = psp_cpu_clock;
   TI99.ti99_speed_limiter   = ti99_speed_limiter;
+  TI99.ti99_pacing          = ti99_pacing;
   TI99.psp_skip_max_frame  = ti99_skip_fps;
   TI99.psp_skip_cur_frame  = 0;
   TI99.ti99_view_fps        = ti99_view_fps;
@@ -389,14 +483,24 @@ psp_settings_menu(void)
       {
         case MENU_SET_SOUND      : ti99_snd_enable = ! ti99_snd_enable;
         break;              
+        case MENU_SET_LATENCY    : psp_settings_menu_latency( step );
+        break;
+        case MENU_SET_RECORD     : ti99_snd_record = ! ti99_snd_record;
+        break;              
         case MENU_SET_SPEED_LIMIT : psp_settings_menu_limiter( step );
         break;              
         case MENU_SET_VIEW_FPS   : ti99_view_fps = ! ti99_view_fps;
         break;              
+        case MENU_SET_PACING     : psp_settings_menu_pacing( step );
+        break;              
         case MENU_SET_SKIP_FPS   : psp_settings_menu_skip_fps( step );
         break;              
         case MENU_SET_RENDER     : psp_settings_menu_render( step );
         break;              
+        case MENU_SET_THREAD     : ti99_render_thread = ! ti99_render_thread;
+        break;              
+        case MENU_SET_SCALER_THREAD : psp_settings_menu_scaler_threads( step );
+        break;              
         case MENU_SET_VSYNC      : ti99_vsync = ! ti99_vsync;
         break;              
         case MENU_SET_DANZEFF    : danzeff_trans = ! danzeff_trans;
@@ -0,0 +1,289 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include <SDL/SDL.h>
+
+#include "global.h"
+#include "psp_pacer.h"
+
+ti99_pacer_stats_t ti99_pacer_stats;
+
+u32
+ti99_pacer_now(void)
+{
+# if defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+  if (! clock_gettime(CLOCK_MONOTONIC, &ts)) {
+    return (u32)ts.tv_sec * 1000000U + (u32)(ts.tv_nsec / 1000);
+  }
+# endif
+  {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (u32)tv.tv_sec * 1000000U + (u32)tv.tv_usec;
+  }
+}
+
+void
+ti99_pacer_sleep_until(u32 deadline)
+{
+  int remain = (int)(deadline - ti99_pacer_now());
+
+  while (remain > TI99_PACER_SPIN_US) {
+    SDL_Delay((remain - TI99_PACER_SPIN_US) / 1000);
+    remain = (int)(deadline - ti99_pacer_now());
+  }
+  while ((int)(deadline - ti99_pacer_now()) > 0);
+}
+
+/*
+   Audio clock : samples consumed by the audio callback, interpolated
+   between two callbacks with the monotonic clock.
+ */
+static volatile u32 loc_audio_samples = 0;
+static volatile u32 loc_audio_stamp   = 0;
+static volatile int loc_audio_freq    = 0;
+static volatile int loc_audio_chunk   = 0;
+
+/*
+   Audio driven emulation : each callback grants the CPU the cycles that
+   produce the samples it consumed, the CPU thread blocks once it has used
+   them up.
+ */
+static volatile u32 loc_drive_granted = 0;
+static u32          loc_drive_rest    = 0;
+static volatile int loc_drive_waiting = 0;
+static SDL_sem     *loc_drive_sem     = NULL;
+static u32          loc_drive_clock   = 0;
+static u32          loc_drive_base    = 0;
+static int          loc_drive_sync    = 1;
+
+void
+ti99_pacer_audio(int samples, int freq)
+{
+  long long cycles;
+
+  loc_audio_freq    = freq;
+  loc_audio_chunk   = samples;
+  loc_audio_stamp   = ti99_pacer_now();
+  loc_audio_samples += samples;
+
+  if (freq <= 0) return;
+
+  cycles = (long long)samples * TI99_PACER_CPU_HZ + loc_drive_rest;
+  loc_drive_rest     = (u32)(cycles % freq);
+  loc_drive_granted += (u32)(cycles / freq);
+
+  __sync_synchronize();
+  if (loc_drive_waiting && loc_drive_sem && ! SDL_SemValue(loc_drive_sem)) {
+    SDL_SemPost(loc_drive_sem);
+  }
+}
+
+/* Cycles run past what the callbacks granted */
+static int
+loc_drive_ahead(u32 clock)
+{
+  return (int)((clock - loc_drive_clock) - (loc_drive_granted - loc_drive_base));
+}
+
+/* CPU thread : blocks until the audio device asked for the cycles up to
+   clock, returns 0 when there is no audio clock to follow */
+int
+ti99_pacer_cycles(u32 clock)
+{
+  int lead = (TI99.ti99_snd_latency + TI99_PACER_DRIVE_MS) * (TI99_PACER_CPU_HZ / 1000);
+
+  if (! loc_audio_freq) return 0;
+  if (! loc_drive_sem) loc_drive_sem = SDL_CreateSemaphore(0);
+
+  if (loc_drive_sync) {
+    loc_drive_clock = clock;
+    loc_drive_base  = loc_drive_granted;
+    loc_drive_sync  = 0;
+  }
+
+  for (;;) {
+    int ahead = loc_drive_ahead(clock);
+
+    /* Too slow to keep up, forget the backlog rather than run flat out */
+    if (ahead < -lead) {
+      loc_drive_clock = clock;
+      loc_drive_base  = loc_drive_granted;
+      return 1;
+    }
+    if (ahead < lead) return 1;
+
+    loc_drive_waiting = 1;
+    __sync_synchronize();
+    if (loc_drive_ahead(clock) < lead) {
+      loc_drive_waiting = 0;
+      return 1;
+    }
+    if (SDL_SemWaitTimeout(loc_drive_sem, TI99_PACER_DRIVE_WAIT)) {
+      loc_drive_waiting = 0;
+      loc_drive_sync    = 1;
+      return 0;
+    }
+    loc_drive_waiting = 0;
+  }
+}
+
+static int
+loc_audio_clock(u32 now, u32 *clock)
+{
+  u32 samples = loc_audio_samples;
+  u32 stamp   = loc_audio_stamp;
+  int freq    = loc_audio_freq;
+  int chunk   = loc_audio_chunk;
+  u32 played;
+  int since;
+
+  if (! freq) return 0;
+
+  /* The callback stopped (audio paused or closed), fall back to the timer */
+  since = (int)(now - stamp);
+  if (since > 250000) return 0;
+
+  played = (u32)((long long)chunk * 1000000 / freq);
+  if (since > (int)played) since = played;
+  if (since < 0) since = 0;
+
+  *clock = (u32)((long long)samples * 1000000 / freq) + since;
+  return 1;
+}
+
+/* Running statistics for the current one second window */
+static u32       loc_last_frame  = 0;
+static int       loc_win_frames  = 0;
+static u32       loc_win_start   = 0;
+static long long loc_win_sum     = 0;
+static long long loc_win_sum2    = 0;
+static int       loc_win_min     = 0;
+static int       loc_win_max     = 0;
+static int       loc_win_late    = 0;
+
+static u32       loc_next        = 0;
+static int       loc_next_audio  = -1;
+
+static int
+loc_isqrt(long long v)
+{
+  long long r = 0;
+  long long b = 1LL << 40;
+
+  while (b > v) b >>= 2;
+  while (b) {
+    if (v >= r + b) {
+      v -= r + b;
+      r  = (r >> 1) + b;
+    } else {
+      r >>= 1;
+    }
+    b >>= 2;
+  }
+  return (int)r;
+}
+
+static void
+loc_stats_update(u32 now, int period)
+{
+  if (loc_last_frame) {
+    int interval = (int)(now - loc_last_frame);
+    if (! loc_win_frames || (interval < loc_win_min)) loc_win_min = interval;
+    if (! loc_win_frames || (interval > loc_win_max)) loc_win_max = interval;
+    if (interval > period + period / 2) loc_win_late++;
+    loc_win_sum  += interval;
+    loc_win_sum2 += (long long)interval * interval;
+    loc_win_frames++;
+  } else {
+    loc_win_start = now;
+  }
+  loc_last_frame = now;
+
+  if ((int)(now - loc_win_start) >= 1000000 && loc_win_frames) {
+    long long mean = loc_win_sum / loc_win_frames;
+    long long var  = loc_win_sum2 / loc_win_frames - mean * mean;
+    ti99_pacer_stats.frames = loc_win_frames;
+    ti99_pacer_stats.mean   = (int)mean;
+    ti99_pacer_stats.jitter = loc_isqrt(var > 0 ? var : 0);
+    ti99_pacer_stats.min    = loc_win_min;
+    ti99_pacer_stats.max    = loc_win_max;
+    ti99_pacer_stats.late   = loc_win_late;
+    loc_win_start  = now;
+    loc_win_frames = 0;
+    loc_win_sum    = 0;
+    loc_win_sum2   = 0;
+    loc_win_late   = 0;
+  }
+}
+
+void
+ti99_pacer_reset(void)
+{
+  loc_last_frame = 0;
+  loc_win_frames = 0;
+  loc_next_audio = -1;
+  loc_drive_sync = 1;
+}
+
+/* Waits for the start of the next frame slot */
+void
+ti99_pacer_frame(int fps, int pacing)
+{
+  int period = 1000000 / fps;
+  u32 now    = ti99_pacer_now();
+  u32 clock  = now;
+  int audio  = (pacing != TI99_PACING_TIMER) && loc_audio_clock(now, &clock);
+
+  /* The CPU already waited for the audio device, present whatever frame
+     is current */
+  if (audio && (pacing == TI99_PACING_DRIVEN)) {
+    loc_next_audio = -1;
+    loc_stats_update(now, period);
+    return;
+  }
+
+  /* Resynchronize after a pause, a change of clock or when too late */
+  if ((audio != loc_next_audio) || ((int)(clock - loc_next) > 4 * period) ||
+      ((int)(loc_next - clock) > 4 * period)) {
+    loc_next       = clock;
+    loc_next_audio = audio;
+  }
+
+  if (audio) {
+    /* The audio clock moves by chunks, sleep on the monotonic clock and
+       look again until it gets there */
+    int remain;
+    while ((remain = (int)(loc_next - clock)) > 0) {
+      ti99_pacer_sleep_until(now + remain);
+      now = ti99_pacer_now();
+      if (! loc_audio_clock(now, &clock)) break;
+    }
+  } else {
+    ti99_pacer_sleep_until(loc_next);
+    now = ti99_pacer_now();
+  }
+
+  loc_next += period;
+  if ((int)(loc_next - (audio ? clock : now)) < 0) loc_next = (audio ? clock : now) + period;
+
+  loc_stats_update(now, period);
+}
@@ -0,0 +1,63 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+# ifndef _PSP_PACER_H_
+# define _PSP_PACER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+# define TI99_PACING_TIMER    0
+# define TI99_PACING_AUDIO    1
+# define TI99_PACING_DRIVEN   2
+# define TI99_LAST_PACING     2
+
+  /* SDL_Delay is only good to a few ms, the end of each wait is a spin */
+# define TI99_PACER_SPIN_US   2000
+
+  /* Audio driven pacing : the CPU runs this far past the samples the
+     device asked for, on top of the sound latency */
+# define TI99_PACER_CPU_HZ       3000000
+# define TI99_PACER_DRIVE_MS     5
+  /* Without a callback for that long the timer takes over */
+# define TI99_PACER_DRIVE_WAIT  250
+
+  /* Frame interval statistics over the last second, microseconds */
+  typedef struct ti99_pacer_stats_t {
+    int frames;
+    int mean;
+    int jitter;    /* standard deviation of the interval */
+    int min;
+    int max;
+    int late;      /* intervals longer than 1.5 frame */
+  } ti99_pacer_stats_t;
+
+  extern ti99_pacer_stats_t ti99_pacer_stats;
+
+  /* Monotonic microseconds, wraps every 71 minutes so only differences
+     are meaningful */
+  extern u32  ti99_pacer_now(void);
+  extern void ti99_pacer_sleep_until(u32 deadline);
+  extern void ti99_pacer_frame(int fps, int pacing);
+  extern void ti99_pacer_reset(void);
+  extern void ti99_pacer_audio(int samples, int freq);
+  extern int  ti99_pacer_cycles(u32 clock);
+
+#ifdef __cplusplus
+}
+#endif
+# endif
@@ -0,0 +1,607 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <SDL/SDL.h>
+#include <SDL/SDL_thread.h>
+
+#include "global.h"
+#include "psp_scaler.h"
+
+# if defined(__SSE2__)
+#  include <emmintrin.h>
+#  define TI99_SCALER_SSE2
+# elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#  include <arm_neon.h>
+#  define TI99_SCALER_NEON
+# endif
+
+/*
+   LUDO: 16-bit HiColor (565 format) helpers, the portable kernels work on
+   two pixels packed in a 32 bits word wherever they can
+ */
+# if SDL_BYTEORDER == SDL_BIG_ENDIAN
+#  define LOC_FIRST(w)        ((u16)((w) >> 16))
+#  define LOC_SECOND(w)       ((u16)(w))
+#  define LOC_PAIR(a, b)      (((u32)(a) << 16) | (u16)(b))
+# else
+#  define LOC_FIRST(w)        ((u16)(w))
+#  define LOC_SECOND(w)       ((u16)((w) >> 16))
+#  define LOC_PAIR(a, b)      (((u32)(b) << 16) | (u16)(a))
+# endif
+
+static inline u32
+loc_average2(u32 a, u32 b)
+{
+  return (((a ^ b) & 0xf7def7deU) >> 1) + (a & b);
+}
+
+static inline u16
+loc_average(u16 a, u16 b)
+{
+  return (u16)(((a ^ b) & 0xf7deU) >> 1) + (a & b);
+}
+
+/* Spread the components so each one has room for a 5 bits weight */
+static inline u32
+loc_spread(u16 p)
+{
+  return (p | ((u32)p << 16)) & 0x07e0f81fU;
+}
+
+static inline u16
+loc_pack(u32 v)
+{
+  return (u16)(v | (v >> 16));
+}
+
+/* w in [0,32] */
+static inline u32
+loc_lerp(u32 a, u32 b, int w)
+{
+  return ((a * (32 - w) + b * w) >> 5) & 0x07e0f81fU;
+}
+
+static inline int
+loc_clamp(int v, int size)
+{
+  if (v < 0) return 0;
+  if (v >= size) return size - 1;
+  return v;
+}
+
+/* Centre of target pixel i on the source, 16.16 fixed point */
+static inline int
+loc_src_pos(int i, int src_size, int dst_size)
+{
+  return (int)(((long long)(2 * i + 1) * src_size - dst_size) * 65536 / (2 * dst_size));
+}
+
+static inline int
+loc_nearest(int pos, int size)
+{
+  return loc_clamp((pos + 0x8000) >> 16, size);
+}
+
+/*
+   1.25x : every 4 source pixels give 5 target pixels, the second one being
+   the average of its neighbours. Two groups are done per iteration so the
+   averages can be computed in a single word.
+ */
+static void
+loc_fit_rows(const ti99_scale_job_t *job, int y0, int y1)
+{
+  int last_sy = -1;
+  int y;
+
+  for (y = y0; y < y1; y++) {
+    int sy   = (y / 5) * 4 + (((y % 5) < 3) ? (y % 5) : 3);
+    u16 *dst = job->dst + y * job->dst_pitch;
+
+    if (sy == last_sy) {
+      memcpy(dst, dst - job->dst_pitch, job->dst_w * sizeof(u16));
+      continue;
+    }
+    last_sy = sy;
+
+    const u32 *src = (const u32 *)(job->src + sy * job->src_pitch);
+    int groups = job->src_w / 4;
+
+    while (groups >= 2) {
+      u32 a = src[0];
+      u32 b = src[1];
+      u32 c = src[2];
+      u32 d = src[3];
+      u32 avg = loc_average2(LOC_PAIR(LOC_FIRST(a), LOC_FIRST(c)),
+                             LOC_PAIR(LOC_SECOND(a), LOC_SECOND(c)));
+      dst[0] = LOC_FIRST(a);
+      dst[1] = LOC_FIRST(avg);
+      dst[2] = LOC_SECOND(a);
+      dst[3] = LOC_FIRST(b);
+      dst[4] = LOC_SECOND(b);
+      dst[5] = LOC_FIRST(c);
+      dst[6] = LOC_SECOND(avg);
+      dst[7] = LOC_SECOND(c);
+      dst[8] = LOC_FIRST(d);
+      dst[9] = LOC_SECOND(d);
+      src += 4;
+      dst += 10;
+      groups -= 2;
+    }
+    if (groups) {
+      const u16 *s = (const u16 *)src;
+      dst[0] = s[0];
+      dst[1] = loc_average(s[0], s[1]);
+      dst[2] = s[1];
+      dst[3] = s[2];
+      dst[4] = s[3];
+    }
+  }
+}
+
+static void
+loc_nearest_rows(const ti99_scale_job_t *job, int y0, int y1)
+{
+  short x_tab[TI99_SCALER_MAX_WIDTH];
+  int   last_sy = -1;
+  int   x;
+  int   y;
+
+  for (x = 0; x < job->dst_w; x++) {
+    x_tab[x] = loc_nearest(loc_src_pos(x, job->src_w, job->dst_w), job->src_w);
+  }
+
+  for (y = y0; y < y1; y++) {
+    int sy   = loc_nearest(loc_src_pos(y, job->src_h, job->dst_h), job->src_h);
+    u16 *dst = job->dst + y * job->dst_pitch;
+
+    if (sy == last_sy) {
+      memcpy(dst, dst - job->dst_pitch, job->dst_w * sizeof(u16));
+      continue;
+    }
+    last_sy = sy;
+
+    const u16 *src = job->src + sy * job->src_pitch;
+    for (x = 0; x < job->dst_w; x++) {
+      dst[x] = src[x_tab[x]];
+    }
+  }
+}
+
+static void
+loc_bilinear_rows(const ti99_scale_job_t *job, int y0, int y1)
+{
+  short x_tab[TI99_SCALER_MAX_WIDTH];
+  short x1_tab[TI99_SCALER_MAX_WIDTH];
+  u8    w_tab[TI99_SCALER_MAX_WIDTH];
+  int   x;
+  int   y;
+
+  for (x = 0; x < job->dst_w; x++) {
+    int pos = loc_src_pos(x, job->src_w, job->dst_w);
+    if (pos < 0) pos = 0;
+    x_tab[x]  = loc_clamp(pos >> 16, job->src_w);
+    x1_tab[x] = loc_clamp(x_tab[x] + 1, job->src_w);
+    w_tab[x]  = (pos >> 11) & 31;
+  }
+
+  for (y = y0; y < y1; y++) {
+    int pos = loc_src_pos(y, job->src_h, job->dst_h);
+    if (pos < 0) pos = 0;
+    int sy  = loc_clamp(pos >> 16, job->src_h);
+    int wy  = (pos >> 11) & 31;
+    const u16 *row0 = job->src + sy * job->src_pitch;
+    const u16 *row1 = job->src + loc_clamp(sy + 1, job->src_h) * job->src_pitch;
+    u16 *dst = job->dst + y * job->dst_pitch;
+
+    if (wy == 0) {
+      for (x = 0; x < job->dst_w; x++) {
+        u32 top = loc_lerp(loc_spread(row0[x_tab[x]]), loc_spread(row0[x1_tab[x]]), w_tab[x]);
+        dst[x] = loc_pack(top);
+      }
+    } else {
+      for (x = 0; x < job->dst_w; x++) {
+        u32 top    = loc_lerp(loc_spread(row0[x_tab[x]]), loc_spread(row0[x1_tab[x]]), w_tab[x]);
+        u32 bottom = loc_lerp(loc_spread(row1[x_tab[x]]), loc_spread(row1[x1_tab[x]]), w_tab[x]);
+        dst[x] = loc_pack(loc_lerp(top, bottom, wy));
+      }
+    }
+  }
+}
+
+/*
+   Edge directed : the Scale2x rules applied at any ratio. Each target pixel
+   picks the source pixel under it and the quadrant of that pixel it falls
+   in, then extends a diagonal edge into that quadrant if there is one.
+   Target pixels sitting right on a source centre keep the source pixel.
+ */
+# define LOC_CENTRE  2
+
+static void
+loc_edge_rows(const ti99_scale_job_t *job, int y0, int y1)
+{
+  short x_tab[TI99_SCALER_MAX_WIDTH];
+  u8    q_tab[TI99_SCALER_MAX_WIDTH];
+  int   x;
+  int   y;
+
+  for (x = 0; x < job->dst_w; x++) {
+    int pos  = loc_src_pos(x, job->src_w, job->dst_w);
+    x_tab[x] = loc_nearest(pos, job->src_w);
+    q_tab[x] = (pos == (x_tab[x] << 16)) ? LOC_CENTRE : (pos > (x_tab[x] << 16));
+  }
+
+  for (y = y0; y < y1; y++) {
+    int pos = loc_src_pos(y, job->src_h, job->dst_h);
+    int sy  = loc_nearest(pos, job->src_h);
+    int qy  = (pos > (sy << 16));
+    int cy  = (pos == (sy << 16));
+    const u16 *e = job->src + sy * job->src_pitch;
+    const u16 *b = job->src + loc_clamp(sy - 1, job->src_h) * job->src_pitch;
+    const u16 *h = job->src + loc_clamp(sy + 1, job->src_h) * job->src_pitch;
+    const u16 *v = qy ? h : b;
+    int last = job->src_w - 1;
+    u16 *dst = job->dst + y * job->dst_pitch;
+
+    for (x = 0; x < job->dst_w; x++) {
+      int sx = x_tab[x];
+      u16 E  = e[sx];
+      u16 D  = e[sx > 0    ? sx - 1 : sx];
+      u16 F  = e[sx < last ? sx + 1 : sx];
+      u16 V  = v[sx];
+      u16 O  = (qy ? b : h)[sx];
+      u16 P  = E;
+      if (!cy && (q_tab[x] != LOC_CENTRE) && (V != O) && (D != F)) {
+        if (q_tab[x]) { if (V == F) P = F; }
+        else          { if (D == V) P = D; }
+      }
+      dst[x] = P;
+    }
+  }
+}
+
+/*
+   Scale2x, one target row : v is the row above for the top half of the
+   source pixels and the row below for the bottom half, o the other one.
+ */
+static inline void
+loc_scale2x_pixel(const u16 *v, const u16 *o, const u16 *e, u16 *dst, int x, int last)
+{
+  u16 E = e[x];
+  u16 D = e[x > 0    ? x - 1 : x];
+  u16 F = e[x < last ? x + 1 : x];
+  u16 V = v[x];
+  u16 L = E;
+  u16 R = E;
+  if ((V != o[x]) && (D != F)) {
+    if (D == V) L = D;
+    if (V == F) R = F;
+  }
+  dst[2 * x    ] = L;
+  dst[2 * x + 1] = R;
+}
+
+static void
+loc_scale2x_row(const u16 *v, const u16 *o, const u16 *e, u16 *dst, int w)
+{
+  int last = w - 1;
+  int x = 0;
+
+  if (w <= 0) return;
+
+  loc_scale2x_pixel(v, o, e, dst, x++, last);
+
+# if defined(TI99_SCALER_SSE2)
+  for (; x + 8 <= last; x += 8) {
+    __m128i E  = _mm_loadu_si128((const __m128i *)(e + x));
+    __m128i D  = _mm_loadu_si128((const __m128i *)(e + x - 1));
+    __m128i F  = _mm_loadu_si128((const __m128i *)(e + x + 1));
+    __m128i V  = _mm_loadu_si128((const __m128i *)(v + x));
+    __m128i O  = _mm_loadu_si128((const __m128i *)(o + x));
+    __m128i no = _mm_or_si128(_mm_cmpeq_epi16(V, O), _mm_cmpeq_epi16(D, F));
+    __m128i ml = _mm_andnot_si128(no, _mm_cmpeq_epi16(D, V));
+    __m128i mr = _mm_andnot_si128(no, _mm_cmpeq_epi16(V, F));
+    __m128i L  = _mm_or_si128(_mm_and_si128(ml, D), _mm_andnot_si128(ml, E));
+    __m128i R  = _mm_or_si128(_mm_and_si128(mr, F), _mm_andnot_si128(mr, E));
+    _mm_storeu_si128((__m128i *)(dst + 2 * x    ), _mm_unpacklo_epi16(L, R));
+    _mm_storeu_si128((__m128i *)(dst + 2 * x + 8), _mm_unpackhi_epi16(L, R));
+  }
+# elif defined(TI99_SCALER_NEON)
+  for (; x + 8 <= last; x += 8) {
+    uint16x8_t E  = vld1q_u16(e + x);
+    uint16x8_t D  = vld1q_u16(e + x - 1);
+    uint16x8_t F  = vld1q_u16(e + x + 1);
+    uint16x8_t V  = vld1q_u16(v + x);
+    uint16x8_t O  = vld1q_u16(o + x);
+    uint16x8_t no = vorrq_u16(vceqq_u16(V, O), vceqq_u16(D, F));
+    uint16x8_t ml = vbicq_u16(vceqq_u16(D, V), no);
+    uint16x8_t mr = vbicq_u16(vceqq_u16(V, F), no);
+    uint16x8x2_t LR;
+    LR.val[0] = vbslq_u16(ml, D, E);
+    LR.val[1] = vbslq_u16(mr, F, E);
+    vst2q_u16(dst + 2 * x, LR);
+  }
+# endif
+
+  for (; x < w; x++) {
+    loc_scale2x_pixel(v, o, e, dst, x, last);
+  }
+}
+
+static void
+loc_scale2x_rows(const ti99_scale_job_t *job, int y0, int y1)
+{
+  int y;
+
+  for (y = y0; y < y1; y++) {
+    int sy = y >> 1;
+    const u16 *e = job->src + sy * job->src_pitch;
+    const u16 *b = job->src + loc_clamp(sy - 1, job->src_h) * job->src_pitch;
+    const u16 *h = job->src + loc_clamp(sy + 1, job->src_h) * job->src_pitch;
+    u16 *dst = job->dst + y * job->dst_pitch;
+
+    if (y & 1) loc_scale2x_row(h, b, e, dst, job->src_w);
+    else       loc_scale2x_row(b, h, e, dst, job->src_w);
+  }
+}
+
+static void
+loc_scale3x_rows(const ti99_scale_job_t *job, int y0, int y1)
+{
+  int last = job->src_w - 1;
+  int x;
+  int y;
+
+  for (y = y0; y < y1; y++) {
+    int sy = y / 3;
+    int r  = y % 3;
+    const u16 *e = job->src + sy * job->src_pitch;
+    const u16 *b = job->src + loc_clamp(sy - 1, job->src_h) * job->src_pitch;
+    const u16 *h = job->src + loc_clamp(sy + 1, job->src_h) * job->src_pitch;
+    u16 *dst = job->dst + y * job->dst_pitch;
+
+    for (x = 0; x <= last; x++) {
+      int xl = x > 0    ? x - 1 : x;
+      int xr = x < last ? x + 1 : x;
+      u16 A = b[xl], B = b[x], C = b[xr];
+      u16 D = e[xl], E = e[x], F = e[xr];
+      u16 G = h[xl], H = h[x], I = h[xr];
+      u16 P0 = E, P1 = E, P2 = E;
+
+      if ((B != H) && (D != F)) {
+        if (r == 0) {
+          if (D == B) P0 = D;
+          if (((D == B) && (E != C)) || ((B == F) && (E != A))) P1 = B;
+          if (B == F) P2 = F;
+        } else
+        if (r == 1) {
+          if (((D == B) && (E != G)) || ((D == H) && (E != A))) P0 = D;
+          if (((B == F) && (E != I)) || ((H == F) && (E != C))) P2 = F;
+        } else {
+          if (D == H) P0 = D;
+          if (((D == H) && (E != I)) || ((H == F) && (E != G))) P1 = H;
+          if (H == F) P2 = F;
+        }
+      }
+      dst[0] = P0;
+      dst[1] = P1;
+      dst[2] = P2;
+      dst += 3;
+    }
+  }
+}
+
+const ti99_scaler_t ti99_scalers[TI99_SCALER_COUNT] =
+{
+  { "fit",      5, 4, loc_fit_rows      },
+  { "nearest",  0, 0, loc_nearest_rows  },
+  { "bilinear", 0, 0, loc_bilinear_rows },
+  { "edge",     0, 0, loc_edge_rows     },
+  { "scale2x",  2, 1, loc_scale2x_rows  },
+  { "scale3x",  3, 1, loc_scale3x_rows  }
+};
+
+/* Band workers, created on first use and kept for the whole session */
+
+typedef struct loc_worker_t {
+  SDL_Thread             *thread;
+  SDL_sem                *start;
+  const ti99_scaler_t    *scaler;
+  const ti99_scale_job_t *job;
+  int                     y0;
+  int                     y1;
+} loc_worker_t;
+
+static loc_worker_t loc_workers[TI99_SCALER_MAX_THREADS - 1];
+static int          loc_worker_count = 0;
+static SDL_sem     *loc_worker_done  = NULL;
+
+static int
+loc_worker_main(void *arg)
+{
+  loc_worker_t *worker = (loc_worker_t *)arg;
+
+  while (1) {
+    SDL_SemWait(worker->start);
+    worker->scaler->scale_rows(worker->job, worker->y0, worker->y1);
+    SDL_SemPost(loc_worker_done);
+  }
+  return 0;
+}
+
+static int
+loc_worker_spawn(int count)
+{
+  if (! loc_worker_done) {
+    loc_worker_done = SDL_CreateSemaphore(0);
+    if (! loc_worker_done) return 0;
+  }
+  while (loc_worker_count < count) {
+    loc_worker_t *worker = &loc_workers[loc_worker_count];
+    worker->start  = SDL_CreateSemaphore(0);
+    worker->thread = SDL_CreateThread(loc_worker_main, worker);
+    if (! worker->thread) {
+      SDL_DestroySemaphore(worker->start);
+      break;
+    }
+    loc_worker_count++;
+  }
+  return (loc_worker_count < count) ? loc_worker_count : count;
+}
+
+void
+ti99_scaler_run(const ti99_scaler_t *scaler, const ti99_scale_job_t *job, int y0, int y1, int threads)
+{
+  int rows = y1 - y0;
+  int bands;
+  int band;
+  int index;
+
+  if (threads > TI99_SCALER_MAX_THREADS) threads = TI99_SCALER_MAX_THREADS;
+
+  /* Not worth waking anybody up for a few rows */
+  if ((threads <= 1) || (rows < threads * 16)) {
+    scaler->scale_rows(job, y0, y1);
+    return;
+  }
+
+  bands = loc_worker_spawn(threads - 1) + 1;
+  band  = (rows + bands - 1) / bands;
+
+  for (index = 1; index < bands; index++) {
+    loc_worker_t *worker = &loc_workers[index - 1];
+    worker->scaler = scaler;
+    worker->job    = job;
+    worker->y0     = y0 + index * band;
+    worker->y1     = y0 + (index + 1) * band;
+    if (worker->y1 > y1) worker->y1 = y1;
+    if (worker->y0 > worker->y1) worker->y0 = worker->y1;
+    SDL_SemPost(worker->start);
+  }
+
+  scaler->scale_rows(job, y0, y0 + band);
+
+  for (index = 1; index < bands; index++) {
+    SDL_SemWait(loc_worker_done);
+  }
+}
+
+/* Benchmark : cost of each scaler at each target size */
+
+static long
+loc_usec(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000000L + tv.tv_usec;
+}
+
+static void
+loc_bench_pattern(u16 *src, int w, int h)
+{
+  static const u16 colors[16] = {
+    0x0000, 0x0000, 0x2624, 0x5ecf, 0x529d, 0x7b9e, 0xd269, 0x461e,
+    0xfaa9, 0xfbcf, 0xd609, 0xe690, 0x2583, 0xc2d7, 0xce59, 0xffff
+  };
+  u32 seed = 0x99;
+  int x;
+  int y;
+
+  /* 8x8 characters with random patterns & colors, like a busy TI screen */
+  for (y = 0; y < h; y += 8) {
+    for (x = 0; x < w; x += 8) {
+      int fore;
+      int back;
+      int i;
+      int j;
+      seed = seed * 1103515245 + 12345;
+      fore = colors[(seed >> 8) & 15];
+      back = colors[(seed >> 12) & 15];
+      for (j = 0; j < 8; j++) {
+        seed = seed * 1103515245 + 12345;
+        for (i = 0; i < 8; i++) {
+          src[(y + j) * w + x + i] = ((seed >> (16 + i)) & 1) ? fore : back;
+        }
+      }
+    }
+  }
+}
+
+void
+ti99_scaler_benchmark(FILE *out)
+{
+  static const int sizes[][2] = { { 320, 240 }, { 400, 300 }, { 640, 480 }, { 800, 600 } };
+  static const int threads[]  = { 1, 2, 4 };
+  ti99_scale_job_t job;
+  int index;
+
+  job.src_w     = TI99_SCREEN_W;
+  job.src_h     = TI99_SCREEN_H;
+  job.src_pitch = TI99_SCREEN_W;
+  job.src       = (u16 *)malloc(job.src_w * job.src_h * sizeof(u16));
+  job.dst       = (u16 *)malloc(800 * 600 * sizeof(u16));
+
+  if (! job.src || ! job.dst) {
+    fprintf(out, "scaler benchmark: out of memory\n");
+    free((void *)job.src);
+    free(job.dst);
+    return;
+  }
+
+  loc_bench_pattern((u16 *)job.src, job.src_w, job.src_h);
+
+  fprintf(out, "scaler    target   threads  usec/frame  Mpixel/s\n");
+
+  for (index = 0; index < TI99_SCALER_COUNT; index++) {
+    const ti99_scaler_t *scaler = &ti99_scalers[index];
+    int num_size = scaler->ratio_num ? 1 : sizeof(sizes) / sizeof(sizes[0]);
+    int s;
+    int t;
+
+    for (s = 0; s < num_size; s++) {
+      if (scaler->ratio_num) {
+        job.dst_w = job.src_w * scaler->ratio_num / scaler->ratio_den;
+        job.dst_h = job.src_h * scaler->ratio_num / scaler->ratio_den;
+      } else {
+        job.dst_w = sizes[s][0];
+        job.dst_h = sizes[s][1];
+      }
+      job.dst_pitch = job.dst_w;
+
+      for (t = 0; t < (int)(sizeof(threads) / sizeof(threads[0])); t++) {
+        long start = loc_usec();
+        long elapsed;
+        int  frames = 0;
+        do {
+          ti99_scaler_run(scaler, &job, 0, job.dst_h, threads[t]);
+          frames++;
+          elapsed = loc_usec() - start;
+        } while ((frames < 10) || (elapsed < 250000));
+
+        fprintf(out, "%-9s %4dx%-4d %4d  %10.1f  %8.1f\n",
+                scaler->name, job.dst_w, job.dst_h, threads[t],
+                (double)elapsed / frames,
+                (double)job.dst_w * job.dst_h * frames / elapsed);
+      }
+    }
+  }
+
+  free((void *)job.src);
+  free(job.dst);
+}
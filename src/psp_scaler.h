@@ -0,0 +1,67 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+# ifndef _PSP_SCALER_H_
+# define _PSP_SCALER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+# define TI99_SCALER_FIT         0
+# define TI99_SCALER_NEAREST     1
+# define TI99_SCALER_BILINEAR    2
+# define TI99_SCALER_EDGE        3
+# define TI99_SCALER_SCALE2X     4
+# define TI99_SCALER_SCALE3X     5
+# define TI99_SCALER_COUNT       6
+
+# define TI99_SCALER_MAX_THREADS 4
+# define TI99_SCALER_MAX_WIDTH   2048
+
+  /* One scaling request, both surfaces are 16 bits 565, pitches in pixels */
+  typedef struct ti99_scale_job_t {
+    const u16 *src;
+    int        src_w;
+    int        src_h;
+    int        src_pitch;
+    u16       *dst;
+    int        dst_w;
+    int        dst_h;
+    int        dst_pitch;
+  } ti99_scale_job_t;
+
+  /* Renders target rows [y0, y1), rows only read the source so any band
+     can be done by any thread */
+  typedef void (*ti99_scale_rows_t)(const ti99_scale_job_t *job, int y0, int y1);
+
+  typedef struct ti99_scaler_t {
+    const char        *name;
+    int                ratio_num;   /* fixed target/source ratio, */
+    int                ratio_den;   /* 0 if any target size works */
+    ti99_scale_rows_t  scale_rows;
+  } ti99_scaler_t;
+
+  extern const ti99_scaler_t ti99_scalers[TI99_SCALER_COUNT];
+
+  extern void ti99_scaler_run(const ti99_scaler_t *scaler, const ti99_scale_job_t *job,
+                              int y0, int y1, int threads);
+  extern void ti99_scaler_benchmark(FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+# endif
@@ -24,6 +24,7 @@
 #include "global.h"
 #include "psp_sdl.h"
 #include "psp_danzeff.h"
+#include "psp_ti99.h"
 
   extern unsigned char psp_font_8x8[];
   extern unsigned char psp_font_6x10[];
@@ -416,6 +417,12 @@ psp_sdl_flip(void)
   SDL_Flip(back_surface);
 }
 
+void
+psp_sdl_flip_rects(SDL_Rect *rects, int count)
+{
+  SDL_UpdateRects(back_surface, count, rects);
+}
+
 #define  systemRedShift      (back_surface->format->Rshift)
 #define  systemGreenShift    (back_surface->format->Gshift)
 #define  systemBlueShift     (back_surface->format->Bshift)
@@ -700,6 +707,8 @@ psp_sdl_init(void)
 void
 psp_sdl_exit(int status)
 {
+  ti99_sound_record(0);
+  ti99_disk_sync();
   SDL_CloseAudio();
   SDL_Quit();
   sleep(1);
@@ -53,6 +53,7 @@ extern "C" {
   extern void psp_sdl_put_char(int x, int y, int color, int bgcolor, uchar c, int drawfg, int drawbg);
   extern void psp_sdl_fill_print(int x,int y,const char *str, int color, int bgcolor);
   extern void psp_sdl_flip(void);
+  extern void psp_sdl_flip_rects(SDL_Rect *rects, int count);
 
   extern int psp_sdl_init(void);
   extern void psp_sdl_save_bmp(char *filename);
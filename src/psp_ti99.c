@@ -25,10 +25,59 @@
 #include "psp_sdl.h"
 #include "psp_danzeff.h"
 #include "psp_ti99.h"
+#include "psp_scaler.h"
+#include "psp_pacer.h"
 
 int psp_screenshot_mode = 0;
 int ti99_in_menu = 0;
 
+ti99_dirty_t ti99_dirty = { 1 };
+
+void
+ti99_dirty_all(void)
+{
+  ti99_dirty.full = 1;
+}
+
+void
+ti99_dirty_line(int y, int left, int right)
+{
+  if (ti99_dirty.left[y] >= ti99_dirty.right[y]) {
+    ti99_dirty.left[y]  = left;
+    ti99_dirty.right[y] = right;
+    ti99_dirty.count++;
+  } else {
+    if (left  < ti99_dirty.left[y])  ti99_dirty.left[y]  = left;
+    if (right > ti99_dirty.right[y]) ti99_dirty.right[y] = right;
+  }
+}
+
+static void
+ti99_dirty_clear(void)
+{
+  memset(&ti99_dirty, 0, sizeof(ti99_dirty));
+}
+
+/* Grow the current rectangle by one line or start a new one */
+static SDL_Rect *
+loc_extend_rect(SDL_Rect *rect, SDL_Rect *rects, int *count, int x, int y, int w)
+{
+  if (rect && (rect->y + rect->h == y)) {
+    int right = rect->x + rect->w;
+    if (x < rect->x) rect->x = x;
+    if (x + w > right) right = x + w;
+    rect->w = right - rect->x;
+    rect->h++;
+    return rect;
+  }
+  rect = &rects[(*count)++];
+  rect->x = x;
+  rect->y = y;
+  rect->w = w;
+  rect->h = 1;
+  return rect;
+}
+
 # if defined(GP2X_MODE) || defined(DINGUX_MODE) || defined(LINUX_MODE)
 static void
 ti99_render_normal()
@@ -46,6 +95,30 @@ ti99_render_normal()
     dst_pixel += (PSP_LINE_SIZE - TI99_SCREEN_W) / 2;
   }
 }
+
+static int
+ti99_render_normal_dirty(SDL_Rect *rects)
+{
+  int dst_x = (320 - TI99_SCREEN_W) / 2;
+  int dst_y = (240 - TI99_SCREEN_H) / 2;
+  SDL_Rect *rect = NULL;
+  int count = 0;
+  int y;
+
+  for (y = 0; y < TI99_SCREEN_H; y++) {
+    int left  = ti99_dirty.left[y];
+    int right = ti99_dirty.right[y];
+    if (left >= right) {
+      rect = NULL;
+      continue;
+    }
+    u16 *src_pixel = (u16*)blit_surface->pixels + y * TI99_SCREEN_W + left;
+    u16 *dst_pixel = (u16*)back_surface->pixels + (y + dst_y) * PSP_LINE_SIZE + dst_x + left;
+    memcpy(dst_pixel, src_pixel, (right - left) * sizeof(u16));
+    rect = loc_extend_rect(rect, rects, &count, dst_x + left, dst_y + y, right - left);
+  }
+  return count;
+}
 # else
 static void
 ti99_render_normal()
@@ -64,91 +137,179 @@ ti99_render_normal()
 
   SDL_SoftStretch( blit_surface, &srcRect, back_surface, &dstRect );
 }
-# endif
 
-# if defined(GP2X_MODE) || defined(DINGUX_MODE) || defined(LINUX_MODE)
-/* 
+static int
+ti99_render_normal_dirty(SDL_Rect *rects)
+{
+  ti99_render_normal();
+  rects[0].x = ( 320 - TI99_WIDTH  ) / 2;
+  rects[0].y = ( 240 - TI99_HEIGHT ) / 2;
+  rects[0].w = TI99_WIDTH;
+  rects[0].h = TI99_HEIGHT;
+  return 1;
+}
+# endif
 
-  LUDO: 16-bit HiColor (565 format) 
-  see http://www.compuphase.com/graphic/scale3.htm
+/* Scaler used by each render mode, normal is a plain copy */
+static const int loc_render_scaler[TI99_LAST_RENDER + 1] = {
+  -1,
+  TI99_SCALER_FIT,
+  TI99_SCALER_NEAREST,
+  TI99_SCALER_BILINEAR,
+  TI99_SCALER_EDGE
+};
 
- */
-static inline u16 loc_coloraverage(u16 a, u16 b)
+const char *
+ti99_render_name(int render_mode)
 {
-  return (u16)(((a ^ b) & 0xf7deU) >> 1) + (a & b);
+  if ((render_mode <= TI99_RENDER_NORMAL) || (render_mode > TI99_LAST_RENDER)) return "normal";
+  return ti99_scalers[loc_render_scaler[render_mode]].name;
 }
 
-static inline void 
-ti99_X125_pixel(u16 *dist, const u16 *src)
+static void
+loc_scale_job(ti99_scale_job_t *job)
 {
-  dist[0] = src[0];
-  dist[1] = loc_coloraverage(src[0], src[1]);
-  dist[2] = src[1];
-  dist[3] = src[2];
-  dist[4] = src[3];
+  job->src       = (const u16*)blit_surface->pixels;
+  job->src_w     = TI99_SCREEN_W;
+  job->src_h     = TI99_SCREEN_H;
+  job->src_pitch = blit_surface->pitch / sizeof(u16);
+  job->dst       = (u16*)back_surface->pixels;
+  job->dst_w     = 320;
+  job->dst_h     = 240;
+  job->dst_pitch = back_surface->pitch / sizeof(u16);
 }
 
 static void
-ti99_render_fit()
+ti99_render_scaled()
 {
-  int step_y = 1;
-  u16 *src_line = (u16*)blit_surface->pixels;
-  u16 *tgt_line = (u16*)back_surface->pixels;
-  int  h = 240;
-  while (h-- > 0) {
-    int w = 320 / 5;
-    u16* scan_src_line = src_line;
-    while (w-- > 0) {
-      ti99_X125_pixel(tgt_line, scan_src_line);
-      tgt_line += 5;
-      scan_src_line += 4;
+  ti99_scale_job_t job;
+
+  loc_scale_job(&job);
+  ti99_scaler_run(&ti99_scalers[loc_render_scaler[TI99.ti99_render_mode]], &job,
+                  0, job.dst_h, TI99.ti99_scaler_threads);
+}
+
+static int
+ti99_render_scaled_dirty(SDL_Rect *rects)
+{
+  const ti99_scaler_t *scaler = &ti99_scalers[loc_render_scaler[TI99.ti99_render_mode]];
+  ti99_scale_job_t job;
+  int count = 0;
+  int last  = 0;
+  int y     = 0;
+
+  loc_scale_job(&job);
+
+  /* Each run of dirty lines becomes a band of target rows, with a line of
+     margin for the filters looking at the neighbours */
+  while (y < TI99_SCREEN_H) {
+    int first;
+    int dst_first;
+    int dst_last;
+
+    if (ti99_dirty.left[y] >= ti99_dirty.right[y]) {
+      y++;
+      continue;
     }
-    step_y++;
-    if (step_y < 5) {
-      src_line += TI99_SCREEN_W;
-    } else  step_y = 0;
+    first = y;
+    while ((y < TI99_SCREEN_H) && (ti99_dirty.left[y] < ti99_dirty.right[y])) y++;
+
+    if (first > 0) first--;
+    dst_first = first * job.dst_h / TI99_SCREEN_H;
+    dst_last  = ((y < TI99_SCREEN_H ? y + 1 : y) * job.dst_h + TI99_SCREEN_H - 1) / TI99_SCREEN_H;
+    if (dst_last > job.dst_h) dst_last = job.dst_h;
+    if (dst_first < last) dst_first = last;
+    if (dst_first >= dst_last) continue;
+
+    ti99_scaler_run(scaler, &job, dst_first, dst_last, TI99.ti99_scaler_threads);
+
+    if (count && (rects[count - 1].y + rects[count - 1].h == dst_first)) {
+      rects[count - 1].h += dst_last - dst_first;
+    } else {
+      rects[count].x = 0;
+      rects[count].y = dst_first;
+      rects[count].w = job.dst_w;
+      rects[count].h = dst_last - dst_first;
+      count++;
+    }
+    last = dst_last;
   }
+  return count;
 }
-# else
+
+/*
+   Automatic frame skipping : the time spent between two synchronizations
+   is measured separately for rendered and skipped frames (microseconds,
+   running averages). A skipped frame costs only the emulation, a rendered
+   one the emulation plus the rendering, so the skip count is the smallest
+   one that keeps the average frame within the budget of the speed limiter.
+ */
+static u32 loc_frame_start    = 0;
+static int loc_frame_rendered = 1;
+static int loc_emu_cost       = 0;
+static int loc_full_cost      = 0;
 
 static void
-ti99_render_fit()
+loc_skip_measure(u32 curclock)
 {
-  SDL_Rect srcRect;
-  SDL_Rect dstRect;
+  int cost;
 
-  srcRect.x = 0;
-  srcRect.y = 0;
-  srcRect.w = TI99_WIDTH;
-  srcRect.h = TI99_HEIGHT;
-  dstRect.x = 0;
-  dstRect.y = 0;
-  dstRect.w = 320;
-  dstRect.h = 240;
+  if (! loc_frame_start) return;
+  cost = (int)(curclock - loc_frame_start);
+  if (loc_frame_rendered) loc_full_cost += (cost - loc_full_cost) >> 3;
+  else                    loc_emu_cost  += (cost - loc_emu_cost ) >> 3;
+}
 
-  SDL_SoftStretch( blit_surface, &srcRect, back_surface, &dstRect );
+static int
+loc_skip_auto()
+{
+  int fps    = TI99.ti99_speed_limiter ? TI99.ti99_speed_limiter : 60;
+  /* Keep some slack for the sound thread */
+  int budget = (1000000 / fps) * 15 / 16;
+  int render = loc_full_cost - loc_emu_cost;
+  int spare  = budget - loc_emu_cost;
+  int skip;
+
+  if (render <= 0) return 0;
+  if (spare  <= 0) return TI99_SKIP_AUTO_MAX;
+
+  skip = (render + spare - 1) / spare - 1;
+  if (skip > TI99_SKIP_AUTO_MAX) skip = TI99_SKIP_AUTO_MAX;
+  return skip;
 }
-# endif
 
+/* Called once per vertical retrace, tells if this frame is to be dropped,
+   in which case neither the VDP nor the scaler do any work for it */
+int
+ti99_skip_frame(int force)
+{
+  if (force || (TI99.psp_skip_cur_frame <= 0)) {
+    if (TI99.psp_skip_max_frame == TI99_SKIP_AUTO) TI99.psp_skip_cur_frame = loc_skip_auto();
+    else                                         TI99.psp_skip_cur_frame = TI99.psp_skip_max_frame;
+    loc_frame_rendered = 1;
+    return 0;
+  }
+  TI99.psp_skip_cur_frame--;
+  loc_frame_rendered = 0;
+  return 1;
+}
 
 void
 ti99_synchronize(void)
 {
-  static u32 nextclock = 1;
   static u32 next_sec_clock = 0;
   static u32 cur_num_frame = 0;
 
-  u32 curclock = SDL_GetTicks();
+  u32 curclock;
+
+  loc_skip_measure(ti99_pacer_now());
 
   if (TI99.ti99_speed_limiter) {
-    while (curclock < nextclock) {
-     curclock = SDL_GetTicks();
-    }
-    u32 f_period = 1000 / TI99.ti99_speed_limiter;
-    nextclock += f_period;
-    if (nextclock < curclock) nextclock = curclock + f_period;
+    ti99_pacer_frame(TI99.ti99_speed_limiter, TI99.ti99_pacing);
   }
 
+  curclock = SDL_GetTicks();
+
   if (TI99.ti99_view_fps) {
     cur_num_frame++;
     if (curclock > next_sec_clock) {
@@ -157,45 +318,73 @@ ti99_synchronize(void)
       cur_num_frame = 0;
     }
   }
+
+  loc_frame_start = ti99_pacer_now();
 }
 
 void
-psp_sdl_render()
+psp_sdl_present()
 {
+  static int last_overlay = 0;
+  SDL_Rect rects[240];
+  int overlay;
+  int count;
+
   if (ti99_in_menu) return;
 
-  if (TI99.psp_skip_cur_frame <= 0) {
+  /* Overlays are drawn over the whole image, repaint it all while they
+     are shown and once after they go away */
+  overlay = psp_kbd_is_danzeff_mode() || TI99.ti99_view_fps || psp_screenshot_mode;
+  if (overlay || last_overlay) ti99_dirty.full = 1;
+  last_overlay = overlay;
 
-    TI99.psp_skip_cur_frame = TI99.psp_skip_max_frame;
+  if (! ti99_dirty.full) {
+    /* Only scale & flip what the VDP changed, nothing at all if the
+       screen is static */
+    if (ti99_dirty.count) {
+      if (TI99.ti99_render_mode == TI99_RENDER_NORMAL) count = ti99_render_normal_dirty(rects);
+      else                                             count = ti99_render_scaled_dirty(rects);
+      psp_sdl_flip_rects(rects, count);
+    }
+    ti99_dirty_clear();
+    return;
+  }
 
-    if (TI99.ti99_render_mode == TI99_RENDER_NORMAL) ti99_render_normal();
-    else                                             ti99_render_fit();
+  ti99_dirty_clear();
 
-    if (psp_kbd_is_danzeff_mode()) {
+  if (TI99.ti99_render_mode == TI99_RENDER_NORMAL) ti99_render_normal();
+  else                                             ti99_render_scaled();
 
-      danzeff_moveTo(-50, -50);
-      danzeff_render( TI99.danzeff_trans );
-    }
+  if (psp_kbd_is_danzeff_mode()) {
 
-    if (TI99.ti99_view_fps) {
-      char buffer[32];
-      sprintf(buffer, "%03d %3d", TI99.ti99_current_clock, (int)TI99.ti99_current_fps );
-      psp_sdl_fill_print(0, 0, buffer, 0xffffff, 0 );
-    }
+    danzeff_moveTo(-50, -50);
+    danzeff_render( TI99.danzeff_trans );
+  }
 
-    psp_sdl_flip();
-  
-    if (psp_screenshot_mode) {
-      psp_screenshot_mode--;
-      if (psp_screenshot_mode <= 0) {
-        psp_sdl_save_screenshot();
-        psp_screenshot_mode = 0;
-      }
-    }
+  if (TI99.ti99_view_fps) {
+    char buffer[32];
+    int  jitter = (ti99_pacer_stats.jitter + 50) / 100;
+    sprintf(buffer, "%03d %3d %d.%d", TI99.ti99_current_clock, (int)TI99.ti99_current_fps,
+            jitter / 10, jitter % 10);
+    psp_sdl_fill_print(0, 0, buffer, 0xffffff, 0 );
+  }
+
+  psp_sdl_flip();
 
-  } else if (TI99.psp_skip_max_frame) {
-    TI99.psp_skip_cur_frame--;
+  if (psp_screenshot_mode) {
+    psp_screenshot_mode--;
+    if (psp_screenshot_mode <= 0) {
+      psp_sdl_save_screenshot();
+      psp_screenshot_mode = 0;
+    }
   }
+}
+
+void
+psp_sdl_render()
+{
+  if (ti99_in_menu) return;
 
+  psp_sdl_present();
   ti99_synchronize();
 }
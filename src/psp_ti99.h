@@ -21,9 +21,32 @@
 extern "C" {
 #endif
 
+# define TI99_DIRTY_LINES  192
+
+     /* Parts of blit_surface changed since the last presented frame */
+     typedef struct ti99_dirty_t {
+       int   full;                      /* present everything */
+       int   count;                     /* number of dirty lines */
+       short left [TI99_DIRTY_LINES];   /* dirty span of each line, */
+       short right[TI99_DIRTY_LINES];   /* clean when left >= right */
+     } ti99_dirty_t;
+
+     extern ti99_dirty_t ti99_dirty;
+
+     void ti99_dirty_all(void);
+     void ti99_dirty_line(int y, int left, int right);
+
      void psp_sdl_render(void);
+     void psp_sdl_present(void);
+     void ti99_synchronize(void);
+     int  ti99_skip_frame(int force);
+     void ti99_video_flush(void);
+     const char *ti99_render_name(int render_mode);
      int  ti99_load_cartridge(const char* filename);
      int  ti99_reset_computer(void);
+     int  ti99_sound_record(int on);
+     int  ti99_sound_recording(void);
+     void ti99_disk_sync(void);
 
 
 #ifdef __cplusplus
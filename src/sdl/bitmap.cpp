@@ -37,6 +37,9 @@
 #include "bitmap.hpp"
 #include "tms9918a-sdl.hpp"
 
+#include "global.h"
+#include "psp_scaler.h"
+
 DBG_REGISTER ( __FILE__ );
 
 cBitMap::cBitMap ( SDL_Surface *surface, bool useScale2x ) :
@@ -462,7 +465,19 @@ void cBitMap::Scale2X ( cBitMap *original )
             Scale2xImp<UCHAR> ( original, pDstData );
             break;
         case 2 :
-            Scale2xImp<USHORT> ( original, pDstData );
+            {
+                // 16 bits surfaces use the shared row kernels
+                ti99_scale_job_t job;
+                job.src       = ( const u16 * ) original->GetData ();
+                job.src_w     = original->Width ();
+                job.src_h     = original->Height ();
+                job.src_pitch = original->Pitch () / sizeof ( u16 );
+                job.dst       = ( u16 * ) pDstData;
+                job.dst_w     = job.src_w * 2;
+                job.dst_h     = job.src_h * 2;
+                job.dst_pitch = Pitch () / sizeof ( u16 );
+                ti99_scaler_run ( &ti99_scalers [ TI99_SCALER_SCALE2X ], &job, 0, job.dst_h, TI99.ti99_scaler_threads );
+            }
             break;
         case 4 :
             Scale2xImp<ULONG> ( original, pDstData );
@@ -498,7 +513,19 @@ void cBitMap::Scale3X ( cBitMap *original )
             Scale3xImp<UCHAR> ( original, pDstData );
             break;
         case 2 :
-            Scale3xImp<USHORT> ( original, pDstData );
+            {
+                // 16 bits surfaces use the shared row kernels
+                ti99_scale_job_t job;
+                job.src       = ( const u16 * ) original->GetData ();
+                job.src_w     = original->Width ();
+                job.src_h     = original->Height ();
+                job.src_pitch = original->Pitch () / sizeof ( u16 );
+                job.dst       = ( u16 * ) pDstData;
+                job.dst_w     = job.src_w * 3;
+                job.dst_h     = job.src_h * 3;
+                job.dst_pitch = Pitch () / sizeof ( u16 );
+                ti99_scaler_run ( &ti99_scalers [ TI99_SCALER_SCALE3X ], &job, 0, job.dst_h, TI99.ti99_scaler_threads );
+            }
             break;
         case 4 :
             Scale3xImp<ULONG> ( original, pDstData );
@@ -588,3 +615,45 @@ void cBitMap::Copy ( cBitMap *original )
 
     }
 }
+
+void cBitMap::Copy ( cBitMap *original, const sRECT *rect )
+{
+    FUNCTION_ENTRY ( this, "cBitMap::Copy", false );
+
+    int scaleX = Width () / original->Width ();
+    int scaleY = Height () / original->Height ();
+
+    // Partial updates are only done for the unscaled case - the scalers need
+    //   the neighbouring pixels, so just redo the whole thing
+    if (( rect == NULL ) || ( min ( scaleX, scaleY ) > 1 )) {
+        Copy ( original );
+        return;
+    }
+
+    int wDif = Width () - original->Width ();
+    int hDif = Height () - original->Height ();
+
+    SDL_Rect srcRect;
+    srcRect.x = ( Sint16 ) rect->Left;
+    srcRect.y = ( Sint16 ) rect->Top;
+    srcRect.w = ( Uint16 ) ( rect->Right - rect->Left );
+    srcRect.h = ( Uint16 ) ( rect->Bottom - rect->Top );
+    SDL_Rect dstRect = srcRect;
+
+    // Center or crop as necessary
+    dstRect.x += wDif / 2;
+    if ( dstRect.x < 0 ) {
+        srcRect.x -= dstRect.x;
+        srcRect.w += dstRect.x;
+        dstRect.x  = 0;
+    }
+
+    dstRect.y += hDif / 2;
+    if ( dstRect.y < 0 ) {
+        srcRect.y -= dstRect.y;
+        srcRect.h += dstRect.y;
+        dstRect.y  = 0;
+    }
+
+    SDL_BlitSurface ( original->m_pSurface, &srcRect, m_pSurface, &dstRect );
+}
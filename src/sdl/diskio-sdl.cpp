@@ -0,0 +1,172 @@
+//----------------------------------------------------------------------------
+//
+// File:        diskio-sdl.cpp
+// Date:        19-Oct-2026
+//
+// Description: This file contains SDL specific code for the disk writer
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include "common.hpp"
+#include "logger.hpp"
+#include "SDL/SDL.h"
+#include "diskio.hpp"
+#include "diskio-sdl.hpp"
+
+DBG_REGISTER ( __FILE__ );
+
+// How long the writer waits for more batches before writing them out
+#define BATCH_DELAY_MS          250
+
+cSdlDiskWriter::cSdlDiskWriter () :
+    m_Mutex ( NULL ),
+    m_IdleCond ( NULL ),
+    m_WorkSem ( NULL ),
+    m_FlushSem ( NULL ),
+    m_Thread ( NULL ),
+    m_Quit ( false ),
+    m_Busy ( false ),
+    m_Head ( NULL ),
+    m_Tail ( NULL )
+{
+    FUNCTION_ENTRY ( this, "cSdlDiskWriter ctor", true );
+
+    m_Mutex    = SDL_CreateMutex ();
+    m_IdleCond = SDL_CreateCond ();
+    m_WorkSem  = SDL_CreateSemaphore ( 0 );
+    m_FlushSem = SDL_CreateSemaphore ( 0 );
+
+    if (( m_Mutex != NULL ) && ( m_IdleCond != NULL ) && ( m_WorkSem != NULL ) && ( m_FlushSem != NULL )) {
+        m_Thread = SDL_CreateThread ( _WriterThreadProc, this );
+    }
+
+    if ( m_Thread == NULL ) {
+        // Submit falls back to writing on the calling thread
+        ERROR ( "Unable to create disk writer thread" );
+    }
+}
+
+cSdlDiskWriter::~cSdlDiskWriter ()
+{
+    FUNCTION_ENTRY ( this, "cSdlDiskWriter dtor", true );
+
+    if ( m_Thread != NULL ) {
+        Sync ();
+        m_Quit = true;
+        SDL_SemPost ( m_WorkSem );
+        SDL_WaitThread ( m_Thread, NULL );
+        m_Thread = NULL;
+    }
+
+    if ( m_FlushSem != NULL ) {
+        SDL_DestroySemaphore ( m_FlushSem );
+        m_FlushSem = NULL;
+    }
+
+    if ( m_WorkSem != NULL ) {
+        SDL_DestroySemaphore ( m_WorkSem );
+        m_WorkSem = NULL;
+    }
+
+    if ( m_IdleCond != NULL ) {
+        SDL_DestroyCond ( m_IdleCond );
+        m_IdleCond = NULL;
+    }
+
+    if ( m_Mutex != NULL ) {
+        SDL_DestroyMutex ( m_Mutex );
+        m_Mutex = NULL;
+    }
+}
+
+int cSdlDiskWriter::_WriterThreadProc ( void *ptr )
+{
+    FUNCTION_ENTRY ( ptr, "cSdlDiskWriter::_WriterThreadProc", true );
+
+    cSdlDiskWriter *pThis = ( cSdlDiskWriter * ) ptr;
+
+    return pThis->WriterThreadProc ();
+}
+
+int cSdlDiskWriter::WriterThreadProc ()
+{
+    FUNCTION_ENTRY ( this, "cSdlDiskWriter::WriterThreadProc", true );
+
+    for ( EVER ) {
+
+        SDL_SemWait ( m_WorkSem );
+
+        if ( m_Quit == true ) break;
+
+        // Sync cuts the wait short
+        SDL_SemWaitTimeout ( m_FlushSem, BATCH_DELAY_MS );
+
+        SDL_mutexP ( m_Mutex );
+        sDiskBatch *list = m_Head;
+        m_Head = m_Tail = NULL;
+        m_Busy = true;
+        SDL_mutexV ( m_Mutex );
+
+        WriteBatches ( list );
+
+        SDL_mutexP ( m_Mutex );
+        m_Busy = false;
+        if ( m_Head == NULL ) SDL_CondBroadcast ( m_IdleCond );
+        SDL_mutexV ( m_Mutex );
+    }
+
+    return 0;
+}
+
+// CPU thread : queue the batch and wake up the writer, never waits for it
+void cSdlDiskWriter::Submit ( sDiskBatch *batch )
+{
+    FUNCTION_ENTRY ( this, "cSdlDiskWriter::Submit", true );
+
+    if ( m_Thread == NULL ) {
+        cDiskWriter::Submit ( batch );
+        return;
+    }
+
+    SDL_mutexP ( m_Mutex );
+    if ( m_Tail != NULL ) m_Tail->Next = batch;
+    else m_Head = batch;
+    while ( batch->Next != NULL ) batch = batch->Next;
+    m_Tail = batch;
+    SDL_mutexV ( m_Mutex );
+
+    if ( SDL_SemValue ( m_WorkSem ) == 0 ) {
+        SDL_SemPost ( m_WorkSem );
+    }
+}
+
+void cSdlDiskWriter::Sync ()
+{
+    FUNCTION_ENTRY ( this, "cSdlDiskWriter::Sync", true );
+
+    if ( m_Thread == NULL ) return;
+
+    SDL_mutexP ( m_Mutex );
+    while (( m_Head != NULL ) || ( m_Busy == true )) {
+        if ( SDL_SemValue ( m_FlushSem ) == 0 ) SDL_SemPost ( m_FlushSem );
+        SDL_CondWait ( m_IdleCond, m_Mutex );
+    }
+    SDL_mutexV ( m_Mutex );
+}
@@ -0,0 +1,125 @@
+//----------------------------------------------------------------------------
+//
+// File:        disklib-sdl.cpp
+// Date:        19-Oct-2026
+//
+// Description: This file contains SDL specific code for the disk library
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include "common.hpp"
+#include "logger.hpp"
+#include "SDL/SDL.h"
+#include "fs.hpp"
+#include "disklib.hpp"
+#include "disklib-sdl.hpp"
+
+DBG_REGISTER ( __FILE__ );
+
+cSdlDiskScanner::cSdlDiskScanner ( int threads ) :
+    m_Mutex ( NULL ),
+    m_Threads ( threads ),
+    m_Job ( NULL ),
+    m_JobCount ( 0 ),
+    m_NextJob ( 0 )
+{
+    FUNCTION_ENTRY ( this, "cSdlDiskScanner ctor", true );
+
+    if ( m_Threads < 1 ) m_Threads = 1;
+    if ( m_Threads > MAX_SCAN_THREADS ) m_Threads = MAX_SCAN_THREADS;
+
+    m_Mutex = SDL_CreateMutex ();
+
+    if ( m_Mutex == NULL ) {
+        // Scan falls back to the calling thread
+        ERROR ( "Unable to create disk scanner mutex" );
+    }
+}
+
+cSdlDiskScanner::~cSdlDiskScanner ()
+{
+    FUNCTION_ENTRY ( this, "cSdlDiskScanner dtor", true );
+
+    if ( m_Mutex != NULL ) {
+        SDL_DestroyMutex ( m_Mutex );
+        m_Mutex = NULL;
+    }
+}
+
+int cSdlDiskScanner::_ScanThreadProc ( void *ptr )
+{
+    FUNCTION_ENTRY ( ptr, "cSdlDiskScanner::_ScanThreadProc", true );
+
+    cSdlDiskScanner *pThis = ( cSdlDiskScanner * ) ptr;
+
+    return pThis->ScanThreadProc ();
+}
+
+int cSdlDiskScanner::ScanThreadProc ()
+{
+    FUNCTION_ENTRY ( this, "cSdlDiskScanner::ScanThreadProc", true );
+
+    for ( EVER ) {
+
+        SDL_mutexP ( m_Mutex );
+        int index = m_NextJob++;
+        SDL_mutexV ( m_Mutex );
+
+        if ( index >= m_JobCount ) break;
+
+        ScanDisk ( &m_Job [index] );
+    }
+
+    return 0;
+}
+
+// The calling thread works through the list along with the others, so the
+//   jobs still get done if no threads could be created
+void cSdlDiskScanner::Scan ( sLibraryJob *job, int count )
+{
+    FUNCTION_ENTRY ( this, "cSdlDiskScanner::Scan", true );
+
+    if (( m_Mutex == NULL ) || ( m_Threads == 1 ) || ( count < 2 )) {
+        cDiskScanner::Scan ( job, count );
+        return;
+    }
+
+    m_Job      = job;
+    m_JobCount = count;
+    m_NextJob  = 0;
+
+    SDL_Thread *thread [ MAX_SCAN_THREADS ];
+
+    int threads = ( m_Threads < count ) ? m_Threads : count;
+
+    for ( int i = 1; i < threads; i++ ) {
+        thread [i] = SDL_CreateThread ( _ScanThreadProc, this );
+        if ( thread [i] == NULL ) WARNING ( "Unable to create disk scanner thread" );
+    }
+
+    ScanThreadProc ();
+
+    for ( int i = 1; i < threads; i++ ) {
+        if ( thread [i] != NULL ) SDL_WaitThread ( thread [i], NULL );
+    }
+
+    m_Job      = NULL;
+    m_JobCount = 0;
+}
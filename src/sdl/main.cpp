@@ -43,9 +43,13 @@
 #include "tms9919.hpp"
 #include "tms9919-sdl.hpp"
 #include "tms5220.hpp"
+#include "tms5220-sdl.hpp"
+#include "vgm.hpp"
 #include "device.hpp"
 #include "diskio.hpp"
+#include "diskio-sdl.hpp"
 #include "ti-disk.hpp"
+#include "ti-dsr.hpp"
 #include "support.hpp"
 #include "option.hpp"
 
@@ -284,6 +288,9 @@ void PrintUsage ()
 
 static cCartridge *loc_ctg = NULL;
 static cSdlTI994A *loc_computer = NULL;
+static cSdlTMS9918A *loc_vdp = NULL;
+static cVgmRecorder *loc_recorder = NULL;
+static cSdlDiskWriter *loc_disk_writer = NULL;
 
 extern "C" {
 
@@ -306,6 +313,52 @@ extern "C" {
     loc_computer->Reset();
     return 0;
   }
+
+  void
+  ti99_video_flush()
+  {
+    if (loc_vdp) loc_vdp->WaitForRender();
+  }
+
+  int
+  ti99_sound_record(int on)
+  {
+    char FileName[MAX_PATH+1];
+
+    if (! on) {
+      if (loc_recorder) {
+        loc_computer->SetRecorder( NULL );
+        delete loc_recorder;
+        loc_recorder = NULL;
+      }
+      return 0;
+    }
+    if (loc_recorder) return 0;
+
+    /* Don't log to a truncated path, it could clobber some other file */
+    int len = snprintf(FileName, sizeof(FileName), "%s/scr/%s.vgm", TI99.ti99_home_dir, TI99.ti99_save_name);
+    if ((len < 0) || (len >= (int) sizeof(FileName))) return 1;
+    loc_recorder = new cVgmRecorder;
+    if (! loc_recorder->Open( FileName, loc_computer->GetCPU()->GetClocks() )) {
+      delete loc_recorder;
+      loc_recorder = NULL;
+      return 1;
+    }
+    loc_computer->SetRecorder( loc_recorder );
+    return 0;
+  }
+
+  int
+  ti99_sound_recording()
+  {
+    return loc_recorder != NULL;
+  }
+
+  void
+  ti99_disk_sync()
+  {
+    if (loc_disk_writer) loc_disk_writer->Sync();
+  }
 }
 
 int SDL_main ( int argc, char *argv [] )
@@ -485,12 +538,17 @@ int SDL_main ( int argc, char *argv [] )
         sdlSound->SetMasterVolume ( volume );
         sound = sdlSound;
     }
-    cTMS5220 *speech = ( flagSpeech == false ) ? NULL : new cTMS5220 ( sound );
+    cTMS5220 *speech = ( flagSpeech == false ) ? NULL : new cSdlTMS5220 ( sound );
 
     vdp->SetFrameRate ( framesOn, framesOff );
 
     cSdlTI994A computer ( consoleROM, vdp, sound, speech );
     loc_computer = &computer;
+    loc_vdp      = vdp;
+
+    // Disk images are written back from their own thread
+    loc_disk_writer = new cSdlDiskWriter ();
+    cDiskMedia::SetWriter ( loc_disk_writer );
 
 # if 0 //LUDO:
     const char *diskFile = LocateFile ( "ti-disk.ctg", "roms" );
@@ -520,6 +578,27 @@ int SDL_main ( int argc, char *argv [] )
     }
 # endif
 
+    // DSKn are served at the file level from dskn.dsk images or dskn directories
+    cDsrDiskDevice *dsr = new cDsrDiskDevice ( vdp );
+    bool dsrMounted = false;
+    for ( int i = 0; i < DSR_MAX_DRIVES; i++ ) {
+        char dskName [16];
+        sprintf ( dskName, "dsk%d.dsk", i + 1 );
+        const char *validName = LocateFile ( dskName, "disks" );
+        if ( validName == NULL ) {
+            sprintf ( dskName, "dsk%d", i + 1 );
+            validName = LocateFile ( dskName, "disks" );
+        }
+        if (( validName != NULL ) && ( dsr->LoadDisk ( i, validName ) == true )) {
+            dsrMounted = true;
+        }
+    }
+    if ( dsrMounted == true ) {
+        computer.AddDevice ( dsr );
+    } else {
+        delete dsr;
+    }
+
     if ( joy1 != NULL ) computer.SetJoystick ( 0, joy1 );
     if ( joy2 != NULL ) computer.SetJoystick ( 1, joy2 );
 
@@ -47,6 +47,8 @@
 #include "support.hpp"
 #include "device.hpp"
 #include "tms9901.hpp"
+#include "global.h"
+#include "psp_pacer.h"
 
 DBG_REGISTER ( __FILE__ );
 
@@ -571,14 +573,27 @@ int cSdlTI994A::TimerHookProc ()
 
     psp_update_keys();
 
-    if ( ellapsedTime > 0 ) {
-        // Limit the emulated speed to 3.0MHz
-        if ( ellapsedCycles / ellapsedTime > 3.0 * 1000.0 ) {
-            Sleep ( 0, 1 );
+    // Audio driven pacing : hand what ran so far to the sound chip and wait
+    //   for the audio callbacks to ask for more, the timer is the fallback
+    bool driven = false;
+    if ( TI99.ti99_pacing == TI99_PACING_DRIVEN ) {
+        m_SoundGenerator->Flush ();
+        driven = ti99_pacer_cycles (( u32 ) clockCycles ) ? true : false;
+    }
+
+    if ( driven == true ) {
+        m_StartClock = m_CPU->GetClocks ();
+        m_StartTime  = SDL_GetTicks ();
+    } else if ( ellapsedTime > 0 ) {
+        // Limit the emulated speed to 3.0MHz - sleep off whatever we are
+        //   ahead rather than polling every millisecond
+        ULONG emulatedTime = ellapsedCycles / 3000;
+        if ( emulatedTime > ellapsedTime ) {
+            Sleep ( 0, emulatedTime - ellapsedTime );
         }
 
         // Reset base time/clocks every 5 minutes to avoid wrap
-        if ( ellapsedTime > 5 * 60 * 1000.0 ) {
+        if ( ellapsedTime > 5 * 60 * 1000 ) {
             m_StartClock = clockCycles;
             m_StartTime  = SDL_GetTicks ();
         }
@@ -588,6 +603,7 @@ int cSdlTI994A::TimerHookProc ()
     if ( clockCycles - m_LastClock > m_RefreshInterval ) {
         m_LastClock = clockCycles;
         m_VDP->Retrace ();
+        m_SoundGenerator->Flush ();
     }
 
     return 0;
@@ -0,0 +1,136 @@
+//----------------------------------------------------------------------------
+//
+// File:        tms5220-sdl.cpp
+// Date:        27-Nov-2000
+// Programmer:  Marc Rousseau
+//
+// Description: This file contains SDL specific code for the TMS5220
+//
+// Copyright (c) 2000-2003 Marc Rousseau, All Rights Reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include "common.hpp"
+#include "logger.hpp"
+#include "SDL/SDL.h"
+#include "tms5220.hpp"
+#include "tms5220-sdl.hpp"
+
+DBG_REGISTER ( __FILE__ );
+
+cSdlTMS5220::cSdlTMS5220 ( cTMS9919 *pSound ) :
+    cTMS5220 ( pSound ),
+    m_Mutex ( NULL ),
+    m_FramesSem ( NULL ),
+    m_Thread ( NULL ),
+    m_Quit ( false )
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS5220 ctor", true );
+
+    // Nothing to synthesize without an audio device
+    if ( m_Ring == NULL ) return;
+
+    m_Mutex     = SDL_CreateMutex ();
+    m_FramesSem = SDL_CreateSemaphore ( 0 );
+
+    if (( m_Mutex != NULL ) && ( m_FramesSem != NULL )) {
+        m_Thread = SDL_CreateThread ( _SynthesizerThreadProc, this );
+    }
+
+    if ( m_Thread == NULL ) {
+        // FramesQueued falls back to synthesizing on the CPU thread
+        ERROR ( "Unable to create speech synthesizer thread" );
+    }
+}
+
+cSdlTMS5220::~cSdlTMS5220 ()
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS5220 dtor", true );
+
+    if ( m_Thread != NULL ) {
+        m_Quit = true;
+        SDL_SemPost ( m_FramesSem );
+        SDL_WaitThread ( m_Thread, NULL );
+        m_Thread = NULL;
+    }
+
+    if ( m_FramesSem != NULL ) {
+        SDL_DestroySemaphore ( m_FramesSem );
+        m_FramesSem = NULL;
+    }
+
+    if ( m_Mutex != NULL ) {
+        SDL_DestroyMutex ( m_Mutex );
+        m_Mutex = NULL;
+    }
+}
+
+int cSdlTMS5220::_SynthesizerThreadProc ( void *ptr )
+{
+    FUNCTION_ENTRY ( ptr, "cSdlTMS5220::_SynthesizerThreadProc", true );
+
+    cSdlTMS5220 *pThis = ( cSdlTMS5220 * ) ptr;
+
+    return pThis->SynthesizerThreadProc ();
+}
+
+int cSdlTMS5220::SynthesizerThreadProc ()
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS5220::SynthesizerThreadProc", true );
+
+    for ( EVER ) {
+
+        SDL_SemWait ( m_FramesSem );
+
+        if ( m_Quit == true ) break;
+
+        SDL_mutexP ( m_Mutex );
+        SynthesizeFrames ();
+        SDL_mutexV ( m_Mutex );
+    }
+
+    return 0;
+}
+
+// CPU thread : wake up the synthesizer, never waits for it
+void cSdlTMS5220::FramesQueued ()
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS5220::FramesQueued", false );
+
+    if ( m_Thread == NULL ) {
+        cTMS5220::FramesQueued ();
+        return;
+    }
+
+    if ( SDL_SemValue ( m_FramesSem ) == 0 ) {
+        SDL_SemPost ( m_FramesSem );
+    }
+}
+
+void cSdlTMS5220::Reset ()
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS5220::Reset", true );
+
+    if ( m_Mutex != NULL ) SDL_mutexP ( m_Mutex );
+
+    cTMS5220::Reset ();
+
+    if ( m_Mutex != NULL ) SDL_mutexV ( m_Mutex );
+}
@@ -37,6 +37,7 @@
 #include "bitmap.hpp"
 #include "tms9918a-sdl.hpp"
 
+#include "global.h"
 #include "psp_sdl.h"
 #include "psp_ti99.h"
 
@@ -50,7 +51,10 @@ cSdlTMS9918A::cSdlTMS9918A ( sRGBQUAD colorTable [17], int refreshRate, bool use
     m_BlankChanged ( false ),
     m_ColorsChanged ( false ),
     m_SpritesChanged ( false ),
+    m_PaletteChanged ( false ),
     m_NeedsUpdate ( false ),
+    m_DirtyLines ( 0 ),
+    m_LastTextMode ( false ),
     m_Scale2x ( useScale2x ),
     m_Screen ( NULL ),
     m_BitmapScreen ( NULL ),
@@ -58,6 +62,13 @@ cSdlTMS9918A::cSdlTMS9918A ( sRGBQUAD colorTable [17], int refreshRate, bool use
     m_CharacterPattern ( NULL ),
     m_BytesPerPixel ( 0 ),
     m_Mutex ( NULL ),
+    m_Snapshot ( NULL ),
+    m_Threaded ( false ),
+    m_RenderQuit ( false ),
+    m_RenderThread ( NULL ),
+    m_FrameReadySem ( NULL ),
+    m_RenderIdleSem ( NULL ),
+    m_FramesDropped ( 0 ),
     m_FullScreen ( false ),
     m_OnFrames ( 1 ),
     m_OffFrames ( 0 ),
@@ -76,6 +87,14 @@ cSdlTMS9918A::cSdlTMS9918A ( sRGBQUAD colorTable [17], int refreshRate, bool use
     memset ( m_SpriteCharUse, 0, sizeof ( m_SpriteCharUse ));
     memset ( m_PatternChanged, 0, sizeof ( m_PatternChanged ));
 
+    memset ( m_DirtyLeft, 0, sizeof ( m_DirtyLeft ));
+    memset ( m_DirtyRight, 0, sizeof ( m_DirtyRight ));
+    memset ( m_SpriteLeft, 0, sizeof ( m_SpriteLeft ));
+    memset ( m_SpriteRight, 0, sizeof ( m_SpriteRight ));
+
+    memset ( &m_Frame, 0, sizeof ( m_Frame ));
+    PublishFrame ( false );
+
     m_CharacterPattern    = new UCHAR [ 3 * 256 * 8 * 8 ];
     memset ( m_CharacterPattern, 0, 3 * 256 * 8 * 8 );
 
@@ -105,8 +124,12 @@ cSdlTMS9918A::~cSdlTMS9918A ()
 {
     FUNCTION_ENTRY ( this, "cSdlTMS9918A dtor", true );
 
+    StopRenderThread ();
+
     SDL_DestroyMutex ( m_Mutex );
 
+    delete m_Snapshot;
+
     delete [] m_CharacterPattern;
 
     delete m_BitmapSpriteScreen;
@@ -309,9 +332,7 @@ void cSdlTMS9918A::ConvertColors ()
     memcpy ( m_SDLColorTable, m_RawColorTable, sizeof ( m_SDLColorTable ));
 
     if ( format->BitsPerPixel == 8 ) {
-        m_Screen->SetPalette ( m_SDLColorTable, SIZE ( m_SDLColorTable ));
-        m_BitmapScreen->SetPalette ( m_SDLColorTable, SIZE ( m_SDLColorTable ));
-        m_BitmapSpriteScreen->SetPalette ( m_SDLColorTable, SIZE ( m_SDLColorTable ));
+        m_PaletteChanged = true;
     } else {
         for ( unsigned i = 0; i < SIZE ( m_SDLColorTable ); i++ ) {
             sRGBQUAD *src = &m_RawColorTable [i];
@@ -330,6 +351,19 @@ void cSdlTMS9918A::ConvertColors ()
 # endif
 }
 
+// The surfaces belong to the renderer - 8-bit palettes are only changed here,
+//   from the color table captured with the frame
+void cSdlTMS9918A::ApplyPalette ()
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9918A::ApplyPalette", true );
+
+    m_Screen->SetPalette ( m_Frame.SDLColorTable, SIZE ( m_Frame.SDLColorTable ));
+    m_BitmapScreen->SetPalette ( m_Frame.SDLColorTable, SIZE ( m_Frame.SDLColorTable ));
+    m_BitmapSpriteScreen->SetPalette ( m_Frame.SDLColorTable, SIZE ( m_Frame.SDLColorTable ));
+
+    m_Frame.PaletteChanged = false;
+}
+
 void cSdlTMS9918A::Reset ()
 {
     FUNCTION_ENTRY ( this, "cSdlTMS9918A::Reset", true );
@@ -385,7 +419,7 @@ void cSdlTMS9918A::UpdateCharacterPatternBitMap ( int ch, UCHAR *pattern )
 
     ASSERT ( ch < 3 * 256 );
 
-    UCHAR *pColor = m_ColorTable->data + ch * 8;
+    UCHAR *pColor = m_Frame.ColorTable->data + ch * 8;
     UCHAR *pData  = m_CharacterPattern + ch * 8 * 8;
 
     for ( int y = 0; y < 8; y++ ) {
@@ -411,6 +445,8 @@ void cSdlTMS9918A::UpdateScreenGraphics ( int x, int y, int ch )
     ASSERT ( y < 24 );
     ASSERT ( ch < 3 * 256 );
 
+    MarkDirty ( x * 8, y * 8, 8, 8 );
+
     UCHAR *pSrcData = m_CharacterPattern + ch * 8 * 8;
     UCHAR *pDstData = m_BitmapScreen->GetData ();
 
@@ -434,7 +470,7 @@ void cSdlTMS9918A::UpdateScreenGraphics ( int x, int y, int ch )
             for ( y = 0; y < 8; y++ ) {
                 USHORT *pDst = ( USHORT * ) pDstData;
                 for ( x = 0; x < 8; x++ ) {
-                    *pDst++ = * ( USHORT * ) &m_SDLColorTable [ *pSrcData++ ];
+                    *pDst++ = * ( USHORT * ) &m_Frame.SDLColorTable [ *pSrcData++ ];
                 }
                 pDstData += dstPitch;
             }
@@ -443,7 +479,7 @@ void cSdlTMS9918A::UpdateScreenGraphics ( int x, int y, int ch )
             for ( y = 0; y < 8; y++ ) {
                 ULONG *pDst = ( ULONG * ) pDstData;
                 for ( x = 0; x < 8; x++ ) {
-                    *pDst++ = * ( ULONG * ) &m_SDLColorTable [ *pSrcData++ ];
+                    *pDst++ = * ( ULONG * ) &m_Frame.SDLColorTable [ *pSrcData++ ];
                 }
                 pDstData += dstPitch;
             }
@@ -459,6 +495,8 @@ void cSdlTMS9918A::UpdateScreenText ( int x, int y, int ch )
     ASSERT ( y < 24 );
     ASSERT ( ch < 256 );
 
+    MarkDirty ( x * 6 + 8, y * 8, 6, 8 );
+
     UCHAR *pSrcData = m_CharacterPattern + ch * 8 * 8;
     UCHAR *pDstData = m_BitmapScreen->GetData ();
 
@@ -481,7 +519,7 @@ void cSdlTMS9918A::UpdateScreenText ( int x, int y, int ch )
             for ( y = 0; y < 8; y++ ) {
                 USHORT *pDst = ( USHORT * ) pDstData;
                 for ( x = 0; x < 6; x++ ) {
-                    *pDst++ = * ( USHORT * ) &m_SDLColorTable [ *pSrcData++ ];
+                    *pDst++ = * ( USHORT * ) &m_Frame.SDLColorTable [ *pSrcData++ ];
                 }
                 pSrcData += 2;
                 pDstData += dstPitch;
@@ -491,7 +529,7 @@ void cSdlTMS9918A::UpdateScreenText ( int x, int y, int ch )
             for ( y = 0; y < 8; y++ ) {
                 ULONG *pDst = ( ULONG * ) pDstData;
                 for ( x = 0; x < 6; x++ ) {
-                    *pDst++ = * ( ULONG * ) &m_SDLColorTable [ *pSrcData++ ];
+                    *pDst++ = * ( ULONG * ) &m_Frame.SDLColorTable [ *pSrcData++ ];
                 }
                 pSrcData += 2;
                 pDstData += dstPitch;
@@ -508,9 +546,11 @@ void cSdlTMS9918A::UpdateScreenMultiColor ( int x, int y, int ch )
     ASSERT ( y < 24 );
     ASSERT ( ch < 256 );
 
-    UCHAR back = ( UCHAR ) ( m_Register [7] & 0x0F );
+    MarkDirty ( x * 8, y * 8, 8, 8 );
 
-    UCHAR *pSrcData = &m_PatternTable->data [ch][( y & 0x03 ) * 2 ];
+    UCHAR back = ( UCHAR ) ( m_Frame.Register [7] & 0x0F );
+
+    UCHAR *pSrcData = &m_Frame.PatternTable->data [ch][( y & 0x03 ) * 2 ];
     UCHAR *pDstData = m_BitmapScreen->GetData ();
 
     int dstPitch = m_BitmapScreen->Pitch ();
@@ -542,10 +582,10 @@ void cSdlTMS9918A::UpdateScreenMultiColor ( int x, int y, int ch )
                 for ( y = 0; y < 4; y++ ) {
                     USHORT *pDst = ( USHORT * ) pDstData;
                     for ( x = 0; x < 4; x++ ) {
-                        *pDst++ = * ( USHORT * ) &m_SDLColorTable [ leftColor ];
+                        *pDst++ = * ( USHORT * ) &m_Frame.SDLColorTable [ leftColor ];
                     }
                     for ( x = 0; x < 4; x++ ) {
-                        *pDst++ = * ( USHORT * ) &m_SDLColorTable [ rightColor ];
+                        *pDst++ = * ( USHORT * ) &m_Frame.SDLColorTable [ rightColor ];
                     }
                     pDstData += dstPitch;
                 }
@@ -554,10 +594,10 @@ void cSdlTMS9918A::UpdateScreenMultiColor ( int x, int y, int ch )
                 for ( y = 0; y < 4; y++ ) {
                     ULONG *pDst = ( ULONG * ) pDstData;
                     for ( x = 0; x < 4; x++ ) {
-                        *pDst++ = * ( ULONG * ) &m_SDLColorTable [ leftColor ];
+                        *pDst++ = * ( ULONG * ) &m_Frame.SDLColorTable [ leftColor ];
                     }
                     for ( x = 0; x < 4; x++ ) {
-                        *pDst++ = * ( ULONG * ) &m_SDLColorTable [ rightColor ];
+                        *pDst++ = * ( ULONG * ) &m_Frame.SDLColorTable [ rightColor ];
                     }
                     pDstData += dstPitch;
                 }
@@ -574,12 +614,12 @@ void cSdlTMS9918A::MarkScreenChanges ( int ch )
 
     ASSERT ( ch < 3 * 256 );
 
-    UCHAR *screen = ( UCHAR * ) m_ImageTable;
-    bool *changed = m_ScreenChanged;
-    int count     = m_CharUse [ch];
-    int max       = m_ImageTableSize;
+    UCHAR *screen = ( UCHAR * ) m_Frame.ImageTable;
+    bool *changed = m_Frame.ScreenChanged;
+    int count     = m_Frame.CharUse [ch];
+    int max       = m_Frame.ImageTableSize;
 
-    if ( m_Mode & VDP_M3 ) {
+    if ( m_Frame.Mode & VDP_M3 ) {
         int index = ch & 0xFF00;
         screen  += index;
         changed += index;
@@ -596,17 +636,93 @@ void cSdlTMS9918A::MarkScreenChanges ( int ch )
     }
 }
 
+void cSdlTMS9918A::MarkDirty ( int x, int y, int width, int height )
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9918A::MarkDirty", false );
+
+    int left   = max ( x, 0 );
+    int right  = min ( x + width, VDP_WIDTH );
+    int bottom = min ( y + height, VDP_HEIGHT );
+
+    if ( left >= right ) return;
+
+    for ( y = max ( y, 0 ); y < bottom; y++ ) {
+        if ( m_DirtyLeft [y] >= m_DirtyRight [y] ) {
+            m_DirtyLeft [y]  = ( short ) left;
+            m_DirtyRight [y] = ( short ) right;
+            m_DirtyLines++;
+        } else {
+            if ( left < m_DirtyLeft [y] ) m_DirtyLeft [y] = ( short ) left;
+            if ( right > m_DirtyRight [y] ) m_DirtyRight [y] = ( short ) right;
+        }
+    }
+}
+
+void cSdlTMS9918A::MarkSpriteExtents ()
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9918A::MarkSpriteExtents", false );
+
+    short left [ VDP_HEIGHT ];
+    short right [ VDP_HEIGHT ];
+
+    memset ( left, 0, sizeof ( left ));
+    memset ( right, 0, sizeof ( right ));
+
+    int count = ( m_Frame.Register [1] & VDP_SPRITE_SIZE ) ? 2 : 1;
+    int size  = ( m_Frame.Register [1] & VDP_SPRITE_MAGNIFY ) ? 16 : 8;
+    int span  = count * size;
+
+    sSpriteAttributeEntry *sprite = &m_Frame.SpriteAttrTable->data [0];
+
+    for ( int i = 0; i < 32; i++, sprite++ ) {
+
+        if ( sprite->posY == 0xD0 ) break;
+
+        int posX = ( int ) sprite->posX;
+        if ( sprite->earlyClock & 0x80 ) posX -= 32;
+
+        int x0 = max ( posX, 0 );
+        int x1 = min ( posX + span, VDP_WIDTH );
+        if ( x0 >= x1 ) continue;
+
+        UCHAR row = ( UCHAR ) ( sprite->posY + 1 );
+        for ( int y = 0; y < span; y++, row++ ) {
+            if ( row >= VDP_HEIGHT ) continue;
+            if ( left [row] >= right [row] ) {
+                left [row]  = ( short ) x0;
+                right [row] = ( short ) x1;
+            } else {
+                if ( x0 < left [row] ) left [row] = ( short ) x0;
+                if ( x1 > right [row] ) right [row] = ( short ) x1;
+            }
+        }
+    }
+
+    // Lines covered by the sprites last frame need repainting too
+    for ( int y = 0; y < VDP_HEIGHT; y++ ) {
+        if ( m_SpriteLeft [y] < m_SpriteRight [y] ) {
+            MarkDirty ( m_SpriteLeft [y], y, m_SpriteRight [y] - m_SpriteLeft [y], 1 );
+        }
+        if ( left [y] < right [y] ) {
+            MarkDirty ( left [y], y, right [y] - left [y], 1 );
+        }
+    }
+
+    memcpy ( m_SpriteLeft, left, sizeof ( m_SpriteLeft ));
+    memcpy ( m_SpriteRight, right, sizeof ( m_SpriteRight ));
+}
+
 void cSdlTMS9918A::DrawSprite ( int index )
 {
     FUNCTION_ENTRY ( this, "cSdlTMS9918A::DrawSprite", false );
 
-    sSpriteAttributeEntry *sprite = &m_SpriteAttrTable->data [index];
+    sSpriteAttributeEntry *sprite = &m_Frame.SpriteAttrTable->data [index];
 
     UCHAR colorIndex = ( UCHAR ) ( sprite->earlyClock & 0x0F );
     if ( colorIndex == 0 ) return;
 
-    int count = ( m_Register [1] & VDP_SPRITE_SIZE ) ? 4 : 1;
-    int size  = ( m_Register [1] & VDP_SPRITE_MAGNIFY ) ? 16 : 8;
+    int count = ( m_Frame.Register [1] & VDP_SPRITE_SIZE ) ? 4 : 1;
+    int size  = ( m_Frame.Register [1] & VDP_SPRITE_MAGNIFY ) ? 16 : 8;
 
     UCHAR *pScreen = m_BitmapSpriteScreen->GetData ();
     int pitch = m_BitmapSpriteScreen->Pitch ();
@@ -620,12 +736,12 @@ void cSdlTMS9918A::DrawSprite ( int index )
 
         UCHAR  row      = ( UCHAR ) ( sprite->posY + 1 + ( i % 2 ) * size );
         UCHAR *pDstData = pScreen + posX * m_BytesPerPixel;
-        UCHAR *pattern  = m_SpriteDescTable->data [(sprite->patternIndex+i)%256];
+        UCHAR *pattern  = m_Frame.SpriteDescTable->data [(sprite->patternIndex+i)%256];
 
         for ( int y = 0; y < size; y++, row++ ) {
 
             // Make sure the current row and sprite are visible
-            if (( row < VDP_HEIGHT ) && ( index <= m_MaxSprite [row] )) {
+            if (( row < VDP_HEIGHT ) && ( index <= m_Frame.MaxSprite [row] )) {
 
                 UCHAR bits   = *pattern;
                 UCHAR *pData = pDstData + row * pitch;
@@ -638,10 +754,10 @@ void cSdlTMS9918A::DrawSprite ( int index )
                                 *pData = colorIndex;
                                 break;
                             case 2 :
-                                * ( USHORT * ) pData = * ( USHORT * ) &m_SDLColorTable [ colorIndex ];
+                                * ( USHORT * ) pData = * ( USHORT * ) &m_Frame.SDLColorTable [ colorIndex ];
                                 break;
                             case 4 :
-                                * ( ULONG * ) pData = * ( ULONG * ) &m_SDLColorTable [ colorIndex ];
+                                * ( ULONG * ) pData = * ( ULONG * ) &m_Frame.SDLColorTable [ colorIndex ];
                                 break;
                         }
                     }
@@ -660,23 +776,23 @@ bool cSdlTMS9918A::RefreshGraphics ()
     FUNCTION_ENTRY ( this, "cSdlTMS9918A::RefreshGraphics", false );
 
     // Check for changes in the character patterns
-    UCHAR fore = ( UCHAR ) ( m_Register [7] >> 4 );
-    UCHAR back = ( UCHAR ) ( m_Register [7] & 0x0F );
+    UCHAR fore = ( UCHAR ) ( m_Frame.Register [7] >> 4 );
+    UCHAR back = ( UCHAR ) ( m_Frame.Register [7] & 0x0F );
     for ( int ch = 0; ch < 256; ch++ ) {
-        if ( ! m_TextMode && ( ch & 0x07 ) == 0 ) {
-            fore = ( UCHAR ) ( m_ColorTable->data [ ch / 8 ] >> 4 );
-            back = ( UCHAR ) ( m_ColorTable->data [ ch / 8 ] & 0x0F );
+        if ( ! m_Frame.TextMode && ( ch & 0x07 ) == 0 ) {
+            fore = ( UCHAR ) ( m_Frame.ColorTable->data [ ch / 8 ] >> 4 );
+            back = ( UCHAR ) ( m_Frame.ColorTable->data [ ch / 8 ] & 0x0F );
         }
-        if ( m_PatternChanged [ch] && m_CharUse [ch] ) {
-            UpdateCharacterPatternGraphics ( ch, fore, back, ( UCHAR * ) &m_PatternTable->data [ch] );
-            m_PatternChanged [ch] = false;
+        if ( m_Frame.PatternChanged [ch] && m_Frame.CharUse [ch] ) {
+            UpdateCharacterPatternGraphics ( ch, fore, back, ( UCHAR * ) &m_Frame.PatternTable->data [ch] );
+            m_Frame.PatternChanged [ch] = false;
             MarkScreenChanges ( ch );
         }
     }
 
     bool needsUpdate = false;
-    bool *changed = m_ScreenChanged;
-    UCHAR *chr = ( UCHAR * ) m_ImageTable;
+    bool *changed = m_Frame.ScreenChanged;
+    UCHAR *chr = ( UCHAR * ) m_Frame.ImageTable;
 
     m_BitmapScreen->LockSurface ();
 
@@ -685,7 +801,7 @@ bool cSdlTMS9918A::RefreshGraphics ()
     for ( int y = 0; y < height; y++ ) {
         for ( int x = 0; x < width; x++ ) {
             if ( *changed++ ) {
-                if ( m_TextMode ) {
+                if ( m_Frame.TextMode ) {
                     UpdateScreenText ( x, y, *chr++ );
                 } else {
                     UpdateScreenGraphics ( x, y, *chr++ );
@@ -698,10 +814,10 @@ bool cSdlTMS9918A::RefreshGraphics ()
     }
 
     if ( needsUpdate ) {
-        memset ( m_ScreenChanged, false, sizeof ( m_ScreenChanged ));
+        memset ( m_Frame.ScreenChanged, false, sizeof ( m_ScreenChanged ));
     }
 
-    if ( m_TextMode && m_ColorsChanged ) {
+    if ( m_Frame.TextMode && m_Frame.ColorsChanged ) {
 
         int x;
         UCHAR *pDstData = ( UCHAR * ) m_BitmapScreen->GetData ();
@@ -721,7 +837,7 @@ bool cSdlTMS9918A::RefreshGraphics ()
                 {
                     USHORT *pDst = ( USHORT * ) pDstData;
                     for ( x = 0; x < 8; x++ ) {
-                        *pDst++ = * ( USHORT * ) &m_SDLColorTable [ back ];
+                        *pDst++ = * ( USHORT * ) &m_Frame.SDLColorTable [ back ];
                     }
                 }
                 break;
@@ -729,7 +845,7 @@ bool cSdlTMS9918A::RefreshGraphics ()
                 {
                     ULONG *pDst = ( ULONG * ) pDstData;
                     for ( x = 0; x < 8; x++ ) {
-                        *pDst++ = * ( ULONG * ) &m_SDLColorTable [ back ];
+                        *pDst++ = * ( ULONG * ) &m_Frame.SDLColorTable [ back ];
                     }
                 }
                 break;
@@ -744,7 +860,10 @@ bool cSdlTMS9918A::RefreshGraphics ()
             pRight += pitch;
         }
 
-        m_ColorsChanged = false;
+        MarkDirty ( 0, 0, 8, VDP_HEIGHT );
+        MarkDirty ( 40 * 6 + 8, 0, 8, VDP_HEIGHT );
+
+        m_Frame.ColorsChanged = false;
     }
 
     m_BitmapScreen->UnlockSurface ();
@@ -758,20 +877,20 @@ bool cSdlTMS9918A::RefreshBitMap ()
 
     // Check for changes in the character patterns
     for ( int ch = 0; ch < 3 * 256; ch++ ) {
-        if ( m_PatternChanged [ch] && m_CharUse [ch] ) {
-            UpdateCharacterPatternBitMap ( ch, ( UCHAR * ) &m_PatternTable->data [ch] );
-            m_PatternChanged [ch] = false;
+        if ( m_Frame.PatternChanged [ch] && m_Frame.CharUse [ch] ) {
+            UpdateCharacterPatternBitMap ( ch, ( UCHAR * ) &m_Frame.PatternTable->data [ch] );
+            m_Frame.PatternChanged [ch] = false;
             MarkScreenChanges ( ch );
         }
     }
 
     bool needsUpdate = false;
-    UCHAR *chr = ( UCHAR * ) m_ImageTable;
+    UCHAR *chr = ( UCHAR * ) m_Frame.ImageTable;
 
     m_BitmapScreen->LockSurface ();
 
-    for ( int i = 0; i < m_ImageTableSize; i++ ) {
-        if ( m_ScreenChanged [i] ) {
+    for ( int i = 0; i < m_Frame.ImageTableSize; i++ ) {
+        if ( m_Frame.ScreenChanged [i] ) {
             UpdateScreenGraphics ( i % 32, i / 32, ( i & 0xFF00 ) + chr [i] );
             needsUpdate = true;
         }
@@ -780,7 +899,7 @@ bool cSdlTMS9918A::RefreshBitMap ()
     m_BitmapScreen->UnlockSurface ();
 
     if ( needsUpdate ) {
-        memset ( m_ScreenChanged, false, sizeof ( m_ScreenChanged ));
+        memset ( m_Frame.ScreenChanged, false, sizeof ( m_ScreenChanged ));
     }
 
     return needsUpdate;
@@ -793,11 +912,11 @@ bool cSdlTMS9918A::RefreshMultiColor ()
     bool needsUpdate = false;
 
     m_BitmapScreen->LockSurface ();
-    UCHAR *chr = ( UCHAR * ) m_ImageTable;
+    UCHAR *chr = ( UCHAR * ) m_Frame.ImageTable;
 
-    for ( int i = 0; i < m_ImageTableSize; i++ ) {
+    for ( int i = 0; i < m_Frame.ImageTableSize; i++ ) {
         UCHAR index = chr [i];
-        if ( m_ScreenChanged [i] || m_PatternChanged [index] ) {
+        if ( m_Frame.ScreenChanged [i] || m_Frame.PatternChanged [index] ) {
             UpdateScreenMultiColor ( i % 32, i / 32, index );
             needsUpdate = true;
         }
@@ -806,8 +925,8 @@ bool cSdlTMS9918A::RefreshMultiColor ()
     m_BitmapScreen->UnlockSurface ();
 
     if ( needsUpdate ) {
-        memset ( m_ScreenChanged, false, sizeof ( m_ScreenChanged ));
-        memset ( m_PatternChanged, false, sizeof ( m_PatternChanged ));
+        memset ( m_Frame.ScreenChanged, false, sizeof ( m_ScreenChanged ));
+        memset ( m_Frame.PatternChanged, false, sizeof ( m_PatternChanged ));
     }
 
     return needsUpdate;
@@ -817,9 +936,26 @@ void cSdlTMS9918A::UpdateSprites ()
 {
     FUNCTION_ENTRY ( this, "cSdlTMS9918A::UpdateSprites", false );
 
-    m_BitmapSpriteScreen->Copy ( m_BitmapScreen );
+    MarkSpriteExtents ();
+
+    // Restore the background under everything that changed - the rest of
+    //   the sprite screen is still valid from the previous frame
+    UCHAR *pSrcData = m_BitmapScreen->GetData ();
+    UCHAR *pDstData = m_BitmapSpriteScreen->GetData ();
+    int srcPitch    = m_BitmapScreen->Pitch ();
+    int dstPitch    = m_BitmapSpriteScreen->Pitch ();
 
-    sSpriteAttributeEntry *sprite = &m_SpriteAttrTable->data [0];
+    for ( int y = 0; y < VDP_HEIGHT; y++ ) {
+        int left  = m_DirtyLeft [y];
+        int right = m_DirtyRight [y];
+        if ( left < right ) {
+            memcpy ( pDstData + left * m_BytesPerPixel, pSrcData + left * m_BytesPerPixel, ( right - left ) * m_BytesPerPixel );
+        }
+        pSrcData += srcPitch;
+        pDstData += dstPitch;
+    }
+
+    sSpriteAttributeEntry *sprite = &m_Frame.SpriteAttrTable->data [0];
 
     int i;
     for ( i = 0; i < 32; i++ ) {
@@ -831,20 +967,20 @@ void cSdlTMS9918A::UpdateSprites ()
         DrawSprite ( i );
     }
 
-    m_SpritesChanged = false;
+    m_Frame.SpritesChanged = false;
 }
 
 void cSdlTMS9918A::BlankScreen ( bool bForce )
 {
     FUNCTION_ENTRY ( this, "cSdlTMS9918A::BlankScreen", true );
 
-    if (( bForce == false ) && (( BlankEnabled () == false ) || ( m_BlankChanged == false ))) return;
+    if (( bForce == false ) && ((( m_Frame.Register [1] & VDP_BLANK_MASK ) != 0 ) || ( m_Frame.BlankChanged == false ))) return;
 
     cBitMap *screen = m_Screen;
 
     screen->LockSurface ();
 
-    UCHAR back      = ( UCHAR ) ( m_Register [7] & 0x0F );
+    UCHAR back      = ( UCHAR ) ( m_Frame.Register [7] & 0x0F );
     UCHAR *pDstData = ( UCHAR * ) screen->GetData ();
     int pitch       = screen->Pitch ();
     int width       = screen->Width ();
@@ -863,7 +999,7 @@ void cSdlTMS9918A::BlankScreen ( bool bForce )
            break;
         case 2 :
             {
-                USHORT color = * ( USHORT * ) &m_SDLColorTable [ back ];
+                USHORT color = * ( USHORT * ) &m_Frame.SDLColorTable [ back ];
                 for ( int y = 0; y < height; y++ ) {
                     USHORT *pData = ( USHORT * ) pDstData;
                     for ( int x = 0; x < width; x++ ) {
@@ -875,7 +1011,7 @@ void cSdlTMS9918A::BlankScreen ( bool bForce )
             break;
         case 4 :
             {
-                ULONG color = * ( ULONG * ) &m_SDLColorTable [ back ];
+                ULONG color = * ( ULONG * ) &m_Frame.SDLColorTable [ back ];
                 for ( int y = 0; y < height; y++ ) {
                     ULONG *pData = ( ULONG * ) pDstData;
                     for ( int x = 0; x < width; x++ ) {
@@ -887,7 +1023,7 @@ void cSdlTMS9918A::BlankScreen ( bool bForce )
             break;
     }
 
-    m_BlankChanged = false;
+    m_Frame.BlankChanged = false;
 
     screen->UnlockSurface ();
 
@@ -902,27 +1038,117 @@ void cSdlTMS9918A::UpdateScreen ()
 
     cBitMap *screen = m_BitmapScreen;
 
-    if ( m_TextMode == false ) {
+    if ( m_Frame.TextMode != m_LastTextMode ) {
+        m_LastTextMode = m_Frame.TextMode;
+        MarkDirty ( 0, 0, VDP_WIDTH, VDP_HEIGHT );
+    }
+
+    if ( m_Frame.TextMode == false ) {
         screen = m_BitmapSpriteScreen;
-        UpdateSprites ();
+        if (( m_DirtyLines > 0 ) || ( m_Frame.SpritesChanged == true )) {
+            UpdateSprites ();
+        }
     }
 
-    m_Screen->Copy ( screen );
+    // The presentation code may have drawn over our surface (menus etc.)
+    if ( ti99_dirty.full ) {
+        m_Screen->Copy ( screen );
+        return;
+    }
+
+    // Copy runs of changed lines, one rectangle per run
+    int y = 0;
+    while ( y < VDP_HEIGHT ) {
+        if ( m_DirtyLeft [y] >= m_DirtyRight [y] ) {
+            y++;
+            continue;
+        }
+        sRECT rect = { m_DirtyLeft [y], m_DirtyRight [y], y, y + 1 };
+        while (( ++y < VDP_HEIGHT ) && ( m_DirtyLeft [y] < m_DirtyRight [y] )) {
+            rect.Left   = min ( rect.Left, ( int ) m_DirtyLeft [y] );
+            rect.Right  = max ( rect.Right, ( int ) m_DirtyRight [y] );
+            rect.Bottom = y + 1;
+        }
+        m_Screen->Copy ( screen, &rect );
+    }
 }
 
-void cSdlTMS9918A::Refresh ( bool force )
+void cSdlTMS9918A::PublishFrame ( bool snapshot )
 {
-    FUNCTION_ENTRY ( this, "cSdlTMS9918A::Refresh", false );
+    FUNCTION_ENTRY ( this, "cSdlTMS9918A::PublishFrame", false );
 
-    // See if we should skip a frame
-    if (( force == false ) && ( m_FrameCycle <= 0 )) {
-        m_FrameCycle += m_OnFrames;
-        return;
+    if ( snapshot == true ) {
+
+        // Take a private copy of VRAM and merge the dirty sets into the ones
+        //   the render thread hasn't consumed yet
+        memcpy ( m_Snapshot->Memory, m_Memory, sizeof ( m_Snapshot->Memory ));
+        memcpy ( m_Snapshot->CharUse, m_CharUse, sizeof ( m_Snapshot->CharUse ));
+
+        for ( unsigned i = 0; i < SIZE ( m_ScreenChanged ); i++ ) {
+            m_Snapshot->ScreenChanged [i] |= m_ScreenChanged [i];
+        }
+        for ( unsigned i = 0; i < SIZE ( m_PatternChanged ); i++ ) {
+            m_Snapshot->PatternChanged [i] |= m_PatternChanged [i];
+        }
+
+        memset ( m_ScreenChanged, false, sizeof ( m_ScreenChanged ));
+        memset ( m_PatternChanged, false, sizeof ( m_PatternChanged ));
+
+        UCHAR *base = m_Snapshot->Memory;
+
+        m_Frame.Memory          = base;
+        m_Frame.ImageTable      = ( sScreenImage * ) ( base + (( UCHAR * ) m_ImageTable - m_Memory ));
+        m_Frame.ColorTable      = ( sColorTable * ) ( base + (( UCHAR * ) m_ColorTable - m_Memory ));
+        m_Frame.PatternTable    = ( sPatternDescriptor * ) ( base + (( UCHAR * ) m_PatternTable - m_Memory ));
+        m_Frame.SpriteAttrTable = ( sSpriteAttribute * ) ( base + (( UCHAR * ) m_SpriteAttrTable - m_Memory ));
+        m_Frame.SpriteDescTable = ( sSpriteDescriptor * ) ( base + (( UCHAR * ) m_SpriteDescTable - m_Memory ));
+        m_Frame.ScreenChanged   = m_Snapshot->ScreenChanged;
+        m_Frame.PatternChanged  = m_Snapshot->PatternChanged;
+        m_Frame.CharUse         = m_Snapshot->CharUse;
+
+    } else {
+
+        m_Frame.Memory          = m_Memory;
+        m_Frame.ImageTable      = m_ImageTable;
+        m_Frame.ColorTable      = m_ColorTable;
+        m_Frame.PatternTable    = m_PatternTable;
+        m_Frame.SpriteAttrTable = m_SpriteAttrTable;
+        m_Frame.SpriteDescTable = m_SpriteDescTable;
+        m_Frame.ScreenChanged   = m_ScreenChanged;
+        m_Frame.PatternChanged  = m_PatternChanged;
+        m_Frame.CharUse         = m_CharUse;
     }
 
-    m_FrameCycle -= m_OffFrames;
+    m_Frame.ImageTableSize = m_ImageTableSize;
+    m_Frame.Mode           = m_Mode;
+    m_Frame.TextMode       = m_TextMode;
+
+    memcpy ( m_Frame.Register, m_Register, sizeof ( m_Frame.Register ));
+    memcpy ( m_Frame.MaxSprite, m_MaxSprite, sizeof ( m_Frame.MaxSprite ));
+    memcpy ( m_Frame.SDLColorTable, m_SDLColorTable, sizeof ( m_Frame.SDLColorTable ));
 
-    if ( BlankEnabled ()) {
+    // Hand the pending changes over to the renderer
+    m_Frame.ChangesMade    |= m_ChangesMade;
+    m_Frame.BlankChanged   |= m_BlankChanged;
+    m_Frame.ColorsChanged  |= m_ColorsChanged;
+    m_Frame.SpritesChanged |= m_SpritesChanged;
+    m_Frame.PaletteChanged |= m_PaletteChanged;
+
+    m_ChangesMade    = false;
+    m_BlankChanged   = false;
+    m_ColorsChanged  = false;
+    m_SpritesChanged = false;
+    m_PaletteChanged = false;
+}
+
+bool cSdlTMS9918A::RenderFrame ()
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9918A::RenderFrame", false );
+
+    if ( m_Frame.PaletteChanged == true ) ApplyPalette ();
+
+    if (( m_Frame.Register [1] & VDP_BLANK_MASK ) == 0 ) {
+        if ( m_Frame.BlankChanged == true ) ti99_dirty_all ();
 # if 0 //TO_BE_DONE
         SDL_mutexP ( m_Mutex );
 # endif
@@ -930,27 +1156,37 @@ void cSdlTMS9918A::Refresh ( bool force )
 # if 0 //TO_BE_DONE
         SDL_mutexV ( m_Mutex );
 # endif
-        return;
+        return false;
     }
 
 # if 0 //LUDO:
-    if ( ! m_ChangesMade && ! m_SpritesChanged ) return;
-    bool colorsChanged = m_ColorsChanged;
+    if ( ! m_Frame.ChangesMade && ! m_Frame.SpritesChanged ) return;
+    bool colorsChanged = m_Frame.ColorsChanged;
 # endif
 
-    if ( m_Mode & VDP_M3 ) {
+    memset ( m_DirtyLeft, 0, sizeof ( m_DirtyLeft ));
+    memset ( m_DirtyRight, 0, sizeof ( m_DirtyRight ));
+    m_DirtyLines = 0;
+
+    // Coming back from a blanked display - everything has to be repainted
+    if ( m_Frame.BlankChanged == true ) {
+        m_Frame.BlankChanged = false;
+        MarkDirty ( 0, 0, VDP_WIDTH, VDP_HEIGHT );
+    }
+
+    if ( m_Frame.Mode & VDP_M3 ) {
         m_NeedsUpdate = RefreshBitMap ();
-    } else if ( m_Mode & VDP_M2 ) {
+    } else if ( m_Frame.Mode & VDP_M2 ) {
         m_NeedsUpdate = RefreshMultiColor ();
     } else {
         m_NeedsUpdate = RefreshGraphics ();
     }
 
-    m_ChangesMade   = false;
-    m_ColorsChanged = false;
+    m_Frame.ChangesMade   = false;
+    m_Frame.ColorsChanged = false;
 
 # if 0 //LUDO: FOR_TEST 0
-    if ( m_NeedsUpdate | m_SpritesChanged | m_BlankChanged ) 
+    if ( m_NeedsUpdate | m_Frame.SpritesChanged | m_Frame.BlankChanged ) 
 # endif
     {
 # if 0 //TO_BE_DONE
@@ -958,14 +1194,165 @@ void cSdlTMS9918A::Refresh ( bool force )
         if ( colorsChanged == true ) BlankScreen ( true );
 # endif
         UpdateScreen ();
-        SDL_UpdateRect ( m_Screen->GetSurface (), 0, 0, m_Screen->Width (), m_Screen->Height ());
 # if 0 //TO_BE_DONE
         SDL_mutexV ( m_Mutex );
 # endif
         m_NeedsUpdate = false;
     }
 
-    psp_sdl_render();
+    // Tell the presentation code what needs to be scaled & flipped
+    for ( int y = 0; y < VDP_HEIGHT; y++ ) {
+        if ( m_DirtyLeft [y] < m_DirtyRight [y] ) {
+            ti99_dirty_line ( y, m_DirtyLeft [y], m_DirtyRight [y] );
+        }
+    }
+
+    return true;
+}
+
+int cSdlTMS9918A::_RenderThreadProc ( void *ptr )
+{
+    FUNCTION_ENTRY ( ptr, "cSdlTMS9918A::_RenderThreadProc", true );
+
+    cSdlTMS9918A *pThis = ( cSdlTMS9918A * ) ptr;
+
+    return pThis->RenderThreadProc ();
+}
+
+int cSdlTMS9918A::RenderThreadProc ()
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9918A::RenderThreadProc", true );
+
+    for ( EVER ) {
+
+        SDL_SemWait ( m_FrameReadySem );
+
+        if ( m_RenderQuit == true ) break;
+
+        if ( RenderFrame () == true ) {
+            psp_sdl_present ();
+        }
+
+        SDL_SemPost ( m_RenderIdleSem );
+    }
+
+    return 0;
+}
+
+bool cSdlTMS9918A::StartRenderThread ()
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9918A::StartRenderThread", true );
+
+    if ( m_RenderThread != NULL ) return true;
+
+    if ( m_Snapshot == NULL ) {
+        m_Snapshot = new sVDPSnapshot;
+        memset ( m_Snapshot, 0, sizeof ( sVDPSnapshot ));
+    }
+
+    m_FrameReadySem = SDL_CreateSemaphore ( 0 );
+    m_RenderIdleSem = SDL_CreateSemaphore ( 1 );
+    m_RenderQuit    = false;
+
+    m_RenderThread = SDL_CreateThread ( _RenderThreadProc, this );
+
+    if ( m_RenderThread == NULL ) {
+        ERROR ( "Unable to create render thread" );
+        SDL_DestroySemaphore ( m_FrameReadySem );
+        SDL_DestroySemaphore ( m_RenderIdleSem );
+        m_FrameReadySem = NULL;
+        m_RenderIdleSem = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+void cSdlTMS9918A::StopRenderThread ()
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9918A::StopRenderThread", true );
+
+    if ( m_RenderThread == NULL ) return;
+
+    m_RenderQuit = true;
+    SDL_SemPost ( m_FrameReadySem );
+    SDL_WaitThread ( m_RenderThread, NULL );
+
+    SDL_DestroySemaphore ( m_FrameReadySem );
+    SDL_DestroySemaphore ( m_RenderIdleSem );
+
+    m_RenderThread  = NULL;
+    m_FrameReadySem = NULL;
+    m_RenderIdleSem = NULL;
+}
+
+void cSdlTMS9918A::WaitForRender ()
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9918A::WaitForRender", true );
+
+    if ( m_RenderThread == NULL ) return;
+
+    // Wait for the frame in flight (if any) to be presented
+    SDL_SemWait ( m_RenderIdleSem );
+    SDL_SemPost ( m_RenderIdleSem );
+}
+
+void cSdlTMS9918A::Refresh ( bool force )
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9918A::Refresh", false );
+
+    // See if we should skip a frame
+    if (( force == false ) && ( m_FrameCycle <= 0 )) {
+        m_FrameCycle += m_OnFrames;
+        return;
+    }
+
+    m_FrameCycle -= m_OffFrames;
+
+    bool threaded = ( TI99.ti99_render_thread != 0 ) && StartRenderThread ();
+
+    if ( threaded != m_Threaded ) {
+        // Switching between live state and the snapshot - let any frame in
+        //   flight finish and repaint everything from the new source
+        WaitForRender ();
+        m_Threaded       = threaded;
+        m_ChangesMade    = true;
+        m_SpritesChanged = true;
+        m_BlankChanged   = true;
+        memset ( m_ScreenChanged, true, sizeof ( m_ScreenChanged ));
+        memset ( m_PatternChanged, true, sizeof ( m_PatternChanged ));
+    }
+
+    // Dropped frames cost nothing but the emulation, the VDP dirty sets
+    //   keep accumulating until a frame is rendered
+    if ( ! ti99_in_menu && ti99_skip_frame ( force )) {
+        ti99_synchronize ();
+        return;
+    }
+
+    if ( threaded == false ) {
+        PublishFrame ( false );
+        if ( RenderFrame () == true ) {
+            psp_sdl_render ();
+        }
+        return;
+    }
+
+    // Hand the frame to the render thread.  If it is still busy with the
+    //   previous one, drop this frame - the dirty sets keep accumulating and
+    //   will be picked up by the next retrace.
+    if ( force == true ) {
+        SDL_SemWait ( m_RenderIdleSem );
+    } else if ( SDL_SemTryWait ( m_RenderIdleSem ) != 0 ) {
+        m_FramesDropped++;
+        if ( ! ti99_in_menu ) ti99_synchronize ();
+        return;
+    }
+
+    PublishFrame ( true );
+    SDL_SemPost ( m_FrameReadySem );
+
+    if ( ! ti99_in_menu ) ti99_synchronize ();
 }
 
 cBitMap *cSdlTMS9918A::GetScreen ()
@@ -1029,9 +1416,7 @@ void cSdlTMS9918A::WriteRegister ( int reg, UCHAR value )
             m_SDLColorTable [ 0] = m_SDLColorTable [ newReg & 0x0F ];
             m_SDLColorTable [16] = m_SDLColorTable [ newReg >> 4 ];
             if ( m_BytesPerPixel == 1 ) {
-                SDL_SetColors ( m_Screen->GetSurface (), m_SDLColorTable, 0, SIZE ( m_SDLColorTable ));
-                SDL_SetColors ( m_BitmapScreen->GetSurface (), m_SDLColorTable, 0, SIZE ( m_SDLColorTable ));
-                SDL_SetColors ( m_BitmapSpriteScreen->GetSurface (), m_SDLColorTable, 0, SIZE ( m_SDLColorTable ));
+                m_PaletteChanged = true;
             }
             // Fall through
 
@@ -32,6 +32,12 @@
 
 #include <iostream>
 #include <memory.h>
+#include <math.h>
+#if defined ( __SSE2__ )
+    #include <emmintrin.h>
+#elif defined ( __ARM_NEON__ ) || defined ( __ARM_NEON )
+    #include <arm_neon.h>
+#endif
 #include "common.hpp"
 #include "logger.hpp"
 #include "SDL/SDL.h"
@@ -39,6 +45,7 @@
 #include "tms9919-sdl.hpp"
 #include "tms5220.hpp"
 #include "global.h"
+#include "psp_pacer.h"
 
 DBG_REGISTER ( __FILE__ );
 
@@ -54,18 +61,96 @@ DBG_REGISTER ( __FILE__ );
 #define NOISE_WHITE_GENERATOR    0x12000
 #define NOISE_PERIODIC_GENERATOR 0x08000
 
-cSdlTMS9919::cSdlTMS9919 ( int sampleFreq ) :
+#define CLOCK_FREQUENCY          3579545
+#define CPU_FREQUENCY            3000000
+
+// Band-limited steps : for each sub-sample phase a windowed sinc impulse
+//   of BLEP_WIDTH taps summing to 1 << BLEP_UNIT_BITS.  Edges add scaled
+//   impulses to a delta buffer whose running sum is the output.
+#define BLEP_PHASE_BITS          5
+#define BLEP_PHASES              ( 1 << BLEP_PHASE_BITS )
+#define BLEP_WIDTH               16
+#define BLEP_UNIT_BITS           15
+#define BLEP_CUTOFF              0.90
+
+// The resampling ratio is bent by at most 1/200th (about 9 cents) to keep
+//   the sample ring at the target latency
+#define RATE_MAX_ADJUST          328
+
+extern "C" ULONG ClockCycleCounter;
+
+static short BlepTable [ BLEP_PHASES ][ BLEP_WIDTH ];
+static bool  BlepTableReady = false;
+
+static void InitBlepTable ()
+{
+    FUNCTION_ENTRY ( NULL, "InitBlepTable", true );
+
+    if ( BlepTableReady == true ) return;
+
+    for ( int p = 0; p < BLEP_PHASES; p++ ) {
+        double kernel [ BLEP_WIDTH ];
+        double sum = 0.0;
+        for ( int k = 0; k < BLEP_WIDTH; k++ ) {
+            double x = k - ( BLEP_WIDTH / 2 - 1 ) - ( double ) p / BLEP_PHASES;
+            double s = ( x == 0.0 ) ? 1.0 : sin ( M_PI * BLEP_CUTOFF * x ) / ( M_PI * BLEP_CUTOFF * x );
+            double w = 0.42 + 0.5 * cos ( 2.0 * M_PI * x / BLEP_WIDTH ) + 0.08 * cos ( 4.0 * M_PI * x / BLEP_WIDTH );
+            kernel [k] = s * w;
+            sum += kernel [k];
+        }
+        // Scale to fixed point and make sure each phase sums exactly to one
+        int total = 0, peak = 0;
+        for ( int k = 0; k < BLEP_WIDTH; k++ ) {
+            BlepTable [p][k] = ( short ) floor ( kernel [k] / sum * ( 1 << BLEP_UNIT_BITS ) + 0.5 );
+            total += BlepTable [p][k];
+            if ( BlepTable [p][k] > BlepTable [p][peak] ) peak = k;
+        }
+        BlepTable [p][peak] += ( 1 << BLEP_UNIT_BITS ) - total;
+    }
+
+    BlepTableReady = true;
+}
+
+cSdlTMS9919::cSdlTMS9919 ( int sampleFreq, bool useDevice ) :
     m_Initialized ( false ),
+    m_Offline ( ! useDevice ),
     m_MasterVolume ( 0 ),
     m_ShiftRegister ( NOISE_RESET ),
     m_NoiseGenerator ( 0 ),
-    m_MixBuffer ( NULL )
+    m_Delta ( NULL ),
+    m_Integrator ( 0 ),
+    m_Muted ( false ),
+    m_QueueHead ( 0 ),
+    m_QueueTail ( 0 ),
+    m_EventsDropped ( 0 ),
+    m_AudioNoiseColor (( NOISE_COLOR_E ) -1 ),
+    m_AudioNoiseType ( -1 ),
+    m_AudioClock ( 0 ),
+    m_AudioFraction ( 0 ),
+    m_DeltaSize ( 0 ),
+    m_Ring ( NULL ),
+    m_RingSize ( 0 ),
+    m_RingHead ( 0 ),
+    m_RingTail ( 0 ),
+    m_OutBuffer ( NULL ),
+    m_LastSample ( 0 ),
+    m_Priming ( true ),
+    m_Underruns ( 0 ),
+    m_Overruns ( 0 ),
+    m_TargetFill ( 0 ),
+    m_RateAdjust ( 0 )
 {
     FUNCTION_ENTRY ( this, "cSdlTMS9919 ctor", true );
 
     memset ( m_VolumeTable, 0, sizeof ( m_VolumeTable ));
     memset ( &m_AudioSpec, 0, sizeof ( m_AudioSpec ));
     memset ( m_Info, 0, sizeof ( m_Info ));
+    memset ( m_Queue, 0, sizeof ( m_Queue ));
+
+    for ( int i = 0; i < 4; i++ ) {
+        m_AudioFrequency [i]   = 0;
+        m_AudioAttenuation [i] = 0x0F;
+    }
 
     SetMasterVolume ( 50 );
 
@@ -77,14 +162,20 @@ cSdlTMS9919::cSdlTMS9919 ( int sampleFreq ) :
     }
     m_VolumeTable [15] = 0;
 
+    InitBlepTable ();
+
     SDL_AudioSpec wanted;
     memset ( &wanted, 0, sizeof ( SDL_AudioSpec ));
 
     if ( sampleFreq > 44100 ) sampleFreq = 44100;
 
     // Make sure the sample buffer is the right size based on the frequency
-    int ratio   = 44100 / sampleFreq;
-    int samples = DEFAULT_SAMPLES / ratio;
+    //   unless the settings ask for a given size
+    int samples = TI99.ti99_snd_buffer;
+    if ( samples <= 0 ) {
+        int ratio = 44100 / sampleFreq;
+        samples   = DEFAULT_SAMPLES / ratio;
+    }
 
     // Set the audio format
     wanted.freq     = sampleFreq;
@@ -98,6 +189,14 @@ cSdlTMS9919::cSdlTMS9919 ( int sampleFreq ) :
     wanted.callback = _AudioCallback;
     wanted.userdata = this;
 
+    bool opened = false;
+
+    if ( m_Offline == true ) {
+        // Offline rendering has no device, ReadSamples pulls the samples
+        memcpy ( &m_AudioSpec, &wanted, sizeof ( SDL_AudioSpec ));
+        m_AudioSpec.format = AUDIO_S16SYS;
+        opened = true;
+    } else
      // Open the audio device, forcing the desired format
 # if 0
     if (( SDL_OpenAudio ( &wanted, &m_AudioSpec ) < 0 ) || (( m_AudioSpec.format & 0x000F ) != 8 )) 
@@ -114,10 +213,26 @@ cSdlTMS9919::cSdlTMS9919 ( int sampleFreq ) :
 std::cout << "Using " << std::hex << m_AudioSpec.format << std::dec << " freq " << m_AudioSpec.freq << "Hz Audio" 
           << "Buffer size: " << m_AudioSpec.samples << std::endl;
 # endif
+        opened = true;
+    }
+
+    if ( opened == true ) {
+        // The ring must hold the longest latency plus a device buffer, a
+        //   single Flush may render up to half of it
+        m_RingSize = 1;
+        while ( m_RingSize < 2 * ( m_AudioSpec.freq * TI99_SND_LATENCY_MAX / 1000 + m_AudioSpec.samples )) {
+            m_RingSize <<= 1;
+        }
+        m_DeltaSize = m_RingSize / 2 + BLEP_WIDTH;
+
         m_Initialized = true;
-        m_MixBuffer   = new Uint8 [ m_AudioSpec.samples * 4 ];
-        memset ( m_MixBuffer, m_AudioSpec.silence, m_AudioSpec.samples );
-        SDL_PauseAudio ( false );
+        m_Delta       = new int [ m_DeltaSize ];
+        memset ( m_Delta, 0, m_DeltaSize * sizeof ( int ));
+        m_Ring        = new Sint16 [ m_RingSize ];
+        memset ( m_Ring, 0, m_RingSize * sizeof ( Sint16 ));
+        m_OutBuffer   = new Sint16 [ m_AudioSpec.samples ];
+        m_AudioClock  = ClockCycleCounter;
+        if ( m_Offline == false ) SDL_PauseAudio ( false );
     }
 
     NOISE_COLOR_E color = m_NoiseColor;
@@ -131,12 +246,18 @@ cSdlTMS9919::~cSdlTMS9919 ()
 {
     FUNCTION_ENTRY ( this, "cSdlTMS9919 dtor", true );
 
-    if ( m_Initialized == true ) {
+    if (( m_Initialized == true ) && ( m_Offline == false )) {
         SDL_PauseAudio ( true );
         SDL_CloseAudio ();
     }
 
-    delete [] m_MixBuffer;
+    if (( m_Underruns != 0 ) || ( m_Overruns != 0 ) || ( m_EventsDropped != 0 )) {
+        TRACE ( "Audio underruns: " << m_Underruns << " overruns: " << m_Overruns << " dropped events: " << m_EventsDropped );
+    }
+
+    delete [] m_Delta;
+    delete [] m_Ring;
+    delete [] m_OutBuffer;
 }
 
 void cSdlTMS9919::_AudioCallback ( void *data, Uint8 *stream, int length )
@@ -146,84 +267,385 @@ void cSdlTMS9919::_AudioCallback ( void *data, Uint8 *stream, int length )
     (( cSdlTMS9919 * ) data)->AudioCallback ( stream, length );
 }
 
-static inline void loc_remix_8to16( Uint8* stream, Uint8* mix_buffer, int length )
+// Master volume in 1/256th, Dingux sets it on the OSS mixer instead
+static inline int loc_output_gain ()
 {
-  Uint16* p_tgt = (Uint16 *)stream;
-  Uint8*  p_src = (Uint8  *)mix_buffer;
-  while (length-- > 0) {
-    *p_tgt++ = (*p_src++) << 8;
-  }
+# if defined(DINGUX_MODE)
+    return 256;
+# else
+    return gp2xGetSoundVolume () * 256 / 100;
+# endif
 }
 
-void cSdlTMS9919::AudioCallback ( Uint8 *stream, int length )
+// Saturating conversions of the int32 mix to the device format
+static void loc_convert_s16 ( const int *src, Sint16 *dst, int count )
 {
-    FUNCTION_ENTRY ( this, "cSdlTMS9919::AudioCallback", false );
+    int i = 0;
 
-    // 8 bits
-# if defined(WIZ_MODE) || defined(GP2X_MODE) // || defined(LINUX_MODE)
-    memset ( m_MixBuffer, m_AudioSpec.silence, length );
-    int MasterVolume = gp2xGetSoundVolume();
-    if (!TI99.ti99_snd_enable) {
-      int volume = ( MasterVolume * SDL_MIX_MAXVOLUME ) / 100;
-      SDL_MixAudio ( stream, m_MixBuffer, length, volume );
-      return;
-    }
-# else // 16 bits
-    length = length >> 1;
-    memset ( m_MixBuffer, m_AudioSpec.silence, length );
-    if (!TI99.ti99_snd_enable) {
-      loc_remix_8to16( stream, m_MixBuffer, length );
-      return;
+# if defined(__SSE2__)
+    for ( ; i + 8 <= count; i += 8 ) {
+        __m128i lo = _mm_loadu_si128 (( const __m128i * ) ( src + i ));
+        __m128i hi = _mm_loadu_si128 (( const __m128i * ) ( src + i + 4 ));
+        _mm_storeu_si128 (( __m128i * ) ( dst + i ), _mm_packs_epi32 ( lo, hi ));
+    }
+# elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+    for ( ; i + 8 <= count; i += 8 ) {
+        int16x4_t lo = vqmovn_s32 ( vld1q_s32 ( src + i ));
+        int16x4_t hi = vqmovn_s32 ( vld1q_s32 ( src + i + 4 ));
+        vst1q_s16 ( dst + i, vcombine_s16 ( lo, hi ));
+    }
+# endif
+
+    for ( ; i < count; i++ ) {
+        int sample = src [i];
+        dst [i] = ( sample > 32767 ) ? 32767 : ( sample < -32768 ) ? -32768 : sample;
+    }
+}
+
+static void loc_convert_s8 ( const Sint16 *src, Sint8 *dst, int count )
+{
+    int i = 0;
+
+# if defined(__SSE2__)
+    for ( ; i + 16 <= count; i += 16 ) {
+        __m128i lo = _mm_srai_epi16 ( _mm_loadu_si128 (( const __m128i * ) ( src + i     )), 8 );
+        __m128i hi = _mm_srai_epi16 ( _mm_loadu_si128 (( const __m128i * ) ( src + i + 8 )), 8 );
+        _mm_storeu_si128 (( __m128i * ) ( dst + i ), _mm_packs_epi16 ( lo, hi ));
+    }
+# elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+    for ( ; i + 8 <= count; i += 8 ) {
+        vst1_s8 ( dst + i, vshrn_n_s16 ( vld1q_s16 ( src + i ), 8 ));
     }
 # endif
 
-    bool mix = false;
+    for ( ; i < count; i++ ) {
+        dst [i] = ( Sint8 ) ( src [i] >> 8 );
+    }
+}
+
+void cSdlTMS9919::AddStep ( int time, int delta )
+{
+    if ( time < 0 ) time = 0;
+
+    const short *kernel = BlepTable [( time >> ( 16 - BLEP_PHASE_BITS )) & ( BLEP_PHASES - 1 )];
+    int *out = m_Delta + ( time >> 16 );
+    int sum  = 0;
+
+    for ( int k = 0; k < BLEP_WIDTH; k++ ) {
+        int value = ( delta * kernel [k] ) >> BLEP_UNIT_BITS;
+        out [k] += value;
+        sum     += value;
+    }
+
+    // Rounding must not leave anything behind in the integrator
+    out [ BLEP_WIDTH / 2 - 1 ] += delta - sum;
+}
+
+void cSdlTMS9919::SetLevel ( sVoiceInfo *info, int time, int level )
+{
+    if ( level == info->level ) return;
+
+    AddStep ( time, level - info->level );
+    info->level = level;
+}
+
+// Generates every edge of every voice before the given time
+void cSdlTMS9919::RunVoices ( int end )
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9919::RunVoices", false );
 
     for ( int i = 0; i < 4; i++ ) {
         sVoiceInfo *info = &m_Info [i];
-        if (( m_Attenuation [i] != 15 ) && ( info->period >= 1.0 )) {
-            mix = true;
-            int left = length, j = 0;
-            do {
-                int count = ( info->toggle < left ) ? ( int ) info->toggle : left;
-                left -= count;
-                info->toggle -= count;
-                while ( count-- ) {
-                    m_MixBuffer [j++] += info->setting;
-                }
-                if ( info->toggle < 1.0 ) {
-                    info->toggle += info->period;
-                    if ( i < 3 ) {
-                        // Tone
-                        info->setting = -info->setting;
-                    } else {
-                        // Noise
-                        if ( m_ShiftRegister & 1 ) {
-                            m_ShiftRegister ^= m_NoiseGenerator;
-                            // Protect against 0
-                            if ( m_ShiftRegister == 0 ) {
-                                m_ShiftRegister = NOISE_RESET;
-                            }
-                            info->setting = -info->setting;
-                        }
-                        m_ShiftRegister >>= 1;
+        if (( info->period == 0 ) || ( info->phase >= end )) continue;
+        int volume = m_VolumeTable [ m_AudioAttenuation [i]] << 8;
+        if ( volume == 0 ) {
+            info->phase += (( end - info->phase ) / info->period + 1 ) * info->period;
+            continue;
+        }
+        do {
+            if ( i < 3 ) {
+                // Tone
+                info->sign = -info->sign;
+            } else {
+                // Noise
+                if ( m_ShiftRegister & 1 ) {
+                    m_ShiftRegister ^= m_NoiseGenerator;
+                    // Protect against 0
+                    if ( m_ShiftRegister == 0 ) {
+                        m_ShiftRegister = NOISE_RESET;
                     }
+                    info->sign = -info->sign;
                 }
-            } while ( left > 0 );
+                m_ShiftRegister >>= 1;
+            }
+            SetLevel ( info, info->phase, info->sign * volume );
+            info->phase += info->period;
+        } while ( info->phase < end );
+    }
+}
+
+// Restart the integrator from the current voice levels
+void cSdlTMS9919::ResetDelta ()
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9919::ResetDelta", false );
+
+    memset ( m_Delta, 0, m_DeltaSize * sizeof ( int ));
+
+    m_Integrator = 0;
+    for ( int i = 0; i < 4; i++ ) {
+        m_Integrator += m_Info [i].level;
+    }
+}
+
+int cSdlTMS9919::RingFill () const
+{
+    return ( m_RingHead - m_RingTail ) & ( m_RingSize - 1 );
+}
+
+// Applies whatever is pending at once and restarts from the current clock,
+//   used when the CPU clock jumped or stood still for too long
+void cSdlTMS9919::Resync ()
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9919::Resync", false );
+
+    while ( m_QueueTail != m_QueueHead ) {
+        ApplyEvent ( &m_Queue [ m_QueueTail ], 0 );
+        m_QueueTail = ( m_QueueTail + 1 ) & ( SOUND_QUEUE_SIZE - 1 );
+    }
+
+    for ( int i = 0; i < 4; i++ ) {
+        sVoiceInfo *info = &m_Info [i];
+        if ( info->phase > info->period ) info->phase = info->period;
+    }
+
+    m_AudioClock    = ClockCycleCounter;
+    m_AudioFraction = 0;
+}
+
+// Turns the first samples of m_Delta into output and hands them to the
+//   audio thread
+void cSdlTMS9919::RenderSamples ( int count )
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9919::RenderSamples", false );
+
+    if ( m_Muted == true ) {
+        memset ( m_Delta, 0, count * sizeof ( int ));
+        // Speech keeps running while muted so its FIFO drains
+        if ( m_pSpeechSynthesizer != NULL ) {
+            m_pSpeechSynthesizer->AudioCallback ( NULL, count );
+        }
+    } else {
+        // Integrate the deltas in place, m_Delta [0, count) becomes the output
+        int acc = m_Integrator;
+        for ( int i = 0; i < count; i++ ) {
+            acc += m_Delta [i];
+            m_Delta [i] = acc;
+        }
+        m_Integrator = acc;
+
+        // Speech adds its full precision samples straight into the mix
+        if ( m_pSpeechSynthesizer != NULL ) {
+            m_pSpeechSynthesizer->AudioCallback ( m_Delta, count );
+        }
+
+        int gain = ( m_Offline == true ) ? 256 : loc_output_gain ();
+        if ( gain != 256 ) {
+            for ( int i = 0; i < count; i++ ) {
+                m_Delta [i] = ( m_Delta [i] * gain ) >> 8;
+            }
         }
     }
 
-    if ( m_pSpeechSynthesizer != NULL ) {
-        mix |= m_pSpeechSynthesizer->AudioCallback ( m_MixBuffer, length );
+    PushSamples ( m_Delta, count );
+
+    // Keep the tails of the last impulses for the next block
+    memmove ( m_Delta, m_Delta + count, BLEP_WIDTH * sizeof ( int ));
+    memset ( m_Delta + BLEP_WIDTH, 0, count * sizeof ( int ));
+}
+
+// CPU thread : append samples to the ring, what does not fit is dropped
+void cSdlTMS9919::PushSamples ( const int *src, int count )
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9919::PushSamples", false );
+
+    int head  = m_RingHead;
+    int space = m_RingSize - 1 - RingFill ();
+
+    if ( count > space ) {
+        m_Overruns++;
+        count = space;
     }
 
-    if ( mix == true ) {
-# if defined(WIZ_MODE) || defined(GP2X_MODE) // || defined(LINUX_MODE)
-        int volume = ( MasterVolume * SDL_MIX_MAXVOLUME ) / 100;
-        SDL_MixAudio ( stream, m_MixBuffer, length, volume );
-# else 
-      loc_remix_8to16( stream, m_MixBuffer, length );
-# endif
+    int first = m_RingSize - head;
+    if ( first > count ) first = count;
+
+    loc_convert_s16 ( src, m_Ring + head, first );
+    loc_convert_s16 ( src + first, m_Ring, count - first );
+
+    __sync_synchronize ();
+    m_RingHead = ( head + count ) & ( m_RingSize - 1 );
+}
+
+// CPU thread : bend the rate towards the target latency, smoothed since the
+//   fill level moves by a whole device buffer at each callback
+void cSdlTMS9919::AdjustRate ()
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9919::AdjustRate", false );
+
+    bool muted = ! TI99.ti99_snd_enable;
+    if ( muted != m_Muted ) {
+        m_Muted = muted;
+        if ( muted == false ) ResetDelta ();
+    }
+
+    int target = m_AudioSpec.freq * TI99.ti99_snd_latency / 1000;
+    if ( target < m_AudioSpec.samples + m_AudioSpec.freq / 50 ) target = m_AudioSpec.samples + m_AudioSpec.freq / 50;
+    if ( target > m_RingSize / 2 ) target = m_RingSize / 2;
+    m_TargetFill = target;
+
+    // Audio driven pacing produces exactly what the device consumes
+    if ( TI99.ti99_pacing == TI99_PACING_DRIVEN ) {
+        m_RateAdjust = 0;
+        return;
+    }
+
+    int wanted = ( int ) (( long long ) RATE_MAX_ADJUST * ( target - RingFill ()) / target );
+    if ( wanted >  RATE_MAX_ADJUST ) wanted =  RATE_MAX_ADJUST;
+    if ( wanted < -RATE_MAX_ADJUST ) wanted = -RATE_MAX_ADJUST;
+    m_RateAdjust += ( wanted - m_RateAdjust ) / 8;
+}
+
+// CPU thread : renders the samples up to the current CPU clock, called
+//   once per frame
+void cSdlTMS9919::Flush ()
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9919::Flush", false );
+
+    if ( m_Initialized == false ) return;
+
+    // Offline rendering follows neither the settings nor a device
+    if ( m_Offline == false ) {
+        AdjustRate ();
+    }
+
+    // Samples per CPU cycle in 1/2^32th of a sample
+    unsigned long long step = ((( unsigned long long ) m_AudioSpec.freq << 32 ) / CPU_FREQUENCY * ( 65536 + m_RateAdjust )) >> 16;
+
+    long cycles = ( long ) ( ClockCycleCounter - m_AudioClock );
+    if (( cycles < 0 ) || ( cycles > CPU_FREQUENCY / 4 )) {
+        Resync ();
+        return;
+    }
+
+    unsigned long long total = ( unsigned long long ) cycles * step + m_AudioFraction;
+    int count = ( int ) ( total >> 32 );
+    if ( count > m_DeltaSize - BLEP_WIDTH ) {
+        Resync ();
+        return;
+    }
+
+    int end = count << 16;
+
+    // Replay the register writes at the time they belong to
+    while ( m_QueueTail != m_QueueHead ) {
+        const sSoundEvent *event = &m_Queue [ m_QueueTail ];
+        long offset = ( long ) ( event->clock - m_AudioClock );
+        int  time   = ( offset <= 0 ) ? 0 : ( int ) ((( unsigned long long ) offset * step + m_AudioFraction ) >> 16 );
+        if ( time > end ) time = end;
+        if ( m_Muted == false ) RunVoices ( time );
+        ApplyEvent ( event, time );
+        m_QueueTail = ( m_QueueTail + 1 ) & ( SOUND_QUEUE_SIZE - 1 );
+    }
+
+    if ( m_Muted == false ) RunVoices ( end );
+
+    // Next block starts at time 0
+    for ( int i = 0; i < 4; i++ ) {
+        sVoiceInfo *info = &m_Info [i];
+        info->phase = ( info->phase > end ) ? info->phase - end : 0;
+    }
+
+    m_AudioClock    = ClockCycleCounter;
+    m_AudioFraction = ( ULONG ) ( total & 0xFFFFFFFF );
+
+    RenderSamples ( count );
+}
+
+// Offline rendering : takes up to count of the samples rendered so far
+int cSdlTMS9919::ReadSamples ( Sint16 *buffer, int count )
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9919::ReadSamples", false );
+
+    if ( m_Initialized == false ) return 0;
+
+    int tail = m_RingTail;
+    if ( count > RingFill ()) count = RingFill ();
+
+    int first = m_RingSize - tail;
+    if ( first > count ) first = count;
+
+    memcpy ( buffer, m_Ring + tail, first * sizeof ( Sint16 ));
+    memcpy ( buffer + first, m_Ring, ( count - first ) * sizeof ( Sint16 ));
+
+    m_RingTail = ( tail + count ) & ( m_RingSize - 1 );
+
+    return count;
+}
+
+void cSdlTMS9919::AudioCallback ( Uint8 *stream, int length )
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9919::AudioCallback", false );
+
+    int bytes = length;
+    length = bytes / (( m_AudioSpec.format & 0xFF ) / 8 );
+
+    // Drives the frame pacer when it is slaved to the audio output
+    ti99_pacer_audio ( length, m_AudioSpec.freq );
+
+    if ( length > m_AudioSpec.samples ) length = m_AudioSpec.samples;
+
+    Sint16 *out = (( m_AudioSpec.format & 0xFF ) == 8 ) ? m_OutBuffer : ( Sint16 * ) stream;
+
+    // After an underrun wait for the ring to be back at the target
+    //   latency, the rate control alone would take seconds to refill it
+    if (( m_Priming == true ) && ( m_TargetFill != 0 ) && ( RingFill () >= m_TargetFill )) {
+        m_Priming = false;
+    }
+
+    int tail  = m_RingTail;
+    int count = ( m_Priming == true ) ? 0 : RingFill ();
+    if ( count > length ) count = length;
+
+    __sync_synchronize ();
+
+    int first = m_RingSize - tail;
+    if ( first > count ) first = count;
+
+    memcpy ( out, m_Ring + tail, first * sizeof ( Sint16 ));
+    memcpy ( out + first, m_Ring, ( count - first ) * sizeof ( Sint16 ));
+
+    __sync_synchronize ();
+    m_RingTail = ( tail + count ) & ( m_RingSize - 1 );
+
+    // Hold the last sample rather than click when the CPU falls behind
+    if ( count > 0 ) m_LastSample = out [ count - 1 ];
+    if ( count < length ) {
+        if ( m_Priming == false ) {
+            m_Underruns++;
+            m_Priming = true;
+        }
+        for ( int i = count; i < length; i++ ) out [i] = m_LastSample;
+    }
+
+    if (( m_AudioSpec.format & 0xFF ) == 8 ) {
+        loc_convert_s8 ( out, ( Sint8 * ) stream, length );
+        if (( m_AudioSpec.format & 0x8000 ) == 0 ) {
+            for ( int i = 0; i < length; i++ ) stream [i] ^= 0x80;
+        }
+    } else {
+        if (( m_AudioSpec.format & 0x8000 ) == 0 ) {
+            for ( int i = 0; i < length; i++ ) (( Uint16 * ) stream ) [i] ^= 0x8000;
+        }
     }
 }
 
@@ -233,6 +655,9 @@ int cSdlTMS9919::SetSpeechSynthesizer ( cTMS5220 *speech )
 
     m_pSpeechSynthesizer = speech;
 
+    // Without an audio device there won't be any callbacks to feed
+    if ( m_Initialized == false ) return -1;
+
     return m_AudioSpec.freq;
 }
 
@@ -245,34 +670,149 @@ void cSdlTMS9919::SetMasterVolume ( int volume )
     m_MasterVolume = volume;
 }
 
-void cSdlTMS9919::SetNoise ( NOISE_COLOR_E color, int type )
+// Queue a register write until the samples it falls in are rendered
+void cSdlTMS9919::PostEvent ( SOUND_EVENT_E type, int tone, int value )
 {
-    FUNCTION_ENTRY ( this, "cSdlTMS9919::SetNoise", true );
+    FUNCTION_ENTRY ( this, "cSdlTMS9919::PostEvent", false );
 
-    if (( color == m_NoiseColor ) && ( type == m_NoiseType )) return;
+    if ( m_Initialized == false ) return;
+
+    int head = m_QueueHead;
+    int next = ( head + 1 ) & ( SOUND_QUEUE_SIZE - 1 );
+
+    if ( next == m_QueueTail ) {
+        m_EventsDropped++;
+        return;
+    }
+
+    sSoundEvent *event = &m_Queue [ head ];
+    event->clock = ClockCycleCounter;
+    event->type  = ( UCHAR ) type;
+    event->tone  = ( UCHAR ) tone;
+    event->value = value;
+
+    m_QueueHead = next;
+}
+
+void cSdlTMS9919::ApplyEvent ( const sSoundEvent *event, int time )
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9919::ApplyEvent", false );
+
+    switch ( event->type ) {
+        case EVENT_FREQUENCY :
+            ApplyFrequency ( event->tone, event->value, time );
+            break;
+        case EVENT_ATTENUATION :
+            ApplyAttenuation ( event->tone, event->value, time );
+            break;
+        case EVENT_NOISE :
+            ApplyNoise (( NOISE_COLOR_E ) ( event->value >> 8 ), event->value & 0xFF, time );
+            break;
+    }
+}
+
+// A new period takes effect at the next edge, or right away if the voice
+//   was silent or that edge is further away than the new period
+void cSdlTMS9919::SetPeriod ( sVoiceInfo *info, int period, int time )
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9919::SetPeriod", false );
+
+    if ( period == 0 ) {
+        info->period = 0;
+        SetLevel ( info, time, 0 );
+        return;
+    }
+
+    if (( info->period == 0 ) || ( info->phase > time + period )) {
+        info->phase = time + period;
+    }
+    info->period = period;
+
+    if ( info->sign == 0 ) info->sign = 1;
+    int tone = info - m_Info;
+    SetLevel ( info, time, info->sign * ( m_VolumeTable [ m_AudioAttenuation [ tone ]] << 8 ));
+}
+
+void cSdlTMS9919::UpdateNoisePeriod ( int time )
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9919::UpdateNoisePeriod", false );
+
+    int period = 0;
+
+    if ( m_AudioFrequency [3] != 0 ) {
+        period = ( int ) ((( long long ) m_AudioSpec.freq << 16 ) / m_AudioFrequency [3] );
+        if ( period < 0x10000 ) period = 0x10000;
+    }
+
+    SetPeriod ( &m_Info [3], period, time );
+}
+
+void cSdlTMS9919::ApplyNoise ( NOISE_COLOR_E color, int type, int time )
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9919::ApplyNoise", false );
 
     // The shift register is reset when the color is changed
-    bool reset = ( color != m_NoiseColor ) ? true : false;
+    if ( color != m_AudioNoiseColor ) m_ShiftRegister = NOISE_RESET;
 
-    cTMS9919::SetNoise ( color, type );
+    m_AudioNoiseColor = color;
+    m_AudioNoiseType  = type;
 
-    if ( m_Initialized == true ) {
+    switch ( type ) {
+        case 0 : m_AudioFrequency [3] = CLOCK_FREQUENCY / 512;   break;
+        case 1 : m_AudioFrequency [3] = CLOCK_FREQUENCY / 1024;  break;
+        case 2 : m_AudioFrequency [3] = CLOCK_FREQUENCY / 2048;  break;
+        case 3 : m_AudioFrequency [3] = m_AudioFrequency [2];    break;
+    }
 
-        if ( reset ) m_ShiftRegister = NOISE_RESET;
-        m_NoiseGenerator = ( color == NOISE_WHITE ) ? NOISE_WHITE_GENERATOR : NOISE_PERIODIC_GENERATOR;
+    m_NoiseGenerator = ( color == NOISE_WHITE ) ? NOISE_WHITE_GENERATOR : NOISE_PERIODIC_GENERATOR;
 
-        sVoiceInfo *info = &m_Info [3];
+    UpdateNoisePeriod ( time );
+}
 
-        if ( m_Frequency [3] != 0 ) {
-            int volume = m_VolumeTable [ m_Attenuation [3]];
-            info->period  = ( float ) m_AudioSpec.freq / ( float ) m_Frequency [3];
-            info->setting = ( info->setting > 0 ) ? volume : -volume;
-        } else {
-            info->period = 0.0;
-        }
+void cSdlTMS9919::ApplyFrequency ( int tone, int freq, int time )
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9919::ApplyFrequency", false );
+
+    m_AudioFrequency [ tone ] = freq;
+
+    // Tones above the Nyquist frequency are silent
+    int period = 0;
+    if (( freq < m_AudioSpec.freq / 2 ) && ( freq != 0 )) {
+        period = ( int ) ((( long long ) m_AudioSpec.freq << 16 ) / ( 2 * freq ));
+    }
+    SetPeriod ( &m_Info [tone], period, time );
+
+    // If we changed voice 2, see if the noise channel needs to be updated
+    if (( tone == 2 ) && ( m_AudioNoiseType == 3 )) {
+        m_AudioFrequency [3] = m_AudioFrequency [2];
+        UpdateNoisePeriod ( time );
+    }
+}
+
+void cSdlTMS9919::ApplyAttenuation ( int tone, int atten, int time )
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9919::ApplyAttenuation", false );
+
+    m_AudioAttenuation [ tone ] = atten;
+
+    sVoiceInfo *info = &m_Info [tone];
+    if ( info->period != 0 ) {
+        if ( info->sign == 0 ) info->sign = 1;
+        SetLevel ( info, time, info->sign * ( m_VolumeTable [ atten ] << 8 ));
     }
 }
 
+void cSdlTMS9919::SetNoise ( NOISE_COLOR_E color, int type )
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9919::SetNoise", true );
+
+    if (( color == m_NoiseColor ) && ( type == m_NoiseType )) return;
+
+    cTMS9919::SetNoise ( color, type );
+
+    PostEvent ( EVENT_NOISE, 3, ( color << 8 ) | type );
+}
+
 void cSdlTMS9919::SetFrequency ( int tone, int freq )
 {
     FUNCTION_ENTRY ( this, "cSdlTMS9919::SetFrequency", true );
@@ -281,32 +821,12 @@ void cSdlTMS9919::SetFrequency ( int tone, int freq )
 
     cTMS9919::SetFrequency ( tone, freq );
 
-    if ( m_Initialized == true ) {
-
-        sVoiceInfo *info = &m_Info [tone];
-
-        if (( freq < m_AudioSpec.freq / 2 ) && ( freq != 0 )) {
-            int volume = m_VolumeTable [ m_Attenuation [ tone ]];
-            info->period  = ( float ) (( float ) m_AudioSpec.freq / ( float ) freq / 2.0 );
-            info->setting = ( info->setting > 0 ) ? volume : -volume;
-        } else {
-            info->period  = m_AudioSpec.samples;
-            info->setting = 0;
-        }
-
-        // If we changed voice 2, see if the noise channel needs to be updated
-        if (( tone == 2 ) && ( m_NoiseType == 3 )) {
-            m_Frequency [3] = m_Frequency [2];
-            sVoiceInfo *info = &m_Info [3];
-            if ( m_Frequency [3] != 0 ) {
-                int volume = m_VolumeTable [ m_Attenuation [3]];
-                info->period  = ( float ) m_AudioSpec.freq / ( float ) m_Frequency [3];
-                info->setting = ( info->setting > 0 ) ? volume : -volume;
-            } else {
-                info->period = 0.0;
-            }
-        }
+    // Periodic noise driven by voice 2 follows it
+    if (( tone == 2 ) && ( m_NoiseType == 3 )) {
+        m_Frequency [3] = m_Frequency [2];
     }
+
+    PostEvent ( EVENT_FREQUENCY, tone, freq );
 }
 
 void cSdlTMS9919::SetAttenuation ( int tone, int atten )
@@ -317,9 +837,5 @@ void cSdlTMS9919::SetAttenuation ( int tone, int atten )
 
     cTMS9919::SetAttenuation ( tone, atten );
 
-    if ( m_Initialized == true ) {
-        sVoiceInfo *info = &m_Info [tone];
-        int volume = m_VolumeTable [ m_Attenuation [ tone ]];
-        info->setting = ( info->setting > 0 ) ? volume : -volume;
-    }
+    PostEvent ( EVENT_ATTENUATION, tone, atten );
 }
@@ -30,8 +30,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#if ! defined ( __WIN32__ ) && ! defined ( PSP )
+  #include <sys/mman.h>
+  #define HAVE_MMAP
+#endif
 #include "common.hpp"
 #include "logger.hpp"
+#include "SDL/SDL.h"
 #include "cartridge.hpp"
 #include "option.hpp"
 #include "diskio.hpp"
@@ -96,13 +103,13 @@ sGromHeader::sGromHeader ( UCHAR *ptr )
     reserved2         = SWAP_ENDIAN_16 ( rawHdr->reserved2 );
 }
 
-void FindName ( cCartridge &cart )
+void FindName ( cCartridge &cart, bool show = true )
 {
     FUNCTION_ENTRY ( NULL, "FindName", true );
 
     if ( cart.Title () != NULL ) return;
 
-    printf ( "Found the following names:\n" );
+    if ( show == true ) printf ( "Found the following names:\n" );
 
     char *title = NULL;
 
@@ -121,7 +128,7 @@ void FindName ( cCartridge &cart )
                 if ( appHdr > GROM_BANK_SIZE ) break;
                 UCHAR length = data [ appHdr + 4 ];
                 UCHAR *name = &data [ appHdr + 5 ];
-                printf ( " %c %*.*s\n", title ? ' ' : MARKER_CHAR, length, length, name );
+                if ( show == true ) printf ( " %c %*.*s\n", title ? ' ' : MARKER_CHAR, length, length, name );
                 appHdr = ( data [ appHdr ] << 8 ) + data [ appHdr + 1 ];
                 if ( title == NULL ) {
                     title = ( char * ) malloc ( length + 1 );
@@ -150,7 +157,7 @@ void FindName ( cCartridge &cart )
                 if ( appHdr > ROM_BANK_SIZE ) break;
                 UCHAR length = data [ appHdr + 4 ];
                 UCHAR *name = &data [ appHdr + 5 ];
-                printf ( " %c %*.*s\n", title ? ' ' : MARKER_CHAR, length, length, name );
+                if ( show == true ) printf ( " %c %*.*s\n", title ? ' ' : MARKER_CHAR, length, length, name );
                 appHdr = ( data [ appHdr ] << 8 ) + data [ appHdr + 1 ];
                 if ( title == NULL ) {
                     title = ( char * ) malloc ( length + 1 );
@@ -162,7 +169,9 @@ void FindName ( cCartridge &cart )
 
     cart.SetTitle ( title );
 
-    printf ( "\n" );
+    free ( title );
+
+    if ( show == true ) printf ( "\n" );
 }
 
 void ShowSummary ( const cCartridge &cartridge )
@@ -219,52 +228,146 @@ void ShowSummary ( const cCartridge &cartridge )
 //----------------------------------------------------------------------------
 char *types[6] = { "RAM", "ROM", "RAMB" };
 
-int ConvertDigit ( char digit )
-{
-    FUNCTION_ENTRY ( NULL, "ConvertDigit", true );
+// Value of each character as a hex digit, -1 if it isn't one
+static const signed char HexDigit [ 256 ] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
 
-    int number = digit - '0';
-    if ( number > 9 ) number -= ( 'A' - '0' ) - 10;
-    return number;
+static inline int HexValue ( char ch )
+{
+    return HexDigit [ ( UCHAR ) ch ];
 }
 
-char *GetAddress ( char *ptr, ULONG *address )
+// A listing file is read from memory (mapped if possible).  All the state
+//   needed to read one is kept here so several can be converted at once.
+struct sListing {
+    const char    *FileName;
+    char          *Data;
+    const char    *Ptr;
+    const char    *End;
+    size_t         Size;
+    bool           Mapped;
+    bool           Quiet;                   // Don't show the progress
+    int            LineNumber;
+};
+
+bool OpenListing ( sListing *listing, const char *filename, bool quiet )
 {
-    FUNCTION_ENTRY ( NULL, "GetAddress", true );
+    FUNCTION_ENTRY ( NULL, "OpenListing", true );
 
-    *address = 0;
+    memset ( listing, 0, sizeof ( sListing ));
 
-    if ( ptr == NULL ) return NULL;
+    listing->FileName = filename;
+    listing->Quiet    = quiet;
 
-    while ( isxdigit ( *ptr )) {
-        *address <<= 4;
-        *address |= ConvertDigit ( *ptr++ );
+    FILE *file = fopen ( filename, "rb" );
+    if ( file == NULL ) return false;
+
+    fseek ( file, 0, SEEK_END );
+    size_t size = ftell ( file );
+    fseek ( file, 0, SEEK_SET );
+
+#if defined ( HAVE_MMAP )
+    if ( size > 0 ) {
+        void *ptr = mmap ( NULL, size, PROT_READ, MAP_PRIVATE, fileno ( file ), 0 );
+        if ( ptr != MAP_FAILED ) {
+            listing->Data   = ( char * ) ptr;
+            listing->Mapped = true;
+        }
     }
+#endif
 
-    while (( *ptr != '\0' ) && ! isspace ( *ptr )) ptr++;
+    if ( listing->Mapped == false ) {
+        listing->Data = new char [ size + 1 ];
+        if ( fread ( listing->Data, 1, size, file ) != size ) {
+            delete [] listing->Data;
+            listing->Data = NULL;
+            fclose ( file );
+            return false;
+        }
+    }
 
-    return ( *ptr != '\0' ) ? ptr : NULL;
+    fclose ( file );
+
+    listing->Ptr  = listing->Data;
+    listing->End  = listing->Data + size;
+    listing->Size = size;
+
+    return true;
 }
 
-static int LineNumber = 0;
-static const char *FileName;
+void CloseListing ( sListing *listing )
+{
+    FUNCTION_ENTRY ( NULL, "CloseListing", true );
+
+#if defined ( HAVE_MMAP )
+    if ( listing->Mapped == true ) {
+        munmap ( listing->Data, listing->Size );
+    } else
+#endif
+    delete [] listing->Data;
+
+    listing->Data = NULL;
+}
 
-bool ReadLine ( FILE *file, char *buffer, int length )
+// Copy the next line that isn't a comment to buffer (with a '\n' like fgets)
+bool ReadLine ( sListing *listing, char *buffer, int length )
 {
     FUNCTION_ENTRY ( NULL, "ReadLine", true );
 
     *buffer = '\0';
 
+    const char *ptr = listing->Ptr;
+    const char *end = listing->End;
+
     do {
-        fgets ( buffer, length, file );
-        LineNumber++;
-        while (( *buffer != '\0' ) && ( isspace ( *buffer ))) buffer++;
+
+        if ( ptr >= end ) {
+            listing->Ptr = ptr;
+            return false;
+        }
+
+        listing->LineNumber++;
+
+        while (( ptr < end ) && (( *ptr == ' ' ) || ( *ptr == '\t' ))) ptr++;
+
+        const char *eol  = ( const char * ) memchr ( ptr, '\n', end - ptr );
+        const char *next = ( eol != NULL ) ? eol + 1 : end;
+        if ( eol == NULL ) eol = end;
+        if (( eol > ptr ) && ( eol [-1] == '\r' )) eol--;
+
+        size_t count = eol - ptr;
+        if ( count > ( size_t ) length - 2 ) count = length - 2;
+
+        memcpy ( buffer, ptr, count );
+        buffer [ count++ ] = '\n';
+        buffer [ count ]   = '\0';
+
+        ptr = next;
+
     } while ( *buffer == '*' );
 
-    return feof ( file ) ? false : true;
+    listing->Ptr = ptr;
+
+    return true;
 }
 
-void ReadBank ( FILE *file, UCHAR *buffer, int size )
+bool ReadBank ( sListing *listing, UCHAR *buffer, int size )
 {
     FUNCTION_ENTRY ( NULL, "ReadBank", true );
 
@@ -276,68 +379,79 @@ void ReadBank ( FILE *file, UCHAR *buffer, int size )
 
     for ( int j = 0; j < size; ) {
 
-        if ( ReadLine ( file, line, sizeof ( line )) == false ) {
-            fprintf ( stderr, "\n%s:%d: Unexpected end of file\n", FileName, LineNumber );
-            exit ( -1 );
+        if ( ReadLine ( listing, line, sizeof ( line )) == false ) {
+            fprintf ( stderr, "\n%s:%d: Unexpected end of file\n", listing->FileName, listing->LineNumber );
+            return false;
         }
 
-        ULONG address;
-        char *src = GetAddress ( line, &address );
-        if ( src == NULL ) break;
+        const char *src = line;
 
-        fprintf ( stdout, "%04X", address );
-        fflush ( stdout );
+        ULONG address = 0;
+        while ( HexValue ( *src ) >= 0 ) {
+            address = ( address << 4 ) | HexValue ( *src++ );
+        }
+
+        while (( *src != '\0' ) && ! isspace ( *src )) src++;
+        if ( *src == '\0' ) break;
+
+        if ( listing->Quiet == false ) {
+            fprintf ( stdout, "%04X", address );
+            fflush ( stdout );
+        }
 
         UCHAR *dest = &buffer [ address & mask ];
+        UCHAR *last = &buffer [ size ];
 
-        int x = 0;
-        while (( *src != '\0' ) && (( unsigned ) x < max )) {
+        unsigned x = 0;
+        while (( *src != '\0' ) && ( x < max ) && ( dest < last )) {
             while (( *src == ' ' ) || ( *src == '-' )) src++;
-            if ( isxdigit ( src [0] ) && isxdigit ( src [1] )) {
-                int hi = ConvertDigit ( *src++ );
-                int lo = ConvertDigit ( *src++ );
-                if ( isxdigit ( *src )) break;
-                *dest++ = ( UCHAR ) (( hi << 4 ) | lo );
-                if ( ++j == size ) break;
-                x++;
-            } else {
-                break;
-            }
+            int hi = HexValue ( src [0] );
+            if ( hi < 0 ) break;
+            int lo = HexValue ( src [1] );
+            if ( lo < 0 ) break;
+            src += 2;
+            if ( HexValue ( *src ) >= 0 ) break;
+            *dest++ = ( UCHAR ) (( hi << 4 ) | lo );
+            if ( ++j == size ) break;
+            x++;
         }
         if (( max == ( unsigned ) -1 ) && ( x > 0 )) max = x;
     }
 
-    fprintf ( stdout, "    " );
-    fflush ( stdout );
+    if ( listing->Quiet == false ) {
+        fprintf ( stdout, "    " );
+        fflush ( stdout );
+    }
+
+    return true;
 }
 
-void ReadFile ( const char *filename, cCartridge &cartridge )
+bool ReadFile ( const char *filename, cCartridge &cartridge, bool quiet )
 {
     FUNCTION_ENTRY ( NULL, "ReadFile", true );
 
-    FILE *file = fopen ( filename, "rt" );
-    if ( file == NULL ) {
+    sListing listing;
+    if ( OpenListing ( &listing, filename, quiet ) == false ) {
         fprintf ( stderr, "Unable to open file \"%s\"\n", filename );
-        exit ( -1 );
+        return false;
     }
 
-    FileName = filename;
-    LineNumber = 0;
-
     char line [ 256 ], temp [ 10 ];
 
-    if ( ReadLine ( file, line, sizeof ( line )) == false ) {
-        fprintf ( stderr, "%s:%d: File is empty!\n", FileName, LineNumber );
-        exit ( -1 );
+    if ( ReadLine ( &listing, line, sizeof ( line )) == false ) {
+        fprintf ( stderr, "%s:%d: File is empty!\n", filename, listing.LineNumber );
+        CloseListing ( &listing );
+        return false;
     }
 
     // Look for a module title (optional)
     if ( line[0] == '[' ) {
         line [ strlen ( line ) - 2 ] = '\0';
         cartridge.SetTitle ( &line[1] );
-        if ( ReadLine ( file, line, sizeof ( line )) == false ) {
-            fprintf ( stderr, "%s:%d: File is invalid - must have at least one bank of ROM/GROM\n", FileName, LineNumber );
-            exit ( -1 );
+        if ( ReadLine ( &listing, line, sizeof ( line )) == false ) {
+            fprintf ( stderr, "%s:%d: File is invalid - must have at least one bank of ROM/GROM\n", filename, listing.LineNumber );
+            CloseListing ( &listing );
+            return false;
         }
     }
 
@@ -348,9 +462,10 @@ void ReadFile ( const char *filename, cCartridge &cartridge )
         if ( base != 0 ) {
             cartridge.SetCRU ( base );
         }
-        if ( ReadLine ( file, line, sizeof ( line )) == false ) {
-            fprintf ( stderr, "%s:%d: File is invalid - must have at least one bank of ROM/GROM\n", FileName, LineNumber );
-            exit ( -1 );
+        if ( ReadLine ( &listing, line, sizeof ( line )) == false ) {
+            fprintf ( stderr, "%s:%d: File is invalid - must have at least one bank of ROM/GROM\n", filename, listing.LineNumber );
+            CloseListing ( &listing );
+            return false;
 	}
     }
 
@@ -359,8 +474,8 @@ void ReadFile ( const char *filename, cCartridge &cartridge )
     for ( EVER ) {
 
         if ( line[0] != ';' ) {
-            fprintf ( stderr, "%s:%d: Expected line beginning with ';'.\n", FileName, LineNumber, errors++ );
-            if ( ReadLine ( file, line, sizeof ( line )) == false ) break;
+            fprintf ( stderr, "%s:%d: Expected line beginning with ';'.\n", filename, listing.LineNumber, errors++ );
+            if ( ReadLine ( &listing, line, sizeof ( line )) == false ) break;
             continue;
         }
 
@@ -370,46 +485,46 @@ void ReadFile ( const char *filename, cCartridge &cartridge )
 
         // Get the next memory type (ROM or GROM) and index
         if (( strcmp ( type, "ROM" ) != 0 ) && ( strcmp ( type, "GROM" ) != 0 )) {
-            fprintf ( stderr, "%s:%d: Invalid memory index '%s' - expected either 'ROM' or 'GROM'.\n", FileName, LineNumber, type, errors++ );
-            if ( ReadLine ( file, line, sizeof ( line )) == false ) break;
+            fprintf ( stderr, "%s:%d: Invalid memory index '%s' - expected either 'ROM' or 'GROM'.\n", filename, listing.LineNumber, type, errors++ );
+            if ( ReadLine ( &listing, line, sizeof ( line )) == false ) break;
             continue;
         }
 
         int size = ( type [0] == 'G' ) ? GROM_BANK_SIZE : ROM_BANK_SIZE;
         int maxIndex = ( type [0] == 'G' ) ? SIZE ( cartridge.GromMemory ) : SIZE ( cartridge.CpuMemory );
         if ( index > maxIndex ) {
-            fprintf ( stderr, "%s:%d: Invalid %s index indicated.\n", FileName, LineNumber, type, index, errors++ );
-            if ( ReadLine ( file, line, sizeof ( line )) == false ) break;
+            fprintf ( stderr, "%s:%d: Invalid %s index indicated.\n", filename, listing.LineNumber, type, index, errors++ );
+            if ( ReadLine ( &listing, line, sizeof ( line )) == false ) break;
             continue;
         }
         sMemoryRegion *memory = ( type [0] == 'G' ) ? &cartridge.GromMemory [index] : &cartridge.CpuMemory [index];
 
-        if ( ReadLine ( file, line, sizeof ( line )) == false ) break;
+        if ( ReadLine ( &listing, line, sizeof ( line )) == false ) break;
 
     READ_BANK:
 
         if ( line [0] != ';' ) {
-            fprintf ( stderr, "%s:%d: Expected line beginning with ';'.\n", FileName, LineNumber, errors++ );
-            if ( ReadLine ( file, line, sizeof ( line )) == false ) break;
+            fprintf ( stderr, "%s:%d: Expected line beginning with ';'.\n", filename, listing.LineNumber, errors++ );
+            if ( ReadLine ( &listing, line, sizeof ( line )) == false ) break;
             continue;
         }
 
         int bank;
         if ( sscanf ( &line[2], "%s %d - %s", temp, &bank, type ) != 3 ) {
-            fprintf ( stderr, "%s:%d: Syntax error.\n", FileName, LineNumber, errors++ );
-            if ( ReadLine ( file, line, sizeof ( line )) == false ) break;
+            fprintf ( stderr, "%s:%d: Syntax error.\n", filename, listing.LineNumber, errors++ );
+            if ( ReadLine ( &listing, line, sizeof ( line )) == false ) break;
             continue;
         }
 
         if ( strcmp ( temp, "BANK" ) != 0 ) {
-            fprintf ( stderr, "%s:%d: Syntax error - expected BANK statement.\n", FileName, LineNumber, errors++ );
-            if ( ReadLine ( file, line, sizeof ( line )) == false ) break;
+            fprintf ( stderr, "%s:%d: Syntax error - expected BANK statement.\n", filename, listing.LineNumber, errors++ );
+            if ( ReadLine ( &listing, line, sizeof ( line )) == false ) break;
             continue;
         }
 
         if (( strcmp ( type, "ROM" ) != 0 ) && ( strcmp ( type, "RAM" ) != 0 ) && ( strcmp ( type, "RAMB" ) != 0 )) {
-            fprintf ( stderr, "%s:%d: Invalid memory type '%s' - expected either 'ROM', 'RAM', or 'RAMB'.\n", FileName, LineNumber, type, errors++ );
-            if ( ReadLine ( file, line, sizeof ( line )) == false ) break;
+            fprintf ( stderr, "%s:%d: Invalid memory type '%s' - expected either 'ROM', 'RAM', or 'RAMB'.\n", filename, listing.LineNumber, type, errors++ );
+            if ( ReadLine ( &listing, line, sizeof ( line )) == false ) break;
             continue;
         }
 
@@ -427,24 +542,29 @@ void ReadFile ( const char *filename, cCartridge &cartridge )
         memory->Bank [bank].Data = ptr;
 
         if ( memoryType == MEMORY_ROM ) {
-            fprintf ( stdout, "\nReading %-4s %2d bank %d:     ", ( size == ROM_BANK_SIZE ) ? "ROM" : "GROM", index, bank );
-            fflush ( stdout );
-            ReadBank ( file, memory->Bank [bank].Data, size );
+            if ( quiet == false ) {
+                fprintf ( stdout, "\nReading %-4s %2d bank %d:     ", ( size == ROM_BANK_SIZE ) ? "ROM" : "GROM", index, bank );
+                fflush ( stdout );
+            }
+            if ( ReadBank ( &listing, memory->Bank [bank].Data, size ) == false ) {
+                errors++;
+                break;
+            }
         }
 
-        if ( ReadLine ( file, line, sizeof ( line )) == false ) break;
+        if ( ReadLine ( &listing, line, sizeof ( line )) == false ) break;
 
         if ( strnicmp ( &line [2], "BANK", 4 ) == 0 ) goto READ_BANK;
 
     }
 
-    printf ( "\n" );
+    if ( quiet == false ) {
+        printf ( "\n" );
+    }
 
-    fclose ( file );
+    CloseListing ( &listing );
 
-    if ( errors > 0 ) {
-        exit ( -1 );
-    }
+    return ( errors > 0 ) ? false : true;
 }
 
 //----------------------------------------------------------------------------
@@ -745,14 +865,14 @@ bool ReadGK ( const char *baseFilename, cCartridge &cart )
         FORMAT_FIAD,
     } type = FORMAT_FIAD;
 
-    char name [80], ext [8];
+    char name [ MAXPATH ], ext [8];
     strcpy ( name, baseFilename );
     memset ( ext, 0, sizeof ( ext ));
     char *ptr = strrchr ( name, '.' );
     char *start = strrchr ( name, FILE_SEPERATOR );
     start = ( start == NULL ) ? name : start + 1;
 
-    char filename [80];
+    char filename [ MAXPATH ];
     strcpy ( filename, baseFilename );
 
     if (( ptr != NULL ) && ( ptr < start )) {
@@ -760,7 +880,7 @@ bool ReadGK ( const char *baseFilename, cCartridge &cart )
     }
 
     if ( ptr != NULL ) {
-        strcpy ( ext, ptr );
+        strncpy ( ext, ptr, sizeof ( ext ) - 1 );
         *ptr = '\0';
         if ( stricmp ( ext, ".PROG" ) == 0 ) {
             type = FORMAT_NATIVE1;
@@ -802,6 +922,7 @@ bool ReadGK ( const char *baseFilename, cCartridge &cart )
             fread ( &fdr, 128, 1, inFile );
             if ( fdr.FileStatus != PROGRAM_TYPE ) {
                 fprintf ( stderr, "File \"%s\" is not a Gram Kracker file\n", filename );
+                fclose ( inFile );
                 return false;
             }
         }
@@ -986,14 +1107,394 @@ eFileType WhichType ( const char *fileName )
     return GK;
 }
 
+// The .ctg file is written to the current directory
+void GetOutputName ( const char *srcFilename, char *buffer )
+{
+    FUNCTION_ENTRY ( NULL, "GetOutputName", true );
+
+    const char *start = strrchr ( srcFilename, FILE_SEPERATOR );
+    start = ( start != NULL ) ? start + 1 : srcFilename;
+
+    strcpy ( buffer, start );
+
+    char *end = strrchr ( buffer, '.' );
+    if (( end != NULL ) && ( end != buffer )) *end = '\0';
+    strcat ( buffer, ".ctg" );
+}
+
+//----------------------------------------------------------------------------
+//
+// Batch conversion
+//
+// The input is either a directory or a file listing one input file per line.
+//   Each file is converted to its own cartridge object, so the conversions
+//   are simply shared out between the threads.
+//
+//----------------------------------------------------------------------------
+
+#define MAX_BATCH_THREADS       16
+
+struct sConvertJob {
+    char          *FileName;
+    char          *OutputName;
+    bool           Skip;
+    bool           Success;
+    ULONG          Time;                    // Milliseconds
+    char           Message [ 80 ];
+};
+
+struct sBatch {
+    SDL_mutex     *Mutex;
+    sConvertJob   *Job;
+    int            Count;
+    int            Max;
+    int            NextJob;
+    int            BaseCRU;
+};
+
+void AddJob ( sBatch *batch, const char *fileName )
+{
+    FUNCTION_ENTRY ( NULL, "AddJob", true );
+
+    if ( batch->Count == batch->Max ) {
+        batch->Max = ( batch->Max == 0 ) ? 64 : batch->Max * 2;
+        batch->Job = ( sConvertJob * ) realloc ( batch->Job, batch->Max * sizeof ( sConvertJob ));
+    }
+
+    sConvertJob *job = &batch->Job [ batch->Count++ ];
+    memset ( job, 0, sizeof ( sConvertJob ));
+
+    char outputName [ MAXPATH ];
+    GetOutputName ( fileName, outputName );
+
+    job->FileName   = strdup ( fileName );
+    job->OutputName = strdup ( outputName );
+}
+
+void FreeJobs ( sBatch *batch )
+{
+    FUNCTION_ENTRY ( NULL, "FreeJobs", true );
+
+    for ( int i = 0; i < batch->Count; i++ ) {
+        free ( batch->Job [i].FileName );
+        free ( batch->Job [i].OutputName );
+    }
+
+    free ( batch->Job );
+
+    batch->Job   = NULL;
+    batch->Count = 0;
+    batch->Max   = 0;
+}
+
+// A set of v9t9 files is converted by giving ReadHex the 'base' filename,
+//   i.e. fooc.bin, food.bin & foog.bin are all converted as foo.bin
+void GetBaseName ( const char *fileName, char *buffer )
+{
+    FUNCTION_ENTRY ( NULL, "GetBaseName", true );
+
+    strcpy ( buffer, fileName );
+
+    char *ext = strrchr ( buffer, '.' );
+    int len = ext - buffer;
+
+    char *suffix = NULL;
+
+    if (( len >= 2 ) && strchr ( "cC", ext [-2] ) && strchr ( "01", ext [-1] )) {
+        suffix = ext - 2;
+    } else if (( len >= 1 ) && strchr ( "cCdDgG", ext [-1] )) {
+        suffix = ext - 1;
+    }
+
+    if (( suffix != NULL ) && ( suffix != buffer ) && ( suffix [-1] != FILE_SEPERATOR )) {
+        memmove ( suffix, ext, strlen ( ext ) + 1 );
+    }
+}
+
+void AddDirectory ( sBatch *batch, const char *dirName )
+{
+    FUNCTION_ENTRY ( NULL, "AddDirectory", true );
+
+    DIR *dir = opendir ( dirName );
+    if ( dir == NULL ) return;
+
+    int first = batch->Count;
+
+    struct dirent *entry;
+    while (( entry = readdir ( dir )) != NULL ) {
+
+        if ( entry->d_name [0] == '.' ) continue;
+
+        char fileName [ MAXPATH ];
+        sprintf ( fileName, "%s%c%s", dirName, FILE_SEPERATOR, entry->d_name );
+
+        struct stat info;
+        if (( stat ( fileName, &info ) != 0 ) || ! S_ISREG ( info.st_mode )) continue;
+
+        const char *ext = strrchr ( entry->d_name, '.' );
+        if ( ext == NULL ) continue;
+
+        switch ( WhichType ( fileName )) {
+            case HEX :
+                {
+                    char baseName [ MAXPATH ];
+                    GetBaseName ( fileName, baseName );
+                    AddJob ( batch, baseName );
+                }
+                break;
+            case LST :
+                AddJob ( batch, fileName );
+                break;
+            case GK :
+                // Only the first file of a Gram Kracker set
+                if ( stricmp ( ext, ".grm" ) == 0 ) {
+                    if ( ext [-1] == '1' ) AddJob ( batch, fileName );
+                } else if ( stricmp ( ext, ".prog" ) == 0 ) {
+                    if ( ! isdigit ( ext [-1] )) AddJob ( batch, fileName );
+                }
+                break;
+            default :
+                break;
+        }
+    }
+
+    closedir ( dir );
+
+    // Drop the duplicate entries for v9t9 sets
+    int count = first;
+    for ( int i = first; i < batch->Count; i++ ) {
+        sConvertJob *job = &batch->Job [i];
+        int j = first;
+        while (( j < count ) && ( strcmp ( batch->Job [j].FileName, job->FileName ) != 0 )) j++;
+        if ( j < count ) {
+            free ( job->FileName );
+            free ( job->OutputName );
+        } else {
+            batch->Job [ count++ ] = *job;
+        }
+    }
+    batch->Count = count;
+}
+
+bool AddManifest ( sBatch *batch, const char *manifest )
+{
+    FUNCTION_ENTRY ( NULL, "AddManifest", true );
+
+    sListing listing;
+    if ( OpenListing ( &listing, manifest, true ) == false ) {
+        fprintf ( stderr, "Unable to open file \"%s\"\n", manifest );
+        return false;
+    }
+
+    char line [ MAXPATH ];
+    while ( ReadLine ( &listing, line, sizeof ( line )) == true ) {
+        char *end = line + strlen ( line );
+        while (( end > line ) && isspace ( end [-1] )) end--;
+        *end = '\0';
+        if (( line [0] == '\0' ) || ( line [0] == '#' )) continue;
+        AddJob ( batch, line );
+    }
+
+    CloseListing ( &listing );
+
+    return true;
+}
+
+bool IsEmpty ( const cCartridge &cartridge )
+{
+    FUNCTION_ENTRY ( NULL, "IsEmpty", true );
+
+    for ( unsigned i = 0; i < SIZE ( cartridge.CpuMemory ); i++ ) {
+        if ( cartridge.CpuMemory [i].NumBanks > 0 ) return false;
+    }
+    for ( unsigned i = 0; i < SIZE ( cartridge.GromMemory ); i++ ) {
+        if ( cartridge.GromMemory [i].NumBanks > 0 ) return false;
+    }
+
+    return true;
+}
+
+bool ConvertJob ( sConvertJob *job, int baseCRU )
+{
+    FUNCTION_ENTRY ( NULL, "ConvertJob", true );
+
+    cCartridge cartridge ( NULL );
+
+    bool success = false;
+
+    switch ( WhichType ( job->FileName )) {
+        case HEX :
+            ReadHex ( job->FileName, cartridge, ( baseCRU > 0 ) ? true : false );
+            success = ! IsEmpty ( cartridge );
+            break;
+        case LST :
+            success = ReadFile ( job->FileName, cartridge, true );
+            break;
+        case GK :
+            success = ReadGK ( job->FileName, cartridge ) && ! IsEmpty ( cartridge );
+            break;
+        default :
+            strcpy ( job->Message, "File type can't be converted in batch mode" );
+            return false;
+    }
+
+    if ( success == false ) {
+        if ( job->Message [0] == '\0' ) strcpy ( job->Message, "Unable to read the file" );
+        return false;
+    }
+
+    if ( baseCRU != -1 ) {
+        cartridge.SetCRU ( baseCRU );
+    }
+
+    FindName ( cartridge, false );
+
+    if ( cartridge.SaveImage ( job->OutputName ) == false ) {
+        strcpy ( job->Message, "Unable to create the .ctg file" );
+        return false;
+    }
+
+    return true;
+}
+
+int BatchThreadProc ( void *ptr )
+{
+    FUNCTION_ENTRY ( NULL, "BatchThreadProc", true );
+
+    sBatch *batch = ( sBatch * ) ptr;
+
+    for ( EVER ) {
+
+        if ( batch->Mutex != NULL ) SDL_mutexP ( batch->Mutex );
+        int index = batch->NextJob++;
+        if ( batch->Mutex != NULL ) SDL_mutexV ( batch->Mutex );
+
+        if ( index >= batch->Count ) break;
+
+        sConvertJob *job = &batch->Job [index];
+        if ( job->Skip == true ) continue;
+
+        ULONG start = SDL_GetTicks ();
+        job->Success = ConvertJob ( job, batch->BaseCRU );
+        job->Time = SDL_GetTicks () - start;
+    }
+
+    return 0;
+}
+
+int ConvertBatch ( const char *input, int threads, int baseCRU )
+{
+    FUNCTION_ENTRY ( NULL, "ConvertBatch", true );
+
+    sBatch batch;
+    memset ( &batch, 0, sizeof ( batch ));
+    batch.BaseCRU = baseCRU;
+
+    struct stat info;
+    if ( stat ( input, &info ) != 0 ) {
+        fprintf ( stderr, "Unable to open \"%s\"\n", input );
+        return -1;
+    }
+
+    if ( S_ISDIR ( info.st_mode )) {
+        AddDirectory ( &batch, input );
+    } else if ( AddManifest ( &batch, input ) == false ) {
+        return -1;
+    }
+
+    if ( batch.Count == 0 ) {
+        fprintf ( stderr, "No files to convert in \"%s\"\n", input );
+        FreeJobs ( &batch );
+        return -1;
+    }
+
+    // Two inputs that would write the same .ctg file are both left alone
+    for ( int i = 0; i < batch.Count; i++ ) {
+        for ( int j = i + 1; j < batch.Count; j++ ) {
+            if ( strcmp ( batch.Job [i].OutputName, batch.Job [j].OutputName ) != 0 ) continue;
+            batch.Job [i].Skip = batch.Job [j].Skip = true;
+            strcpy ( batch.Job [i].Message, "Another file has the same output name" );
+            strcpy ( batch.Job [j].Message, "Another file has the same output name" );
+        }
+    }
+
+    if ( threads < 1 ) threads = 1;
+    if ( threads > MAX_BATCH_THREADS ) threads = MAX_BATCH_THREADS;
+    if ( threads > batch.Count ) threads = batch.Count;
+
+    SDL_Init ( SDL_INIT_TIMER );
+
+    batch.Mutex = ( threads > 1 ) ? SDL_CreateMutex () : NULL;
+    if ( batch.Mutex == NULL ) threads = 1;
+
+    ULONG start = SDL_GetTicks ();
+
+    // The calling thread works through the list along with the others
+    SDL_Thread *thread [ MAX_BATCH_THREADS ];
+    for ( int i = 1; i < threads; i++ ) {
+        thread [i] = SDL_CreateThread ( BatchThreadProc, &batch );
+    }
+
+    BatchThreadProc ( &batch );
+
+    for ( int i = 1; i < threads; i++ ) {
+        if ( thread [i] != NULL ) SDL_WaitThread ( thread [i], NULL );
+    }
+
+    ULONG totalTime = SDL_GetTicks () - start;
+
+    if ( batch.Mutex != NULL ) SDL_DestroyMutex ( batch.Mutex );
+
+    SDL_Quit ();
+
+    printf ( "\nBatch Summary:\n" );
+
+    int converted = 0;
+    for ( int i = 0; i < batch.Count; i++ ) {
+        const sConvertJob *job = &batch.Job [i];
+        if ( job->Success == true ) {
+            printf ( "  %6lu ms  OK      %s -> %s\n", job->Time, job->FileName, job->OutputName );
+            converted++;
+        } else {
+            printf ( "  %6lu ms  FAILED  %s: %s\n", job->Time, job->FileName, job->Message );
+        }
+    }
+
+    printf ( "\n  %d of %d file%s converted in %lu ms using %d thread%s\n", converted, batch.Count, ( batch.Count != 1 ) ? "s" : "",
+             totalTime, threads, ( threads != 1 ) ? "s" : "" );
+
+    int retVal = ( converted == batch.Count ) ? 0 : -1;
+
+    FreeJobs ( &batch );
+
+    return retVal;
+}
+
 void PrintUsage ()
 {
     FUNCTION_ENTRY ( NULL, "PrintUsage", true );
 
     fprintf ( stdout, "Usage: convert-ctg [options] file\n" );
+    fprintf ( stdout, "       convert-ctg [options] --batch=<file|dir>\n" );
     fprintf ( stdout, "\n" );
 }
 
+bool ParseString ( const char *arg, void *base )
+{
+    FUNCTION_ENTRY ( NULL, "ParseString", true );
+
+    const char *ptr = strchr ( arg, '=' );
+
+    if ( ptr == NULL ) {
+        fprintf ( stderr, "A value needs to be specified: '%s'\n", arg );
+        return false;
+    }
+
+    * ( char ** ) base = strdup ( ptr + 1 );
+
+    return true;
+}
+
 bool ParseCRU ( const char *arg, void *ptr )
 {
     FUNCTION_ENTRY ( NULL, "ParseJoystick", true );
@@ -1014,11 +1515,15 @@ int main ( int argc, char *argv [] )
 
     int baseCRU = -1;
     bool dumpCartridge = false;
+    char *batchName = NULL;
+    int threads = 4;
 
     sOption optList [] = {
-        {  0,  "cru*=base",  OPT_NONE,                      0,    &baseCRU,       ParseCRU, "Create a DSR cartridge at the indicated CRU address" },
-        { 'd', "dump",       OPT_VALUE_SET | OPT_SIZE_BOOL, true, &dumpCartridge, NULL,      "Create a hex dump of the cartridge" },
-        { 'v', "verbose*=n", OPT_VALUE_PARSE_INT,           1,    &verbose,       NULL,      "Display extra information" }
+        {  0,  "batch=*<file|dir>", OPT_NONE,                      0,    &batchName,     ParseString, "Convert each file listed in <file> or found in <dir>" },
+        {  0,  "cru*=base",         OPT_NONE,                      0,    &baseCRU,       ParseCRU,    "Create a DSR cartridge at the indicated CRU address" },
+        { 'd', "dump",              OPT_VALUE_SET | OPT_SIZE_BOOL, true, &dumpCartridge, NULL,        "Create a hex dump of the cartridge" },
+        {  0,  "threads=*n",        OPT_VALUE_PARSE_INT,           4,    &threads,       NULL,        "Use n threads for a batch conversion" },
+        { 'v', "verbose*=n",        OPT_VALUE_PARSE_INT,           1,    &verbose,       NULL,        "Display extra information" }
     };
 
     if ( argc == 1 ) {
@@ -1031,6 +1536,12 @@ int main ( int argc, char *argv [] )
     int index = 1;
     index = ParseArgs ( index, argc, argv, SIZE ( optList ), optList );
 
+    if ( batchName != NULL ) {
+        int retVal = ConvertBatch ( batchName, threads, baseCRU );
+        free ( batchName );
+        return retVal;
+    }
+
     if ( index >= argc ) {
         fprintf ( stderr, "No input file specified\n" );
         return -1;
@@ -1066,7 +1577,7 @@ int main ( int argc, char *argv [] )
             ReadHex ( srcFilename, cartridge, ( baseCRU > 0 ) ? true : false );
             break;
         case LST :
-            ReadFile ( srcFilename, cartridge );
+            if ( ReadFile ( srcFilename, cartridge, false ) == false ) return -1;
             break;
         case GK :
             ReadGK ( srcFilename, cartridge );
@@ -1093,19 +1604,10 @@ int main ( int argc, char *argv [] )
     if ( dumpCartridge == true ) {
         DumpCartridge ( cartridge );
     } else {
-        char filename [256];
-        strcpy ( filename, ( dstFilename == NULL ) ? srcFilename : dstFilename );
-    
-        char *start = filename + strlen ( filename ) - 1;
-        while (( start > filename ) && ( *start != FILE_SEPERATOR )) start--;
-        if ( start != filename ) start++;
-
-        char *end = start + strlen ( start ) - 1;
-        while (( end > start ) && ( *end != '.' )) end--;
-        if ( end != start ) *end = '\0';
-        strcat ( start, ".ctg" );
+        char filename [ MAXPATH ];
+        GetOutputName (( dstFilename == NULL ) ? srcFilename : dstFilename, filename );
 
-        cartridge.SaveImage ( start );
+        cartridge.SaveImage ( filename );
     }
 
     return 0;
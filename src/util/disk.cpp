@@ -40,10 +40,13 @@
 #include "logger.hpp"
 #include "diskio.hpp"
 #include "diskfs.hpp"
+#include "disklib.hpp"
 #include "arcfs.hpp"
 #include "fileio.hpp"
 #include "option.hpp"
 #include "support.hpp"
+#include "SDL/SDL.h"
+#include "disklib-sdl.hpp"
 
 DBG_REGISTER ( __FILE__ );
 
@@ -276,11 +279,80 @@ bool ParseFileName ( const char *arg, void *base )
     return false;
 }
 
+bool ParseString ( const char *arg, void *base )
+{
+    FUNCTION_ENTRY ( NULL, "ParseString", true );
+
+    const char *ptr = strchr ( arg, '=' );
+
+    if ( ptr == NULL ) {
+        fprintf ( stderr, "A value needs to be specified: '%s'\n", arg );
+        return false;
+    }
+
+    * ( char ** ) base = strdup ( ptr + 1 );
+
+    return true;
+}
+
+int ShowLibrary ( const char *root, const char *findName, int threads, bool verbose )
+{
+    FUNCTION_ENTRY ( NULL, "ShowLibrary", true );
+
+    cDiskLibrary library ( root );
+    cSdlDiskScanner scanner ( threads );
+
+    int scanned = library.Update ( &scanner );
+    if ( scanned < 0 ) {
+        fprintf ( stderr, "Unable to update the disk library in \"%s\"\n", root );
+        return -1;
+    }
+
+    if ( verbose == true ) {
+        fprintf ( stdout, "%d disks, %d files (%d disks scanned)\n", library.DiskCount (), library.FileCount (), scanned );
+    }
+
+    fprintf ( stdout, "\n" );
+
+    if ( findName == NULL ) {
+        fprintf ( stdout, "  Volume      Free Used Files  Path\n" );
+        fprintf ( stdout, "  ==========  ==== ==== =====  ====\n" );
+        for ( int i = 0; i < library.DiskCount (); i++ ) {
+            const sLibraryDisk *disk = library.GetDisk ( i );
+            if ( disk->IsValid == true ) {
+                fprintf ( stdout, "  %10.10s  %4d %4d %5d  %s\n", disk->VolumeName, disk->FreeSectors,
+                          disk->TotalSectors - disk->FreeSectors, disk->FileCount, library.GetPath ( disk ));
+            } else {
+                fprintf ( stdout, "  <invalid>                       %s\n", library.GetPath ( disk ));
+            }
+        }
+    } else {
+        fprintf ( stdout, "  Filename    Size Type         Path\n" );
+        fprintf ( stdout, "  ==========  ==== ===========  ====\n" );
+        for ( int i = library.FindFile ( findName ); i != -1; i = library.FindFile ( findName, i + 1 )) {
+            const sLibraryFile *file = library.GetFile ( i );
+            const sLibraryDisk *disk = library.GetDisk ( file->Disk );
+            fprintf ( stdout, "  %10.10s  %4d", file->FileName, file->TotalSectors + 1 );
+            if ( file->FileStatus & PROGRAM_TYPE ) {
+                fprintf ( stdout, " PROGRAM    " );
+            } else {
+                fprintf ( stdout, " %s/%s %3d", ( file->FileStatus & INTERNAL_TYPE ) ? "INT" : "DIS",
+                                                ( file->FileStatus & VARIABLE_TYPE ) ? "VAR" : "FIX",
+                                                file->RecordLength ? file->RecordLength : DEFAULT_SECTOR_SIZE );
+            }
+            fprintf ( stdout, "  %s\n", library.GetPath ( disk ));
+        }
+    }
+
+    return 0;
+}
+
 void PrintUsage ()
 {
     FUNCTION_ENTRY ( NULL, "PrintUsage", true );
 
     fprintf ( stdout, "Usage: disk [options] file\n" );
+    fprintf ( stdout, "       disk --library=<dir> [--find=<name>]\n" );
     fprintf ( stdout, "\n" );
 }
 
@@ -292,17 +364,23 @@ int main ( int argc, char *argv[] )
     bool convertFiles = false;
     bool verboseMode  = false;
     bool showLayout   = false;
+    char *libraryDir  = NULL;
+    char *findName    = NULL;
+    int scanThreads   = 4;
     eDiskFormat outputFormat = FORMAT_UNKNOWN;
 
     sOption optList [] = {
         { 'a', "add=*<filename>",     OPT_NONE,                      true,              addFiles,      ParseFileName,  "Add <filename> to the disk image" },
         { 'c', "convert",             OPT_VALUE_SET | OPT_SIZE_BOOL, true,              &convertFiles, NULL,           "Convert extracted files to DOS files" },
         { 'd', "dump",                OPT_VALUE_SET | OPT_SIZE_BOOL, true,              &dumpFiles,    NULL,           "Extract all files to FIAD files" },
+        {  0,  "find=*<name>",        OPT_NONE,                      0,                 &findName,     ParseString,    "Search the disk library for files named *<name>*" },
         { 'l', "layout",              OPT_VALUE_SET | OPT_SIZE_BOOL, true,              &showLayout,   NULL,           "Display the disk sector layout" },
+        {  0,  "library=*<dir>",      OPT_NONE,                      0,                 &libraryDir,   ParseString,    "Update and list the disk library index of <dir>" },
         {  0,  "output=PC99",         OPT_VALUE_SET | OPT_SIZE_INT,  FORMAT_RAW_TRACK,  &outputFormat, NULL,           "Convert disk to PC99 format" },
         {  0,  "output=v9t9",         OPT_VALUE_SET | OPT_SIZE_INT,  FORMAT_RAW_SECTOR, &outputFormat, NULL,           "Convert disk to v9t9 DOAD format" },
         {  0,  "output=anadisk",      OPT_VALUE_SET | OPT_SIZE_INT,  FORMAT_ANADISK,    &outputFormat, NULL,           "Convert disk to AnaDisk format /w headers" },
         { 'r', "remove=*<filename>",  OPT_NONE,                      true,              delFiles,      ParseFileName,  "Remove <filename> from the disk image" },
+        {  0,  "threads=*n",          OPT_VALUE_PARSE_INT,           4,                 &scanThreads,  NULL,           "Scan the disk library with n threads" },
         { 'v', "verbose",             OPT_VALUE_SET | OPT_SIZE_BOOL, true,              &verboseMode,  NULL,           "Display information about the disk image" },
         { 'e', "extract*=<filename>", OPT_NONE,                      true,              extFiles,      ParseFileName,  "Extract <filename> to v9t9 FIAD file" }
     };
@@ -335,6 +413,18 @@ int main ( int argc, char *argv[] )
         }
     }
 
+    if ( libraryDir != NULL ) {
+        int retVal = ShowLibrary ( libraryDir, findName, scanThreads, verboseMode );
+        free ( libraryDir );
+        free ( findName );
+        return retVal;
+    }
+
+    if ( findName != NULL ) {
+        fprintf ( stderr, "The disk library needs to be specified with --library\n" );
+        return -1;
+    }
+
     if ( showLayout == true ) verboseMode = true;
 
     if ( validName == NULL ) {
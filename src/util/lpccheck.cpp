@@ -0,0 +1,408 @@
+//----------------------------------------------------------------------------
+//
+// File:        lpccheck.cpp
+// Date:        19-Oct-2026
+//
+// Description: Compares the fixed point TMS5220 synthesizer against the
+//              double precision code it replaced, run on the same random
+//              LPC frames, and reports the signal to noise ratio
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.hpp"
+#include "logger.hpp"
+#include "tms5220.hpp"
+#include "option.hpp"
+
+DBG_REGISTER ( __FILE__ );
+
+// The tables as the double precision synthesizer had them
+static const int ENERGY [0x10] = {
+    0, 52, 87, 123, 174, 246, 348, 491, 694, 981, 1385, 1957, 2764, 3904, 5514, 7789
+};
+
+static const int PITCH [0x40] = {
+     0,  15,  16,  17,  18,  19,  20,  21,  22,  23,  24,  25,  26,  27,  28,  29,
+    30,  31,  32,  33,  34,  35,  36,  37,  38,  39,  40,  41,  42,  44,  46,  48,
+    50,  52,  53,  56,  58,  60,  62,  65,  68,  70,  72,  76,  78,  80,  84,  86,
+    91,  94,  98, 101, 105, 109, 114, 118, 122, 127, 132, 137, 142, 148, 153, 159
+};
+
+static const double K1 [0x20] = {
+  -0.97850, -0.97270, -0.97070, -0.96680, -0.96290, -0.95900, -0.95310, -0.94140,
+  -0.93360, -0.92580, -0.91600, -0.90620, -0.89650, -0.88280, -0.86910, -0.85350,
+  -0.80420, -0.74058, -0.66019, -0.56116, -0.44296, -0.30706, -0.15735, -0.00005,
+   0.15725,  0.30696,  0.44288,  0.56109,  0.66013,  0.74054,  0.80416,  0.85350
+};
+
+static const double K2 [0x20] = {
+  -0.64000, -0.58999, -0.53500, -0.47507, -0.41039, -0.34129, -0.26830, -0.19209,
+  -0.11350, -0.03345,  0.04702,  0.12690,  0.20515,  0.28087,  0.35325,  0.42163,
+   0.48553,  0.54464,  0.59878,  0.64796,  0.69227,  0.73190,  0.76714,  0.79828,
+   0.82567,  0.84965,  0.87057,  0.88875,  0.90451,  0.91813,  0.92988,  0.98830
+};
+
+static const double K3 [0x10] = {
+  -0.86000, -0.75467, -0.64933, -0.54400, -0.43867, -0.33333, -0.22800, -0.12267,
+  -0.01733,  0.08800,  0.19333,  0.29867,  0.40400,  0.50933,  0.61467,  0.72000
+};
+
+static const double K4 [0x10] = {
+  -0.64000, -0.53145, -0.42289, -0.31434, -0.20579, -0.09723,  0.01132,  0.11987,
+   0.22843,  0.33698,  0.44553,  0.55409,  0.66264,  0.77119,  0.87975,  0.98830
+};
+
+static const double K5 [0x10] = {
+  -0.64000, -0.54933, -0.45867, -0.36800, -0.27733, -0.18667, -0.09600, -0.00533,
+   0.08533,  0.17600,  0.26667,  0.35733,  0.44800,  0.53867,  0.62933,  0.72000
+};
+
+static const double K6 [0x10] = {
+  -0.50000, -0.41333, -0.32667, -0.24000, -0.15333, -0.06667,  0.02000,  0.10667,
+   0.19333,  0.28000,  0.36667,  0.45333,  0.54000,  0.62667,  0.71333,  0.80000
+};
+
+static const double K7 [0x10] = {
+  -0.60000, -0.50667, -0.41333, -0.32000, -0.22667, -0.13333, -0.04000,  0.05333,
+   0.14667,  0.24000,  0.33333,  0.42667,  0.52000,  0.61333,  0.70667,  0.80000
+};
+
+static const double K8 [0x08] = {
+  -0.50000, -0.31429, -0.12857,  0.05714,  0.24286,  0.42857,  0.61429,  0.80000
+};
+
+static const double K9 [0x08] = {
+  -0.50000, -0.34286, -0.18571, -0.02857,  0.12857,  0.28571,  0.44286,  0.60000
+};
+
+static const double K10 [0x08] = {
+  -0.40000, -0.25714, -0.11429,  0.02857,  0.17143,  0.31429,  0.45714,  0.60000
+};
+
+static const double *COEFF_TABLE [ RC_ORDER ] = { K1, K2, K3, K4, K5, K6, K7, K8, K9, K10 };
+static const int     COEFF_SIZE  [ RC_ORDER ] = { 32, 32, 16, 16, 16, 16, 16, 8, 8, 8 };
+
+// Must match the chirp the synthesizer is built with (CHIRP == 2)
+static const double CHIRP_TABLE [30] = { 256.0 };
+
+struct sFrame {
+    int            Energy;
+    int            Pitch;
+    bool           Repeat;
+    double         Reflection [ RC_ORDER ];
+};
+
+// The double precision synthesizer, as it was before the fixed point one
+class cReference {
+
+    struct sParams {
+        int        Energy;
+        int        Pitch;
+        double     Reflection [ RC_ORDER ];
+        double     Gain;
+    };
+
+    sParams        m_Start;
+    sParams        m_Target;
+    int            m_Stage;
+    int            m_PitchIndex;
+    ULONG          m_NoiseSeed;
+    double         m_NonVoicedLevel;
+    double         m_Forward [ RC_ORDER + 1 ];
+    double         m_Backward [ RC_ORDER + 1 ];
+    double         m_DeempInput [ 3 ];
+    double         m_DeempOutput [ 4 ];
+
+    void Interpolate ( int, sParams * ) const;
+    void Deemphasize ( double *, int );
+
+public:
+
+    cReference ();
+
+    void SetFrame ( const sFrame & );
+    void CreateNextBuffer ( double * );
+
+};
+
+cReference::cReference () :
+    m_Stage ( 0 ),
+    m_PitchIndex ( 0 ),
+    m_NoiseSeed ( 1 ),
+    m_NonVoicedLevel ( 0.0 )
+{
+    FUNCTION_ENTRY ( this, "cReference ctor", true );
+
+    memset ( &m_Start, 0, sizeof ( m_Start ));
+    memset ( &m_Target, 0, sizeof ( m_Target ));
+    memset ( m_Forward, 0, sizeof ( m_Forward ));
+    memset ( m_Backward, 0, sizeof ( m_Backward ));
+    memset ( m_DeempInput, 0, sizeof ( m_DeempInput ));
+    memset ( m_DeempOutput, 0, sizeof ( m_DeempOutput ));
+
+    double sum = 0.0;
+    for ( unsigned i = 0; i < SIZE ( CHIRP_TABLE ); i++ ) {
+        sum += CHIRP_TABLE [i] * CHIRP_TABLE [i];
+    }
+    m_NonVoicedLevel = sqrt ( sum / SIZE ( CHIRP_TABLE ));
+}
+
+void cReference::SetFrame ( const sFrame &frame )
+{
+    FUNCTION_ENTRY ( this, "cReference::SetFrame", true );
+
+    memcpy ( &m_Start, &m_Target, sizeof ( sParams ));
+
+    m_Target.Energy = frame.Energy;
+    m_Target.Pitch  = frame.Pitch;
+
+    if ( frame.Repeat == false ) {
+        memcpy ( m_Target.Reflection, frame.Reflection, sizeof ( m_Target.Reflection ));
+    }
+}
+
+void cReference::Interpolate ( int stage, sParams *param ) const
+{
+    FUNCTION_ENTRY ( this, "cReference::Interpolate", true );
+
+    memcpy ( param, &m_Start, sizeof ( sParams ));
+
+    param->Energy = m_Start.Energy + stage * ( m_Target.Energy - m_Start.Energy ) / 8;
+    param->Pitch  = m_Start.Pitch + stage * ( m_Target.Pitch - m_Start.Pitch ) / 8;
+
+    if ( m_Target.Pitch == 0 ) {
+        param->Pitch = m_Start.Pitch;
+    } else if ( m_Start.Pitch == 0 ) {
+        param->Pitch = 0;
+    }
+
+    double gain = 1.0;
+    for ( int i = 0; i < RC_ORDER; i++ ) {
+        param->Reflection [i] = m_Start.Reflection [i] + stage * ( m_Target.Reflection [i] - m_Start.Reflection [i] ) / 8;
+        gain /= ( 1 - ( param->Reflection [i] * param->Reflection [i] ));
+    }
+
+    param->Gain = 0.001 * sqrt ( param->Energy / sqrt ( gain )) * sqrt (( double ) param->Pitch );
+}
+
+void cReference::Deemphasize ( double *x, int count )
+{
+    FUNCTION_ENTRY ( this, "cReference::Deemphasize", false );
+
+    double *dei = m_DeempInput;
+    double *deo = m_DeempOutput;
+
+    for ( int i = 0; i < count; i++ ) {
+        dei [0] = x [i];
+        x [i] = dei [0] - dei [1] * 1.9998 + dei [2] + deo [1] * 2.5 - deo [2] * 2.0925 + deo [3] * 0.585;
+        dei [2] = dei [1];
+        dei [1] = dei [0];
+        deo [3] = deo [2];
+        deo [2] = deo [1];
+        deo [1] = x [i];
+        x [i] *= 0.5;
+    }
+}
+
+void cReference::CreateNextBuffer ( double *buffer )
+{
+    FUNCTION_ENTRY ( this, "cReference::CreateNextBuffer", true );
+
+    sParams param;
+    Interpolate ( m_Stage, &param );
+    m_Stage = ( m_Stage + 1 ) % 8;
+
+    if ( m_PitchIndex >= param.Pitch ) {
+        m_PitchIndex = 0;
+    }
+
+    for ( int i = 0; i < INTERPOLATION_INTERVAL; i++ ) {
+
+        double sample = 0.0;
+
+        if ( param.Pitch == 0 ) {
+            // The fixed point code replaced rand () with this generator
+            m_NoiseSeed = m_NoiseSeed * 1103515245 + 12345;
+            double random = (( m_NoiseSeed >> 16 ) & 0x7FFF ) / 16384.0 - 1.0;
+            sample = m_NonVoicedLevel * random * 0.25;
+        } else {
+            if ( m_PitchIndex < ( int ) SIZE ( CHIRP_TABLE )) {
+                sample = CHIRP_TABLE [ m_PitchIndex ] * param.Gain;
+            }
+            m_PitchIndex = ( m_PitchIndex + 1 ) % param.Pitch;
+        }
+
+        m_Forward [ RC_ORDER ] = sample;
+
+        for ( int j = RC_ORDER - 1; j >= 0; j-- ) {
+            m_Forward [ j ] = m_Forward [ j + 1 ] - param.Reflection [ j ] * m_Backward [ j ];
+        }
+
+        for ( int j = RC_ORDER - 1; j >= 1; j-- ) {
+            m_Backward [ j ] = m_Backward [ j - 1 ] + param.Reflection [ j - 1 ] * m_Forward [ j - 1 ];
+        }
+
+        buffer [ i ] = m_Backward [ 0 ] = m_Forward [ 0 ];
+    }
+
+    Deemphasize ( buffer, INTERPOLATION_INTERVAL );
+}
+
+// Gets at the fixed point synthesizer one interpolation interval at a time
+class cFixedSynthesizer : public cTMS5220 {
+
+public:
+
+    cFixedSynthesizer () : cTMS5220 ( NULL )    {}
+
+    void SetFrame ( const sFrame & );
+    const int *CreateNextBuffer ();
+
+};
+
+void cFixedSynthesizer::SetFrame ( const sFrame &frame )
+{
+    FUNCTION_ENTRY ( this, "cFixedSynthesizer::SetFrame", true );
+
+    memcpy ( &m_StartParams, &m_TargetParams, sizeof ( sSpeechParams ));
+
+    m_TargetParams.Energy = frame.Energy;
+    m_TargetParams.Pitch  = frame.Pitch;
+
+    if ( frame.Repeat == false ) {
+        for ( int i = 0; i < RC_ORDER; i++ ) {
+            double k = frame.Reflection [i];
+            m_TargetParams.Reflection [i] = ( int ) ( k * ( 1 << COEFF_BITS ) + (( k < 0 ) ? -0.5 : 0.5 ));
+        }
+    }
+}
+
+const int *cFixedSynthesizer::CreateNextBuffer ()
+{
+    FUNCTION_ENTRY ( this, "cFixedSynthesizer::CreateNextBuffer", true );
+
+    cTMS5220::CreateNextBuffer ();
+
+    return m_RawDataBuffer;
+}
+
+// Random frames in the proportions real speech has them - mostly voiced,
+//   some unvoiced (K5-K10 are 0) and some repeats
+static void RandomFrame ( sFrame *frame )
+{
+    FUNCTION_ENTRY ( NULL, "RandomFrame", true );
+
+    memset ( frame, 0, sizeof ( sFrame ));
+
+    frame->Energy = ENERGY [ 1 + rand () % 14 ];
+    frame->Pitch  = (( rand () % 8 ) == 0 ) ? 0 : PITCH [ 1 + rand () % 63 ];
+    frame->Repeat = (( rand () % 8 ) == 0 ) ? true : false;
+
+    if ( frame->Repeat == false ) {
+        int count = ( frame->Pitch != 0 ) ? RC_ORDER : 4;
+        for ( int i = 0; i < count; i++ ) {
+            frame->Reflection [i] = COEFF_TABLE [i][ rand () % COEFF_SIZE [i]];
+        }
+    }
+}
+
+void PrintUsage ()
+{
+    FUNCTION_ENTRY ( NULL, "PrintUsage", true );
+
+    fprintf ( stdout, "Usage: lpccheck [options]\n" );
+    fprintf ( stdout, "\n" );
+}
+
+int main ( int argc, char *argv[] )
+{
+    FUNCTION_ENTRY ( NULL, "main", true );
+
+    int  frames  = 10000;
+    int  seed    = 1;
+    int  minSNR  = 40;
+
+    sOption optList [] = {
+        { 'f', "frames=*n",          OPT_VALUE_PARSE_INT,           10000, &frames,         NULL,            "Number of random frames to synthesize" },
+        {  0,  "seed=*n",            OPT_VALUE_PARSE_INT,           1,     &seed,           NULL,            "Seed for the random frames" },
+        {  0,  "snr=*n",             OPT_VALUE_PARSE_INT,           40,    &minSNR,         NULL,            "Lowest acceptable SNR in dB" },
+        { 'v', "verbose*=n",         OPT_VALUE_PARSE_INT,           1,     &verbose,        NULL,            "Display extra information" }
+    };
+
+    ParseArgs ( 1, argc, argv, SIZE ( optList ), optList );
+
+    srand ( seed );
+
+    cReference        reference;
+    cFixedSynthesizer synthesizer;
+
+    double signal   = 0.0;
+    double noise    = 0.0;
+    double maxError = 0.0;
+    long   samples  = 0;
+
+    for ( int i = 0; i < frames; i++ ) {
+
+        sFrame frame;
+        RandomFrame ( &frame );
+
+        reference.SetFrame ( frame );
+        synthesizer.SetFrame ( frame );
+
+        double frameSignal = 0.0;
+        double frameNoise  = 0.0;
+
+        for ( int j = 0; j < 8; j++ ) {
+            double expected [ INTERPOLATION_INTERVAL ];
+            reference.CreateNextBuffer ( expected );
+            const int *actual = synthesizer.CreateNextBuffer ();
+            for ( int k = 0; k < INTERPOLATION_INTERVAL; k++ ) {
+                // Both are in 8-bit output steps, the fixed point samples are Q12
+                double error = ( double ) actual [k] / ( 1 << SAMPLE_BITS ) - expected [k];
+                frameSignal += expected [k] * expected [k];
+                frameNoise  += error * error;
+                if ( fabs ( error ) > maxError ) maxError = fabs ( error );
+            }
+        }
+
+        if ( verbose >= 2 ) {
+            fprintf ( stdout, "%6d  En: %4d  Pi: %3d  Rpt: %d  SNR: %6.1f dB\n", i, frame.Energy, frame.Pitch, frame.Repeat,
+                      ( frameNoise > 0.0 ) ? 10.0 * log10 ( frameSignal / frameNoise ) : 999.9 );
+        }
+
+        signal  += frameSignal;
+        noise   += frameNoise;
+        samples += 8 * INTERPOLATION_INTERVAL;
+    }
+
+    double snr = ( noise > 0.0 ) ? 10.0 * log10 ( signal / noise ) : 999.9;
+
+    fprintf ( stdout, "Frames: %d  Samples: %ld  SNR: %.1f dB  Max error: %.2f (8-bit steps)\n", frames, samples, snr, maxError );
+
+    if ( snr < minSNR ) {
+        fprintf ( stdout, "FAILED - SNR is below %d dB\n", minSNR );
+        return -1;
+    }
+
+    return 0;
+}
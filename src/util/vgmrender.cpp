@@ -0,0 +1,321 @@
+//----------------------------------------------------------------------------
+//
+// File:        vgmrender.cpp
+// Date:        19-Oct-2026
+//
+// Description: Offline renderer for the VGM logs of the sound and speech
+//              chips, replays them through the emulator's own synthesis
+//              code as fast as it can into a WAV file
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "common.hpp"
+#include "logger.hpp"
+#include "SDL/SDL.h"
+#include "tms5220.hpp"
+#include "tms9919.hpp"
+#include "tms9919-sdl.hpp"
+#include "vgm.hpp"
+#include "option.hpp"
+#include "global.h"
+
+DBG_REGISTER ( __FILE__ );
+
+// The renderer drives the sound chip clock itself
+#define CPU_CLOCK               3000000
+#define FLUSH_CYCLES            50000
+
+extern "C" ULONG ClockCycleCounter;
+
+// What the SDL sound chip expects from the PSP/SDL glue
+extern "C" {
+    TI99_t TI99;
+    int  gp2xGetSoundVolume ()                  { return 100; }
+    void ti99_pacer_audio ( int, int )          { }
+}
+
+static ULONG GetLong ( const UCHAR *ptr )
+{
+    return ( ULONG ) ptr [0] | (( ULONG ) ptr [1] << 8 ) | (( ULONG ) ptr [2] << 16 ) | (( ULONG ) ptr [3] << 24 );
+}
+
+static void PutLong ( UCHAR *ptr, ULONG value )
+{
+    ptr [0] = ( UCHAR ) ( value >>  0 );
+    ptr [1] = ( UCHAR ) ( value >>  8 );
+    ptr [2] = ( UCHAR ) ( value >> 16 );
+    ptr [3] = ( UCHAR ) ( value >> 24 );
+}
+
+static void WriteWaveHeader ( FILE *file, int freq, ULONG samples )
+{
+    FUNCTION_ENTRY ( NULL, "WriteWaveHeader", true );
+
+    UCHAR header [44];
+
+    memcpy ( header + 0, "RIFF", 4 );
+    PutLong ( header + 4, 36 + samples * 2 );
+    memcpy ( header + 8, "WAVEfmt ", 8 );
+    PutLong ( header + 16, 16 );
+    PutLong ( header + 20, 0x00010001 );        // PCM, mono
+    PutLong ( header + 24, freq );
+    PutLong ( header + 28, freq * 2 );
+    PutLong ( header + 32, 0x00100002 );        // 2 bytes/frame, 16 bits
+    memcpy ( header + 36, "data", 4 );
+    PutLong ( header + 40, samples * 2 );
+
+    fseek ( file, 0, SEEK_SET );
+    fwrite ( header, sizeof ( header ), 1, file );
+}
+
+static ULONG DrainSamples ( cSdlTMS9919 *sound, FILE *file )
+{
+    FUNCTION_ENTRY ( NULL, "DrainSamples", false );
+
+    Sint16 buffer [ 4096 ];
+    ULONG  total = 0;
+
+    for ( EVER ) {
+        int count = sound->ReadSamples ( buffer, SIZE ( buffer ));
+        if ( count == 0 ) break;
+        // WAV samples are little endian
+        for ( int i = 0; i < count; i++ ) {
+            UCHAR data [2] = { ( UCHAR ) ( buffer [i] & 0xFF ), ( UCHAR ) (( USHORT ) buffer [i] >> 8 ) };
+            fwrite ( data, 2, 1, file );
+        }
+        total += count;
+    }
+
+    return total;
+}
+
+// Moves the emulated clock forward, rendering at least every FLUSH_CYCLES
+static ULONG AdvanceClock ( cSdlTMS9919 *sound, FILE *file, ULONG clock, ULONG *flushClock )
+{
+    FUNCTION_ENTRY ( NULL, "AdvanceClock", false );
+
+    ULONG total = 0;
+
+    while (( long ) ( clock - *flushClock ) >= FLUSH_CYCLES ) {
+        *flushClock      += FLUSH_CYCLES;
+        ClockCycleCounter = *flushClock;
+        sound->Flush ();
+        total += DrainSamples ( sound, file );
+    }
+    ClockCycleCounter = clock;
+
+    return total;
+}
+
+static bool RenderFile ( const char *inputFile, const char *outputFile, int freq )
+{
+    FUNCTION_ENTRY ( NULL, "RenderFile", true );
+
+    FILE *input = fopen ( inputFile, "rb" );
+    if ( input == NULL ) {
+        fprintf ( stderr, "Unable to open file \"%s\"\n", inputFile );
+        return false;
+    }
+
+    fseek ( input, 0, SEEK_END );
+    long size = ftell ( input );
+    fseek ( input, 0, SEEK_SET );
+
+    UCHAR *data = new UCHAR [ size + 1 ];
+    size = fread ( data, 1, size, input );
+    fclose ( input );
+
+    if (( size < VGM_HEADER_SIZE ) || ( memcmp ( data, "Vgm ", 4 ) != 0 )) {
+        fprintf ( stderr, "File \"%s\" is not a VGM file\n", inputFile );
+        delete [] data;
+        return false;
+    }
+
+    // Files before 1.50 have no data offset and start at 0x40
+    ULONG start = ( GetLong ( data + 0x34 ) != 0 ) ? 0x34 + GetLong ( data + 0x34 ) : VGM_HEADER_SIZE;
+    if (( GetLong ( data + 0x08 ) < VGM_VERSION ) || ( start >= ( ULONG ) size )) start = VGM_HEADER_SIZE;
+
+    FILE *output = fopen ( outputFile, "wb" );
+    if ( output == NULL ) {
+        fprintf ( stderr, "Unable to create file \"%s\"\n", outputFile );
+        delete [] data;
+        return false;
+    }
+
+    WriteWaveHeader ( output, freq, 0 );
+
+    TI99.ti99_snd_enable  = 1;
+    TI99.ti99_snd_buffer  = 1024;
+    TI99.ti99_snd_latency = TI99_SND_LATENCY_MAX;
+
+    ClockCycleCounter = 0;
+
+    cSdlTMS9919 *sound  = new cSdlTMS9919 ( freq, false );
+    cTMS5220    *speech = new cTMS5220 ( sound );
+
+    speech->WriteData ( 0x70 );  // Reset
+
+    unsigned long long samples = 0;
+    ULONG flushClock = 0;
+    ULONG written  = 0;
+    int   commands = 0;
+    bool  done     = false;
+
+    clock_t startTime = clock ();
+
+    for ( ULONG ptr = start; ( done == false ) && ( ptr < ( ULONG ) size ); ) {
+        UCHAR command = data [ ptr++ ];
+        int   wait    = 0;
+        switch ( command ) {
+            case VGM_CMD_PSG :
+                sound->WriteData ( data [ ptr++ ] );
+                break;
+            case VGM_CMD_SPEECH_WRITE :
+                // Let the chip play up to now so the FIFO has room, as the
+                //   CPU stall did when the log was recorded
+                sound->Flush ();
+                written += DrainSamples ( sound, output );
+                flushClock = ClockCycleCounter;
+                speech->WriteData ( data [ ptr++ ] );
+                break;
+            case VGM_CMD_SPEECH_READ :
+                speech->ReadData ( 0 );
+                ptr++;
+                break;
+            case VGM_CMD_WAIT :
+                wait = data [ ptr ] | ( data [ ptr + 1 ] << 8 );
+                ptr += 2;
+                break;
+            case VGM_CMD_WAIT_NTSC :
+                wait = 735;
+                break;
+            case VGM_CMD_WAIT_PAL :
+                wait = 882;
+                break;
+            case VGM_CMD_END :
+                done = true;
+                break;
+            default :
+                if (( command & 0xF0 ) == VGM_CMD_WAIT_SHORT ) {
+                    wait = ( command & 0x0F ) + 1;
+                } else if (( command >= 0x30 ) && ( command <= 0x3F )) {
+                    ptr += 1;
+                } else if (( command >= 0x40 ) && ( command <= 0x5F )) {
+                    ptr += 2;
+                } else if (( command >= 0xA0 ) && ( command <= 0xBF )) {
+                    ptr += 2;
+                } else if (( command >= 0xC0 ) && ( command <= 0xDF )) {
+                    ptr += 3;
+                } else if ( command >= 0xE0 ) {
+                    ptr += 4;
+                } else {
+                    fprintf ( stderr, "Unsupported VGM command %02X at offset %04X\n", command, ( int ) ptr - 1 );
+                    done = true;
+                }
+                break;
+        }
+        if ( wait != 0 ) {
+            samples += wait;
+            written += AdvanceClock ( sound, output, ( ULONG ) ( samples * CPU_CLOCK / VGM_SAMPLE_RATE ), &flushClock );
+        }
+        commands++;
+    }
+
+    sound->Flush ();
+    written += DrainSamples ( sound, output );
+
+    double elapsed = ( double ) ( clock () - startTime ) / CLOCKS_PER_SEC;
+
+    WriteWaveHeader ( output, freq, written );
+    fclose ( output );
+
+    delete speech;
+    delete sound;
+    delete [] data;
+
+    if ( verbose > 0 ) {
+        double length = ( double ) samples / VGM_SAMPLE_RATE;
+        fprintf ( stdout, "%d commands, %.2f seconds rendered in %.2f seconds", commands, length, elapsed );
+        if ( elapsed > 0 ) fprintf ( stdout, " (%.1fx real time)", length / elapsed );
+        fprintf ( stdout, "\n" );
+    }
+
+    return true;
+}
+
+bool ParseSampleRate ( const char *arg, void *ptr )
+{
+    FUNCTION_ENTRY ( NULL, "ParseSampleRate", true );
+
+    int freq = 0;
+
+    arg = strchr ( arg, '=' ) + 1;
+
+    if ( sscanf ( arg, "%d", &freq ) != 1 ) {
+        fprintf ( stderr, "Invalid sampling rate '%s'\n", arg );
+        return false;
+    }
+
+    if (( freq > 48000 ) || ( freq < 8000 )) {
+        fprintf ( stderr, "Sampling rate must be between 8000 and 48000\n" );
+        return false;
+    }
+
+    * ( int * ) ptr = freq;
+
+    return true;
+}
+
+void PrintUsage ()
+{
+    FUNCTION_ENTRY ( NULL, "PrintUsage", true );
+
+    fprintf ( stdout, "Usage: vgmrender [options] file.vgm file.wav\n" );
+    fprintf ( stdout, "\n" );
+}
+
+int main ( int argc, char *argv[] )
+{
+    FUNCTION_ENTRY ( NULL, "main", true );
+
+    int  samplingRate   = 44100;
+
+    sOption optList [] = {
+        { 's', "sample=*<freq>",     OPT_NONE,                      0,     &samplingRate,   ParseSampleRate, "Select sampling frequency of the output" },
+        { 'v', "verbose*=n",         OPT_VALUE_PARSE_INT,           1,     &verbose,        NULL,            "Display extra information" }
+    };
+
+    if ( argc == 1 ) {
+        PrintHelp ( SIZE ( optList ), optList );
+        return 0;
+    }
+
+    int index = ParseArgs ( 1, argc, argv, SIZE ( optList ), optList );
+
+    if ( index + 2 > argc ) {
+        PrintUsage ();
+        return -1;
+    }
+
+    return ( RenderFile ( argv [ index ], argv [ index + 1 ], samplingRate ) == true ) ? 0 : -1;
+}